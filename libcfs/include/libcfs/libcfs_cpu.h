@@ -273,6 +273,8 @@ struct cfs_percpt_lock {
 	unsigned int		  pcl_locked;
 	/* private lock table */
 	spinlock_t		**pcl_locks;
+	/* # times each private lock was found held, under the lock */
+	__u64			**pcl_contended;
 };
 
 /* return number of private locks */
@@ -293,6 +295,11 @@ void cfs_percpt_lock(struct cfs_percpt_lock *pcl, int index);
 /* unlock private lock \a index of \a pcl */
 void cfs_percpt_unlock(struct cfs_percpt_lock *pcl, int index);
 
+/* # times any private lock of \a pcl had to be waited for */
+__u64 cfs_percpt_lock_contended(struct cfs_percpt_lock *pcl);
+/* reset the contention counters, caller holds \a pcl exclusively */
+void cfs_percpt_lock_contended_reset(struct cfs_percpt_lock *pcl);
+
 #define CFS_PERCPT_LOCK_KEYS	256
 
 /* NB: don't allocate keys dynamically, lockdep needs them to be in ".data" */
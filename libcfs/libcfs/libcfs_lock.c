@@ -41,6 +41,7 @@ cfs_percpt_lock_free(struct cfs_percpt_lock *pcl)
 	LASSERT(pcl->pcl_locks != NULL);
 	LASSERT(!pcl->pcl_locked);
 
+	cfs_percpt_free(pcl->pcl_contended);
 	cfs_percpt_free(pcl->pcl_locks);
 	LIBCFS_FREE(pcl, sizeof(*pcl));
 }
@@ -73,6 +74,14 @@ cfs_percpt_lock_create(struct cfs_cpt_table *cptab,
 		return NULL;
 	}
 
+	pcl->pcl_contended = cfs_percpt_alloc(cptab,
+					      sizeof(*pcl->pcl_contended[0]));
+	if (pcl->pcl_contended == NULL) {
+		cfs_percpt_free(pcl->pcl_locks);
+		LIBCFS_FREE(pcl, sizeof(*pcl));
+		return NULL;
+	}
+
 	if (keys == NULL) {
 		CWARN("Cannot setup class key for percpt lock, you may see "
 		      "recursive locking warnings which are actually fake.\n");
@@ -114,13 +123,19 @@ __acquires(pcl->pcl_locks)
 	}
 
 	if (likely(index != CFS_PERCPT_LOCK_EX)) {
-		spin_lock(pcl->pcl_locks[index]);
+		if (unlikely(!spin_trylock(pcl->pcl_locks[index]))) {
+			spin_lock(pcl->pcl_locks[index]);
+			(*pcl->pcl_contended[index])++;
+		}
 		return;
 	}
 
 	/* exclusive lock request */
 	for (i = 0; i < ncpt; i++) {
-		spin_lock(pcl->pcl_locks[i]);
+		if (unlikely(!spin_trylock(pcl->pcl_locks[i]))) {
+			spin_lock(pcl->pcl_locks[i]);
+			(*pcl->pcl_contended[i])++;
+		}
 		if (i == 0) {
 			LASSERT(!pcl->pcl_locked);
 			/* nobody should take private lock after this
@@ -155,3 +170,33 @@ __releases(pcl->pcl_locks)
 	}
 }
 EXPORT_SYMBOL(cfs_percpt_unlock);
+
+/**
+ * Return how many times the private locks of \a pcl were found held by
+ * somebody else. The counters are read without locking.
+ */
+__u64
+cfs_percpt_lock_contended(struct cfs_percpt_lock *pcl)
+{
+	__u64	*contended;
+	__u64	sum = 0;
+	int	i;
+
+	cfs_percpt_for_each(contended, i, pcl->pcl_contended)
+		sum += READ_ONCE(*contended);
+
+	return sum;
+}
+EXPORT_SYMBOL(cfs_percpt_lock_contended);
+
+/** reset the contention counters, \a pcl is exclusively locked by caller */
+void
+cfs_percpt_lock_contended_reset(struct cfs_percpt_lock *pcl)
+{
+	__u64	*contended;
+	int	i;
+
+	cfs_percpt_for_each(contended, i, pcl->pcl_contended)
+		*contended = 0;
+}
+EXPORT_SYMBOL(cfs_percpt_lock_contended_reset);
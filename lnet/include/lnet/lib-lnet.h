@@ -420,6 +420,23 @@ lnet_peer_decref_locked(struct lnet_peer *lp)
 		lnet_destroy_peer_locked(lp);
 }
 
+/*
+ * Drop a reference taken by lnet_find_peer() without holding
+ * lnet_net_lock, which is only needed for the final put.
+ */
+static inline void
+lnet_peer_decref(struct lnet_peer *lp)
+{
+	int cpt;
+
+	if (atomic_add_unless(&lp->lp_refcount, -1, 1))
+		return;
+
+	cpt = lnet_net_lock_current();
+	lnet_peer_decref_locked(lp);
+	lnet_net_unlock(cpt);
+}
+
 static inline void
 lnet_peer_ni_addref_locked(struct lnet_peer_ni *lp)
 {
@@ -437,6 +454,24 @@ lnet_peer_ni_decref_locked(struct lnet_peer_ni *lp)
 		lnet_destroy_peer_ni_locked(lp);
 }
 
+/*
+ * Drop a reference taken by lnet_find_peer_ni() without holding
+ * lnet_net_lock, which is only needed for the final put.
+ */
+static inline void
+lnet_peer_ni_decref(struct lnet_peer_ni *lp)
+{
+	int cpt;
+
+	LASSERT(atomic_read(&lp->lpni_refcount) > 0);
+	if (atomic_add_unless(&lp->lpni_refcount, -1, 1))
+		return;
+
+	cpt = lnet_net_lock_current();
+	lnet_peer_ni_decref_locked(lp);
+	lnet_net_unlock(cpt);
+}
+
 static inline int
 lnet_isrouter(struct lnet_peer_ni *lpni)
 {
@@ -581,7 +616,8 @@ void lnet_destroy_routes(void);
 int lnet_get_route(int idx, __u32 *net, __u32 *hops,
 		   lnet_nid_t *gateway, __u32 *alive, __u32 *priority,
 		   __u32 *sensitivity);
-int lnet_get_rtr_pool_cfg(int idx, struct lnet_ioctl_pool_cfg *pool_cfg);
+int lnet_get_rtr_pool_cfg(int idx, struct lnet_ioctl_pool_cfg *pool_cfg,
+			  bool stats);
 struct lnet_ni *lnet_get_next_ni_locked(struct lnet_net *mynet,
 					struct lnet_ni *prev);
 struct lnet_ni *lnet_get_ni_idx_locked(int idx);
@@ -598,6 +634,7 @@ void lnet_router_debugfs_fini(void);
 int  lnet_rtrpools_alloc(int im_a_router);
 void lnet_destroy_rtrbuf(struct lnet_rtrbuf *rb, int npages);
 int  lnet_rtrpools_adjust(int tiny, int small, int large);
+void lnet_rtrpools_autosize(void);
 int lnet_rtrpools_enable(void);
 void lnet_rtrpools_disable(void);
 void lnet_rtrpools_free(int keep_pools);
@@ -669,6 +706,9 @@ lnet_ptl_unsetopt(struct lnet_portal *ptl, int opt)
 /* match-table functions */
 struct list_head *lnet_mt_match_head(struct lnet_match_table *mtable,
 			       struct lnet_process_id id, __u64 mbits);
+void lnet_mt_grow(struct lnet_match_table *mtable);
+int lnet_mt_match_bench(unsigned int nmes, bool wildcard, unsigned int bits,
+			__u64 *nsec);
 struct lnet_match_table *lnet_mt_of_attach(unsigned int index,
 					   struct lnet_process_id id,
 					   __u64 mbits, __u64 ignore_bits,
@@ -744,6 +784,34 @@ bool lnet_delay_rule_match_locked(struct lnet_hdr *hdr, struct lnet_msg *msg);
 
 /** @} lnet_fault_simulation */
 
+/** \addtogroup lnet_trace @{ */
+
+extern unsigned int lnet_trace_sample;
+
+int lnet_trace_init(void);
+void lnet_trace_fini(void);
+int lnet_trace_dump(struct lnet_ioctl_trace_dump *dump);
+void lnet_trace_msg_sample(struct lnet_msg *msg);
+void lnet_trace_record(struct lnet_msg *msg, enum lnet_trace_event event,
+		       int status);
+
+/* give \a msg a trace id if it is the 1 in lnet_trace_sample */
+static inline void
+lnet_trace_sample_msg(struct lnet_msg *msg)
+{
+	if (READ_ONCE(lnet_trace_sample) != 0 && msg->msg_trace_id == 0)
+		lnet_trace_msg_sample(msg);
+}
+
+static inline void
+lnet_trace(struct lnet_msg *msg, enum lnet_trace_event event, int status)
+{
+	if (unlikely(msg->msg_trace_id != 0))
+		lnet_trace_record(msg, event, status);
+}
+
+/** @} lnet_trace */
+
 void lnet_counters_get_common(struct lnet_counters_common *common);
 void lnet_counters_get(struct lnet_counters *counters);
 void lnet_counters_reset(void);
@@ -923,8 +991,13 @@ struct lnet_peer_ni *lnet_nid2peerni_ex(lnet_nid_t nid, int cpt);
 struct lnet_peer_ni *lnet_peer_get_ni_locked(struct lnet_peer *lp,
 					     lnet_nid_t nid);
 struct lnet_peer_ni *lnet_find_peer_ni_locked(lnet_nid_t nid);
+struct lnet_peer_ni *lnet_find_peer_ni(lnet_nid_t nid);
 struct lnet_peer *lnet_find_peer(lnet_nid_t nid);
 void lnet_peer_net_added(struct lnet_net *net);
+void lnet_peer_credits_rebalance(void);
+void lnet_peer_ni_set_txcredits(struct lnet_peer_ni *lpni, int target,
+				struct list_head *released);
+void lnet_post_released_sends(struct list_head *released);
 lnet_nid_t lnet_peer_primary_nid_locked(lnet_nid_t nid);
 int lnet_discover_peer_locked(struct lnet_peer_ni *lpni, int cpt, bool block);
 int lnet_peer_discovery_start(void);
@@ -940,7 +1013,8 @@ bool lnet_peer_is_pref_nid_locked(struct lnet_peer_ni *lpni, lnet_nid_t nid);
 int lnet_peer_ni_set_non_mr_pref_nid(struct lnet_peer_ni *lpni, lnet_nid_t nid);
 int lnet_add_peer_ni(lnet_nid_t key_nid, lnet_nid_t nid, bool mr);
 int lnet_del_peer_ni(lnet_nid_t key_nid, lnet_nid_t nid);
-int lnet_get_peer_info(struct lnet_ioctl_peer_cfg *cfg, void __user *bulk);
+int lnet_get_peer_info(struct lnet_ioctl_peer_cfg *cfg, void __user *bulk,
+		       __u32 flags);
 int lnet_get_peer_ni_info(__u32 peer_index, __u64 *nid,
 			  char alivness[LNET_MAX_STR_LEN],
 			  __u32 *cpt_iter, __u32 *refcount,
@@ -155,6 +155,12 @@ struct lnet_msg {
 
 	struct lnet_peer_ni  *msg_txpeer;         /* peer I'm sending to */
 	struct lnet_peer_ni  *msg_rxpeer;         /* peer I received from */
+	/* path of msg_txni -> msg_txpeer the send is accounted on */
+	struct lnet_peer_path *msg_txpath;
+	/* when the send was handed to msg_txpath */
+	ktime_t			msg_txpath_start;
+	/* trace ring id of a sampled message, 0 if it is not traced */
+	__u64			msg_trace_id;
 
 	void                 *msg_private;
 	struct lnet_libmd    *msg_md;
@@ -173,6 +179,22 @@ struct lnet_msg {
 	struct lnet_hdr		msg_hdr;
 };
 
+/*
+ * Per-CPU ring of struct lnet_trace_rec.  Only the owning CPU writes it,
+ * with preemption disabled, so no lock is needed; readers detect records
+ * overwritten while they were copied by re-reading tr_head.
+ */
+struct lnet_trace_ring {
+	/* number of records ever written, the next slot is tr_head & mask */
+	unsigned long		tr_head;
+	/* ids handed out to messages sampled on this CPU */
+	__u64			tr_seq;
+	/* messages left before the next one is sampled */
+	int			tr_countdown;
+	unsigned int		tr_mask;
+	struct lnet_trace_rec	tr_recs[0];
+};
+
 struct lnet_libhandle {
 	struct list_head	lh_hash_chain;
 	__u64			lh_cookie;
@@ -421,6 +443,14 @@ struct lnet_net {
 
 	/* protects access to net_last_alive */
 	spinlock_t		net_lock;
+
+	/* how NIs and peer NIs are chosen, enum lnet_sel_policy */
+	__u32			net_sel_policy;
+
+	/* dynamic peer credits: credits handed out above the minimum
+	 * and what the peers asked for at the last pass */
+	long			net_pc_budget;
+	long			net_pc_wanted;
 };
 
 struct lnet_ni {
@@ -530,6 +560,24 @@ struct lnet_ping_buffer {
 #define LNET_PING_INFO_TO_BUFFER(PINFO)	\
 	container_of((PINFO), struct lnet_ping_buffer, pb_info)
 
+/* # local NIs a peer NI keeps latency statistics for */
+#define LNET_PEER_NPATHS	4
+
+/* Statistics of the path between a local NI and a peer NI, used by the
+ * latency aware selection policy.  Updates are racy but harmless. */
+struct lnet_peer_path {
+	/* local NI, never dereferenced; NULL if the slot is unused */
+	struct lnet_ni		*lpp_ni;
+	/* EWMA of the send completion time (ns) */
+	__u64			lpp_ewma_ns;
+	/* EWMA of the message size (bytes) */
+	__u64			lpp_ewma_nob;
+	/* bytes handed to this path and not completed yet */
+	atomic64_t		lpp_outstanding;
+	/* # completed sends */
+	__u64			lpp_nsamples;
+};
+
 struct lnet_peer_ni {
 	/* chain on lpn_peer_nis */
 	struct list_head	lpni_peer_nis;
@@ -537,8 +585,10 @@ struct lnet_peer_ni {
 	struct list_head	lpni_on_remote_peer_ni_list;
 	/* chain on recovery queue */
 	struct list_head	lpni_recovery;
-	/* chain on peer hash */
+	/* chain on peer hash, walked under RCU by lookups */
 	struct list_head	lpni_hashlist;
+	/* chain on pt_zombie_list once unhashed */
+	struct list_head	lpni_zombie_list;
 	/* messages blocking for tx credits */
 	struct list_head	lpni_txq;
 	/* pointer to peer net I'm part of */
@@ -548,10 +598,18 @@ struct lnet_peer_ni {
 	struct lnet_health_remote_stats lpni_hstats;
 	/* spin lock protecting credits and lpni_txq */
 	spinlock_t		lpni_lock;
-	/* # tx credits available */
-	int			lpni_txcredits;
+	/* # tx credits available, only taken under lpni_lock when they
+	 * run out and the message has to be queued on lpni_txq */
+	atomic_t		lpni_txcredits;
 	/* low water mark */
 	int			lpni_mintxcredits;
+	/* tx credits currently allotted to this peer NI; the static
+	 * peer_credits unless dynamic_peer_credits is rebalancing */
+	int			lpni_maxtxcredits;
+	/* low water mark since the last rebalancing pass */
+	int			lpni_win_mintxcredits;
+	/* credits this peer NI wanted at the last rebalancing pass */
+	int			lpni_txdemand;
 	/*
 	 * Each peer_ni in a gateway maintains its own credits. This
 	 * allows more traffic to gateways that have multiple interfaces.
@@ -561,7 +619,7 @@ struct lnet_peer_ni {
 	/* low water mark */
 	int			lpni_minrtrcredits;
 	/* bytes queued for sending */
-	long			lpni_txqnob;
+	atomic_long_t		lpni_txqnob;
 	/* network peer is on */
 	struct lnet_net		*lpni_net;
 	/* peer's NID */
@@ -593,6 +651,10 @@ struct lnet_peer_ni {
 	} lpni_pref;
 	/* number of preferred NIDs in lnpi_pref_nids */
 	__u32			lpni_pref_nnids;
+	/* paths from local NIs, for LNET_SEL_POLICY_LATENCY */
+	struct lnet_peer_path	lpni_paths[LNET_PEER_NPATHS];
+	/* deferred free, lookups may still be walking lpni_hashlist */
+	struct rcu_head		lpni_rcu;
 };
 
 /* Preferred path added due to traffic on non-MR peer_ni */
@@ -691,6 +753,9 @@ struct lnet_peer {
 
 	/* tasks waiting on discovery of this peer */
 	wait_queue_head_t	lp_dc_waitq;
+
+	/* deferred free, lockless lookups may still follow lpn_peer */
+	struct rcu_head		lp_rcu;
 };
 
 /*
@@ -772,6 +837,9 @@ struct lnet_peer_net {
 
 	/* reference count */
 	atomic_t		lpn_refcount;
+
+	/* deferred free, lockless lookups may still follow lpni_peer_net */
+	struct rcu_head		lpn_rcu;
 };
 
 /* peer hash size */
@@ -787,6 +855,10 @@ struct lnet_peer_net {
  *    pt_hash[...]
  *    pt_peer_list
  *    pt_peers
+ * pt_hash[...] chains are also RCU lists: lookups walk them under
+ * rcu_read_lock() only. A peer_ni, peer_net and peer are freed after a
+ * grace period, so that lnet_find_peer() can follow lpni_peer_net and
+ * lpn_peer without lnet_net_lock.
  * protected by pt_zombie_lock:
  *    pt_zombie_list
  *    pt_zombies
@@ -858,6 +930,18 @@ struct lnet_rtrbufpool {
 	int			rbp_credits;
 	/* low water mark */
 	int			rbp_mincredits;
+	/* low water mark since the last auto-sizing pass */
+	int			rbp_win_mincredits;
+	/* high water mark of rbp_nbuffers */
+	int			rbp_hw_nbuffers;
+	/* # passes the pool has had spare buffers, for auto-sizing */
+	int			rbp_idle_passes;
+	/* # passes left before the pool may grow again */
+	int			rbp_grow_hold;
+	/* # messages which had to wait for a buffer */
+	__u64			rbp_nblocked;
+	/* rbp_nblocked as of the last auto-sizing pass */
+	__u64			rbp_nblocked_seen;
 };
 
 struct lnet_rtrbuf {
@@ -897,19 +981,20 @@ struct lnet_match_info {
 	unsigned int		mi_roffset;
 };
 
-/* ME hash of RDMA portal */
+/* ME hash of RDMA portal, it starts with 2^LNET_MT_HASH_BITS chains and
+ * grows 4 times once it has LNET_MT_HASH_LOAD MEs per chain */
 #define LNET_MT_HASH_BITS		8
-#define LNET_MT_HASH_SIZE		(1 << LNET_MT_HASH_BITS)
-#define LNET_MT_HASH_MASK		(LNET_MT_HASH_SIZE - 1)
-/* we allocate (LNET_MT_HASH_SIZE + 1) entries for lnet_match_table::mt_hash,
+#define LNET_MT_HASH_BITS_MAX		14
+#define LNET_MT_HASH_BITS_STEP		2
+#define LNET_MT_HASH_LOAD		4
+/* we allocate (2^mt_hash_bits + 1) entries for lnet_match_table::mt_mhash,
  * the last entry is reserved for MEs with ignore-bits */
-#define LNET_MT_HASH_IGNORE		LNET_MT_HASH_SIZE
-/* __u64 has 2^6 bits, so need 2^(LNET_MT_HASH_BITS - LNET_MT_BITS_U64) which
- * is 4 __u64s as bit-map, and add an extra __u64 (only use one bit) for the
- * ME-list with ignore-bits, which is mtable::mt_hash[LNET_MT_HASH_IGNORE] */
+#define LNET_MT_HASH_IGNORE(bits)	(1U << (bits))
+/* __u64 has 2^6 bits, so need 2^(bits - LNET_MT_BITS_U64) __u64s as
+ * bit-map, and add an extra __u64 (only use one bit) for the ME-list with
+ * ignore-bits, which is mtable::mt_mhash[LNET_MT_HASH_IGNORE(bits)] */
 #define LNET_MT_BITS_U64		6	/* 2^6 bits */
-#define LNET_MT_EXHAUSTED_BITS		(LNET_MT_HASH_BITS - LNET_MT_BITS_U64)
-#define LNET_MT_EXHAUSTED_BMAP		((1 << LNET_MT_EXHAUSTED_BITS) + 1)
+#define LNET_MT_EXHAUSTED_BMAP(bits)	((1 << ((bits) - LNET_MT_BITS_U64)) + 1)
 
 /* portal match table */
 struct lnet_match_table {
@@ -919,8 +1004,12 @@ struct lnet_match_table {
 	/* match table is set as "enabled" if there's non-exhausted MD
 	 * attached on mt_mhash, it's only valid for wildcard portal */
 	unsigned int		mt_enabled;
-	/* bitmap to flag whether MEs on mt_hash are exhausted or not */
-	__u64			mt_exhausted[LNET_MT_EXHAUSTED_BMAP];
+	/* mt_mhash has 2^mt_hash_bits chains plus the ignore-bits one */
+	unsigned int		mt_hash_bits;
+	/* # MEs on the hash chains, MEs with ignore-bits not counted */
+	unsigned int		mt_nmes;
+	/* bitmap to flag whether MEs on mt_mhash are exhausted or not */
+	__u64			*mt_exhausted;
 	struct list_head	*mt_mhash;	/* matching hash */
 };
 
@@ -1142,6 +1231,8 @@ struct lnet {
 	struct list_head		**ln_mt_rstq;
 	/* recovery eq handler */
 	struct lnet_handle_eq		ln_mt_eqh;
+	/* per-CPU message trace rings, indexed by CPU id */
+	struct lnet_trace_ring		**ln_trace_rings;
 
 };
 
@@ -113,6 +113,13 @@ struct lnet_ioctl_pool_cfg {
 		__u32 pl_mincredits;
 	} pl_pools[LNET_NRBPOOLS];
 	__u32 pl_routing;
+	/* only filled in if the caller's buffer is large enough */
+	__u32 pl_padding;
+	struct {
+		__u32 pl_maxbuffers;	/* high water of pl_nbuffers */
+		__u32 pl_padding;
+		__u64 pl_nblocked;	/* # msgs which waited for a buffer */
+	} pl_stats[LNET_NRBPOOLS];
 };
 
 struct lnet_ioctl_ping_data {
@@ -265,6 +272,84 @@ struct lnet_ioctl_peer_cfg {
 	__u32 prcfg_state;
 	__u32 prcfg_size;
 	void __user *prcfg_bulk;
+	/* LNET_PEER_INFO_F_*, absent from older tools */
+	__u32 prcfg_flags;
+};
+
+/* IOC_LIBCFS_GET_PEER_NI: append lnet_ioctl_peer_ni_tx_alloc to each
+ * peer NI in the bulk. Older kernels ignore it, so check prcfg_size. */
+#define LNET_PEER_INFO_F_TX_ALLOC	0x1
+
+struct lnet_ioctl_peer_ni_tx_alloc {
+	__s32 pta_tx_credits;		/* tx credits allotted right now */
+	__s32 pta_tx_demand;		/* most in use during the last second */
+	__s32 pta_tx_floor;		/* kept with dynamic peer credits */
+	__u32 pta_dynamic;		/* dynamic peer credits enabled */
+};
+
+/* How a net picks the local NI and peer NI to send over */
+enum lnet_sel_policy {
+	/* health, NUMA distance, credits, then round-robin */
+	LNET_SEL_POLICY_DEFAULT = 0,
+	/* health, then the lowest expected completion time from the
+	 * measured latency and bytes outstanding on each path */
+	LNET_SEL_POLICY_LATENCY = 1,
+	LNET_SEL_POLICY_MAX
+};
+
+struct lnet_ioctl_net_sel_policy {
+	struct libcfs_ioctl_hdr nsp_hdr;
+	__u32 nsp_net;		/* net to set or query */
+	__u32 nsp_policy;	/* enum lnet_sel_policy */
+	__u32 nsp_set;		/* set nsp_policy rather than query it */
+	__u32 nsp_padding;
+};
+
+/* Points in the life of a sampled message recorded in the trace ring */
+enum lnet_trace_event {
+	LNET_TRACE_SEND		= 1,	/* handed to lnet_send() */
+	LNET_TRACE_WAIT_PEER	= 2,	/* queued for a peer tx credit */
+	LNET_TRACE_WAIT_NI	= 3,	/* queued for an NI tx credit */
+	LNET_TRACE_WAIT_RTR	= 4,	/* queued for a router buffer/credit */
+	LNET_TRACE_LND_SEND	= 5,	/* passed to the LND */
+	LNET_TRACE_RECV		= 6,	/* arrived in lnet_parse() */
+	LNET_TRACE_LND_RECV	= 7,	/* payload receive started in the LND */
+	LNET_TRACE_DONE		= 8,	/* lnet_finalize() */
+	LNET_TRACE_EVENT_MAX
+};
+
+#define LNET_TRACE_F_SENDING	0x01	/* outgoing side of the message */
+#define LNET_TRACE_F_ROUTING	0x02	/* being forwarded by this router */
+#define LNET_TRACE_F_RESEND	0x04	/* resent after a failure */
+
+/* One trace ring record, also the record format of "lnetctl trace dump" */
+struct lnet_trace_rec {
+	__u64	ltr_time_ns;	/* ktime_get_ns() on the recording CPU */
+	__u64	ltr_id;		/* shared by all records of one message */
+	__u64	ltr_cookie;	/* wire handle linking PUT/GET to ACK/REPLY,
+				 * only set for LNET_TRACE_SEND and RECV */
+	__u64	ltr_ni_nid;	/* local NI */
+	__u64	ltr_peer_nid;	/* next hop (or destination before the
+				 * path is selected) when sending,
+				 * previous hop when receiving */
+	__u32	ltr_len;	/* payload length */
+	__s32	ltr_status;	/* completion status for LNET_TRACE_DONE */
+	__u16	ltr_event;	/* enum lnet_trace_event */
+	__u8	ltr_msg_type;	/* LNET_MSG_* */
+	__u8	ltr_flags;	/* LNET_TRACE_F_* */
+	__u32	ltr_cpu;
+};
+
+struct lnet_ioctl_trace_dump {
+	struct libcfs_ioctl_hdr ltd_hdr;
+	__u32 ltd_cpu;		/* in: CPU whose ring is copied */
+	__u32 ltd_count;	/* in: records ltd_buf can hold
+				 * out: records copied */
+	__u32 ltd_ncpus;	/* out: number of possible CPU ids */
+	__u32 ltd_sample;	/* out: 1 in ltd_sample messages is traced */
+	__u64 ltd_lost;		/* out: records written before the first
+				 * one copied, overwritten or no room */
+	void __user *ltd_buf;
 };
 
 struct lnet_ioctl_reset_health_cfg {
@@ -253,9 +253,18 @@ struct lnet_counters_health {
 	__u32	lch_network_timeout_count;
 };
 
+struct lnet_counters_lock {
+	__u64	lcl_net_lock_contended;
+	__u64	lcl_res_lock_contended;
+	__u64	lcl_peer_credit_fast;
+	__u64	lcl_peer_credit_locked;
+};
+
 struct lnet_counters {
 	struct lnet_counters_common lct_common;
 	struct lnet_counters_health lct_health;
+	/* appended, older tools don't ask for it */
+	struct lnet_counters_lock lct_lock;
 };
 
 #define LNET_NI_STATUS_UP	0x15aac0de
@@ -39,9 +39,11 @@
 
 #define LST_FEAT_NONE		(0)
 #define LST_FEAT_BULK_LEN	(1 << 0)	/* enable variable page size */
+#define LST_FEAT_LATENCY	(1 << 1)	/* latency stats, open-loop rate */
 
 #define LST_FEATS_EMPTY		(LST_FEAT_NONE)
-#define LST_FEATS_MASK		(LST_FEAT_NONE | LST_FEAT_BULK_LEN)
+#define LST_FEATS_MASK		(LST_FEAT_NONE | LST_FEAT_BULK_LEN | \
+				 LST_FEAT_LATENCY)
 
 #define LST_NAME_SIZE		32		/* max name buffer length */
 
@@ -427,6 +429,13 @@ struct lstio_stat_args {
 	struct lnet_process_id __user *lstio_sta_idsp;
 	/* OUT: list head of result buffer */
 	struct list_head __user *lstio_sta_resultp;
+	/* IN: LST_STAT_COUNTERS or LST_STAT_LATENCY */
+	int			lstio_sta_type;
+};
+
+enum lst_stat_type {
+	LST_STAT_COUNTERS	= 0,	/* sfw, srpc and LNet counters */
+	LST_STAT_LATENCY	= 1,	/* struct sfw_lat_counters */
 };
 
 enum lst_test_type {
@@ -464,6 +473,8 @@ struct lstio_test_args {
 	int __user		*lstio_tes_retp;
 	/* OUT: list head of result buffer */
 	struct list_head __user *lstio_tes_resultp;
+	/* IN: open-loop RPCs/s per client node, 0 for closed loop */
+	int			lstio_tes_rate;
 };
 
 enum lst_brw_type {
@@ -512,4 +523,21 @@ struct sfw_counters {
 	__u32 ping_errors;
 } WIRE_ATTR;
 
+/**
+ * RPC round trip latency of the test clients on a node, since the
+ * previous latency query of the session. Percentiles come from a
+ * log-linear histogram and are accurate to 1/8th of their value.
+ */
+struct sfw_lat_counters {
+	__u64 lat_count;	/* # of RPCs completed */
+	__u64 lat_min_ns;
+	__u64 lat_max_ns;
+	__u64 lat_avg_ns;
+	__u64 lat_p50_ns;
+	__u64 lat_p99_ns;
+	__u64 lat_p999_ns;
+	/* open-loop RPCs sent late because all units were busy */
+	__u64 lat_late;
+} WIRE_ATTR;
+
 #endif
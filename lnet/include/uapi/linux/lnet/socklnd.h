@@ -32,6 +32,8 @@
 #ifndef __UAPI_LNET_SOCKLND_H__
 #define __UAPI_LNET_SOCKLND_H__
 
+#include <linux/types.h>
+
 #define SOCKLND_CONN_NONE     (-1)
 #define SOCKLND_CONN_ANY	0
 #define SOCKLND_CONN_CONTROL	1
@@ -41,4 +43,15 @@
 
 #define SOCKLND_CONN_ACK	SOCKLND_CONN_BULK_IN
 
+/* Per-connection traffic counters, returned by IOC_LIBCFS_GET_CONN in
+ * ioc_pbuf1 when the caller supplies a buffer large enough for them */
+struct ksock_conn_stats {
+	__u64	kcs_tx_bytes;
+	__u64	kcs_tx_msgs;
+	__u64	kcs_rx_bytes;
+	__u64	kcs_rx_msgs;
+	__u32	kcs_stripe;	/* index among the route's conns of a type */
+	__u32	kcs_padding;
+};
+
 #endif
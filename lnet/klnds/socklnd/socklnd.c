@@ -79,8 +79,10 @@ ksocknal_create_route(__u32 ipaddr, int port)
         route->ksnr_connecting = 0;
         route->ksnr_connected = 0;
         route->ksnr_deleted = 0;
+	route->ksnr_no_stripe = 0;
         route->ksnr_conn_count = 0;
         route->ksnr_share_count = 0;
+	memset(route->ksnr_ctype_count, 0, sizeof(route->ksnr_ctype_count));
 
         return (route);
 }
@@ -318,6 +320,29 @@ out:
 	return rc;
 }
 
+/*
+ * Lowest stripe index not used by another connection of \a type on
+ * \a route, so that indices are reused once a connection closes.
+ * The connection being associated is not on ksnp_conns yet.
+ */
+static unsigned int
+ksocknal_route_free_stripe_locked(struct ksock_route *route, int type)
+{
+	struct ksock_conn *conn;
+	unsigned int stripe = 0;
+
+again:
+	list_for_each_entry(conn, &route->ksnr_peer->ksnp_conns, ksnc_list) {
+		if (conn->ksnc_route == route && conn->ksnc_type == type &&
+		    conn->ksnc_stripe == stripe) {
+			stripe++;
+			goto again;
+		}
+	}
+
+	return stripe;
+}
+
 static void
 ksocknal_associate_route_conn_locked(struct ksock_route *route, struct ksock_conn *conn)
 {
@@ -356,6 +381,8 @@ ksocknal_associate_route_conn_locked(struct ksock_route *route, struct ksock_con
 
         route->ksnr_connected |= (1<<type);
         route->ksnr_conn_count++;
+	conn->ksnc_stripe = ksocknal_route_free_stripe_locked(route, type);
+	route->ksnr_ctype_count[type]++;
 
         /* Successful connection => further attempts can
          * proceed immediately */
@@ -1027,6 +1054,7 @@ ksocknal_create_conn(struct lnet_ni *ni, struct ksock_route *route,
 	struct ksock_sched *sched;
 	struct ksock_hello_msg *hello;
 	int cpt;
+	int i;
 	struct ksock_tx *tx;
 	struct ksock_tx *txtmp;
 	int rc;
@@ -1199,6 +1227,17 @@ ksocknal_create_conn(struct lnet_ni *ni, struct ksock_route *route,
         case 0:
                 break;
         case EALREADY:
+		/* A peer which already has a bulk connection of this type
+		 * refusing another one doesn't stripe: stop asking. */
+		if (active &&
+		    (conn->ksnc_type == SOCKLND_CONN_BULK_IN ||
+		     conn->ksnc_type == SOCKLND_CONN_BULK_OUT) &&
+		    route->ksnr_ctype_count[conn->ksnc_type] > 0 &&
+		    !route->ksnr_no_stripe) {
+			CDEBUG(D_NET, "%s refused extra type %d conn, not striping\n",
+			       libcfs_id2str(peerid), conn->ksnc_type);
+			route->ksnr_no_stripe = 1;
+		}
                 warn = "lost conn race";
                 goto failed_2;
         case EPROTO:
@@ -1207,8 +1246,16 @@ ksocknal_create_conn(struct lnet_ni *ni, struct ksock_route *route,
         }
 
 	/* Refuse to duplicate an existing connection, unless this is a
-	 * loopback connection */
+	 * loopback connection or an extra bulk connection to stripe over */
 	if (conn->ksnc_ipaddr != conn->ksnc_myipaddr) {
+		int nstripe = 1;
+		int ndup = 0;
+
+		if (*ksocknal_tunables.ksnd_typed_conns &&
+		    (conn->ksnc_type == SOCKLND_CONN_BULK_IN ||
+		     conn->ksnc_type == SOCKLND_CONN_BULK_OUT))
+			nstripe = *ksocknal_tunables.ksnd_conns_per_peer;
+
 		list_for_each(tmp, &peer_ni->ksnp_conns) {
 			conn2 = list_entry(tmp, struct ksock_conn, ksnc_list);
 
@@ -1217,6 +1264,9 @@ ksocknal_create_conn(struct lnet_ni *ni, struct ksock_route *route,
                             conn2->ksnc_type != conn->ksnc_type)
                                 continue;
 
+			if (++ndup < nstripe)
+				continue;
+
                         /* Reply on a passive connection attempt so the peer_ni
                          * realises we're connected. */
                         LASSERT (rc == 0);
@@ -1258,6 +1308,18 @@ ksocknal_create_conn(struct lnet_ni *ni, struct ksock_route *route,
 	peer_ni->ksnp_send_keepalive = 0;
 	peer_ni->ksnp_error = 0;
 
+	/* spread the stripes of a bulk connection over the NI's CPTs */
+	if (conn->ksnc_stripe != 0 && ni->ni_cpts != NULL) {
+		for (i = 0; i < ni->ni_ncpts; i++) {
+			if (ni->ni_cpts[i] == cpt)
+				break;
+		}
+		cpt = ni->ni_cpts[(i + conn->ksnc_stripe) % ni->ni_ncpts];
+	} else if (conn->ksnc_stripe != 0) {
+		cpt = (cpt + conn->ksnc_stripe) %
+		      cfs_cpt_number(lnet_cpt_table());
+	}
+
 	sched = ksocknal_choose_scheduler_locked(cpt);
 	if (!sched) {
 		CERROR("no schedulers available. node is unhealthy\n");
@@ -1423,8 +1485,6 @@ ksocknal_close_conn_locked(struct ksock_conn *conn, int error)
          * Caller holds ksnd_global_lock exclusively in irq context */
 	struct ksock_peer_ni *peer_ni = conn->ksnc_peer;
 	struct ksock_route *route;
-	struct ksock_conn *conn2;
-	struct list_head *tmp;
 
 	LASSERT(peer_ni->ksnp_error == 0);
 	LASSERT(!conn->ksnc_closing);
@@ -1438,18 +1498,9 @@ ksocknal_close_conn_locked(struct ksock_conn *conn, int error)
 		/* dissociate conn from route... */
 		LASSERT(!route->ksnr_deleted);
 		LASSERT((route->ksnr_connected & (1 << conn->ksnc_type)) != 0);
+		LASSERT(route->ksnr_ctype_count[conn->ksnc_type] > 0);
 
-		conn2 = NULL;
-		list_for_each(tmp, &peer_ni->ksnp_conns) {
-			conn2 = list_entry(tmp, struct ksock_conn, ksnc_list);
-
-			if (conn2->ksnc_route == route &&
-			    conn2->ksnc_type == conn->ksnc_type)
-				break;
-
-			conn2 = NULL;
-		}
-		if (conn2 == NULL)
+		if (--route->ksnr_ctype_count[conn->ksnc_type] == 0)
 			route->ksnr_connected &= ~(1 << conn->ksnc_type);
 
 		conn->ksnc_route = NULL;
@@ -2193,6 +2244,24 @@ ksocknal_ctl(struct lnet_ni *ni, unsigned int cmd, void *arg)
 		data->ioc_u32[4] = conn->ksnc_scheduler->kss_cpt;
                 data->ioc_u32[5] = rxmem;
                 data->ioc_u32[6] = conn->ksnc_peer->ksnp_id.pid;
+
+		/* optional per-connection traffic counters */
+		if (data->ioc_pbuf1 != NULL &&
+		    data->ioc_plen1 >= sizeof(struct ksock_conn_stats)) {
+			struct ksock_conn_stats stats = {
+				.kcs_tx_bytes	= conn->ksnc_tx_bytes,
+				.kcs_tx_msgs	= conn->ksnc_tx_msgs,
+				.kcs_rx_bytes	= conn->ksnc_rx_bytes,
+				.kcs_rx_msgs	= conn->ksnc_rx_msgs,
+				.kcs_stripe	= conn->ksnc_stripe,
+			};
+
+			if (copy_to_user(data->ioc_pbuf1, &stats,
+					 sizeof(stats))) {
+				ksocknal_conn_decref(conn);
+				return -EFAULT;
+			}
+		}
                 ksocknal_conn_decref(conn);
                 return 0;
         }
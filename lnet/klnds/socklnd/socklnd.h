@@ -74,6 +74,7 @@
 #define SOCKNAL_RESCHED         100             /* # scheduler loops before reschedule */
 #define SOCKNAL_INSANITY_RECONN 5000            /* connd is trying on reconn infinitely */
 #define SOCKNAL_ENOMEM_RETRY    1		/* seconds between retries */
+#define SOCKNAL_CONNS_PER_PEER_MAX 16		/* max bulk conns per type/route */
 
 #define SOCKNAL_SINGLE_FRAG_TX      0           /* disable multi-fragment sends */
 #define SOCKNAL_SINGLE_FRAG_RX      0           /* disable multi-fragment receives */
@@ -133,7 +134,9 @@ struct ksock_tunables {
         int              *ksnd_max_reconnectms; /* ...exponentially increasing to this */
         int              *ksnd_eager_ack;       /* make TCP ack eagerly? */
         int              *ksnd_typed_conns;     /* drive sockets by type? */
+	int		 *ksnd_conns_per_peer;	/* # bulk conns of each type per route */
         int              *ksnd_min_bulk;        /* smallest "large" message */
+	int		 *ksnd_rx_batch;	/* max msgs received per rx turn */
         int              *ksnd_tx_buffer_size;  /* socket tx buffer size */
         int              *ksnd_rx_buffer_size;  /* socket rx buffer size */
         int              *ksnd_nagle;           /* enable NAGLE? */
@@ -195,6 +198,8 @@ struct ksock_nal_data {
 	struct ksock_sched	**ksnd_schedulers;
 
 	atomic_t      ksnd_nactive_txs;    /* #active txs */
+	/* # receives beyond the first in an rx turn */
+	atomic_long_t		ksnd_rx_batched;
 
 	/* conns to close: reaper_lock*/
 	struct list_head	ksnd_deathrow_conns;
@@ -323,6 +328,8 @@ struct ksock_conn {
 	unsigned int	    ksnc_closing:1;  /* being shut down */
 	unsigned int	    ksnc_flip:1;     /* flip or not, only for V2.x */
 	unsigned int	    ksnc_zc_capable:1; /* enable to ZC */
+	unsigned int	    ksnc_stripe;     /* index among route's conns of
+					      * this type, 0 for the first */
         struct ksock_proto *ksnc_proto;      /* protocol for the connection */
 
 	/* READER */
@@ -369,6 +376,12 @@ struct ksock_conn {
 	int			ksnc_tx_scheduled;
 	/* time stamp of the last posted TX */
 	time64_t		ksnc_tx_last_post;
+
+	/* STATS: only updated by the conn's scheduler */
+	__u64			ksnc_tx_bytes;	/* # bytes sent */
+	__u64			ksnc_tx_msgs;	/* # messages sent */
+	__u64			ksnc_rx_bytes;	/* # bytes received */
+	__u64			ksnc_rx_msgs;	/* # messages received */
 };
 
 struct ksock_route {
@@ -385,8 +398,11 @@ struct ksock_route {
         unsigned int          ksnr_connecting:1;/* connection establishment in progress */
         unsigned int          ksnr_connected:4; /* connections established by type */
         unsigned int          ksnr_deleted:1;   /* been removed from peer_ni? */
+	unsigned int	      ksnr_no_stripe:1; /* peer refused extra bulk conns */
         unsigned int          ksnr_share_count; /* created explicitly? */
         int                   ksnr_conn_count;  /* # conns established by this route */
+	/* # conns established by this route, by type */
+	int		      ksnr_ctype_count[SOCKLND_CONN_NTYPES];
 };
 
 #define SOCKNAL_KEEPALIVE_PING          1       /* cookie for keepalive ping */
@@ -483,6 +499,41 @@ ksocknal_route_mask(void)
                 (1 << SOCKLND_CONN_BULK_OUT));
 }
 
+/* The number of connections of @type the route should have: bulk traffic is
+ * striped over up to conns_per_peer connections of each bulk type, unless
+ * the peer has refused them. */
+static inline int
+ksocknal_route_type_conns(struct ksock_route *route, int type)
+{
+	if (type != SOCKLND_CONN_BULK_IN && type != SOCKLND_CONN_BULK_OUT)
+		return 1;
+
+	if (route->ksnr_no_stripe)
+		return 1;
+
+	return *ksocknal_tunables.ksnd_conns_per_peer;
+}
+
+/* Mask of connection types the route still needs to establish */
+static inline int
+ksocknal_route_wanted(struct ksock_route *route)
+{
+	int wanted = ksocknal_route_mask() & ~route->ksnr_connected;
+	int type;
+
+	if (!*ksocknal_tunables.ksnd_typed_conns)
+		return wanted;
+
+	for (type = SOCKLND_CONN_BULK_IN; type <= SOCKLND_CONN_BULK_OUT;
+	     type++) {
+		if (route->ksnr_ctype_count[type] <
+		    ksocknal_route_type_conns(route, type))
+			wanted |= (1 << type);
+	}
+
+	return wanted;
+}
+
 static inline struct list_head *
 ksocknal_nid2peerlist (lnet_nid_t nid)
 {
@@ -219,8 +219,10 @@ ksocknal_transmit(struct ksock_conn *conn, struct ksock_tx *tx,
 		}
 
 		bufnob = conn->ksnc_sock->sk->sk_wmem_queued;
-		if (rc > 0)                     /* sent something? */
+		if (rc > 0) {                   /* sent something? */
 			conn->ksnc_tx_bufnob += rc; /* account it */
+			conn->ksnc_tx_bytes += rc;
+		}
 
 		if (bufnob < conn->ksnc_tx_bufnob) {
 			/* allocated send buffer bytes < computed; infer
@@ -250,6 +252,9 @@ ksocknal_transmit(struct ksock_conn *conn, struct ksock_tx *tx,
 
 	} while (tx->tx_resid != 0);
 
+	if (rc == 0)
+		conn->ksnc_tx_msgs++;
+
 	ksocknal_connsock_decref(conn);
 	return rc;
 }
@@ -383,6 +388,8 @@ ksocknal_receive(struct ksock_conn *conn, struct page **rx_scratch_pgs,
 			break;
 		}
 
+		conn->ksnc_rx_bytes += rc;
+
 		/* Completed a fragment */
 
 		if (conn->ksnc_rx_nob_wanted == 0) {
@@ -647,7 +654,7 @@ ksocknal_launch_connection_locked(struct ksock_route *route)
 
         LASSERT (!route->ksnr_scheduled);
         LASSERT (!route->ksnr_connecting);
-        LASSERT ((ksocknal_route_mask() & ~route->ksnr_connected) != 0);
+        LASSERT(ksocknal_route_wanted(route) != 0);
 
         route->ksnr_scheduled = 1;              /* scheduling conn for connd */
         ksocknal_route_addref(route);           /* extra ref for connd */
@@ -849,7 +856,7 @@ ksocknal_find_connectable_route_locked(struct ksock_peer_ni *peer_ni)
                         continue;
 
                 /* all route types connected ? */
-                if ((ksocknal_route_mask() & ~route->ksnr_connected) == 0)
+                if (ksocknal_route_wanted(route) == 0)
                         continue;
 
                 if (!(route->ksnr_retry_interval == 0 || /* first attempt */
@@ -1360,6 +1367,7 @@ ksocknal_process_receive(struct ksock_conn *conn,
 			conn->ksnc_lnet_msg->msg_health_status =
 				LNET_MSG_STATUS_REMOTE_ERROR;
 		lnet_finalize(conn->ksnc_lnet_msg, rc);
+		conn->ksnc_rx_msgs++;
 
                 if (rc != 0) {
                         ksocknal_new_packet(conn, 0);
@@ -1464,6 +1472,7 @@ int ksocknal_scheduler(void *arg)
 	struct ksock_tx	*tx;
 	int rc;
 	int nloops = 0;
+	int nrx;
 	long id = (long)arg;
 	struct page **rx_scratch_pgs;
 	struct kvec *scratch_iov;
@@ -1507,24 +1516,39 @@ int ksocknal_scheduler(void *arg)
 			LASSERT(conn->ksnc_rx_scheduled);
 			LASSERT(conn->ksnc_rx_ready);
 
-			/* clear rx_ready in case receive isn't complete.
-			 * Do it BEFORE we call process_recv, since
-			 * data_ready can set it any time after we release
-			 * kss_lock. */
-			conn->ksnc_rx_ready = 0;
-			spin_unlock_bh(&sched->kss_lock);
-
-			rc = ksocknal_process_receive(conn, rx_scratch_pgs,
-						      scratch_iov);
+			/* Receive up to rx_batch messages from this conn
+			 * before moving on, as long as it has data and
+			 * isn't blocked waiting for ksocknal_recv(). */
+			nrx = 0;
+			do {
+				/* clear rx_ready in case receive isn't
+				 * complete.  Do it BEFORE we call
+				 * process_recv, since data_ready can set it
+				 * any time after we release kss_lock. */
+				conn->ksnc_rx_ready = 0;
+				spin_unlock_bh(&sched->kss_lock);
+
+				nrx++;
+				rc = ksocknal_process_receive(conn,
+							      rx_scratch_pgs,
+							      scratch_iov);
 
-			spin_lock_bh(&sched->kss_lock);
-
-			/* I'm the only one that can clear this flag */
-			LASSERT(conn->ksnc_rx_scheduled);
+				spin_lock_bh(&sched->kss_lock);
 
-			/* Did process_receive get everything it wanted? */
-			if (rc == 0)
-				conn->ksnc_rx_ready = 1;
+				/* I'm the only one that can clear this flag */
+				LASSERT(conn->ksnc_rx_scheduled);
+
+				/* Did process_receive get everything it
+				 * wanted? */
+				if (rc == 0)
+					conn->ksnc_rx_ready = 1;
+			} while (rc == 0 &&
+				 conn->ksnc_rx_state != SOCKNAL_RX_PARSE &&
+				 nrx < *ksocknal_tunables.ksnd_rx_batch &&
+				 !ksocknal_data.ksnd_shuttingdown);
+			if (nrx > 1)
+				atomic_long_add(nrx - 1,
+						&ksocknal_data.ksnd_rx_batched);
 
 			if (conn->ksnc_rx_state == SOCKNAL_RX_PARSE) {
 				/* Conn blocked waiting for ksocknal_recv()
@@ -1952,7 +1976,7 @@ ksocknal_connect(struct ksock_route *route)
         route->ksnr_connecting = 1;
 
         for (;;) {
-                wanted = ksocknal_route_mask() & ~route->ksnr_connected;
+                wanted = ksocknal_route_wanted(route);
 
                 /* stop connecting if peer_ni/route got closed under me, or
                  * route got connected while queued */
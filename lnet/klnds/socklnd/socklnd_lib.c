@@ -127,27 +127,42 @@ ksocknal_lib_send_kiov(struct ksock_conn *conn, struct ksock_tx *tx,
 	/* NB we can't trust socket ops to either consume our iovs
 	 * or leave them alone. */
 	if (tx->tx_msg.ksm_zc_cookies[0] != 0) {
-		/* Zero copy is enabled */
+		/* Zero copy is enabled: push as many fragments as the socket
+		 * takes in one go, so a bulk message costs one pass through
+		 * ksocknal_transmit() rather than one per page. */
 		struct sock   *sk = sock->sk;
-		struct page   *page = kiov->kiov_page;
-		int            offset = kiov->kiov_offset;
-		int            fragsize = kiov->kiov_len;
-		int            msgflg = MSG_DONTWAIT;
-
-		CDEBUG(D_NET, "page %p + offset %x for %d\n",
-			       page, offset, kiov->kiov_len);
-
-		if (!list_empty(&conn->ksnc_tx_queue) ||
-		    fragsize < tx->tx_resid)
-			msgflg |= MSG_MORE;
-
-		if (sk->sk_prot->sendpage != NULL) {
-			rc = sk->sk_prot->sendpage(sk, page,
-						   offset, fragsize, msgflg);
-		} else {
-			rc = cfs_tcp_sendpage(sk, page, offset, fragsize,
-					      msgflg);
+		int            i;
+
+		for (nob = i = 0; i < tx->tx_nkiov; i++) {
+			struct page   *page = kiov[i].kiov_page;
+			int            offset = kiov[i].kiov_offset;
+			int            fragsize = kiov[i].kiov_len;
+			int            msgflg = MSG_DONTWAIT;
+
+			CDEBUG(D_NET, "page %p + offset %x for %d\n",
+			       page, offset, fragsize);
+
+			if (!list_empty(&conn->ksnc_tx_queue) ||
+			    nob + fragsize < tx->tx_resid)
+				msgflg |= MSG_MORE;
+
+			if (sk->sk_prot->sendpage != NULL) {
+				rc = sk->sk_prot->sendpage(sk, page,
+							   offset, fragsize,
+							   msgflg);
+			} else {
+				rc = cfs_tcp_sendpage(sk, page, offset,
+						      fragsize, msgflg);
+			}
+
+			if (rc <= 0)
+				return nob > 0 ? nob : rc;
+
+			nob += rc;
+			if (rc < fragsize)	/* socket buffer full */
+				break;
 		}
+		rc = nob;
 	} else {
 #if SOCKNAL_SINGLE_FRAG_TX || !SOCKNAL_RISK_KMAP_DEADLOCK
 		struct kvec	scratch;
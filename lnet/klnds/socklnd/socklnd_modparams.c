@@ -71,6 +71,34 @@ static int typed_conns = 1;
 module_param(typed_conns, int, 0444);
 MODULE_PARM_DESC(typed_conns, "use different sockets for bulk");
 
+static int conns_per_peer = 1;
+module_param(conns_per_peer, int, 0444);
+MODULE_PARM_DESC(conns_per_peer, "number of bulk connections of each direction per peer interface (requires typed_conns)");
+
+static int rx_batch = 8;
+module_param(rx_batch, int, 0644);
+MODULE_PARM_DESC(rx_batch, "max messages received from a connection per scheduling turn");
+
+static int rx_batched_get(char *buffer, cfs_kernel_param_arg_t *kp)
+{
+	return sprintf(buffer, "%ld",
+		       atomic_long_read(&ksocknal_data.ksnd_rx_batched));
+}
+
+/* read-only, the count lives in ksocknal_data */
+static unsigned long rx_batched;
+#ifdef HAVE_KERNEL_PARAM_OPS
+static struct kernel_param_ops param_ops_rx_batched = {
+	.get = rx_batched_get,
+};
+#define param_check_rx_batched(name, p) \
+		__param_check(name, p, unsigned long)
+module_param(rx_batched, rx_batched, 0444);
+#else
+module_param_call(rx_batched, NULL, rx_batched_get, &rx_batched, 0444);
+#endif
+MODULE_PARM_DESC(rx_batched, "# receives done beyond the first per scheduling turn");
+
 static int min_bulk = (1<<10);
 module_param(min_bulk, int, 0644);
 MODULE_PARM_DESC(min_bulk, "smallest 'large' message");
@@ -169,7 +197,9 @@ int ksocknal_tunables_init(void)
         ksocknal_tunables.ksnd_max_reconnectms    = &max_reconnectms;
         ksocknal_tunables.ksnd_eager_ack          = &eager_ack;
         ksocknal_tunables.ksnd_typed_conns        = &typed_conns;
+	ksocknal_tunables.ksnd_conns_per_peer	  = &conns_per_peer;
         ksocknal_tunables.ksnd_min_bulk           = &min_bulk;
+	ksocknal_tunables.ksnd_rx_batch		  = &rx_batch;
         ksocknal_tunables.ksnd_tx_buffer_size     = &tx_buffer_size;
         ksocknal_tunables.ksnd_rx_buffer_size     = &rx_buffer_size;
         ksocknal_tunables.ksnd_nagle              = &nagle;
@@ -211,5 +241,12 @@ int ksocknal_tunables_init(void)
         if (*ksocknal_tunables.ksnd_zc_min_payload < (2 << 10))
                 *ksocknal_tunables.ksnd_zc_min_payload = (2 << 10);
 
+	if (conns_per_peer < 1 || conns_per_peer > SOCKNAL_CONNS_PER_PEER_MAX) {
+		CWARN("conns_per_peer=%d out of range [1, %d], clamping\n",
+		      conns_per_peer, SOCKNAL_CONNS_PER_PEER_MAX);
+		conns_per_peer = clamp(conns_per_peer, 1,
+				       SOCKNAL_CONNS_PER_PEER_MAX);
+	}
+
 	return 0;
 };
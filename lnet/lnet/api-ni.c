@@ -883,6 +883,7 @@ lnet_counters_get(struct lnet_counters *counters)
 {
 	struct lnet_counters *ctr;
 	struct lnet_counters_health *health = &counters->lct_health;
+	struct lnet_counters_lock *lock = &counters->lct_lock;
 	int		i;
 
 	memset(counters, 0, sizeof(*counters));
@@ -916,7 +917,15 @@ lnet_counters_get(struct lnet_counters *counters)
 				ctr->lct_health.lch_remote_timeout_count;
 		health->lch_network_timeout_count +=
 				ctr->lct_health.lch_network_timeout_count;
-	}
+		lock->lcl_peer_credit_fast +=
+				ctr->lct_lock.lcl_peer_credit_fast;
+		lock->lcl_peer_credit_locked +=
+				ctr->lct_lock.lcl_peer_credit_locked;
+	}
+	lock->lcl_net_lock_contended =
+		cfs_percpt_lock_contended(the_lnet.ln_net_lock);
+	lock->lcl_res_lock_contended =
+		cfs_percpt_lock_contended(the_lnet.ln_res_lock);
 	lnet_net_unlock(LNET_LOCK_EX);
 }
 EXPORT_SYMBOL(lnet_counters_get);
@@ -932,7 +941,12 @@ lnet_counters_reset(void)
 	cfs_percpt_for_each(counters, i, the_lnet.ln_counters)
 		memset(counters, 0, sizeof(struct lnet_counters));
 
+	cfs_percpt_lock_contended_reset(the_lnet.ln_net_lock);
 	lnet_net_unlock(LNET_LOCK_EX);
+
+	lnet_res_lock(LNET_LOCK_EX);
+	cfs_percpt_lock_contended_reset(the_lnet.ln_res_lock);
+	lnet_res_unlock(LNET_LOCK_EX);
 }
 
 static char *
@@ -2506,6 +2520,13 @@ int lnet_lib_init(void)
 		return rc;
 	}
 
+	rc = lnet_trace_init();
+	if (rc != 0) {
+		CERROR("Can't allocate LNet trace rings: %d\n", rc);
+		lnet_destroy_locks();
+		return rc;
+	}
+
 	the_lnet.ln_refcount = 0;
 	INIT_LIST_HEAD(&the_lnet.ln_lnds);
 	INIT_LIST_HEAD(&the_lnet.ln_net_zombie);
@@ -2541,6 +2562,7 @@ void lnet_lib_exit(void)
 	while (!list_empty(&the_lnet.ln_lnds))
 		lnet_unregister_lnd(list_entry(the_lnet.ln_lnds.next,
 					       struct lnet_lnd, lnd_list));
+	lnet_trace_fini();
 	lnet_destroy_locks();
 }
 
@@ -3539,6 +3561,9 @@ lnet_get_peer_ni_recovery_list(struct lnet_ioctl_recovery_list *list)
 	return 0;
 }
 
+/* peer ioctls from tools which predate lnet_ioctl_peer_cfg::prcfg_flags */
+#define LNET_PEER_CFG_MIN_LEN	offsetof(struct lnet_ioctl_peer_cfg, prcfg_flags)
+
 /**
  * LNet ioctl handler.
  *
@@ -3674,13 +3699,28 @@ LNetCtl(unsigned int cmd, void *arg)
 	case IOC_LIBCFS_GET_LNET_STATS:
 	{
 		struct lnet_ioctl_lnet_stats *lnet_stats = arg;
+		size_t min_len = offsetof(struct lnet_ioctl_lnet_stats,
+					  st_cntrs.lct_lock);
+		struct lnet_counters *counters;
 
-		if (lnet_stats->st_hdr.ioc_len < sizeof(*lnet_stats))
+		/* tools built before lct_lock was added pass a shorter one */
+		if (lnet_stats->st_hdr.ioc_len < min_len)
 			return -EINVAL;
 
+		LIBCFS_ALLOC(counters, sizeof(*counters));
+		if (counters == NULL)
+			return -ENOMEM;
+
 		mutex_lock(&the_lnet.ln_api_mutex);
-		lnet_counters_get(&lnet_stats->st_cntrs);
+		lnet_counters_get(counters);
 		mutex_unlock(&the_lnet.ln_api_mutex);
+
+		memcpy(&lnet_stats->st_cntrs, counters,
+		       min_t(size_t, sizeof(*counters),
+			     lnet_stats->st_hdr.ioc_len -
+			     offsetof(struct lnet_ioctl_lnet_stats,
+				      st_cntrs)));
+		LIBCFS_FREE(counters, sizeof(*counters));
 		return 0;
 	}
 
@@ -3738,17 +3778,21 @@ LNetCtl(unsigned int cmd, void *arg)
 
 	case IOC_LIBCFS_GET_BUF: {
 		struct lnet_ioctl_pool_cfg *pool_cfg;
-		size_t total = sizeof(*config) + sizeof(*pool_cfg);
+		size_t total = sizeof(*config) +
+			       offsetof(struct lnet_ioctl_pool_cfg, pl_padding);
 
 		config = arg;
 
+		/* older tools don't know about the pool stats */
 		if (config->cfg_hdr.ioc_len < total)
 			return -EINVAL;
 
 		pool_cfg = (struct lnet_ioctl_pool_cfg *)config->cfg_bulk;
 
 		mutex_lock(&the_lnet.ln_api_mutex);
-		rc = lnet_get_rtr_pool_cfg(config->cfg_count, pool_cfg);
+		rc = lnet_get_rtr_pool_cfg(config->cfg_count, pool_cfg,
+					   config->cfg_hdr.ioc_len >=
+					   sizeof(*config) + sizeof(*pool_cfg));
 		mutex_unlock(&the_lnet.ln_api_mutex);
 		return rc;
 	}
@@ -3783,7 +3827,7 @@ LNetCtl(unsigned int cmd, void *arg)
 	case IOC_LIBCFS_ADD_PEER_NI: {
 		struct lnet_ioctl_peer_cfg *cfg = arg;
 
-		if (cfg->prcfg_hdr.ioc_len < sizeof(*cfg))
+		if (cfg->prcfg_hdr.ioc_len < LNET_PEER_CFG_MIN_LEN)
 			return -EINVAL;
 
 		mutex_lock(&the_lnet.ln_api_mutex);
@@ -3797,7 +3841,7 @@ LNetCtl(unsigned int cmd, void *arg)
 	case IOC_LIBCFS_DEL_PEER_NI: {
 		struct lnet_ioctl_peer_cfg *cfg = arg;
 
-		if (cfg->prcfg_hdr.ioc_len < sizeof(*cfg))
+		if (cfg->prcfg_hdr.ioc_len < LNET_PEER_CFG_MIN_LEN)
 			return -EINVAL;
 
 		mutex_lock(&the_lnet.ln_api_mutex);
@@ -3831,13 +3875,17 @@ LNetCtl(unsigned int cmd, void *arg)
 
 	case IOC_LIBCFS_GET_PEER_NI: {
 		struct lnet_ioctl_peer_cfg *cfg = arg;
+		__u32 flags = 0;
 
-		if (cfg->prcfg_hdr.ioc_len < sizeof(*cfg))
+		if (cfg->prcfg_hdr.ioc_len < LNET_PEER_CFG_MIN_LEN)
 			return -EINVAL;
 
+		if (cfg->prcfg_hdr.ioc_len >= sizeof(*cfg))
+			flags = cfg->prcfg_flags;
+
 		mutex_lock(&the_lnet.ln_api_mutex);
 		rc = lnet_get_peer_info(cfg,
-					(void __user *)cfg->prcfg_bulk);
+					(void __user *)cfg->prcfg_bulk, flags);
 		mutex_unlock(&the_lnet.ln_api_mutex);
 		return rc;
 	}
@@ -3845,7 +3893,7 @@ LNetCtl(unsigned int cmd, void *arg)
 	case IOC_LIBCFS_GET_PEER_LIST: {
 		struct lnet_ioctl_peer_cfg *cfg = arg;
 
-		if (cfg->prcfg_hdr.ioc_len < sizeof(*cfg))
+		if (cfg->prcfg_hdr.ioc_len < LNET_PEER_CFG_MIN_LEN)
 			return -EINVAL;
 
 		mutex_lock(&the_lnet.ln_api_mutex);
@@ -3879,6 +3927,40 @@ LNetCtl(unsigned int cmd, void *arg)
 		return 0;
 	}
 
+	case IOC_LIBCFS_NET_SEL_POLICY: {
+		struct lnet_ioctl_net_sel_policy *cfg = arg;
+		struct lnet_net *net;
+
+		if (cfg->nsp_hdr.ioc_len < sizeof(*cfg))
+			return -EINVAL;
+		if (cfg->nsp_set && cfg->nsp_policy >= LNET_SEL_POLICY_MAX)
+			return -EINVAL;
+
+		mutex_lock(&the_lnet.ln_api_mutex);
+		lnet_net_lock(LNET_LOCK_EX);
+		net = lnet_get_net_locked(cfg->nsp_net);
+		if (!net) {
+			rc = -ENOENT;
+		} else {
+			if (cfg->nsp_set)
+				net->net_sel_policy = cfg->nsp_policy;
+			cfg->nsp_policy = net->net_sel_policy;
+			rc = 0;
+		}
+		lnet_net_unlock(LNET_LOCK_EX);
+		mutex_unlock(&the_lnet.ln_api_mutex);
+		return rc;
+	}
+
+	case IOC_LIBCFS_TRACE_DUMP: {
+		struct lnet_ioctl_trace_dump *dump = arg;
+
+		if (dump->ltd_hdr.ioc_len < sizeof(*dump))
+			return -EINVAL;
+
+		return lnet_trace_dump(dump);
+	}
+
 	case IOC_LIBCFS_NOTIFY_ROUTER: {
 		time64_t deadline = ktime_get_real_seconds() - data->ioc_u64[0];
 
@@ -3954,7 +4036,7 @@ LNetCtl(unsigned int cmd, void *arg)
 		if (lp) {
 			ping->ping_id.nid = lp->lp_primary_nid;
 			ping->mr_info = lnet_peer_is_multi_rail(lp);
-			lnet_peer_decref_locked(lp);
+			lnet_peer_decref(lp);
 		}
 		mutex_unlock(&the_lnet.ln_api_mutex);
 
@@ -3977,7 +4059,7 @@ LNetCtl(unsigned int cmd, void *arg)
 		if (lp) {
 			discover->ping_id.nid = lp->lp_primary_nid;
 			discover->mr_info = lnet_peer_is_multi_rail(lp);
-			lnet_peer_decref_locked(lp);
+			lnet_peer_decref(lp);
 		}
 		mutex_unlock(&the_lnet.ln_api_mutex);
 
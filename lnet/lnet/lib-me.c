@@ -104,10 +104,13 @@ LNetMEAttach(unsigned int portal,
 
 	lnet_res_lh_initialize(the_lnet.ln_me_containers[mtable->mt_cpt],
 			       &me->me_lh);
-	if (ignore_bits != 0)
-		head = &mtable->mt_mhash[LNET_MT_HASH_IGNORE];
-	else
+	if (ignore_bits != 0) {
+		head = &mtable->mt_mhash[LNET_MT_HASH_IGNORE(
+						mtable->mt_hash_bits)];
+	} else {
 		head = lnet_mt_match_head(mtable, match_id, match_bits);
+		mtable->mt_nmes++;
+	}
 
 	me->me_pos = head - &mtable->mt_mhash[0];
 	if (pos == LNET_INS_AFTER || pos == LNET_INS_LOCAL)
@@ -118,6 +121,11 @@ LNetMEAttach(unsigned int portal,
 	lnet_me2handle(handle, me);
 
 	lnet_res_unlock(mtable->mt_cpt);
+
+	/* NB: read w/o lock, lnet_mt_grow() checks again */
+	if (mtable->mt_nmes > LNET_MT_HASH_LOAD << mtable->mt_hash_bits)
+		lnet_mt_grow(mtable);
+
 	return 0;
 }
 EXPORT_SYMBOL(LNetMEAttach);
@@ -183,6 +191,9 @@ LNetMEInsert(struct lnet_handle_me current_meh,
 	}
 
 	new_me->me_pos = current_me->me_pos;
+	if (new_me->me_pos !=
+	    LNET_MT_HASH_IGNORE(ptl->ptl_mtables[cpt]->mt_hash_bits))
+		ptl->ptl_mtables[cpt]->mt_nmes++;
 	new_me->me_portal = current_me->me_portal;
 	new_me->me_match_id = match_id;
 	new_me->me_match_bits = match_bits;
@@ -258,6 +269,13 @@ EXPORT_SYMBOL(LNetMEUnlink);
 void
 lnet_me_unlink(struct lnet_me *me)
 {
+	struct lnet_match_table *mtable;
+
+	mtable = the_lnet.ln_portals[me->me_portal]->ptl_mtables[
+				lnet_cpt_of_cookie(me->me_lh.lh_cookie)];
+	if (me->me_pos != LNET_MT_HASH_IGNORE(mtable->mt_hash_bits))
+		mtable->mt_nmes--;
+
 	list_del(&me->me_list);
 
 	if (me->me_md != NULL) {
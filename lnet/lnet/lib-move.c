@@ -705,6 +705,8 @@ lnet_ni_recv(struct lnet_ni *ni, void *private, struct lnet_msg *msg,
 			LASSERT (niov > 0);
 			LASSERT ((iov == NULL) != (kiov == NULL));
 		}
+
+		lnet_trace(msg, LNET_TRACE_LND_RECV, 0);
 	}
 
 	rc = (ni->ni_net->net_lnd->lnd_recv)(ni, private, msg, delayed,
@@ -765,6 +767,7 @@ lnet_ni_send(struct lnet_ni *ni, struct lnet_msg *msg)
 	LASSERT (LNET_NETTYP(LNET_NIDNET(ni->ni_nid)) == LOLND ||
 		 (msg->msg_txcredit && msg->msg_peertxcredit));
 
+	lnet_trace(msg, LNET_TRACE_LND_SEND, 0);
 	rc = (ni->ni_net->net_lnd->lnd_send)(ni, priv, msg);
 	if (rc < 0) {
 		msg->msg_no_resend = true;
@@ -918,24 +921,43 @@ lnet_post_send_locked(struct lnet_msg *msg, int do_send)
 	}
 
 	if (!msg->msg_peertxcredit) {
-		spin_lock(&lp->lpni_lock);
-		LASSERT((lp->lpni_txcredits < 0) ==
-			!list_empty(&lp->lpni_txq));
+		struct lnet_counters_lock *lcl;
+		int credits;
 
+		lcl = &the_lnet.ln_counters[cpt]->lct_lock;
 		msg->msg_peertxcredit = 1;
-		lp->lpni_txqnob += msg->msg_len + sizeof(struct lnet_hdr);
-		lp->lpni_txcredits--;
-
-		if (lp->lpni_txcredits < lp->lpni_mintxcredits)
-			lp->lpni_mintxcredits = lp->lpni_txcredits;
+		atomic_long_add(msg->msg_len + sizeof(struct lnet_hdr),
+				&lp->lpni_txqnob);
 
-		if (lp->lpni_txcredits < 0) {
-			msg->msg_tx_delayed = 1;
-			list_add_tail(&msg->msg_list, &lp->lpni_txq);
+		/*
+		 * Fast path: while the peer has credits left nobody can be
+		 * queued on lpni_txq, so the credit is taken without
+		 * lpni_lock, which may belong to the traffic of another CPT.
+		 */
+		credits = atomic_dec_if_positive(&lp->lpni_txcredits);
+		if (credits >= 0) {
+			lcl->lcl_peer_credit_fast++;
+		} else {
+			lcl->lcl_peer_credit_locked++;
+			spin_lock(&lp->lpni_lock);
+			credits = atomic_dec_return(&lp->lpni_txcredits);
+			if (credits < 0) {
+				msg->msg_tx_delayed = 1;
+				list_add_tail(&msg->msg_list, &lp->lpni_txq);
+			}
 			spin_unlock(&lp->lpni_lock);
+		}
+
+		/* racy, but it is only a statistic */
+		if (credits < READ_ONCE(lp->lpni_mintxcredits))
+			WRITE_ONCE(lp->lpni_mintxcredits, credits);
+		if (credits < READ_ONCE(lp->lpni_win_mintxcredits))
+			WRITE_ONCE(lp->lpni_win_mintxcredits, credits);
+
+		if (credits < 0) {
+			lnet_trace(msg, LNET_TRACE_WAIT_PEER, credits);
 			return LNET_CREDIT_WAIT;
 		}
-		spin_unlock(&lp->lpni_lock);
 	}
 
 	if (!msg->msg_txcredit) {
@@ -952,6 +974,7 @@ lnet_post_send_locked(struct lnet_msg *msg, int do_send)
 		if (tq->tq_credits < 0) {
 			msg->msg_tx_delayed = 1;
 			list_add_tail(&msg->msg_list, &tq->tq_delayed);
+			lnet_trace(msg, LNET_TRACE_WAIT_NI, tq->tq_credits);
 			return LNET_CREDIT_WAIT;
 		}
 	}
@@ -1032,6 +1055,8 @@ lnet_post_routed_recv_locked(struct lnet_msg *msg, int do_recv)
 			list_add_tail(&msg->msg_list, &lp->lp_rtrq);
 			spin_unlock(&lp->lp_lock);
 			spin_unlock(&lpni->lpni_lock);
+			lnet_trace(msg, LNET_TRACE_WAIT_RTR,
+				   lpni->lpni_rtrcredits);
 			return LNET_CREDIT_WAIT;
 		}
 		spin_unlock(&lp->lp_lock);
@@ -1045,12 +1070,16 @@ lnet_post_routed_recv_locked(struct lnet_msg *msg, int do_recv)
 		rbp->rbp_credits--;
 		if (rbp->rbp_credits < rbp->rbp_mincredits)
 			rbp->rbp_mincredits = rbp->rbp_credits;
+		if (rbp->rbp_credits < rbp->rbp_win_mincredits)
+			rbp->rbp_win_mincredits = rbp->rbp_credits;
 
 		if (rbp->rbp_credits < 0) {
 			/* must have checked eager_recv before here */
 			LASSERT(msg->msg_rx_ready_delay);
 			msg->msg_rx_delayed = 1;
+			rbp->rbp_nblocked++;
 			list_add_tail(&msg->msg_list, &rbp->rbp_msgs);
+			lnet_trace(msg, LNET_TRACE_WAIT_RTR, rbp->rbp_credits);
 			return LNET_CREDIT_WAIT;
 		}
 	}
@@ -1076,6 +1105,8 @@ lnet_post_routed_recv_locked(struct lnet_msg *msg, int do_recv)
 	return LNET_CREDIT_OK;
 }
 
+static void lnet_path_done(struct lnet_msg *msg);
+
 void
 lnet_return_tx_credits_locked(struct lnet_msg *msg)
 {
@@ -1109,20 +1140,27 @@ lnet_return_tx_credits_locked(struct lnet_msg *msg)
 	}
 
 	if (msg->msg_peertxcredit) {
+		long qnob;
+
 		/* give back peer txcredits */
 		msg->msg_peertxcredit = 0;
 
-		spin_lock(&txpeer->lpni_lock);
-		LASSERT((txpeer->lpni_txcredits < 0) ==
-			!list_empty(&txpeer->lpni_txq));
-
-		txpeer->lpni_txqnob -= msg->msg_len + sizeof(struct lnet_hdr);
-		LASSERT(txpeer->lpni_txqnob >= 0);
+		qnob = atomic_long_sub_return(msg->msg_len +
+					      sizeof(struct lnet_hdr),
+					      &txpeer->lpni_txqnob);
+		LASSERT(qnob >= 0);
 
-		txpeer->lpni_txcredits++;
-		if (txpeer->lpni_txcredits <= 0) {
+		/*
+		 * Only a credit which was overdrawn has a message waiting
+		 * for it. The waiter was queued under lpni_lock by the
+		 * thread which overdrew it, so lpni_txq can't be empty by
+		 * the time we hold the lock.
+		 */
+		if (atomic_inc_return(&txpeer->lpni_txcredits) <= 0) {
 			int msg2_cpt;
 
+			spin_lock(&txpeer->lpni_lock);
+			LASSERT(!list_empty(&txpeer->lpni_txq));
 			msg2 = list_entry(txpeer->lpni_txq.next,
 					      struct lnet_msg, msg_list);
 			list_del(&msg2->msg_list);
@@ -1153,10 +1191,11 @@ lnet_return_tx_credits_locked(struct lnet_msg *msg)
 				lnet_net_unlock(msg2_cpt);
 				lnet_net_lock(msg->msg_tx_cpt);
 			}
-                } else {
-			spin_unlock(&txpeer->lpni_lock);
 		}
-        }
+	}
+
+	if (msg->msg_txpath)
+		lnet_path_done(msg);
 
 	if (txni != NULL) {
 		msg->msg_txni = NULL;
@@ -1169,6 +1208,67 @@ lnet_return_tx_credits_locked(struct lnet_msg *msg)
 	}
 }
 
+/*
+ * Move the tx credit allotment of \a lpni towards \a target. Messages
+ * waiting on lpni_txq which the new credits let through are moved onto
+ * \a released for lnet_post_released_sends(); the caller may hold a
+ * net lock here but must drop it before posting them.
+ *
+ * Credits are only taken back while they are free, so lpni_txcredits
+ * never goes negative without a matching waiter on lpni_txq. Whatever
+ * is still in flight is taken back by a later pass.
+ */
+void
+lnet_peer_ni_set_txcredits(struct lnet_peer_ni *lpni, int target,
+			   struct list_head *released)
+{
+	int delta = target - lpni->lpni_maxtxcredits;
+	int before;
+	int nwait;
+
+	if (delta == 0)
+		return;
+
+	spin_lock(&lpni->lpni_lock);
+	if (delta > 0) {
+		/* a negative count is the number of queued messages, which
+		 * only grows under lpni_lock */
+		before = atomic_add_return(delta, &lpni->lpni_txcredits) -
+			 delta;
+		for (nwait = min(delta, -before); nwait > 0; nwait--) {
+			LASSERT(!list_empty(&lpni->lpni_txq));
+			list_move_tail(lpni->lpni_txq.next, released);
+		}
+	} else {
+		for (; delta < 0; delta++) {
+			if (atomic_dec_if_positive(&lpni->lpni_txcredits) < 0)
+				break;
+		}
+		target -= delta;
+	}
+	lpni->lpni_maxtxcredits = target;
+	spin_unlock(&lpni->lpni_lock);
+}
+
+void
+lnet_post_released_sends(struct list_head *released)
+{
+	struct lnet_msg *msg;
+	struct lnet_msg *tmp;
+	int cpt;
+
+	list_for_each_entry_safe(msg, tmp, released, msg_list) {
+		list_del(&msg->msg_list);
+		LASSERT(msg->msg_tx_delayed);
+
+		/* msg may be finalized by the time we unlock */
+		cpt = msg->msg_tx_cpt;
+		lnet_net_lock(cpt);
+		(void) lnet_post_send_locked(msg, 1);
+		lnet_net_unlock(cpt);
+	}
+}
+
 void
 lnet_schedule_blocked_locked(struct lnet_rtrbufpool *rbp)
 {
@@ -1319,19 +1419,132 @@ routing_off:
 	}
 }
 
+/* weight of a new sample in the path EWMAs is 1 / (1 << shift) */
+#define LNET_PATH_EWMA_SHIFT	3
+
+/* Find the statistics of the path from @ni to @lpni.  If @create, claim a
+ * free slot for it, or recycle an idle one; NULL if all slots are busy. */
+static struct lnet_peer_path *
+lnet_peer_path(struct lnet_peer_ni *lpni, struct lnet_ni *ni, bool create)
+{
+	struct lnet_peer_path *path;
+	struct lnet_peer_path *victim = NULL;
+	int i;
+
+	for (i = 0; i < LNET_PEER_NPATHS; i++) {
+		path = &lpni->lpni_paths[i];
+		if (READ_ONCE(path->lpp_ni) == ni)
+			return path;
+	}
+
+	if (!create)
+		return NULL;
+
+	spin_lock(&lpni->lpni_lock);
+	for (i = 0; i < LNET_PEER_NPATHS; i++) {
+		path = &lpni->lpni_paths[i];
+		if (path->lpp_ni == ni) {
+			victim = path;
+			goto out;
+		}
+		if (atomic64_read(&path->lpp_outstanding) != 0)
+			continue;
+		if (!victim || !path->lpp_ni ||
+		    (victim->lpp_ni && path->lpp_nsamples < victim->lpp_nsamples))
+			victim = path;
+	}
+
+	if (victim) {
+		victim->lpp_ewma_ns = 0;
+		victim->lpp_ewma_nob = 0;
+		victim->lpp_nsamples = 0;
+		WRITE_ONCE(victim->lpp_ni, ni);
+	}
+out:
+	spin_unlock(&lpni->lpni_lock);
+	return victim;
+}
+
+/* Expected time for the path from @ni to @lpni to complete a send of an
+ * average message behind the bytes already outstanding on it.  Paths not
+ * measured yet rate 0, so each path gets tried. */
+static __u64
+lnet_path_ect(struct lnet_peer_ni *lpni, struct lnet_ni *ni)
+{
+	struct lnet_peer_path *path = lnet_peer_path(lpni, ni, false);
+	__u64 nob;
+
+	if (!path || path->lpp_nsamples == 0)
+		return 0;
+
+	nob = min_t(__u64, atomic64_read(&path->lpp_outstanding), 1ULL << 28);
+	nob += path->lpp_ewma_nob + 1;
+
+	return div64_u64(path->lpp_ewma_ns * nob, path->lpp_ewma_nob + 1);
+}
+
+static void
+lnet_path_start(struct lnet_msg *msg)
+{
+	struct lnet_peer_path *path;
+
+	if (msg->msg_txpath)
+		return;
+
+	path = lnet_peer_path(msg->msg_txpeer, msg->msg_txni, true);
+	if (!path)
+		return;
+
+	msg->msg_txpath = path;
+	msg->msg_txpath_start = ktime_get();
+	atomic64_add(msg->msg_len, &path->lpp_outstanding);
+}
+
+static void
+lnet_path_done(struct lnet_msg *msg)
+{
+	struct lnet_peer_path *path = msg->msg_txpath;
+	__u64 ns;
+
+	msg->msg_txpath = NULL;
+	atomic64_sub(msg->msg_len, &path->lpp_outstanding);
+
+	if (msg->msg_health_status != LNET_MSG_STATUS_OK)
+		return;
+
+	ns = ktime_to_ns(ktime_sub(ktime_get(), msg->msg_txpath_start));
+	if (path->lpp_nsamples++ == 0) {
+		path->lpp_ewma_ns = ns;
+		path->lpp_ewma_nob = msg->msg_len;
+		return;
+	}
+
+	path->lpp_ewma_ns = path->lpp_ewma_ns -
+			    (path->lpp_ewma_ns >> LNET_PATH_EWMA_SHIFT) +
+			    (ns >> LNET_PATH_EWMA_SHIFT);
+	path->lpp_ewma_nob = path->lpp_ewma_nob -
+			     (path->lpp_ewma_nob >> LNET_PATH_EWMA_SHIFT) +
+			     (msg->msg_len >> LNET_PATH_EWMA_SHIFT);
+}
+
 static int
 lnet_compare_peers(struct lnet_peer_ni *p1, struct lnet_peer_ni *p2)
 {
-	if (p1->lpni_txqnob < p2->lpni_txqnob)
+	long qnob1 = atomic_long_read(&p1->lpni_txqnob);
+	long qnob2 = atomic_long_read(&p2->lpni_txqnob);
+	int credits1 = atomic_read(&p1->lpni_txcredits);
+	int credits2 = atomic_read(&p2->lpni_txcredits);
+
+	if (qnob1 < qnob2)
 		return 1;
 
-	if (p1->lpni_txqnob > p2->lpni_txqnob)
+	if (qnob1 > qnob2)
 		return -1;
 
-	if (p1->lpni_txcredits > p2->lpni_txcredits)
+	if (credits1 > credits2)
 		return 1;
 
-	if (p1->lpni_txcredits < p2->lpni_txcredits)
+	if (credits1 < credits2)
 		return -1;
 
 	return 0;
@@ -1357,6 +1570,11 @@ lnet_select_peer_ni(struct lnet_ni *best_ni, lnet_nid_t dst_nid,
 	bool ni_is_pref;
 	int best_lpni_healthv = 0;
 	int lpni_healthv;
+	int lpni_credits;
+	bool latency = best_ni &&
+		best_ni->ni_net->net_sel_policy == LNET_SEL_POLICY_LATENCY;
+	__u64 best_ect = U64_MAX;
+	__u64 ect = 0;
 
 	while ((lpni = lnet_get_next_peer_ni_locked(peer, peer_net, lpni))) {
 		/*
@@ -1373,11 +1591,14 @@ lnet_select_peer_ni(struct lnet_ni *best_ni, lnet_nid_t dst_nid,
 		}
 
 		lpni_healthv = atomic_read(&lpni->lpni_healthv);
+		lpni_credits = atomic_read(&lpni->lpni_txcredits);
+		if (latency)
+			ect = lnet_path_ect(lpni, best_ni);
 
 		if (best_lpni)
 			CDEBUG(D_NET, "%s c:[%d, %d], s:[%d, %d]\n",
 				libcfs_nid2str(lpni->lpni_nid),
-				lpni->lpni_txcredits, best_lpni_credits,
+				lpni_credits, best_lpni_credits,
 				lpni->lpni_seq, best_lpni->lpni_seq);
 
 		/* pick the healthiest peer ni */
@@ -1394,14 +1615,30 @@ lnet_select_peer_ni(struct lnet_ni *best_ni, lnet_nid_t dst_nid,
 			 * it.
 			 */
 			continue;
-		} else if (lpni->lpni_txcredits < best_lpni_credits) {
+		} else if (latency) {
+			/*
+			 * pick the path expected to complete first. The
+			 * queued bytes in the ECT already account for the
+			 * sends waiting on credits, so credits only break
+			 * ties, then round-robin between equally good ones
+			 */
+			if (ect > best_ect)
+				continue;
+			if (ect == best_ect && best_lpni) {
+				if (lpni_credits < best_lpni_credits)
+					continue;
+				if (lpni_credits == best_lpni_credits &&
+				    best_lpni->lpni_seq <= lpni->lpni_seq)
+					continue;
+			}
+		} else if (lpni_credits < best_lpni_credits) {
 			/*
 			 * We already have a peer that has more credits
 			 * available than this one. No need to consider
 			 * this peer further.
 			 */
 			continue;
-		} else if (lpni->lpni_txcredits == best_lpni_credits) {
+		} else if (lpni_credits == best_lpni_credits) {
 			/*
 			 * The best peer found so far and the current peer
 			 * have the same number of available credits let's
@@ -1415,7 +1652,8 @@ lnet_select_peer_ni(struct lnet_ni *best_ni, lnet_nid_t dst_nid,
 		}
 
 		best_lpni = lpni;
-		best_lpni_credits = lpni->lpni_txcredits;
+		best_lpni_credits = lpni_credits;
+		best_ect = ect;
 	}
 
 	/* if we still can't find a peer ni then we can't reach it */
@@ -1568,6 +1806,81 @@ lnet_find_route_locked(struct lnet_net *net, __u32 remote_net,
 	return best_route;
 }
 
+/* The lowest expected completion time from @ni to any of the healthiest
+ * peer NIs of @peer on @peer_net */
+static __u64
+lnet_ni_best_ect(struct lnet_ni *ni, struct lnet_peer *peer,
+		 struct lnet_peer_net *peer_net)
+{
+	struct lnet_peer_ni *lpni = NULL;
+	__u64 best_ect = U64_MAX;
+	int best_healthv = 0;
+
+	while ((lpni = lnet_get_next_peer_ni_locked(peer, peer_net, lpni))) {
+		int healthv = atomic_read(&lpni->lpni_healthv);
+		__u64 ect;
+
+		if (healthv < best_healthv)
+			continue;
+		ect = lnet_path_ect(lpni, ni);
+		if (healthv > best_healthv) {
+			best_healthv = healthv;
+			best_ect = ect;
+		} else if (ect < best_ect) {
+			best_ect = ect;
+		}
+	}
+
+	return best_ect;
+}
+
+/* LNET_SEL_POLICY_LATENCY: pick the healthiest NI, and among those the one
+ * with the fastest path to the peer, then round-robin */
+static struct lnet_ni *
+lnet_get_best_ni_latency(struct lnet_net *local_net, struct lnet_ni *best_ni,
+			 struct lnet_peer *peer, struct lnet_peer_net *peer_net)
+{
+	struct lnet_ni *ni = NULL;
+	__u64 best_ect = U64_MAX;
+	int best_healthv = 0;
+
+	if (best_ni) {
+		best_healthv = atomic_read(&best_ni->ni_healthv);
+		best_ect = lnet_ni_best_ect(best_ni, peer, peer_net);
+	}
+
+	while ((ni = lnet_get_next_ni_locked(local_net, ni))) {
+		int ni_healthv = atomic_read(&ni->ni_healthv);
+		__u64 ect;
+
+		if (atomic_read(&ni->ni_fatal_error_on) ||
+		    ni_healthv < best_healthv)
+			continue;
+
+		ect = lnet_ni_best_ect(ni, peer, peer_net);
+		CDEBUG(D_NET, "compare ni %s [h:%d, ect:%llu] with best_ni %s [h:%d, ect:%llu]\n",
+		       libcfs_nid2str(ni->ni_nid), ni_healthv, ect,
+		       best_ni ? libcfs_nid2str(best_ni->ni_nid) : "none",
+		       best_healthv, best_ect);
+
+		if (ni_healthv == best_healthv) {
+			if (ect > best_ect)
+				continue;
+			if (ect == best_ect && best_ni &&
+			    best_ni->ni_seq <= ni->ni_seq)
+				continue;
+		}
+		best_ni = ni;
+		best_healthv = ni_healthv;
+		best_ect = ect;
+	}
+
+	CDEBUG(D_NET, "selected best_ni %s\n",
+	       (best_ni) ? libcfs_nid2str(best_ni->ni_nid) : "no selection");
+
+	return best_ni;
+}
+
 static struct lnet_ni *
 lnet_get_best_ni(struct lnet_net *local_net, struct lnet_ni *best_ni,
 		 struct lnet_peer *peer, struct lnet_peer_net *peer_net,
@@ -1585,6 +1898,12 @@ lnet_get_best_ni(struct lnet_net *local_net, struct lnet_ni *best_ni,
 	if (!lnet_get_next_peer_ni_locked(peer, peer_net, NULL))
 		return best_ni;
 
+	/* an NI found on another net can't be rated by latency here */
+	if (local_net->net_sel_policy == LNET_SEL_POLICY_LATENCY &&
+	    (!best_ni || best_ni->ni_net == local_net))
+		return lnet_get_best_ni_latency(local_net, best_ni, peer,
+						peer_net);
+
 	if (best_ni == NULL) {
 		shortest_distance = UINT_MAX;
 		best_credits = INT_MIN;
@@ -1781,6 +2100,8 @@ lnet_handle_send(struct lnet_send_data *sd)
 	 */
 	msg->msg_txpeer = best_lpni;
 	msg->msg_txni = best_ni;
+	if (best_ni->ni_net->net_sel_policy == LNET_SEL_POLICY_LATENCY)
+		lnet_path_start(msg);
 
 	/*
 	 * grab a reference for the best_ni since now it's in use in this
@@ -2620,6 +2941,13 @@ lnet_select_pathway(lnet_nid_t src_nid, lnet_nid_t dst_nid,
 
 	memset(&send_data, 0, sizeof(send_data));
 
+	/*
+	 * The peer_ni lookup is lockless, so don't do it under the cpt lock
+	 * and don't wait for the lock if discovery holds it exclusively
+	 * meanwhile. The lock is only needed to create a missing peer_ni.
+	 */
+	lpni = lnet_find_peer_ni(dst_nid);
+
 	/*
 	 * get an initial CPT to use for locking. The idea here is not to
 	 * serialize the calls to select_pathway, so that as many
@@ -2646,6 +2974,8 @@ again:
 	send_data.sd_cpt = cpt;
 	if (LNET_NETTYP(LNET_NIDNET(dst_nid)) == LOLND) {
 		rc = lnet_handle_lo_send(&send_data);
+		if (lpni)
+			lnet_peer_ni_decref_locked(lpni);
 		lnet_net_unlock(cpt);
 		return rc;
 	}
@@ -2655,7 +2985,8 @@ again:
 	 * created due to network traffic. This call will create the
 	 * peer->peer_net->peer_ni tree.
 	 */
-	lpni = lnet_nid2peerni_locked(dst_nid, LNET_NID_ANY, cpt);
+	if (!lpni)
+		lpni = lnet_nid2peerni_locked(dst_nid, LNET_NID_ANY, cpt);
 	if (IS_ERR(lpni)) {
 		lnet_net_unlock(cpt);
 		return PTR_ERR(lpni);
@@ -2733,8 +3064,11 @@ again:
 	 */
 	cpt = send_data.sd_cpt;
 
-	if (rc == REPEAT_SEND)
+	if (rc == REPEAT_SEND) {
+		/* our reference was dropped, look the peer_ni up again */
+		lpni = NULL;
 		goto again;
+	}
 
 	lnet_net_unlock(cpt);
 
@@ -2763,6 +3097,9 @@ lnet_send(lnet_nid_t src_nid, struct lnet_msg *msg, lnet_nid_t rtr_nid)
 
 	LASSERT(!msg->msg_tx_committed);
 
+	lnet_trace_sample_msg(msg);
+	lnet_trace(msg, LNET_TRACE_SEND, 0);
+
 	rc = lnet_select_pathway(src_nid, dst_nid, msg, rtr_nid);
 	if (rc < 0) {
 		if (rc == -EHOSTUNREACH)
@@ -3442,6 +3779,7 @@ lnet_monitor_thread(void *arg)
 {
 	time64_t recovery_timeout = 0;
 	time64_t rsp_timeout = 0;
+	time64_t rtrpool_timeout = 0;
 	int interval;
 	time64_t now;
 
@@ -3454,6 +3792,7 @@ lnet_monitor_thread(void *arg)
 	 *     pings them
 	 *  4. Checks if there are any NIs on the remote recovery queue
 	 *     and pings them.
+	 *  5. Resizes the router buffer pools if they are auto-sized.
 	 */
 	cfs_block_allsigs();
 
@@ -3465,6 +3804,12 @@ lnet_monitor_thread(void *arg)
 
 		lnet_resend_pending_msgs();
 
+		if (now >= rtrpool_timeout) {
+			lnet_rtrpools_autosize();
+			lnet_peer_credits_rebalance();
+			rtrpool_timeout = now + 1;
+		}
+
 		if (now >= rsp_timeout) {
 			lnet_finalize_expired_responses(false);
 			rsp_timeout = now + (lnet_transaction_timeout / 2);
@@ -3610,21 +3955,17 @@ lnet_handle_recovery_reply(struct lnet_mt_event_info *ev_info,
 			lnet_inc_healthv(&ni->ni_healthv);
 	} else {
 		struct lnet_peer_ni *lpni;
-		int cpt;
 
-		cpt = lnet_net_lock_current();
-		lpni = lnet_find_peer_ni_locked(nid);
-		if (!lpni) {
-			lnet_net_unlock(cpt);
+		/* lpni_state is protected by lpni_lock only */
+		lpni = lnet_find_peer_ni(nid);
+		if (!lpni)
 			return;
-		}
 		spin_lock(&lpni->lpni_lock);
 		lpni->lpni_state &= ~LNET_PEER_NI_RECOVERY_PENDING;
 		if (status)
 			lpni->lpni_state |= LNET_PEER_NI_RECOVERY_FAILED;
 		spin_unlock(&lpni->lpni_lock);
-		lnet_peer_ni_decref_locked(lpni);
-		lnet_net_unlock(cpt);
+		lnet_peer_ni_decref(lpni);
 
 		if (status != 0)
 			CERROR("peer NI (%s) recovery failed with %d\n",
@@ -4429,8 +4770,12 @@ lnet_parse(struct lnet_ni *ni, struct lnet_hdr *hdr, lnet_nid_t from_nid,
 		msg->msg_hdr.payload_length = payload_length;
 	}
 
+	/* lockless, see lnet_select_pathway() */
+	lpni = lnet_find_peer_ni(from_nid);
+
 	lnet_net_lock(cpt);
-	lpni = lnet_nid2peerni_locked(from_nid, ni->ni_nid, cpt);
+	if (!lpni)
+		lpni = lnet_nid2peerni_locked(from_nid, ni->ni_nid, cpt);
 	if (IS_ERR(lpni)) {
 		lnet_net_unlock(cpt);
 		CERROR("%s, src %s: Dropping %s "
@@ -4460,6 +4805,9 @@ lnet_parse(struct lnet_ni *ni, struct lnet_hdr *hdr, lnet_nid_t from_nid,
 	 */
 	msg->msg_rxpeer->lpni_ns_status = LNET_NI_STATUS_UP;
 
+	lnet_trace_sample_msg(msg);
+	lnet_trace(msg, LNET_TRACE_RECV, 0);
+
 	lnet_msg_commit(msg, cpt);
 
 	/* message delay simulation */
@@ -946,6 +946,8 @@ lnet_finalize(struct lnet_msg *msg, int status)
 	if (msg == NULL)
 		return;
 
+	lnet_trace(msg, LNET_TRACE_DONE, status);
+
 	msg->msg_ev.status = status;
 
 	if (lnet_is_health_check(msg)) {
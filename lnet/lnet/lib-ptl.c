@@ -321,14 +321,15 @@ lnet_mt_test_exhausted(struct lnet_match_table *mtable, int pos)
 		return 0;
 
 	if (pos < 0) { /* check all bits */
-		for (i = 0; i < LNET_MT_EXHAUSTED_BMAP; i++) {
+		for (i = 0; i < LNET_MT_EXHAUSTED_BMAP(mtable->mt_hash_bits);
+		     i++) {
 			if (mtable->mt_exhausted[i] != (__u64)(-1))
 				return 0;
 		}
 		return 1;
 	}
 
-	LASSERT(pos <= LNET_MT_HASH_IGNORE);
+	LASSERT(pos <= LNET_MT_HASH_IGNORE(mtable->mt_hash_bits));
 	/* mtable::mt_mhash[pos] is marked as exhausted or not */
 	bmap = &mtable->mt_exhausted[pos >> LNET_MT_BITS_U64];
 	pos &= (1 << LNET_MT_BITS_U64) - 1;
@@ -342,7 +343,7 @@ lnet_mt_set_exhausted(struct lnet_match_table *mtable, int pos, int exhausted)
 	__u64	*bmap;
 
 	LASSERT(lnet_ptl_is_wildcard(the_lnet.ln_portals[mtable->mt_portal]));
-	LASSERT(pos <= LNET_MT_HASH_IGNORE);
+	LASSERT(pos <= LNET_MT_HASH_IGNORE(mtable->mt_hash_bits));
 
 	/* set mtable::mt_mhash[pos] as exhausted/non-exhausted */
 	bmap = &mtable->mt_exhausted[pos >> LNET_MT_BITS_U64];
@@ -354,21 +355,237 @@ lnet_mt_set_exhausted(struct lnet_match_table *mtable, int pos, int exhausted)
 		*bmap |= 1ULL << pos;
 }
 
+static unsigned int
+lnet_mt_hash(bool wildcard, unsigned int bits,
+	     struct lnet_process_id id, __u64 mbits)
+{
+	unsigned long hash;
+
+	if (wildcard)
+		return mbits & ((1U << bits) - 1);
+
+	hash = mbits + id.nid + id.pid;
+	return hash_long(hash, bits);
+}
+
 struct list_head *
 lnet_mt_match_head(struct lnet_match_table *mtable,
 		   struct lnet_process_id id, __u64 mbits)
 {
 	struct lnet_portal *ptl = the_lnet.ln_portals[mtable->mt_portal];
 
-	if (lnet_ptl_is_wildcard(ptl)) {
-		return &mtable->mt_mhash[mbits & LNET_MT_HASH_MASK];
-	} else {
-		unsigned long hash = mbits + id.nid + id.pid;
+	LASSERT(lnet_ptl_is_wildcard(ptl) || lnet_ptl_is_unique(ptl));
+	return &mtable->mt_mhash[lnet_mt_hash(lnet_ptl_is_wildcard(ptl),
+					      mtable->mt_hash_bits,
+					      id, mbits)];
+}
+
+static void
+lnet_mt_free_hash(unsigned int bits, struct list_head *mhash,
+		  __u64 *exhausted)
+{
+	if (exhausted != NULL)
+		LIBCFS_FREE(exhausted,
+			    sizeof(*exhausted) * LNET_MT_EXHAUSTED_BMAP(bits));
+	if (mhash != NULL)
+		LIBCFS_FREE(mhash,
+			    sizeof(*mhash) * (LNET_MT_HASH_IGNORE(bits) + 1));
+}
+
+static int
+lnet_mt_alloc_hash(int cpt, unsigned int bits, struct list_head **mhashp,
+		   __u64 **exhaustedp)
+{
+	struct list_head *mhash;
+	__u64 *exhausted;
+	int i;
+
+	/* the extra entry is for MEs with ignore bits */
+	LIBCFS_CPT_ALLOC(mhash, lnet_cpt_table(), cpt,
+			 sizeof(*mhash) * (LNET_MT_HASH_IGNORE(bits) + 1));
+	if (mhash == NULL)
+		return -ENOMEM;
+
+	LIBCFS_CPT_ALLOC(exhausted, lnet_cpt_table(), cpt,
+			 sizeof(*exhausted) * LNET_MT_EXHAUSTED_BMAP(bits));
+	if (exhausted == NULL) {
+		lnet_mt_free_hash(bits, mhash, NULL);
+		return -ENOMEM;
+	}
+
+	for (i = 0; i <= LNET_MT_HASH_IGNORE(bits); i++)
+		INIT_LIST_HEAD(&mhash[i]);
+
+	*mhashp = mhash;
+	*exhaustedp = exhausted;
+	return 0;
+}
+
+/**
+ * Rehash the MEs of \a mtable to 2^LNET_MT_HASH_BITS_STEP times as many
+ * chains once it has more than LNET_MT_HASH_LOAD MEs per chain, so that
+ * servers with many posted MEs don't walk long chains in lnet_parse().
+ *
+ * MEs with the same match bits and ID stay in their order. A new chain
+ * inherits the exhausted flag of the chain its MEs come from, which
+ * covers all of them.
+ */
+void
+lnet_mt_grow(struct lnet_match_table *mtable)
+{
+	struct lnet_portal *ptl = the_lnet.ln_portals[mtable->mt_portal];
+	struct list_head *old_mhash;
+	struct list_head *mhash;
+	__u64 *old_exhausted;
+	__u64 *exhausted;
+	struct lnet_me *me;
+	struct lnet_me *tmp;
+	unsigned int bits = READ_ONCE(mtable->mt_hash_bits);
+	unsigned int new_bits;
+	unsigned int pos = 0;
+	bool wildcard;
+	int i;
+
+	if (bits >= LNET_MT_HASH_BITS_MAX)
+		return;
+
+	new_bits = min(bits + LNET_MT_HASH_BITS_STEP,
+		       (unsigned int)LNET_MT_HASH_BITS_MAX);
+	if (lnet_mt_alloc_hash(mtable->mt_cpt, new_bits, &mhash, &exhausted))
+		return; /* keep the current one */
+
+	lnet_res_lock(mtable->mt_cpt);
+	if (mtable->mt_hash_bits != bits ||
+	    mtable->mt_nmes <= LNET_MT_HASH_LOAD << bits) {
+		/* somebody else has grown it */
+		lnet_res_unlock(mtable->mt_cpt);
+		lnet_mt_free_hash(new_bits, mhash, exhausted);
+		return;
+	}
 
-		LASSERT(lnet_ptl_is_unique(ptl));
-		hash = hash_long(hash, LNET_MT_HASH_BITS);
-		return &mtable->mt_mhash[hash & LNET_MT_HASH_MASK];
+	wildcard = lnet_ptl_is_wildcard(ptl);
+	old_mhash = mtable->mt_mhash;
+	old_exhausted = mtable->mt_exhausted;
+	for (i = 0; i < LNET_MT_HASH_IGNORE(bits); i++) {
+		bool first = true;
+
+		list_for_each_entry_safe(me, tmp, &old_mhash[i], me_list) {
+			/* an ME with ignore-bits here has been inserted next
+			 * to another one by LNetMEInsert(), keep it there */
+			if (me->me_ignore_bits == 0 || first)
+				pos = lnet_mt_hash(wildcard, new_bits,
+						   me->me_match_id,
+						   me->me_match_bits);
+			first = false;
+			me->me_pos = pos;
+			list_move_tail(&me->me_list, &mhash[pos]);
+		}
 	}
+
+	list_splice_init(&old_mhash[LNET_MT_HASH_IGNORE(bits)],
+			 &mhash[LNET_MT_HASH_IGNORE(new_bits)]);
+	list_for_each_entry(me, &mhash[LNET_MT_HASH_IGNORE(new_bits)],
+			    me_list)
+		me->me_pos = LNET_MT_HASH_IGNORE(new_bits);
+
+	/* only wildcard portals use the bitmap, their chains are split by
+	 * the low match bits. As in lnet_ptl_setup() all bits start set,
+	 * including the unused ones, so that lnet_mt_test_exhausted(-1)
+	 * still works; a chain split from a non-exhausted one is cleared. */
+	memset(exhausted, -1,
+	       sizeof(*exhausted) * LNET_MT_EXHAUSTED_BMAP(new_bits));
+	for (i = 0; i <= LNET_MT_HASH_IGNORE(new_bits); i++) {
+		unsigned int old_pos = i == LNET_MT_HASH_IGNORE(new_bits) ?
+				       LNET_MT_HASH_IGNORE(bits) :
+				       i & (LNET_MT_HASH_IGNORE(bits) - 1);
+
+		if (!(old_exhausted[old_pos >> LNET_MT_BITS_U64] &
+		      (1ULL << (old_pos & ((1 << LNET_MT_BITS_U64) - 1)))))
+			exhausted[i >> LNET_MT_BITS_U64] &=
+				~(1ULL << (i & ((1 << LNET_MT_BITS_U64) - 1)));
+	}
+
+	mtable->mt_exhausted = exhausted;
+	mtable->mt_mhash = mhash;
+	mtable->mt_hash_bits = new_bits;
+	lnet_res_unlock(mtable->mt_cpt);
+
+	CDEBUG(D_NET, "portal %d cpt %d: %u MEs, %u -> %u hash bits\n",
+	       mtable->mt_portal, mtable->mt_cpt, mtable->mt_nmes, bits,
+	       new_bits);
+	lnet_mt_free_hash(bits, old_mhash, old_exhausted);
+}
+
+/**
+ * Microbenchmark of the ME lookup done by lnet_mt_match_md(): hash \a nmes
+ * MEs with distinct match bits on 2^\a bits chains the way a wildcard or a
+ * unique portal does, then look each of them up.
+ *
+ * \retval 0 and the average nanoseconds of a lookup in \a nsec
+ */
+int
+lnet_mt_match_bench(unsigned int nmes, bool wildcard, unsigned int bits,
+		    __u64 *nsec)
+{
+	struct lnet_process_id id = {
+		.nid = LNET_MKNID(LNET_MKNET(SOCKLND, 0), 0x0a000001),
+		.pid = LNET_PID_LUSTRE,
+	};
+	const __u64 base = 0x5a5a000000000000ULL;
+	struct list_head *mhash;
+	struct lnet_me *mes;
+	struct lnet_me *me;
+	unsigned int found = 0;
+	ktime_t start;
+	int i;
+
+	if (nmes == 0 || bits > LNET_MT_HASH_BITS_MAX)
+		return -EINVAL;
+
+	LIBCFS_ALLOC(mes, nmes * sizeof(*mes));
+	if (mes == NULL)
+		return -ENOMEM;
+
+	LIBCFS_ALLOC(mhash, sizeof(*mhash) << bits);
+	if (mhash == NULL) {
+		LIBCFS_FREE(mes, nmes * sizeof(*mes));
+		return -ENOMEM;
+	}
+
+	for (i = 0; i < (1 << bits); i++)
+		INIT_LIST_HEAD(&mhash[i]);
+
+	for (i = 0; i < nmes; i++) {
+		me = &mes[i];
+		me->me_match_id = id;
+		me->me_match_bits = base + i;
+		list_add_tail(&me->me_list,
+			      &mhash[lnet_mt_hash(wildcard, bits, id,
+						  me->me_match_bits)]);
+	}
+
+	start = ktime_get();
+	for (i = 0; i < nmes; i++) {
+		__u64 mbits = base + i;
+
+		list_for_each_entry(me, &mhash[lnet_mt_hash(wildcard, bits,
+							    id, mbits)],
+				    me_list) {
+			if (me->me_match_id.nid == id.nid &&
+			    me->me_match_id.pid == id.pid &&
+			    ((me->me_match_bits ^ mbits) &
+			     ~me->me_ignore_bits) == 0) {
+				found++;
+				break;
+			}
+		}
+	}
+	*nsec = ktime_to_ns(ktime_sub(ktime_get(), start)) / nmes;
+
+	LIBCFS_FREE(mhash, sizeof(*mhash) << bits);
+	LIBCFS_FREE(mes, nmes * sizeof(*mes));
+
+	return found == nmes ? 0 : -EIO;
 }
 
 int
@@ -378,12 +595,13 @@ lnet_mt_match_md(struct lnet_match_table *mtable,
 	struct list_head	*head;
 	struct lnet_me		*me;
 	struct lnet_me		*tmp;
+	unsigned int		ignore = LNET_MT_HASH_IGNORE(mtable->mt_hash_bits);
 	int			exhausted = 0;
 	int			rc;
 
 	/* any ME with ignore bits? */
-	if (!list_empty(&mtable->mt_mhash[LNET_MT_HASH_IGNORE]))
-		head = &mtable->mt_mhash[LNET_MT_HASH_IGNORE];
+	if (!list_empty(&mtable->mt_mhash[ignore]))
+		head = &mtable->mt_mhash[ignore];
 	else
 		head = lnet_mt_match_head(mtable, info->mi_id, info->mi_mbits);
  again:
@@ -415,7 +633,7 @@ lnet_mt_match_md(struct lnet_match_table *mtable,
 			exhausted = 0;
 	}
 
-	if (exhausted == 0 && head == &mtable->mt_mhash[LNET_MT_HASH_IGNORE]) {
+	if (exhausted == 0 && head == &mtable->mt_mhash[ignore]) {
 		head = lnet_mt_match_head(mtable, info->mi_id, info->mi_mbits);
 		goto again; /* re-check MEs w/o ignore-bits */
 	}
@@ -762,7 +980,8 @@ lnet_ptl_cleanup(struct lnet_portal *ptl)
 
 		mhash = mtable->mt_mhash;
 		/* cleanup ME */
-		for (j = 0; j < LNET_MT_HASH_SIZE + 1; j++) {
+		for (j = 0; j <= LNET_MT_HASH_IGNORE(mtable->mt_hash_bits);
+		     j++) {
 			while (!list_empty(&mhash[j])) {
 				me = list_entry(mhash[j].next,
 						struct lnet_me, me_list);
@@ -771,8 +990,8 @@ lnet_ptl_cleanup(struct lnet_portal *ptl)
 				lnet_me_free(me);
 			}
 		}
-		/* the extra entry is for MEs with ignore bits */
-		LIBCFS_FREE(mhash, sizeof(*mhash) * (LNET_MT_HASH_SIZE + 1));
+		lnet_mt_free_hash(mtable->mt_hash_bits, mhash,
+				  mtable->mt_exhausted);
 	}
 
 	cfs_percpt_free(ptl->ptl_mtables);
@@ -783,9 +1002,7 @@ static int
 lnet_ptl_setup(struct lnet_portal *ptl, int index)
 {
 	struct lnet_match_table	*mtable;
-	struct list_head	*mhash;
 	int			i;
-	int			j;
 
 	ptl->ptl_mtables = cfs_percpt_alloc(lnet_cpt_table(),
 					    sizeof(struct lnet_match_table));
@@ -799,21 +1016,18 @@ lnet_ptl_setup(struct lnet_portal *ptl, int index)
 	INIT_LIST_HEAD(&ptl->ptl_msg_stealing);
 	spin_lock_init(&ptl->ptl_lock);
 	cfs_percpt_for_each(mtable, i, ptl->ptl_mtables) {
-		/* the extra entry is for MEs with ignore bits */
-		LIBCFS_CPT_ALLOC(mhash, lnet_cpt_table(), i,
-				 sizeof(*mhash) * (LNET_MT_HASH_SIZE + 1));
-		if (mhash == NULL) {
+		mtable->mt_hash_bits = LNET_MT_HASH_BITS;
+		if (lnet_mt_alloc_hash(i, mtable->mt_hash_bits,
+				       &mtable->mt_mhash,
+				       &mtable->mt_exhausted)) {
 			CERROR("Failed to create match hash for portal %d\n",
 			       index);
 			goto failed;
 		}
 
-		memset(&mtable->mt_exhausted[0], -1,
+		memset(mtable->mt_exhausted, -1,
 		       sizeof(mtable->mt_exhausted[0]) *
-		       LNET_MT_EXHAUSTED_BMAP);
-		mtable->mt_mhash = mhash;
-		for (j = 0; j < LNET_MT_HASH_SIZE + 1; j++)
-			INIT_LIST_HEAD(&mhash[j]);
+		       LNET_MT_EXHAUSTED_BMAP(mtable->mt_hash_bits));
 
 		mtable->mt_portal = index;
 		mtable->mt_cpt = i;
@@ -0,0 +1,275 @@
+/*
+ * GPL HEADER START
+ *
+ * DO NOT ALTER OR REMOVE COPYRIGHT NOTICES OR THIS FILE HEADER.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 only,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License version 2 for more details (a copy is included
+ * in the LICENSE file that accompanied this code).
+ *
+ * You should have received a copy of the GNU General Public License
+ * version 2 along with this program; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 021110-1307, USA
+ *
+ * GPL HEADER END
+ */
+/*
+ * This file is part of Lustre, http://www.lustre.org/
+ *
+ * lnet/lnet/lib-trace.c
+ *
+ * Sampled message tracing.  1 in lnet_trace_sample messages gets a trace
+ * id when it is sent or received, and every step it then goes through
+ * (credit waits, LND hand-off, completion) is timestamped into a ring
+ * owned by the current CPU.  The rings are copied out with
+ * IOC_LIBCFS_TRACE_DUMP ("lnetctl trace dump").
+ */
+
+#define DEBUG_SUBSYSTEM S_LNET
+
+#include <lnet/lib-lnet.h>
+
+unsigned int lnet_trace_sample = 1024;
+module_param(lnet_trace_sample, uint, 0644);
+MODULE_PARM_DESC(lnet_trace_sample,
+		 "Trace 1 in N messages, 0 to disable message tracing");
+
+static unsigned int lnet_trace_records = 1024;
+module_param(lnet_trace_records, uint, 0444);
+MODULE_PARM_DESC(lnet_trace_records,
+		 "Records in the message trace ring of each CPU");
+
+/* trace ids are unique per CPU, the CPU id is kept in the top bits */
+#define LNET_TRACE_ID_CPU_SHIFT	48
+
+static inline size_t
+lnet_trace_ring_size(unsigned int nrecs)
+{
+	return sizeof(struct lnet_trace_ring) +
+	       nrecs * sizeof(struct lnet_trace_rec);
+}
+
+static __u64
+lnet_trace_cookie(struct lnet_msg *msg)
+{
+	struct lnet_hdr *hdr = &msg->msg_hdr;
+
+	/* type specific fields are still in wire order when this is
+	 * called, so the sender and the receiver record the same value */
+	switch (msg->msg_type) {
+	case LNET_MSG_PUT:
+		return le64_to_cpu(hdr->msg.put.ack_wmd.wh_object_cookie);
+	case LNET_MSG_GET:
+		return le64_to_cpu(hdr->msg.get.return_wmd.wh_object_cookie);
+	case LNET_MSG_ACK:
+		return le64_to_cpu(hdr->msg.ack.dst_wmd.wh_object_cookie);
+	case LNET_MSG_REPLY:
+		return le64_to_cpu(hdr->msg.reply.dst_wmd.wh_object_cookie);
+	default:
+		return 0;
+	}
+}
+
+void
+lnet_trace_msg_sample(struct lnet_msg *msg)
+{
+	unsigned int sample = READ_ONCE(lnet_trace_sample);
+	struct lnet_trace_ring *ring;
+	int cpu;
+
+	if (the_lnet.ln_trace_rings == NULL || sample == 0)
+		return;
+
+	cpu = get_cpu();
+	ring = the_lnet.ln_trace_rings[cpu];
+	/* lnet_trace_sample may have been lowered since the last sample */
+	if ((unsigned int)ring->tr_countdown > sample)
+		ring->tr_countdown = sample;
+	if (--ring->tr_countdown <= 0) {
+		ring->tr_countdown = sample;
+		ring->tr_seq++;
+		msg->msg_trace_id = ((__u64)cpu << LNET_TRACE_ID_CPU_SHIFT) |
+			(ring->tr_seq &
+			 ((1ULL << LNET_TRACE_ID_CPU_SHIFT) - 1));
+	}
+	put_cpu();
+}
+
+/*
+ * All trace points run in thread context, so disabling preemption is
+ * enough to make the current CPU the only writer of its ring.
+ */
+void
+lnet_trace_record(struct lnet_msg *msg, enum lnet_trace_event event,
+		  int status)
+{
+	struct lnet_trace_ring *ring;
+	struct lnet_trace_rec *rec;
+	unsigned long head;
+	int cpu;
+
+	cpu = get_cpu();
+	ring = the_lnet.ln_trace_rings[cpu];
+	head = ring->tr_head;
+	rec = &ring->tr_recs[head & ring->tr_mask];
+
+	rec->ltr_time_ns = ktime_get_ns();
+	rec->ltr_id = msg->msg_trace_id;
+	rec->ltr_cookie = (event == LNET_TRACE_SEND ||
+			   event == LNET_TRACE_RECV) ?
+			  lnet_trace_cookie(msg) : 0;
+	rec->ltr_len = msg->msg_len;
+	rec->ltr_status = status;
+	rec->ltr_event = event;
+	rec->ltr_msg_type = msg->msg_type;
+	rec->ltr_cpu = cpu;
+	rec->ltr_flags = 0;
+	if (msg->msg_routing)
+		rec->ltr_flags |= LNET_TRACE_F_ROUTING;
+	if (msg->msg_retry_count > 0)
+		rec->ltr_flags |= LNET_TRACE_F_RESEND;
+
+	if (msg->msg_sending) {
+		rec->ltr_flags |= LNET_TRACE_F_SENDING;
+		rec->ltr_ni_nid = msg->msg_txni != NULL ?
+				  msg->msg_txni->ni_nid : LNET_NID_ANY;
+		/* the next hop is unknown until the pathway is selected */
+		rec->ltr_peer_nid = msg->msg_txpeer != NULL ?
+				    msg->msg_txpeer->lpni_nid :
+				    msg->msg_target.nid;
+	} else {
+		rec->ltr_ni_nid = msg->msg_rxni != NULL ?
+				  msg->msg_rxni->ni_nid : LNET_NID_ANY;
+		rec->ltr_peer_nid = msg->msg_from;
+	}
+
+	/* publish the record, pairs with lnet_trace_dump() */
+	smp_store_release(&ring->tr_head, head + 1);
+	put_cpu();
+}
+
+int
+lnet_trace_dump(struct lnet_ioctl_trace_dump *dump)
+{
+	struct lnet_trace_ring *ring;
+	struct lnet_trace_rec *recs;
+	unsigned long first;
+	unsigned long head;
+	unsigned long last;
+	unsigned long i;
+	__u32 count;
+	int rc = 0;
+
+	dump->ltd_ncpus = nr_cpu_ids;
+	dump->ltd_sample = READ_ONCE(lnet_trace_sample);
+	dump->ltd_lost = 0;
+
+	if (dump->ltd_cpu >= nr_cpu_ids)
+		return -EINVAL;
+
+	if (the_lnet.ln_trace_rings == NULL || !cpu_possible(dump->ltd_cpu)) {
+		dump->ltd_count = 0;
+		return 0;
+	}
+
+	ring = the_lnet.ln_trace_rings[dump->ltd_cpu];
+	count = min(dump->ltd_count, ring->tr_mask + 1);
+	if (count == 0)
+		return 0;
+
+	/* copy to a private buffer first, the ring keeps moving */
+	LIBCFS_ALLOC(recs, count * sizeof(*recs));
+	if (recs == NULL)
+		return -ENOMEM;
+
+	head = smp_load_acquire(&ring->tr_head);
+	first = head > count ? head - count : 0;
+	for (i = first; i < head; i++)
+		recs[i - first] = ring->tr_recs[i & ring->tr_mask];
+
+	/* record N shares its slot with N + mask + 1, so everything older
+	 * than that may have been overwritten while it was copied */
+	smp_rmb();
+	last = READ_ONCE(ring->tr_head);
+	if (last > ring->tr_mask && last - ring->tr_mask > first) {
+		i = min(last - ring->tr_mask, head);
+		memmove(recs, &recs[i - first], (head - i) * sizeof(*recs));
+		first = i;
+	}
+
+	dump->ltd_count = head - first;
+	dump->ltd_lost = first;
+	if (dump->ltd_count > 0 &&
+	    copy_to_user(dump->ltd_buf, recs,
+			 dump->ltd_count * sizeof(*recs)))
+		rc = -EFAULT;
+
+	LIBCFS_FREE(recs, count * sizeof(*recs));
+	return rc;
+}
+
+int
+lnet_trace_init(void)
+{
+	struct lnet_trace_ring *ring;
+	unsigned int nrecs;
+	int cpu;
+
+	CLASSERT(sizeof(struct lnet_trace_rec) == 56);
+
+	if (lnet_trace_records == 0) {
+		lnet_trace_sample = 0;
+		return 0;
+	}
+
+	nrecs = roundup_pow_of_two(lnet_trace_records);
+
+	LIBCFS_ALLOC(the_lnet.ln_trace_rings,
+		     nr_cpu_ids * sizeof(the_lnet.ln_trace_rings[0]));
+	if (the_lnet.ln_trace_rings == NULL)
+		return -ENOMEM;
+
+	for_each_possible_cpu(cpu) {
+		LIBCFS_CPT_ALLOC(ring, lnet_cpt_table(),
+				 cfs_cpt_of_cpu(lnet_cpt_table(), cpu),
+				 lnet_trace_ring_size(nrecs));
+		if (ring == NULL) {
+			lnet_trace_fini();
+			return -ENOMEM;
+		}
+
+		ring->tr_mask = nrecs - 1;
+		the_lnet.ln_trace_rings[cpu] = ring;
+	}
+
+	return 0;
+}
+
+void
+lnet_trace_fini(void)
+{
+	struct lnet_trace_ring *ring;
+	int cpu;
+
+	if (the_lnet.ln_trace_rings == NULL)
+		return;
+
+	for_each_possible_cpu(cpu) {
+		ring = the_lnet.ln_trace_rings[cpu];
+		if (ring == NULL)
+			continue;
+
+		LIBCFS_FREE(ring, lnet_trace_ring_size(ring->tr_mask + 1));
+	}
+
+	LIBCFS_FREE(the_lnet.ln_trace_rings,
+		    nr_cpu_ids * sizeof(the_lnet.ln_trace_rings[0]));
+	the_lnet.ln_trace_rings = NULL;
+}
@@ -46,6 +46,14 @@
 /* Value indicating that recovery needs to re-check a peer immediately. */
 #define LNET_REDISCOVER_PEER	(1)
 
+static int dynamic_peer_credits;
+module_param(dynamic_peer_credits, int, 0644);
+MODULE_PARM_DESC(dynamic_peer_credits, "share each net's tx credits among busy peers instead of a fixed peer_credits each");
+
+static int dynamic_peer_credits_min = 2;
+module_param(dynamic_peer_credits_min, int, 0644);
+MODULE_PARM_DESC(dynamic_peer_credits_min, "tx credits every peer keeps with dynamic_peer_credits");
+
 static int lnet_peer_queue_for_discovery(struct lnet_peer *lp);
 
 static void
@@ -69,9 +77,12 @@ lnet_peer_net_added(struct lnet_net *net)
 			lpni->lpni_net = net;
 
 			spin_lock(&lpni->lpni_lock);
-			lpni->lpni_txcredits =
+			atomic_set(&lpni->lpni_txcredits,
+				lpni->lpni_net->net_tunables.lct_peer_tx_credits);
+			lpni->lpni_mintxcredits =
 				lpni->lpni_net->net_tunables.lct_peer_tx_credits;
-			lpni->lpni_mintxcredits = lpni->lpni_txcredits;
+			lpni->lpni_maxtxcredits = lpni->lpni_mintxcredits;
+			lpni->lpni_win_mintxcredits = lpni->lpni_mintxcredits;
 			lpni->lpni_rtrcredits =
 				lnet_peer_buffer_credits(lpni->lpni_net);
 			lpni->lpni_minrtrcredits = lpni->lpni_rtrcredits;
@@ -82,6 +93,143 @@ lnet_peer_net_added(struct lnet_net *net)
 	}
 }
 
+/* credits a peer NI on \a net is guaranteed with dynamic_peer_credits */
+static int
+lnet_peer_credits_floor(struct lnet_net *net)
+{
+	return clamp(dynamic_peer_credits_min, 1,
+		     net->net_tunables.lct_peer_tx_credits);
+}
+
+/* what the peer NI would like for the next second, at least the floor */
+static int
+lnet_peer_ni_txwant(struct lnet_peer_ni *lpni, int floor)
+{
+	int want = lpni->lpni_txdemand + lpni->lpni_txdemand / 4;
+
+	return clamp(want, floor,
+		     max(floor, lpni->lpni_net->net_tunables.lct_max_tx_credits));
+}
+
+/*
+ * Demand is the most credits in use at once since the last pass, queued
+ * messages included, which the window low water mark gives us directly.
+ */
+static void
+lnet_peer_ni_measure_locked(struct lnet_peer_ni *lpni)
+{
+	struct lnet_net *net = lpni->lpni_net;
+	int floor = lnet_peer_credits_floor(net);
+	int low;
+
+	low = xchg(&lpni->lpni_win_mintxcredits,
+		   atomic_read(&lpni->lpni_txcredits));
+	lpni->lpni_txdemand = max(lpni->lpni_maxtxcredits - low, 0);
+	net->net_pc_wanted += lnet_peer_ni_txwant(lpni, floor) - floor;
+}
+
+static int
+lnet_peer_ni_txtarget(struct lnet_peer_ni *lpni, bool enabled)
+{
+	struct lnet_net *net = lpni->lpni_net;
+	int floor = lnet_peer_credits_floor(net);
+	long extra;
+	int target;
+
+	if (!enabled)
+		return net->net_tunables.lct_peer_tx_credits;
+
+	/* everybody keeps the floor; what is left of the budget is
+	 * shared in proportion to what was asked for */
+	extra = lnet_peer_ni_txwant(lpni, floor) - floor;
+	if (net->net_pc_wanted > net->net_pc_budget)
+		extra = extra * net->net_pc_budget / net->net_pc_wanted;
+	target = floor + extra;
+
+	/* give back gradually so a peer which is busy in bursts doesn't
+	 * start every burst from the floor */
+	if (target < lpni->lpni_maxtxcredits)
+		target = (target + lpni->lpni_maxtxcredits) / 2;
+
+	return target;
+}
+
+/*
+ * Called once a second by the monitor thread. With dynamic_peer_credits
+ * set, each local net has a budget of lct_max_tx_credits per NI which is
+ * shared among its peer NIs on top of a guaranteed floor, so idle peers
+ * don't sit on credits busy ones could use. Turning it off puts every
+ * peer NI back on the static peer_credits.
+ */
+void
+lnet_peer_credits_rebalance(void)
+{
+	static bool active;
+	struct lnet_peer_table *ptable;
+	struct lnet_peer_ni *lpni;
+	struct lnet_net *net;
+	struct lnet_ni *ni;
+	LIST_HEAD(released);
+	bool enabled = dynamic_peer_credits != 0;
+	bool settled = true;
+	int target;
+	int i;
+	int j;
+
+	if (!enabled && !active)
+		return;
+
+	/* nets are added and removed under ln_api_mutex */
+	if (!mutex_trylock(&the_lnet.ln_api_mutex))
+		return;
+
+	if (the_lnet.ln_state != LNET_STATE_RUNNING)
+		goto out;
+
+	list_for_each_entry(net, &the_lnet.ln_nets, net_list) {
+		net->net_pc_budget = 0;
+		net->net_pc_wanted = 0;
+		list_for_each_entry(ni, &net->net_ni_list, ni_netlist)
+			net->net_pc_budget +=
+				net->net_tunables.lct_max_tx_credits;
+	}
+
+	cfs_percpt_for_each(ptable, i, the_lnet.ln_peer_tables) {
+		lnet_net_lock(i);
+		for (j = 0; j < LNET_PEER_HASH_SIZE; j++) {
+			list_for_each_entry(lpni, &ptable->pt_hash[j],
+					    lpni_hashlist) {
+				if (lpni->lpni_net != NULL)
+					lnet_peer_ni_measure_locked(lpni);
+			}
+		}
+		lnet_net_unlock(i);
+	}
+
+	cfs_percpt_for_each(ptable, i, the_lnet.ln_peer_tables) {
+		lnet_net_lock(i);
+		for (j = 0; j < LNET_PEER_HASH_SIZE; j++) {
+			list_for_each_entry(lpni, &ptable->pt_hash[j],
+					    lpni_hashlist) {
+				if (lpni->lpni_net == NULL)
+					continue;
+				target = lnet_peer_ni_txtarget(lpni, enabled);
+				lnet_peer_ni_set_txcredits(lpni, target,
+							   &released);
+				if (lpni->lpni_maxtxcredits != target)
+					settled = false;
+			}
+		}
+		lnet_net_unlock(i);
+
+		lnet_post_released_sends(&released);
+	}
+
+	active = enabled || !settled;
+out:
+	mutex_unlock(&the_lnet.ln_api_mutex);
+}
+
 static void
 lnet_peer_tables_destroy(void)
 {
@@ -93,6 +241,9 @@ lnet_peer_tables_destroy(void)
 	if (!the_lnet.ln_peer_tables)
 		return;
 
+	/* wait for the last RCU-deferred peer_ni frees */
+	rcu_barrier();
+
 	cfs_percpt_for_each(ptable, i, the_lnet.ln_peer_tables) {
 		hash = ptable->pt_hash;
 		if (!hash) /* not intialized */
@@ -163,6 +314,7 @@ lnet_peer_ni_alloc(lnet_nid_t nid)
 
 	INIT_LIST_HEAD(&lpni->lpni_txq);
 	INIT_LIST_HEAD(&lpni->lpni_hashlist);
+	INIT_LIST_HEAD(&lpni->lpni_zombie_list);
 	INIT_LIST_HEAD(&lpni->lpni_peer_nis);
 	INIT_LIST_HEAD(&lpni->lpni_recovery);
 	INIT_LIST_HEAD(&lpni->lpni_on_remote_peer_ni_list);
@@ -182,8 +334,11 @@ lnet_peer_ni_alloc(lnet_nid_t nid)
 	net = lnet_get_net_locked(LNET_NIDNET(nid));
 	lpni->lpni_net = net;
 	if (net) {
-		lpni->lpni_txcredits = net->net_tunables.lct_peer_tx_credits;
-		lpni->lpni_mintxcredits = lpni->lpni_txcredits;
+		atomic_set(&lpni->lpni_txcredits,
+			   net->net_tunables.lct_peer_tx_credits);
+		lpni->lpni_mintxcredits = net->net_tunables.lct_peer_tx_credits;
+		lpni->lpni_maxtxcredits = lpni->lpni_mintxcredits;
+		lpni->lpni_win_mintxcredits = lpni->lpni_mintxcredits;
 		lpni->lpni_rtrcredits = lnet_peer_buffer_credits(net);
 		lpni->lpni_minrtrcredits = lpni->lpni_rtrcredits;
 	} else {
@@ -222,6 +377,15 @@ lnet_peer_net_alloc(__u32 net_id)
 	return lpn;
 }
 
+static void
+lnet_peer_net_free_rcu(struct rcu_head *head)
+{
+	struct lnet_peer_net *lpn = container_of(head, struct lnet_peer_net,
+						 lpn_rcu);
+
+	LIBCFS_FREE(lpn, sizeof(*lpn));
+}
+
 void
 lnet_destroy_peer_net_locked(struct lnet_peer_net *lpn)
 {
@@ -234,7 +398,7 @@ lnet_destroy_peer_net_locked(struct lnet_peer_net *lpn)
 	LASSERT(list_empty(&lpn->lpn_peer_nets));
 	lp = lpn->lpn_peer;
 	lpn->lpn_peer = NULL;
-	LIBCFS_FREE(lpn, sizeof(*lpn));
+	call_rcu(&lpn->lpn_rcu, lnet_peer_net_free_rcu);
 
 	lnet_peer_decref_locked(lp);
 }
@@ -282,6 +446,14 @@ lnet_peer_alloc(lnet_nid_t nid)
 	return lp;
 }
 
+static void
+lnet_peer_free_rcu(struct rcu_head *head)
+{
+	struct lnet_peer *lp = container_of(head, struct lnet_peer, lp_rcu);
+
+	LIBCFS_FREE(lp, sizeof(*lp));
+}
+
 void
 lnet_destroy_peer_locked(struct lnet_peer *lp)
 {
@@ -315,7 +487,7 @@ lnet_destroy_peer_locked(struct lnet_peer *lp)
 	spin_unlock(&the_lnet.ln_msg_resend_lock);
 	wake_up(&the_lnet.ln_dc_waitq);
 
-	LIBCFS_FREE(lp, sizeof(*lp));
+	call_rcu(&lp->lp_rcu, lnet_peer_free_rcu);
 }
 
 /*
@@ -387,8 +559,12 @@ lnet_peer_ni_del_locked(struct lnet_peer_ni *lpni, bool force)
 
 	lnet_peer_remove_from_remote_list(lpni);
 
-	/* remove peer ni from the hash list. */
-	list_del_init(&lpni->lpni_hashlist);
+	/*
+	 * remove peer ni from the hash list. Lockless lookups may still
+	 * be walking through it, so lpni_hashlist.next must stay valid
+	 * until the RCU grace period after the final decref.
+	 */
+	list_del_rcu(&lpni->lpni_hashlist);
 
 	/*
 	 * indicate the peer is being deleted so the monitor thread can
@@ -414,7 +590,7 @@ lnet_peer_ni_del_locked(struct lnet_peer_ni *lpni, bool force)
 	 * has its own lock.
 	 */
 	spin_lock(&ptable->pt_zombie_lock);
-	list_add(&lpni->lpni_hashlist, &ptable->pt_zombie_list);
+	list_add(&lpni->lpni_zombie_list, &ptable->pt_zombie_list);
 	ptable->pt_zombies++;
 	spin_unlock(&ptable->pt_zombie_lock);
 
@@ -645,6 +821,14 @@ lnet_peer_tables_cleanup(struct lnet_net *net)
 		lnet_peer_ni_finalize_wait(ptable);
 }
 
+/*
+ * The hash chains are RCU lists, so the lookup itself needs no
+ * lnet_net_lock and never waits behind discovery or ping updates
+ * holding it exclusively. A peer_ni whose last reference is being
+ * dropped is skipped rather than revived. A caller holding no cpt
+ * lock can also race with lnet_peer_ni_del_locked() and must check
+ * LNET_PEER_NI_DELETING before following lpni_peer_net.
+ */
 static struct lnet_peer_ni *
 lnet_get_peer_ni_locked(struct lnet_peer_table *ptable, lnet_nid_t nid)
 {
@@ -654,12 +838,15 @@ lnet_get_peer_ni_locked(struct lnet_peer_table *ptable, lnet_nid_t nid)
 	LASSERT(the_lnet.ln_state == LNET_STATE_RUNNING);
 
 	peers = &ptable->pt_hash[lnet_nid2peerhash(nid)];
-	list_for_each_entry(lp, peers, lpni_hashlist) {
-		if (lp->lpni_nid == nid) {
-			lnet_peer_ni_addref_locked(lp);
+	rcu_read_lock();
+	list_for_each_entry_rcu(lp, peers, lpni_hashlist) {
+		if (lp->lpni_nid == nid &&
+		    atomic_inc_not_zero(&lp->lpni_refcount)) {
+			rcu_read_unlock();
 			return lp;
 		}
 	}
+	rcu_read_unlock();
 
 	return NULL;
 }
@@ -679,6 +866,20 @@ lnet_find_peer_ni_locked(lnet_nid_t nid)
 	return lpni;
 }
 
+/*
+ * Look up the peer_ni of \a nid without lnet_net_lock. The reference
+ * must be dropped with lnet_peer_ni_decref() unless the caller holds
+ * lnet_net_lock by then. Returns NULL once LNet is shutting down.
+ */
+struct lnet_peer_ni *
+lnet_find_peer_ni(lnet_nid_t nid)
+{
+	if (the_lnet.ln_state != LNET_STATE_RUNNING)
+		return NULL;
+
+	return lnet_find_peer_ni_locked(nid);
+}
+
 struct lnet_peer_ni *
 lnet_peer_get_ni_locked(struct lnet_peer *lp, lnet_nid_t nid)
 {
@@ -697,21 +898,34 @@ lnet_peer_get_ni_locked(struct lnet_peer *lp, lnet_nid_t nid)
 	return NULL;
 }
 
+/*
+ * Look up the peer owning \a nid without lnet_net_lock. The peer_net and
+ * the peer are freed after an RCU grace period, so they can be followed
+ * even if the peer_ni is being moved to another peer, and a peer whose
+ * last reference is being dropped is skipped. The reference must be
+ * dropped with lnet_peer_decref() unless the caller holds lnet_net_lock
+ * by then.
+ */
 struct lnet_peer *
 lnet_find_peer(lnet_nid_t nid)
 {
 	struct lnet_peer_ni *lpni;
+	struct lnet_peer_net *lpn;
 	struct lnet_peer *lp = NULL;
-	int cpt;
 
-	cpt = lnet_net_lock_current();
-	lpni = lnet_find_peer_ni_locked(nid);
-	if (lpni) {
-		lp = lpni->lpni_peer_net->lpn_peer;
-		lnet_peer_addref_locked(lp);
-		lnet_peer_ni_decref_locked(lpni);
-	}
-	lnet_net_unlock(cpt);
+	lpni = lnet_find_peer_ni(nid);
+	if (!lpni)
+		return NULL;
+
+	rcu_read_lock();
+	lpn = READ_ONCE(lpni->lpni_peer_net);
+	if (lpn)
+		lp = READ_ONCE(lpn->lpn_peer);
+	if (lp && !atomic_inc_not_zero(&lp->lp_refcount))
+		lp = NULL;
+	rcu_read_unlock();
+
+	lnet_peer_ni_decref(lpni);
 
 	return lp;
 }
@@ -881,11 +1095,16 @@ lnet_push_update_to_peers(int force)
 	int lncpt;
 	int cpt;
 
-	lnet_net_lock(LNET_LOCK_EX);
 	if (lnet_peer_discovery_disabled)
 		force = 0;
 	lncpt = cfs_percpt_number(the_lnet.ln_peer_tables);
+	/*
+	 * Take the exclusive lock one peer table at a time, so that on a
+	 * large cluster senders only stall for one table's worth of peers
+	 * instead of the whole walk.
+	 */
 	for (cpt = 0; cpt < lncpt; cpt++) {
+		lnet_net_lock(LNET_LOCK_EX);
 		ptable = the_lnet.ln_peer_tables[cpt];
 		list_for_each_entry(lp, &ptable->pt_peer_list, lp_peer_list) {
 			if (force) {
@@ -897,8 +1116,8 @@ lnet_push_update_to_peers(int force)
 			if (lnet_peer_needs_push(lp))
 				lnet_peer_queue_for_discovery(lp);
 		}
+		lnet_net_unlock(LNET_LOCK_EX);
 	}
-	lnet_net_unlock(LNET_LOCK_EX);
 	wake_up(&the_lnet.ln_dc_waitq);
 }
 
@@ -1254,11 +1473,12 @@ lnet_peer_attach_peer_ni(struct lnet_peer *lp,
 		int hash = lnet_nid2peerhash(lpni->lpni_nid);
 
 		ptable = the_lnet.ln_peer_tables[lpni->lpni_cpt];
-		list_add_tail(&lpni->lpni_hashlist, &ptable->pt_hash[hash]);
-		ptable->pt_version++;
-		ptable->pt_number++;
 		/* This is the 1st refcount on lpni. */
 		atomic_inc(&lpni->lpni_refcount);
+		list_add_tail_rcu(&lpni->lpni_hashlist,
+				  &ptable->pt_hash[hash]);
+		ptable->pt_version++;
+		ptable->pt_number++;
 	}
 
 	/* Detach the peer_ni from an existing peer, if necessary. */
@@ -1696,6 +1916,19 @@ lnet_del_peer_ni(lnet_nid_t prim_nid, lnet_nid_t nid)
 	return lnet_peer_del_nid(lp, nid, flags);
 }
 
+static void
+lnet_peer_ni_free_rcu(struct rcu_head *head)
+{
+	struct lnet_peer_ni *lpni = container_of(head, struct lnet_peer_ni,
+						 lpni_rcu);
+
+	if (lpni->lpni_pref_nnids > 1) {
+		LIBCFS_FREE(lpni->lpni_pref.nids,
+			sizeof(*lpni->lpni_pref.nids) * lpni->lpni_pref_nnids);
+	}
+	LIBCFS_FREE(lpni, sizeof(*lpni));
+}
+
 void
 lnet_destroy_peer_ni_locked(struct lnet_peer_ni *lpni)
 {
@@ -1706,7 +1939,7 @@ lnet_destroy_peer_ni_locked(struct lnet_peer_ni *lpni)
 
 	LASSERT(atomic_read(&lpni->lpni_refcount) == 0);
 	LASSERT(list_empty(&lpni->lpni_txq));
-	LASSERT(lpni->lpni_txqnob == 0);
+	LASSERT(atomic_long_read(&lpni->lpni_txqnob) == 0);
 	LASSERT(list_empty(&lpni->lpni_peer_nis));
 	LASSERT(list_empty(&lpni->lpni_on_remote_peer_ni_list));
 
@@ -1717,15 +1950,11 @@ lnet_destroy_peer_ni_locked(struct lnet_peer_ni *lpni)
 	/* remove the peer ni from the zombie list */
 	ptable = the_lnet.ln_peer_tables[lpni->lpni_cpt];
 	spin_lock(&ptable->pt_zombie_lock);
-	list_del_init(&lpni->lpni_hashlist);
+	list_del_init(&lpni->lpni_zombie_list);
 	ptable->pt_zombies--;
 	spin_unlock(&ptable->pt_zombie_lock);
 
-	if (lpni->lpni_pref_nnids > 1) {
-		LIBCFS_FREE(lpni->lpni_pref.nids,
-			sizeof(*lpni->lpni_pref.nids) * lpni->lpni_pref_nnids);
-	}
-	LIBCFS_FREE(lpni, sizeof(*lpni));
+	call_rcu(&lpni->lpni_rcu, lnet_peer_ni_free_rcu);
 
 	lnet_peer_net_decref_locked(lpn);
 }
@@ -3486,7 +3715,8 @@ lnet_debug_peer(lnet_nid_t nid)
 	       libcfs_nid2str(lp->lpni_nid), atomic_read(&lp->lpni_refcount),
 	       aliveness, lp->lpni_net->net_tunables.lct_peer_tx_credits,
 	       lp->lpni_rtrcredits, lp->lpni_minrtrcredits,
-	       lp->lpni_txcredits, lp->lpni_mintxcredits, lp->lpni_txqnob);
+	       atomic_read(&lp->lpni_txcredits), lp->lpni_mintxcredits,
+	       atomic_long_read(&lp->lpni_txqnob));
 
 	lnet_peer_ni_decref_locked(lp);
 
@@ -3542,10 +3772,10 @@ int lnet_get_peer_ni_info(__u32 peer_index, __u64 *nid,
 			*refcount = atomic_read(&lp->lpni_refcount);
 			*ni_peer_tx_credits =
 				lp->lpni_net->net_tunables.lct_peer_tx_credits;
-			*peer_tx_credits = lp->lpni_txcredits;
+			*peer_tx_credits = atomic_read(&lp->lpni_txcredits);
 			*peer_rtr_credits = lp->lpni_rtrcredits;
 			*peer_min_rtr_credits = lp->lpni_mintxcredits;
-			*peer_tx_qnob = lp->lpni_txqnob;
+			*peer_tx_qnob = atomic_long_read(&lp->lpni_txqnob);
 
 			found = true;
 		}
@@ -3559,8 +3789,10 @@ int lnet_get_peer_ni_info(__u32 peer_index, __u64 *nid,
 }
 
 /* ln_api_mutex is held, which keeps the peer list stable */
-int lnet_get_peer_info(struct lnet_ioctl_peer_cfg *cfg, void __user *bulk)
+int lnet_get_peer_info(struct lnet_ioctl_peer_cfg *cfg, void __user *bulk,
+		       __u32 flags)
 {
+	struct lnet_ioctl_peer_ni_tx_alloc tx_alloc;
 	struct lnet_ioctl_element_stats *lpni_stats;
 	struct lnet_ioctl_element_msg_stats *lpni_msg_stats;
 	struct lnet_ioctl_peer_ni_hstats *lpni_hstats;
@@ -3580,6 +3812,8 @@ int lnet_get_peer_info(struct lnet_ioctl_peer_cfg *cfg, void __user *bulk)
 
 	size = sizeof(nid) + sizeof(*lpni_info) + sizeof(*lpni_stats)
 		+ sizeof(*lpni_msg_stats) + sizeof(*lpni_hstats);
+	if (flags & LNET_PEER_INFO_F_TX_ALLOC)
+		size += sizeof(tx_alloc);
 	size *= lp->lp_nnis;
 	if (size > cfg->prcfg_size) {
 		cfg->prcfg_size = size;
@@ -3628,11 +3862,12 @@ int lnet_get_peer_info(struct lnet_ioctl_peer_cfg *cfg, void __user *bulk)
 		lpni_info->cr_refcount = atomic_read(&lpni->lpni_refcount);
 		lpni_info->cr_ni_peer_tx_credits = (lpni->lpni_net != NULL) ?
 			lpni->lpni_net->net_tunables.lct_peer_tx_credits : 0;
-		lpni_info->cr_peer_tx_credits = lpni->lpni_txcredits;
+		lpni_info->cr_peer_tx_credits =
+			atomic_read(&lpni->lpni_txcredits);
 		lpni_info->cr_peer_rtr_credits = lpni->lpni_rtrcredits;
 		lpni_info->cr_peer_min_rtr_credits = lpni->lpni_minrtrcredits;
 		lpni_info->cr_peer_min_tx_credits = lpni->lpni_mintxcredits;
-		lpni_info->cr_peer_tx_qnob = lpni->lpni_txqnob;
+		lpni_info->cr_peer_tx_qnob = atomic_long_read(&lpni->lpni_txqnob);
 		if (copy_to_user(bulk, lpni_info, sizeof(*lpni_info)))
 			goto out_free_hstats;
 		bulk += sizeof(*lpni_info);
@@ -3664,6 +3899,19 @@ int lnet_get_peer_info(struct lnet_ioctl_peer_cfg *cfg, void __user *bulk)
 		if (copy_to_user(bulk, lpni_hstats, sizeof(*lpni_hstats)))
 			goto out_free_hstats;
 		bulk += sizeof(*lpni_hstats);
+
+		if (!(flags & LNET_PEER_INFO_F_TX_ALLOC))
+			continue;
+		memset(&tx_alloc, 0, sizeof(tx_alloc));
+		tx_alloc.pta_tx_credits = lpni->lpni_maxtxcredits;
+		tx_alloc.pta_tx_demand = lpni->lpni_txdemand;
+		if (lpni->lpni_net != NULL)
+			tx_alloc.pta_tx_floor =
+				lnet_peer_credits_floor(lpni->lpni_net);
+		tx_alloc.pta_dynamic = dynamic_peer_credits != 0;
+		if (copy_to_user(bulk, &tx_alloc, sizeof(tx_alloc)))
+			goto out_free_hstats;
+		bulk += sizeof(tx_alloc);
 	}
 	rc = 0;
 
@@ -3676,7 +3924,7 @@ out_free_stats:
 out_free_info:
 	LIBCFS_FREE(lpni_info, sizeof(*lpni_info));
 out_lp_decref:
-	lnet_peer_decref_locked(lp);
+	lnet_peer_decref(lp);
 out:
 	return rc;
 }
@@ -50,6 +50,12 @@ MODULE_PARM_DESC(small_router_buffers, "# of small (1 page) messages to buffer i
 static int large_router_buffers;
 module_param(large_router_buffers, int, 0444);
 MODULE_PARM_DESC(large_router_buffers, "# of large messages to buffer in the router");
+static int auto_router_buffers;
+module_param(auto_router_buffers, int, 0644);
+MODULE_PARM_DESC(auto_router_buffers, "grow and shrink router buffer pools with load, never below *_router_buffers");
+static int router_buffers_max_mb = 2048;
+module_param(router_buffers_max_mb, int, 0644);
+MODULE_PARM_DESC(router_buffers_max_mb, "max MB of router buffers per CPT the pools may grow to when auto sizing");
 static int peer_buffer_credits;
 module_param(peer_buffer_credits, int, 0444);
 MODULE_PARM_DESC(peer_buffer_credits, "# router buffer credits per peer");
@@ -691,7 +697,8 @@ lnet_destroy_routes (void)
 	lnet_del_route(LNET_NIDNET(LNET_NID_ANY), LNET_NID_ANY);
 }
 
-int lnet_get_rtr_pool_cfg(int cpt, struct lnet_ioctl_pool_cfg *pool_cfg)
+int lnet_get_rtr_pool_cfg(int cpt, struct lnet_ioctl_pool_cfg *pool_cfg,
+			  bool stats)
 {
 	struct lnet_rtrbufpool *rbp;
 	int i, rc = -ENOENT, j;
@@ -710,6 +717,11 @@ int lnet_get_rtr_pool_cfg(int cpt, struct lnet_ioctl_pool_cfg *pool_cfg)
 			pool_cfg->pl_pools[j].pl_nbuffers = rbp[j].rbp_nbuffers;
 			pool_cfg->pl_pools[j].pl_credits = rbp[j].rbp_credits;
 			pool_cfg->pl_pools[j].pl_mincredits = rbp[j].rbp_mincredits;
+			if (!stats)
+				continue;
+			pool_cfg->pl_stats[j].pl_maxbuffers =
+				rbp[j].rbp_hw_nbuffers;
+			pool_cfg->pl_stats[j].pl_nblocked = rbp[j].rbp_nblocked;
 		}
 		lnet_net_unlock(i);
 		rc = 0;
@@ -1085,20 +1097,32 @@ lnet_rtrpool_adjust_bufs(struct lnet_rtrbufpool *rbp, int nbufs, int cpt)
 	int		num_buffers = 0;
 	int		old_req_nbufs;
 	int		npages = rbp->rbp_npages;
+	int		rc = 0;
+
+	INIT_LIST_HEAD(&rb_list);
 
 	lnet_net_lock(cpt);
 	/* If we are called for less buffers than already in the pool, we
-	 * just lower the req_nbuffers number and excess buffers will be
-	 * thrown away as they are returned to the free list.  Credits
-	 * then get adjusted as well.
+	 * lower the req_nbuffers number and free the excess buffers which
+	 * are idle now; the others will be thrown away as they are
+	 * returned to the free list.  Credits then get adjusted as well.
 	 * If we already have enough buffers allocated to serve the
 	 * increase requested, then we can treat that the same way as we
 	 * do the decrease. */
 	num_rb = nbufs - rbp->rbp_nbuffers;
 	if (nbufs <= rbp->rbp_req_nbuffers || num_rb <= 0) {
 		rbp->rbp_req_nbuffers = nbufs;
+		while (rbp->rbp_nbuffers > nbufs && rbp->rbp_credits > 0) {
+			rb = list_entry(rbp->rbp_bufs.next,
+					struct lnet_rtrbuf, rb_list);
+			list_move(&rb->rb_list, &rb_list);
+			rbp->rbp_nbuffers--;
+			rbp->rbp_credits--;
+		}
+		if (rbp->rbp_mincredits > rbp->rbp_credits)
+			rbp->rbp_mincredits = rbp->rbp_credits;
 		lnet_net_unlock(cpt);
-		return 0;
+		goto free;
 	}
 	/* store the older value of rbp_req_nbuffers and then set it to
 	 * the new request to prevent lnet_return_rx_credits_locked() from
@@ -1107,8 +1131,6 @@ lnet_rtrpool_adjust_bufs(struct lnet_rtrbufpool *rbp, int nbufs, int cpt)
 	rbp->rbp_req_nbuffers = nbufs;
 	lnet_net_unlock(cpt);
 
-	INIT_LIST_HEAD(&rb_list);
-
 	/* allocate the buffers on a local list first.	If all buffers are
 	 * allocated successfully then join this list to the rbp buffer
 	 * list.  If not then free all allocated buffers. */
@@ -1122,7 +1144,8 @@ lnet_rtrpool_adjust_bufs(struct lnet_rtrbufpool *rbp, int nbufs, int cpt)
 			rbp->rbp_req_nbuffers = old_req_nbufs;
 			lnet_net_unlock(cpt);
 
-			goto failed;
+			rc = -ENOMEM;
+			goto free;
 		}
 
 		list_add(&rb->rb_list, &rb_list);
@@ -1135,6 +1158,8 @@ lnet_rtrpool_adjust_bufs(struct lnet_rtrbufpool *rbp, int nbufs, int cpt)
 	rbp->rbp_nbuffers += num_buffers;
 	rbp->rbp_credits += num_buffers;
 	rbp->rbp_mincredits = rbp->rbp_credits;
+	if (rbp->rbp_hw_nbuffers < rbp->rbp_nbuffers)
+		rbp->rbp_hw_nbuffers = rbp->rbp_nbuffers;
 	/* We need to schedule blocked msg using the newly
 	 * added buffers. */
 	while (!list_empty(&rbp->rbp_bufs) &&
@@ -1145,14 +1170,14 @@ lnet_rtrpool_adjust_bufs(struct lnet_rtrbufpool *rbp, int nbufs, int cpt)
 
 	return 0;
 
-failed:
+free:
 	while (!list_empty(&rb_list)) {
 		rb = list_entry(rb_list.next, struct lnet_rtrbuf, rb_list);
 		list_del(&rb->rb_list);
 		lnet_destroy_rtrbuf(rb, npages);
 	}
 
-	return -ENOMEM;
+	return rc;
 }
 
 static void
@@ -1380,6 +1405,126 @@ lnet_rtrpools_adjust(int tiny, int small, int large)
 	return lnet_rtrpools_adjust_helper(tiny, small, large);
 }
 
+/* # consecutive passes a pool must have spare buffers before it shrinks */
+#define LNET_RTRPOOL_SHRINK_PASSES	30
+
+/* # passes a pool waits after growing before it may grow again, so that the
+ * new buffers are used before more are added */
+#define LNET_RTRPOOL_GROW_PASSES	5
+
+/* MB of buffers allocated per CPT in one pass at most.  The passes run from
+ * the monitor thread, which must not be held up allocating buffers */
+#define LNET_RTRPOOL_GROW_MAX_MB	64
+
+/* One auto-sizing pass over a pool: grow it when messages have queued for
+ * its buffers since the last pass, shrink it towards @floor when a good part
+ * of it stayed idle for LNET_RTRPOOL_SHRINK_PASSES passes.  Growth is
+ * bounded by @budget pages still available to the CPT and by @step pages
+ * for this pass, and a pool which just grew waits LNET_RTRPOOL_GROW_PASSES
+ * passes before growing again. */
+static void
+lnet_rtrpool_autosize(struct lnet_rtrbufpool *rbp, int floor, long *budget,
+		      long *step, int cpt)
+{
+	int cost = max(rbp->rbp_npages, 1);
+	__u64 blocked;
+	int spare;
+	int req;
+	int nbufs;
+
+	lnet_net_lock(cpt);
+	blocked = rbp->rbp_nblocked - rbp->rbp_nblocked_seen;
+	rbp->rbp_nblocked_seen = rbp->rbp_nblocked;
+	spare = rbp->rbp_win_mincredits;
+	rbp->rbp_win_mincredits = rbp->rbp_credits;
+	req = rbp->rbp_req_nbuffers;
+	lnet_net_unlock(cpt);
+
+	if (blocked > 0 || spare < 0) {
+		rbp->rbp_idle_passes = 0;
+		if (rbp->rbp_grow_hold > 0) {
+			rbp->rbp_grow_hold--;
+			return;
+		}
+
+		nbufs = req + max3(req / 4, -spare,
+				   (int)min_t(__u64, blocked, INT_MAX / 2));
+		nbufs = min_t(long, nbufs, req + min(*budget, *step) / cost);
+		if (nbufs <= req)
+			return;
+
+		CDEBUG(D_NET, "cpt %d: growing %d page router pool %d -> %d\n",
+		       cpt, rbp->rbp_npages, req, nbufs);
+		if (lnet_rtrpool_adjust_bufs(rbp, nbufs, cpt) == 0) {
+			*budget -= (long)(nbufs - req) * cost;
+			*step -= (long)(nbufs - req) * cost;
+		}
+		rbp->rbp_grow_hold = LNET_RTRPOOL_GROW_PASSES;
+		return;
+	}
+
+	if (rbp->rbp_grow_hold > 0)
+		rbp->rbp_grow_hold--;
+
+	if (req <= floor || spare <= req / 4) {
+		rbp->rbp_idle_passes = 0;
+		return;
+	}
+
+	if (++rbp->rbp_idle_passes < LNET_RTRPOOL_SHRINK_PASSES)
+		return;
+
+	rbp->rbp_idle_passes = 0;
+	nbufs = max(floor, req - spare / 2);
+	CDEBUG(D_NET, "cpt %d: shrinking %d page router pool %d -> %d\n",
+	       cpt, rbp->rbp_npages, req, nbufs);
+	lnet_rtrpool_adjust_bufs(rbp, nbufs, cpt);
+}
+
+/* Called periodically by the monitor thread */
+void
+lnet_rtrpools_autosize(void)
+{
+	struct lnet_rtrbufpool *rtrp;
+	int floor[LNET_NRBPOOLS];
+	long budget;
+	long step;
+	int i;
+	int j;
+
+	if (!auto_router_buffers || !the_lnet.ln_routing)
+		return;
+
+	/* pools are configured and freed under ln_api_mutex; just skip
+	 * this pass if someone is busy with them (or shutting down) */
+	if (!mutex_trylock(&the_lnet.ln_api_mutex))
+		return;
+
+	if (the_lnet.ln_rtrpools == NULL || !the_lnet.ln_routing)
+		goto out;
+
+	floor[LNET_TINY_BUF_IDX] = lnet_nrb_tiny_calculate();
+	floor[LNET_SMALL_BUF_IDX] = lnet_nrb_small_calculate();
+	floor[LNET_LARGE_BUF_IDX] = lnet_nrb_large_calculate();
+
+	cfs_percpt_for_each(rtrp, i, the_lnet.ln_rtrpools) {
+		budget = (long)router_buffers_max_mb << (20 - PAGE_SHIFT);
+		step = (long)LNET_RTRPOOL_GROW_MAX_MB << (20 - PAGE_SHIFT);
+		for (j = 0; j < LNET_NRBPOOLS; j++)
+			budget -= (long)rtrp[j].rbp_nbuffers *
+				  max(rtrp[j].rbp_npages, 1);
+
+		for (j = 0; j < LNET_NRBPOOLS; j++) {
+			if (floor[j] < 0)
+				continue;
+			lnet_rtrpool_autosize(&rtrp[j], floor[j], &budget,
+					      &step, i);
+		}
+	}
+out:
+	mutex_unlock(&the_lnet.ln_api_mutex);
+}
+
 int
 lnet_rtrpools_enable(void)
 {
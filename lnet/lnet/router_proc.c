@@ -393,7 +393,7 @@ proc_lnet_peers(struct ctl_table *table, int write, void __user *buffer,
 						    &ptable->pt_hash[hash],
 						    lpni_hashlist) {
 					peer->lpni_mintxcredits =
-						peer->lpni_txcredits;
+						atomic_read(&peer->lpni_txcredits);
 					peer->lpni_minrtrcredits =
 						peer->lpni_rtrcredits;
 				}
@@ -493,11 +493,11 @@ proc_lnet_peers(struct ctl_table *table, int write, void __user *buffer,
 			char *aliveness = "NA";
 			int maxcr = (peer->lpni_net) ?
 			  peer->lpni_net->net_tunables.lct_peer_tx_credits : 0;
-			int txcr = peer->lpni_txcredits;
+			int txcr = atomic_read(&peer->lpni_txcredits);
 			int mintxcr = peer->lpni_mintxcredits;
 			int rtrcr = peer->lpni_rtrcredits;
 			int minrtrcr = peer->lpni_minrtrcredits;
-			int txqnob = peer->lpni_txqnob;
+			int txqnob = atomic_long_read(&peer->lpni_txqnob);
 
 			if (lnet_isrouter(peer) ||
 			    lnet_peer_aliveness_enabled(peer))
@@ -558,8 +558,8 @@ static int __proc_lnet_buffers(void *data, int write,
 
 	LASSERT(!write);
 
-	/* (4 %d) * 4 * LNET_CPT_NUMBER */
-	tmpsiz = 64 * (LNET_NRBPOOLS + 1) * LNET_CPT_NUMBER;
+	/* (5 %d + %llu) * 4 * LNET_CPT_NUMBER */
+	tmpsiz = 96 * (LNET_NRBPOOLS + 1) * LNET_CPT_NUMBER;
 	LIBCFS_ALLOC(tmpstr, tmpsiz);
 	if (tmpstr == NULL)
 		return -ENOMEM;
@@ -567,8 +567,8 @@ static int __proc_lnet_buffers(void *data, int write,
 	s = tmpstr; /* points to current position in tmpstr[] */
 
 	s += snprintf(s, tmpstr + tmpsiz - s,
-		      "%5s %5s %7s %7s\n",
-		      "pages", "count", "credits", "min");
+		      "%5s %5s %7s %7s %5s %10s\n",
+		      "pages", "count", "credits", "min", "max", "blocked");
 	LASSERT(tmpstr + tmpsiz - s > 0);
 
 	if (the_lnet.ln_rtrpools == NULL)
@@ -580,11 +580,13 @@ static int __proc_lnet_buffers(void *data, int write,
 		lnet_net_lock(LNET_LOCK_EX);
 		cfs_percpt_for_each(rbp, i, the_lnet.ln_rtrpools) {
 			s += snprintf(s, tmpstr + tmpsiz - s,
-				      "%5d %5d %7d %7d\n",
+				      "%5d %5d %7d %7d %5d %10llu\n",
 				      rbp[idx].rbp_npages,
 				      rbp[idx].rbp_nbuffers,
 				      rbp[idx].rbp_credits,
-				      rbp[idx].rbp_mincredits);
+				      rbp[idx].rbp_mincredits,
+				      rbp[idx].rbp_hw_nbuffers,
+				      rbp[idx].rbp_nblocked);
 			LASSERT(tmpstr + tmpsiz - s > 0);
 		}
 		lnet_net_unlock(LNET_LOCK_EX);
@@ -861,6 +863,85 @@ proc_lnet_portal_rotor(struct ctl_table *table, int write, void __user *buffer,
 }
 
 
+/* limits the memory of the fake MEs */
+#define LNET_MATCH_BENCH_MAX	(1 << 17)
+
+static DEFINE_MUTEX(lnet_match_bench_mutex);
+static char lnet_match_bench_buf[256];
+
+static int __proc_lnet_match_bench(void *data, int write,
+				   loff_t pos, void __user *buffer, int nob)
+{
+	const int	buf_len = sizeof(lnet_match_bench_buf);
+	char		tmp[16];
+	unsigned int	nmes;
+	unsigned int	bits;
+	int		len = 0;
+	int		rc;
+	int		i;
+
+	if (!write) {
+		mutex_lock(&lnet_match_bench_mutex);
+		len = strlen(lnet_match_bench_buf);
+		if (pos >= len)
+			rc = 0;
+		else
+			rc = cfs_trace_copyout_string(buffer, nob,
+					lnet_match_bench_buf + pos, NULL);
+		mutex_unlock(&lnet_match_bench_mutex);
+		return rc;
+	}
+
+	rc = cfs_trace_copyin_string(tmp, sizeof(tmp), buffer, nob);
+	if (rc < 0)
+		return rc;
+
+	rc = kstrtouint(strim(tmp), 0, &nmes);
+	if (rc < 0)
+		return rc;
+
+	if (nmes == 0 || nmes > LNET_MATCH_BENCH_MAX)
+		return -ERANGE;
+
+	/* the size a match table reaches with nmes MEs */
+	bits = LNET_MT_HASH_BITS;
+	while (bits < LNET_MT_HASH_BITS_MAX &&
+	       nmes > LNET_MT_HASH_LOAD << bits)
+		bits = min(bits + LNET_MT_HASH_BITS_STEP,
+			   (unsigned int)LNET_MT_HASH_BITS_MAX);
+
+	mutex_lock(&lnet_match_bench_mutex);
+	len = scnprintf(lnet_match_bench_buf, buf_len,
+			"mes: %u\n%-10s %-10s %s\n", nmes,
+			"portal", "hash_bits", "nsec_per_match");
+	for (i = 0; i < 4; i++) {
+		bool wildcard = i < 2;
+		unsigned int b = i % 2 ? bits : LNET_MT_HASH_BITS;
+		__u64 nsec;
+
+		rc = lnet_mt_match_bench(nmes, wildcard, b, &nsec);
+		if (rc < 0)
+			break;
+
+		len += scnprintf(lnet_match_bench_buf + len, buf_len - len,
+				 "%-10s %-10u %llu\n",
+				 wildcard ? "wildcard" : "unique", b, nsec);
+	}
+	if (rc < 0)
+		lnet_match_bench_buf[0] = '\0';
+	mutex_unlock(&lnet_match_bench_mutex);
+
+	return rc;
+}
+
+static int
+proc_lnet_match_bench(struct ctl_table *table, int write,
+		      void __user *buffer, size_t *lenp, loff_t *ppos)
+{
+	return lprocfs_call_handler(table->data, write, ppos, buffer, lenp,
+				    __proc_lnet_match_bench);
+}
+
 static struct ctl_table lnet_table[] = {
 	/*
 	 * NB No .strategy entries have been provided since sysctl(8) prefers
@@ -908,6 +989,12 @@ static struct ctl_table lnet_table[] = {
 		.mode		= 0644,
 		.proc_handler	= &proc_lnet_portal_rotor,
 	},
+	{
+		INIT_CTL_NAME
+		.procname	= "match_bench",
+		.mode		= 0644,
+		.proc_handler	= &proc_lnet_match_bench,
+	},
 	{ .procname = NULL }
 };
 
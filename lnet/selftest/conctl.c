@@ -663,10 +663,18 @@ lst_batch_info_ioctl(struct lstio_batch_info_args *args)
 }
 
 static int
-lst_stat_query_ioctl(struct lstio_stat_args *args)
+lst_stat_query_ioctl(struct lstio_stat_args *args, int len)
 {
         int             rc;
 	char           *name = NULL;
+	int		type = LST_STAT_COUNTERS;
+
+	/* older lst doesn't pass lstio_sta_type */
+	if (len >= offsetof(struct lstio_stat_args, lstio_sta_type) +
+		   sizeof(args->lstio_sta_type))
+		type = args->lstio_sta_type;
+	if (type != LST_STAT_COUNTERS && type != LST_STAT_LATENCY)
+		return -EINVAL;
 
         /* TODO: not finished */
         if (args->lstio_sta_key != console_session.ses_key)
@@ -680,7 +688,7 @@ lst_stat_query_ioctl(struct lstio_stat_args *args)
 			return -EINVAL;
 
 		rc = lstcon_nodes_stat(args->lstio_sta_count,
-                                       args->lstio_sta_idsp,
+				       args->lstio_sta_idsp, type,
                                        args->lstio_sta_timeout,
                                        args->lstio_sta_resultp);
 	} else if (args->lstio_sta_namep != NULL) {
@@ -695,7 +703,8 @@ lst_stat_query_ioctl(struct lstio_stat_args *args)
 		rc = copy_from_user(name, args->lstio_sta_namep,
 				    args->lstio_sta_nmlen);
 		if (rc == 0)
-			rc = lstcon_group_stat(name, args->lstio_sta_timeout,
+			rc = lstcon_group_stat(name, type,
+					       args->lstio_sta_timeout,
 					       args->lstio_sta_resultp);
 		else
 			rc = -EFAULT;
@@ -709,7 +718,7 @@ lst_stat_query_ioctl(struct lstio_stat_args *args)
 	return rc;
 }
 
-static int lst_test_add_ioctl(struct lstio_test_args *args)
+static int lst_test_add_ioctl(struct lstio_test_args *args, int len)
 {
 	char		*batch_name;
 	char		*src_name = NULL;
@@ -717,6 +726,14 @@ static int lst_test_add_ioctl(struct lstio_test_args *args)
 	void		*param = NULL;
 	int		ret = 0;
 	int		rc = -ENOMEM;
+	int		rate = 0;
+
+	/* older lst doesn't pass lstio_tes_rate */
+	if (len >= offsetof(struct lstio_test_args, lstio_tes_rate) +
+		   sizeof(args->lstio_tes_rate))
+		rate = args->lstio_tes_rate;
+	if (rate < 0)
+		return -EINVAL;
 
 	if (args->lstio_tes_resultp == NULL ||
 	    args->lstio_tes_retp == NULL ||
@@ -779,7 +796,7 @@ static int lst_test_add_ioctl(struct lstio_test_args *args)
 	rc = lstcon_test_add(batch_name,
 			    args->lstio_tes_type,
 			    args->lstio_tes_loop,
-			    args->lstio_tes_concur,
+			    args->lstio_tes_concur, rate,
 			    args->lstio_tes_dist, args->lstio_tes_span,
 			    src_name, dst_name, param,
 			    args->lstio_tes_param_len,
@@ -907,10 +924,12 @@ lstcon_ioctl_entry(struct notifier_block *nb,
 		rc = lst_batch_info_ioctl((struct lstio_batch_info_args *)buf);
 		break;
 	case LSTIO_TEST_ADD:
-		rc = lst_test_add_ioctl((struct lstio_test_args *)buf);
+		rc = lst_test_add_ioctl((struct lstio_test_args *)buf,
+					data->ioc_plen1);
 		break;
 	case LSTIO_STAT_QUERY:
-		rc = lst_stat_query_ioctl((struct lstio_stat_args *)buf);
+		rc = lst_stat_query_ioctl((struct lstio_stat_args *)buf,
+					  data->ioc_plen1);
 		break;
 	default:
 		rc = -EINVAL;
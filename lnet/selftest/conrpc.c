@@ -224,6 +224,9 @@ lstcon_rpc_trans_name(int transop)
         if (transop == LST_TRANS_STATQRY)
                 return "STATQRY";
 
+	if (transop == LST_TRANS_LATQRY)
+		return "LATQRY";
+
         return "Unknown";
 }
 
@@ -699,6 +702,23 @@ lstcon_statrpc_prep(struct lstcon_node *nd, unsigned int feats,
         return 0;
 }
 
+int
+lstcon_latrpc_prep(struct lstcon_node *nd, unsigned int feats,
+		   struct lstcon_rpc **crpc)
+{
+	struct srpc_lat_reqst *lrq;
+	int rc;
+
+	rc = lstcon_rpc_prep(nd, SRPC_SERVICE_QUERY_LAT, feats, 0, 0, crpc);
+	if (rc != 0)
+		return rc;
+
+	lrq = &(*crpc)->crp_rpc->crpc_reqstmsg.msg_body.lat_reqst;
+	lrq->lat_sid = console_session.ses_id;
+
+	return 0;
+}
+
 static struct lnet_process_id_packed *
 lstcon_next_id(int idx, int nkiov, lnet_kiov_t *kiov)
 {
@@ -888,6 +908,8 @@ lstcon_testrpc_prep(struct lstcon_node *nd, int transop, unsigned int feats,
         trq->tsr_concur     = test->tes_concur;
         trq->tsr_is_client  = (transop == LST_TRANS_TSBCLIADD) ? 1 : 0;
         trq->tsr_stop_onerr = !!test->tes_stop_onerr;
+	if ((feats & LST_FEAT_LATENCY) != 0)
+		trq->tsr_rate = test->tes_rate;
 
         switch (test->tes_type) {
         case LST_TEST_PING:
@@ -1073,6 +1095,16 @@ lstcon_rpc_stat_reply(struct lstcon_rpc_trans *trans, struct srpc_msg *msg,
                 rc = stat_rep->str_status;
                 break;
 
+	case LST_TRANS_LATQRY:
+		if (msg->msg_body.lat_reply.lat_status == 0) {
+			lstcon_statqry_stat_success(stat, 1);
+			return;
+		}
+
+		lstcon_statqry_stat_failure(stat, 1);
+		rc = msg->msg_body.lat_reply.lat_status;
+		break;
+
         default:
                 LBUG();
         }
@@ -1146,6 +1178,9 @@ lstcon_rpc_trans_ndlist(struct list_head *ndlist,
 		case LST_TRANS_STATQRY:
 			rc = lstcon_statrpc_prep(nd, feats, &rpc);
                         break;
+		case LST_TRANS_LATQRY:
+			rc = lstcon_latrpc_prep(nd, feats, &rpc);
+			break;
                 default:
                         rc = -EINVAL;
                         break;
@@ -1280,7 +1280,7 @@ lstcon_verify_group(const char *name, struct lstcon_group **grp)
 
 int
 lstcon_test_add(char *batch_name, int type, int loop,
-		int concur, int dist, int span,
+		int concur, int rate, int dist, int span,
 		char *src_name, char *dst_name,
 		void *param, int paramlen, int *retp,
 		struct list_head __user *result_up)
@@ -1325,6 +1325,7 @@ lstcon_test_add(char *batch_name, int type, int loop,
 	test->tes_oneside	= 0; /* TODO */
 	test->tes_loop		= loop;
 	test->tes_concur	= concur;
+	test->tes_rate		= rate;
 	test->tes_stop_onerr	= 1; /* TODO */
 	test->tes_span		= span;
 	test->tes_dist		= dist;
@@ -1492,7 +1493,23 @@ lstcon_statrpc_readent(int transop, struct srpc_msg *msg,
 }
 
 static int
-lstcon_ndlist_stat(struct list_head *ndlist,
+lstcon_latrpc_readent(int transop, struct srpc_msg *msg,
+		      struct lstcon_rpc_ent __user *ent_up)
+{
+	struct srpc_lat_reply *rep = &msg->msg_body.lat_reply;
+
+	if (rep->lat_status != 0)
+		return 0;
+
+	if (copy_to_user(&ent_up->rpe_payload[0], &rep->lat_cnt,
+			 sizeof(rep->lat_cnt)))
+		return -EFAULT;
+
+	return 0;
+}
+
+static int
+lstcon_ndlist_stat(struct list_head *ndlist, int type,
 		   int timeout, struct list_head __user *result_up)
 {
 	struct list_head    head;
@@ -1501,8 +1518,14 @@ lstcon_ndlist_stat(struct list_head *ndlist,
 
 	INIT_LIST_HEAD(&head);
 
-        rc = lstcon_rpc_trans_ndlist(ndlist, &head,
-                                     LST_TRANS_STATQRY, NULL, NULL, &trans);
+	if (type == LST_STAT_LATENCY &&
+	    (console_session.ses_features & LST_FEAT_LATENCY) == 0)
+		return -EOPNOTSUPP;
+
+	rc = lstcon_rpc_trans_ndlist(ndlist, &head,
+				     type == LST_STAT_LATENCY ?
+				     LST_TRANS_LATQRY : LST_TRANS_STATQRY,
+				     NULL, NULL, &trans);
         if (rc != 0) {
                 CERROR("Can't create transaction: %d\n", rc);
                 return rc;
@@ -1510,15 +1533,17 @@ lstcon_ndlist_stat(struct list_head *ndlist,
 
         lstcon_rpc_trans_postwait(trans, LST_VALIDATE_TIMEOUT(timeout));
 
-        rc = lstcon_rpc_trans_interpreter(trans, result_up,
-                                          lstcon_statrpc_readent);
+	rc = lstcon_rpc_trans_interpreter(trans, result_up,
+					  type == LST_STAT_LATENCY ?
+					  lstcon_latrpc_readent :
+					  lstcon_statrpc_readent);
         lstcon_rpc_trans_destroy(trans);
 
         return rc;
 }
 
 int
-lstcon_group_stat(char *grp_name, int timeout,
+lstcon_group_stat(char *grp_name, int type, int timeout,
 		  struct list_head __user *result_up)
 {
 	struct lstcon_group *grp;
@@ -1530,7 +1555,7 @@ lstcon_group_stat(char *grp_name, int timeout,
                 return rc;
         }
 
-        rc = lstcon_ndlist_stat(&grp->grp_ndl_list, timeout, result_up);
+	rc = lstcon_ndlist_stat(&grp->grp_ndl_list, type, timeout, result_up);
 
 	lstcon_group_decref(grp);
 
@@ -1539,7 +1564,7 @@ lstcon_group_stat(char *grp_name, int timeout,
 
 int
 lstcon_nodes_stat(int count, struct lnet_process_id __user *ids_up,
-		  int timeout, struct list_head __user *result_up)
+		  int type, int timeout, struct list_head __user *result_up)
 {
 	struct lstcon_ndlink *ndl;
 	struct lstcon_group *tmp;
@@ -1574,7 +1599,7 @@ lstcon_nodes_stat(int count, struct lnet_process_id __user *ids_up,
                 return rc;
         }
 
-        rc = lstcon_ndlist_stat(&tmp->grp_ndl_list, timeout, result_up);
+	rc = lstcon_ndlist_stat(&tmp->grp_ndl_list, type, timeout, result_up);
 
 	lstcon_group_decref(tmp);
 
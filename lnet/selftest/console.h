@@ -131,6 +131,7 @@ struct lstcon_test {
         int                   tes_dist;       /* nodes distribution of target group */
         int                   tes_span;       /* nodes span of target group */
         int                   tes_cliidx;     /* client index, used for RPC creating */
+	int		      tes_rate;	      /* open-loop RPCs/s, 0: closed */
 
 	struct list_head	tes_trans_list;	/* transaction list */
 	struct lstcon_group	*tes_src_grp;	/* group run the test */
@@ -246,12 +247,13 @@ extern int lstcon_batch_info(char *name,
 			     int server, int testidx, int *index_p,
 			     int *ndent_p,
 			     struct lstcon_node_ent __user *dents_up);
-extern int lstcon_group_stat(char *grp_name, int timeout,
+extern int lstcon_group_stat(char *grp_name, int type, int timeout,
 			     struct list_head __user *result_up);
 extern int lstcon_nodes_stat(int count, struct lnet_process_id __user *ids_up,
-			     int timeout, struct list_head __user *result_up);
+			     int type, int timeout,
+			     struct list_head __user *result_up);
 extern int lstcon_test_add(char *batch_name, int type, int loop,
-			   int concur, int dist, int span,
+			   int concur, int rate, int dist, int span,
 			   char *src_name, char *dst_name,
 			   void *param, int paramlen, int *retp,
 			   struct list_head __user *result_up);
@@ -410,6 +410,176 @@ sfw_get_stats(struct srpc_stat_reqst *request, struct srpc_stat_reply *reply)
 	return 0;
 }
 
+static inline int
+sfw_lat_bucket(__u64 ns)
+{
+	int msb;
+
+	if (ns < SFW_LAT_SUB)
+		return ns;
+
+	msb = fls64(ns) - 1;
+	return min_t(int, SFW_LAT_NBUCKETS - 1,
+		     ((msb - SFW_LAT_SUB_BITS + 1) << SFW_LAT_SUB_BITS) +
+		     ((ns >> (msb - SFW_LAT_SUB_BITS)) & (SFW_LAT_SUB - 1)));
+}
+
+/* middle of latency bucket @idx, in ns */
+static __u64
+sfw_lat_bucket_ns(int idx)
+{
+	int shift;
+
+	if (idx < SFW_LAT_SUB)
+		return idx;
+
+	shift = (idx >> SFW_LAT_SUB_BITS) - 1;
+	return ((__u64)(SFW_LAT_SUB + (idx & (SFW_LAT_SUB - 1))) << shift) +
+	       ((1ULL << shift) >> 1);
+}
+
+static void
+sfw_lat_record(struct sfw_session *sn, ktime_t start)
+{
+	struct sfw_lat_hist *lh;
+	__u64 ns;
+
+	if (sn->sn_lat == NULL)
+		return;
+
+	ns = max_t(s64, ktime_to_ns(ktime_sub(ktime_get(), start)), 0);
+	lh = sn->sn_lat[lnet_cpt_current()];
+
+	spin_lock(&lh->lh_lock);
+	lh->lh_buckets[sfw_lat_bucket(ns)]++;
+	if (lh->lh_count == 0 || ns < lh->lh_min_ns)
+		lh->lh_min_ns = ns;
+	if (ns > lh->lh_max_ns)
+		lh->lh_max_ns = ns;
+	lh->lh_count++;
+	lh->lh_sum_ns += ns;
+	spin_unlock(&lh->lh_lock);
+}
+
+static void
+sfw_lat_late(struct sfw_session *sn, int late)
+{
+	struct sfw_lat_hist *lh;
+
+	if (sn->sn_lat == NULL)
+		return;
+
+	lh = sn->sn_lat[lnet_cpt_current()];
+	spin_lock(&lh->lh_lock);
+	lh->lh_late += late;
+	spin_unlock(&lh->lh_lock);
+}
+
+static __u64
+sfw_lat_percentile(__u32 *buckets, __u64 count, int permille)
+{
+	__u64 rank = div_u64(count * permille + 999, 1000);
+	__u64 seen = 0;
+	int i;
+
+	for (i = 0; i < SFW_LAT_NBUCKETS; i++) {
+		seen += buckets[i];
+		if (seen >= rank)
+			break;
+	}
+
+	return sfw_lat_bucket_ns(min(i, SFW_LAT_NBUCKETS - 1));
+}
+
+static int
+sfw_lat_hist_alloc(struct sfw_session *sn)
+{
+	struct sfw_lat_hist *lh;
+	int i;
+
+	sn->sn_lat = cfs_percpt_alloc(lnet_cpt_table(), sizeof(*lh));
+	if (sn->sn_lat == NULL)
+		return -ENOMEM;
+
+	cfs_percpt_for_each(lh, i, sn->sn_lat)
+		spin_lock_init(&lh->lh_lock);
+
+	return 0;
+}
+
+/* latency of test RPCs sent by this node since the last query */
+static int
+sfw_get_lat(struct srpc_lat_reqst *request, struct srpc_lat_reply *reply)
+{
+	struct sfw_session *sn = sfw_data.fw_session;
+	struct sfw_lat_counters *cnt = &reply->lat_cnt;
+	struct sfw_lat_hist *lh;
+	__u32 *buckets;
+	__u64 sum = 0;
+	int i;
+	int j;
+
+	reply->lat_sid = (sn == NULL) ? LST_INVALID_SID : sn->sn_id;
+
+	if (request->lat_sid.ses_nid == LNET_NID_ANY) {
+		reply->lat_status = EINVAL;
+		return 0;
+	}
+
+	if (sn == NULL || !sfw_sid_equal(request->lat_sid, sn->sn_id)) {
+		reply->lat_status = ESRCH;
+		return 0;
+	}
+
+	if (sn->sn_lat == NULL) {
+		reply->lat_status = EPROTO;
+		return 0;
+	}
+
+	LIBCFS_ALLOC(buckets, sizeof(*buckets) * SFW_LAT_NBUCKETS);
+	if (buckets == NULL)
+		return -ENOMEM;
+
+	memset(cnt, 0, sizeof(*cnt));
+	cfs_percpt_for_each(lh, i, sn->sn_lat) {
+		spin_lock(&lh->lh_lock);
+		for (j = 0; j < SFW_LAT_NBUCKETS; j++)
+			buckets[j] += lh->lh_buckets[j];
+
+		if (lh->lh_count != 0 &&
+		    (cnt->lat_count == 0 || lh->lh_min_ns < cnt->lat_min_ns))
+			cnt->lat_min_ns = lh->lh_min_ns;
+		cnt->lat_max_ns = max(cnt->lat_max_ns, lh->lh_max_ns);
+		cnt->lat_count += lh->lh_count;
+		cnt->lat_late += lh->lh_late;
+		sum += lh->lh_sum_ns;
+
+		/* every query starts a new interval */
+		memset(lh->lh_buckets, 0, sizeof(lh->lh_buckets));
+		lh->lh_count = 0;
+		lh->lh_sum_ns = 0;
+		lh->lh_min_ns = 0;
+		lh->lh_max_ns = 0;
+		lh->lh_late = 0;
+		spin_unlock(&lh->lh_lock);
+	}
+
+	if (cnt->lat_count != 0) {
+		cnt->lat_avg_ns = div64_u64(sum, cnt->lat_count);
+		cnt->lat_p50_ns = sfw_lat_percentile(buckets, cnt->lat_count,
+						     500);
+		cnt->lat_p99_ns = sfw_lat_percentile(buckets, cnt->lat_count,
+						     990);
+		cnt->lat_p999_ns = sfw_lat_percentile(buckets, cnt->lat_count,
+						      999);
+	}
+
+	LIBCFS_FREE(buckets, sizeof(*buckets) * SFW_LAT_NBUCKETS);
+
+	reply->lat_status = 0;
+	return 0;
+}
+
 int
 sfw_make_session(struct srpc_mksn_reqst *request, struct srpc_mksn_reply *reply)
 {
@@ -465,6 +635,13 @@ sfw_make_session(struct srpc_mksn_reqst *request, struct srpc_mksn_reply *reply)
 	sfw_init_session(sn, request->mksn_sid,
 			 msg->msg_ses_feats, &request->mksn_name[0]);
 
+	if ((msg->msg_ses_feats & LST_FEAT_LATENCY) != 0 &&
+	    sfw_lat_hist_alloc(sn) != 0) {
+		CERROR("dropping RPC mksn: no memory for latency stats\n");
+		LIBCFS_FREE(sn, sizeof(*sn));
+		return -ENOMEM;
+	}
+
 	spin_lock(&sfw_data.fw_lock);
 
 	sfw_deactivate_session();
@@ -687,6 +864,8 @@ sfw_destroy_session(struct sfw_session *sn)
 		sfw_destroy_batch(batch);
 	}
 
+	if (sn->sn_lat != NULL)
+		cfs_percpt_free(sn->sn_lat);
 	LIBCFS_FREE(sn, sizeof(*sn));
 	atomic_dec(&sfw_data.fw_nzombies);
 	return;
@@ -761,6 +940,8 @@ sfw_add_test_instance(struct sfw_batch *tsb, struct srpc_server_rpc *rpc)
 	INIT_LIST_HEAD(&tsi->tsi_units);
 	INIT_LIST_HEAD(&tsi->tsi_free_rpcs);
 	INIT_LIST_HEAD(&tsi->tsi_active_rpcs);
+	INIT_LIST_HEAD(&tsi->tsi_idle_units);
+	init_waitqueue_head(&tsi->tsi_pacer_waitq);
 
         tsi->tsi_stopping      = 0;
         tsi->tsi_batch         = tsb;
@@ -769,6 +950,8 @@ sfw_add_test_instance(struct sfw_batch *tsb, struct srpc_server_rpc *rpc)
         tsi->tsi_service       = req->tsr_service;
         tsi->tsi_is_client     = !!(req->tsr_is_client);
         tsi->tsi_stoptsu_onerr = !!(req->tsr_stop_onerr);
+	if ((msg->msg_ses_feats & LST_FEAT_LATENCY) != 0)
+		tsi->tsi_rate = req->tsr_rate;
 
         rc = sfw_load_test(tsi);
         if (rc != 0) {
@@ -816,6 +999,7 @@ sfw_add_test_instance(struct sfw_batch *tsb, struct srpc_server_rpc *rpc)
 			tsu->tsu_dest.pid = id.pid;
 			tsu->tsu_instance = tsi;
 			tsu->tsu_private  = NULL;
+			INIT_LIST_HEAD(&tsu->tsu_idle);
 			list_add_tail(&tsu->tsu_list, &tsi->tsi_units);
 		}
 	}
@@ -832,17 +1016,21 @@ error:
 	return rc;
 }
 
+/* drop an active unit (or the pacer) of @tsi */
 static void
-sfw_test_unit_done(struct sfw_test_unit *tsu)
+sfw_test_instance_done(struct sfw_test_instance *tsi)
 {
-	struct sfw_test_instance *tsi = tsu->tsu_instance;
 	struct sfw_batch *tsb = tsi->tsi_batch;
 	struct sfw_session *sn = tsb->bat_session;
 
         LASSERT (sfw_test_active(tsi));
 
-	if (!atomic_dec_and_test(&tsi->tsi_nactive))
+	if (!atomic_dec_and_test(&tsi->tsi_nactive)) {
+		/* the pacer exits once it is the last one active */
+		if (tsi->tsi_rate != 0)
+			wake_up(&tsi->tsi_pacer_waitq);
                 return;
+	}
 
         /* the test instance is done */
 	spin_lock(&tsi->tsi_lock);
@@ -875,6 +1063,12 @@ sfw_test_unit_done(struct sfw_test_unit *tsu)
 	return;
 }
 
+static void
+sfw_test_unit_done(struct sfw_test_unit *tsu)
+{
+	sfw_test_instance_done(tsu->tsu_instance);
+}
+
 static void
 sfw_test_rpc_done(struct srpc_client_rpc *rpc)
 {
@@ -884,6 +1078,9 @@ sfw_test_rpc_done(struct srpc_client_rpc *rpc)
 
         tsi->tsi_ops->tso_done_rpc(tsu, rpc);
 
+	if (rpc->crpc_status == 0)
+		sfw_lat_record(tsi->tsi_batch->bat_session, tsu->tsu_start);
+
 	spin_lock(&tsi->tsi_lock);
 
 	LASSERT(sfw_test_active(tsi));
@@ -900,6 +1097,14 @@ sfw_test_rpc_done(struct srpc_client_rpc *rpc)
         /* dec ref for poster */
         srpc_client_rpc_decref(rpc);
 
+	if (!done && tsi->tsi_rate != 0) {
+		/* open loop: the pacer releases the next RPC on schedule */
+		list_add_tail(&tsu->tsu_idle, &tsi->tsi_idle_units);
+		wake_up(&tsi->tsi_pacer_waitq);
+		spin_unlock(&tsi->tsi_lock);
+		return;
+	}
+
 	spin_unlock(&tsi->tsi_lock);
 
         if (!done) {
@@ -981,6 +1186,10 @@ sfw_run_test(struct swi_workitem *wi)
 	if (tsu->tsu_loop > 0)
 		tsu->tsu_loop--;
 
+	/* in open loop the pacer has set the scheduled send time */
+	if (tsi->tsi_rate == 0)
+		tsu->tsu_start = ktime_get();
+
 	list_add_tail(&rpc->crpc_list, &tsi->tsi_active_rpcs);
 	spin_unlock(&tsi->tsi_lock);
 
@@ -1003,6 +1212,108 @@ test_done:
 	return 1;
 }
 
+/*
+ * Open-loop driver of a test instance: release idle units at
+ * tsi_rate RPCs/s regardless of how fast earlier RPCs complete, so
+ * latency is measured under a fixed offered load. A unit's latency
+ * counts from its scheduled slot, which includes time it had to
+ * queue because all tsi_concur units were busy.
+ *
+ * The pacer holds an active reference on @tsi, and drops it once it
+ * is the only one left or the test is stopping.
+ */
+static int
+sfw_test_pacer(void *arg)
+{
+	struct sfw_test_instance *tsi = arg;
+	struct sfw_session *sn = tsi->tsi_batch->bat_session;
+	__u64 interval = NSEC_PER_SEC / tsi->tsi_rate;
+	ktime_t next = ktime_get();
+	struct sfw_test_unit *tsu;
+	LIST_HEAD(ready);
+	bool stop = false;
+	int late;
+
+	while (!stop) {
+		ktime_t now = ktime_get();
+
+		late = 0;
+		spin_lock(&tsi->tsi_lock);
+		if (tsi->tsi_stopping ||
+		    atomic_read(&tsi->tsi_nactive) == 1) {
+			/* let the idle units run and notice they're done */
+			list_splice_init(&tsi->tsi_idle_units, &ready);
+			stop = true;
+		}
+
+		while (!stop && !list_empty(&tsi->tsi_idle_units) &&
+		       ktime_compare(next, now) <= 0) {
+			tsu = list_entry(tsi->tsi_idle_units.next,
+					 struct sfw_test_unit, tsu_idle);
+			list_move_tail(&tsu->tsu_idle, &ready);
+			tsu->tsu_start = next;
+			if (ktime_to_ns(ktime_sub(now, next)) > interval)
+				late++;
+			next = ktime_add_ns(next, interval);
+		}
+		spin_unlock(&tsi->tsi_lock);
+
+		while (!list_empty(&ready)) {
+			tsu = list_entry(ready.next, struct sfw_test_unit,
+					 tsu_idle);
+			list_del_init(&tsu->tsu_idle);
+			swi_schedule_workitem(&tsu->tsu_worker);
+		}
+
+		if (late != 0)
+			sfw_lat_late(sn, late);
+
+		if (stop)
+			break;
+
+		if (ktime_compare(next, now) > 0 &&
+		    !list_empty(&tsi->tsi_idle_units)) {
+			/* a unit is ready, wait for its slot */
+			set_current_state(TASK_INTERRUPTIBLE);
+			schedule_hrtimeout(&next, HRTIMER_MODE_ABS);
+			continue;
+		}
+
+		wait_event_interruptible_timeout(tsi->tsi_pacer_waitq,
+			!list_empty(&tsi->tsi_idle_units) ||
+			tsi->tsi_stopping ||
+			atomic_read(&tsi->tsi_nactive) == 1,
+			cfs_time_seconds(1));
+	}
+
+	sfw_test_instance_done(tsi);
+	return 0;
+}
+
+static void
+sfw_start_pacer(struct sfw_test_instance *tsi)
+{
+	struct task_struct *task;
+	struct sfw_test_unit *tsu;
+
+	atomic_inc(&tsi->tsi_nactive);
+	task = kthread_run(sfw_test_pacer, tsi, "lst_pacer");
+	if (!IS_ERR(task))
+		return;
+
+	CERROR("Can't start pacer, running test closed-loop: %ld\n",
+	       PTR_ERR(task));
+	/* no unit has been released yet, so nothing races with this */
+	tsi->tsi_rate = 0;
+	atomic_dec(&tsi->tsi_nactive);
+	while (!list_empty(&tsi->tsi_idle_units)) {
+		tsu = list_entry(tsi->tsi_idle_units.next,
+				 struct sfw_test_unit, tsu_idle);
+		list_del_init(&tsu->tsu_idle);
+		swi_schedule_workitem(&tsu->tsu_worker);
+	}
+}
+
 static int
 sfw_run_batch(struct sfw_batch *tsb)
 {
@@ -1031,8 +1342,15 @@ sfw_run_batch(struct sfw_batch *tsb)
 			wi = &tsu->tsu_worker;
 			swi_init_workitem(wi, sfw_run_test,
 					  lst_sched_test[lnet_cpt_of_nid(tsu->tsu_dest.nid, NULL)]);
-			swi_schedule_workitem(wi);
+			if (tsi->tsi_rate != 0)
+				list_add_tail(&tsu->tsu_idle,
+					      &tsi->tsi_idle_units);
+			else
+				swi_schedule_workitem(wi);
 		}
+
+		if (tsi->tsi_rate != 0)
+			sfw_start_pacer(tsi);
 	}
 
 	return 0;
@@ -1059,6 +1377,7 @@ sfw_stop_batch(struct sfw_batch *tsb, int force)
 		}
 
 		tsi->tsi_stopping = 1;
+		wake_up(&tsi->tsi_pacer_waitq);
 
 		if (!force) {
 			spin_unlock(&tsi->tsi_lock);
@@ -1313,6 +1632,11 @@ sfw_handle_server_rpc(struct srpc_server_rpc *rpc)
                                    &reply->msg_body.stat_reply);
                 break;
 
+	case SRPC_SERVICE_QUERY_LAT:
+		rc = sfw_get_lat(&request->msg_body.lat_reqst,
+				 &reply->msg_body.lat_reply);
+		break;
+
         case SRPC_SERVICE_DEBUG:
                 rc = sfw_debug_session(&request->msg_body.dbg_reqst,
                                        &reply->msg_body.dbg_reply);
@@ -1458,6 +1782,30 @@ sfw_unpack_message(struct srpc_msg *msg)
                 return;
         }
 
+	if (msg->msg_type == SRPC_MSG_LAT_REQST) {
+		struct srpc_lat_reqst *req = &msg->msg_body.lat_reqst;
+
+		__swab64s(&req->lat_rpyid);
+		sfw_unpack_sid(req->lat_sid);
+		return;
+	}
+
+	if (msg->msg_type == SRPC_MSG_LAT_REPLY) {
+		struct srpc_lat_reply *rep = &msg->msg_body.lat_reply;
+
+		__swab32s(&rep->lat_status);
+		sfw_unpack_sid(rep->lat_sid);
+		__swab64s(&rep->lat_cnt.lat_count);
+		__swab64s(&rep->lat_cnt.lat_min_ns);
+		__swab64s(&rep->lat_cnt.lat_max_ns);
+		__swab64s(&rep->lat_cnt.lat_avg_ns);
+		__swab64s(&rep->lat_cnt.lat_p50_ns);
+		__swab64s(&rep->lat_cnt.lat_p99_ns);
+		__swab64s(&rep->lat_cnt.lat_p999_ns);
+		__swab64s(&rep->lat_cnt.lat_late);
+		return;
+	}
+
         if (msg->msg_type == SRPC_MSG_MKSN_REQST) {
 		struct srpc_mksn_reqst *req = &msg->msg_body.mksn_reqst;
 
@@ -1539,6 +1887,7 @@ sfw_unpack_message(struct srpc_msg *msg)
                 __swab32s(&req->tsr_ndest);
                 __swab32s(&req->tsr_concur);
                 __swab32s(&req->tsr_service);
+		__swab32s(&req->tsr_rate);
                 sfw_unpack_sid(req->tsr_sid);
                 __swab64s(&req->tsr_bid.bat_id);
                 return;
@@ -1605,6 +1954,7 @@ sfw_post_rpc(struct srpc_client_rpc *rpc)
 static struct srpc_service sfw_services[] = {
 	{ .sv_id = SRPC_SERVICE_DEBUG,		.sv_name = "debug", },
 	{ .sv_id = SRPC_SERVICE_QUERY_STAT,	.sv_name = "query stats", },
+	{ .sv_id = SRPC_SERVICE_QUERY_LAT,	.sv_name = "query latency", },
 	{ .sv_id = SRPC_SERVICE_MAKE_SESSION,	.sv_name = "make session", },
 	{ .sv_id = SRPC_SERVICE_REMOVE_SESSION,	.sv_name = "remove session", },
 	{ .sv_id = SRPC_SERVICE_BATCH,		.sv_name = "batch service", },
@@ -59,6 +59,8 @@ enum srpc_msg_type {
         SRPC_MSG_PING_REPLY     = 15,
         SRPC_MSG_JOIN_REQST     = 16,
         SRPC_MSG_JOIN_REPLY     = 17,
+	SRPC_MSG_LAT_REQST	= 18,
+	SRPC_MSG_LAT_REPLY	= 19,
 };
 
 /* CAVEAT EMPTOR:
@@ -164,6 +166,17 @@ struct srpc_stat_reply {
 	struct lnet_counters_common str_lnet;
 } WIRE_ATTR;
 
+struct srpc_lat_reqst {
+	__u64			lat_rpyid;	/* reply buffer matchbits */
+	struct lst_sid		lat_sid;	/* session id */
+} WIRE_ATTR;
+
+struct srpc_lat_reply {
+	__u32			lat_status;
+	struct lst_sid		lat_sid;
+	struct sfw_lat_counters	lat_cnt;
+} WIRE_ATTR;
+
 struct test_bulk_req {
         __u32                   blk_opc;        /* bulk operation code */
         __u32                   blk_npg;        /* # of pages */
@@ -204,6 +217,8 @@ struct srpc_test_reqst {
 		struct test_bulk_req	bulk_v0;
 		struct test_bulk_req_v1	bulk_v1;
 	} tsr_u;
+	/* open-loop RPCs/s of a client, only with LST_FEAT_LATENCY */
+	__u32			tsr_rate;
 } WIRE_ATTR;
 
 struct srpc_test_reply {
@@ -266,6 +281,8 @@ struct srpc_msg {
 		struct srpc_batch_reply		bat_reply;
 		struct srpc_stat_reqst		stat_reqst;
 		struct srpc_stat_reply		stat_reply;
+		struct srpc_lat_reqst		lat_reqst;
+		struct srpc_lat_reply		lat_reply;
 		struct srpc_test_reqst		tes_reqst;
 		struct srpc_test_reply		tes_reply;
 		struct srpc_join_reqst		join_reqst;
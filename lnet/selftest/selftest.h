@@ -77,6 +77,7 @@ struct sfw_test_instance;
 #define SRPC_SERVICE_TEST               4
 #define SRPC_SERVICE_QUERY_STAT         5
 #define SRPC_SERVICE_JOIN               6
+#define SRPC_SERVICE_QUERY_LAT		7
 #define SRPC_FRAMEWORK_SERVICE_MAX_ID   10
 /* other services start from SRPC_FRAMEWORK_SERVICE_MAX_ID+1 */
 #define SRPC_SERVICE_BRW                11
@@ -121,6 +122,9 @@ srpc_service2request (int service)
 
         case SRPC_SERVICE_JOIN:
                 return SRPC_MSG_JOIN_REQST;
+
+	case SRPC_SERVICE_QUERY_LAT:
+		return SRPC_MSG_LAT_REQST;
         }
 }
 
@@ -334,6 +338,27 @@ struct sfw_session {
 	atomic_t		sn_brw_errors;
 	atomic_t		sn_ping_errors;
 	ktime_t			sn_started;
+	/* per-CPT RPC latency, only with LST_FEAT_LATENCY */
+	struct sfw_lat_hist	**sn_lat;
+};
+
+/*
+ * Log-linear RPC latency histogram in ns: SFW_LAT_SUB buckets per
+ * power of two, so a bucket is at most 1/8th of its value wide.
+ * Covers up to 2^40ns, slower RPCs land in the last bucket.
+ */
+#define SFW_LAT_SUB_BITS	3
+#define SFW_LAT_SUB		(1 << SFW_LAT_SUB_BITS)
+#define SFW_LAT_NBUCKETS	(38 << SFW_LAT_SUB_BITS)
+
+struct sfw_lat_hist {
+	spinlock_t		lh_lock;
+	__u64			lh_count;
+	__u64			lh_sum_ns;
+	__u64			lh_min_ns;
+	__u64			lh_max_ns;
+	__u64			lh_late;
+	__u32			lh_buckets[SFW_LAT_NBUCKETS];
 };
 
 #define sfw_sid_equal(sid0, sid1)     ((sid0).ses_nid == (sid1).ses_nid && \
@@ -378,6 +403,12 @@ struct sfw_test_instance {
 	struct list_head	tsi_free_rpcs;	/* free rpcs */
 	struct list_head	tsi_active_rpcs;/* active rpcs */
 
+	/* open-loop RPCs/s, 0 for closed loop; see sfw_test_pacer() */
+	unsigned int		tsi_rate;
+	/* units waiting for the pacer to release their next RPC */
+	struct list_head	tsi_idle_units;
+	wait_queue_head_t	tsi_pacer_waitq;
+
 	union {
 		struct test_ping_req	ping;	  /* ping parameter */
 		struct test_bulk_req	bulk_v0;  /* bulk parameter */
@@ -399,6 +430,10 @@ struct sfw_test_unit {
 	struct sfw_test_instance *tsu_instance;	/* pointer to test instance */
 	void			*tsu_private;	/* private data */
 	struct swi_workitem	 tsu_worker;	/* workitem of the test unit */
+	struct list_head	tsu_idle;	/* chain on tsi_idle_units */
+	/* when the current RPC was (or, in open loop, should have been)
+	 * sent */
+	ktime_t			tsu_start;
 };
 
 struct sfw_test_case {
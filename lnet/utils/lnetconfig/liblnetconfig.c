@@ -2120,6 +2120,70 @@ int lustre_lnet_config_peer_ni_healthv(int value, bool all, char *lpni_nid,
 					  "peer_ni healthv", seq_no, err_rc);
 }
 
+int lustre_lnet_get_net_sel_policy(__u32 net, int *policy)
+{
+	struct lnet_ioctl_net_sel_policy data;
+	int rc;
+
+	LIBCFS_IOC_INIT_V2(data, nsp_hdr);
+	data.nsp_net = net;
+	data.nsp_set = 0;
+
+	rc = l_ioctl(LNET_DEV_ID, IOC_LIBCFS_NET_SEL_POLICY, &data);
+	if (rc != 0)
+		return -errno;
+
+	*policy = data.nsp_policy;
+	return 0;
+}
+
+int lustre_lnet_config_net_sel_policy(char *nw, char *policy, int seq_no,
+				      struct cYAML **err_rc)
+{
+	struct lnet_ioctl_net_sel_policy data;
+	int rc = LUSTRE_CFG_RC_NO_ERR;
+	char err_str[LNET_MAX_STR_LEN];
+	__u32 net;
+
+	snprintf(err_str, sizeof(err_str), "\"success\"");
+
+	net = nw ? libcfs_str2net(nw) : LNET_NIDNET(LNET_NID_ANY);
+	if (net == LNET_NIDNET(LNET_NID_ANY)) {
+		rc = LUSTRE_CFG_RC_MISSING_PARAM;
+		snprintf(err_str, sizeof(err_str),
+			 "\"a valid net must be provided\"");
+		goto out;
+	}
+
+	LIBCFS_IOC_INIT_V2(data, nsp_hdr);
+	data.nsp_net = net;
+	data.nsp_set = 1;
+	if (policy && !strcmp(policy, "latency")) {
+		data.nsp_policy = LNET_SEL_POLICY_LATENCY;
+	} else if (policy && !strcmp(policy, "default")) {
+		data.nsp_policy = LNET_SEL_POLICY_DEFAULT;
+	} else {
+		rc = LUSTRE_CFG_RC_BAD_PARAM;
+		snprintf(err_str, sizeof(err_str),
+			 "\"selection must be 'default' or 'latency'\"");
+		goto out;
+	}
+
+	rc = l_ioctl(LNET_DEV_ID, IOC_LIBCFS_NET_SEL_POLICY, &data);
+	if (rc != 0) {
+		rc = -errno;
+		snprintf(err_str, sizeof(err_str),
+			 "\"cannot set selection policy of %s: %s\"",
+			 nw, strerror(errno));
+	}
+
+out:
+	cYAML_build_error(rc, seq_no, ADD_CMD, "net selection", err_str,
+			  err_rc);
+
+	return rc;
+}
+
 static bool
 add_msg_stats_to_yaml_blk(struct cYAML *yaml,
 			  struct lnet_ioctl_comm_count *counts)
@@ -2261,10 +2325,19 @@ int lustre_lnet_show_net(char *nw, int detail, int seq_no,
 		}
 
 		if (new_net) {
+			int policy;
+
 			if (!cYAML_create_string(net_node, "net type",
 						 libcfs_net2str(rc_net)))
 				goto out;
 
+			if (detail && !backup &&
+			    lustre_lnet_get_net_sel_policy(rc_net, &policy) == 0 &&
+			    !cYAML_create_string(net_node, "selection",
+				policy == LNET_SEL_POLICY_LATENCY ?
+					"latency" : "default"))
+				goto out;
+
 			tmp = cYAML_create_seq(net_node, "local NI(s)");
 			if (tmp == NULL)
 				goto out;
@@ -2885,6 +2958,16 @@ calculate_buffers:
 						pool_cfg->pl_pools[j].
 						   pl_mincredits) == NULL)
 				goto out;
+			if (!backup &&
+			    cYAML_create_number(type_node, "maxbuffers",
+						pool_cfg->pl_stats[j].
+						   pl_maxbuffers) == NULL)
+				goto out;
+			if (!backup &&
+			    cYAML_create_number(type_node, "blocked",
+						pool_cfg->pl_stats[j].
+						   pl_nblocked) == NULL)
+				goto out;
 			/* keep track of the total count for each of the
 			 * tiny, small and large buffers */
 			buf_count[j] += pool_cfg->pl_pools[j].pl_nbuffers;
@@ -2978,12 +3061,14 @@ int lustre_lnet_show_peer(char *knid, int detail, int seq_no,
 	struct lnet_ioctl_element_stats *lpni_stats;
 	struct lnet_ioctl_element_msg_stats *msg_stats;
 	struct lnet_ioctl_peer_ni_hstats *hstats;
+	struct lnet_ioctl_peer_ni_tx_alloc *tx_alloc;
 	lnet_nid_t *nidp;
 	int rc = LUSTRE_CFG_RC_OUT_OF_MEM;
 	int i, j, k;
 	int l_errno = 0;
 	__u32 count;
 	__u32 size;
+	__u32 stride;
 	struct cYAML *root = NULL, *peer = NULL, *peer_ni = NULL,
 		     *first_seq = NULL, *peer_root = NULL, *tmp = NULL,
 		     *msg_statistics = NULL, *statistics = NULL,
@@ -3064,6 +3149,9 @@ int lustre_lnet_show_peer(char *knid, int detail, int seq_no,
 			peer_info.prcfg_prim_nid = list[i].nid;
 			peer_info.prcfg_size = size;
 			peer_info.prcfg_bulk = data;
+			if (detail && !backup)
+				peer_info.prcfg_flags =
+					LNET_PEER_INFO_F_TX_ALLOC;
 
 			l_errno = 0;
 			rc = l_ioctl(LNET_DEV_ID, IOC_LIBCFS_GET_PEER_NI,
@@ -3121,6 +3209,10 @@ int lustre_lnet_show_peer(char *knid, int detail, int seq_no,
 		if (tmp == NULL)
 			goto out;
 
+		/* older kernels don't append the tx allotment */
+		stride = peer_info.prcfg_count ?
+			 peer_info.prcfg_size / peer_info.prcfg_count : 0;
+
 		lpni_data = data;
 		for (j = 0; j < peer_info.prcfg_count; j++) {
 			nidp = lpni_data;
@@ -3128,7 +3220,11 @@ int lustre_lnet_show_peer(char *knid, int detail, int seq_no,
 			lpni_stats = (void *)lpni_cri + sizeof(*lpni_cri);
 			msg_stats = (void *)lpni_stats + sizeof(*lpni_stats);
 			hstats = (void *)msg_stats + sizeof(*msg_stats);
-			lpni_data = (void *)hstats + sizeof(*hstats);
+			tx_alloc = (void *)hstats + sizeof(*hstats);
+			if ((void *)tx_alloc + sizeof(*tx_alloc) >
+			    (void *)nidp + stride)
+				tx_alloc = NULL;
+			lpni_data = (void *)nidp + stride;
 
 			peer_ni = cYAML_create_seq_item(tmp);
 			if (peer_ni == NULL)
@@ -3165,6 +3261,18 @@ int lustre_lnet_show_peer(char *knid, int detail, int seq_no,
 			    == NULL)
 				goto out;
 
+			if (tx_alloc && tx_alloc->pta_dynamic &&
+			    (cYAML_create_number(peer_ni, "allotted_tx_credits",
+						 tx_alloc->pta_tx_credits)
+			     == NULL ||
+			     cYAML_create_number(peer_ni, "tx_credit_demand",
+						 tx_alloc->pta_tx_demand)
+			     == NULL ||
+			     cYAML_create_number(peer_ni, "floor_tx_credits",
+						 tx_alloc->pta_tx_floor)
+			     == NULL))
+				goto out;
+
 			if (cYAML_create_number(peer_ni, "tx_q_num_of_buf",
 						lpni_cri->cr_peer_tx_qnob)
 			    == NULL)
@@ -3587,6 +3695,379 @@ int lustre_lnet_show_transaction_to(int seq_no, struct cYAML **show_rc,
 				       err_rc, l_errno);
 }
 
+int lustre_lnet_config_trace_sample(int sample, int seq_no,
+				    struct cYAML **err_rc)
+{
+	int rc = LUSTRE_CFG_RC_NO_ERR;
+	char err_str[LNET_MAX_STR_LEN];
+	char val[LNET_MAX_STR_LEN];
+
+	snprintf(err_str, sizeof(err_str), "\"success\"");
+
+	if (sample < 0) {
+		snprintf(err_str, sizeof(err_str),
+			 "\"invalid trace sample rate %d\"", sample);
+		rc = LUSTRE_CFG_RC_BAD_PARAM;
+		goto out;
+	}
+
+	snprintf(val, sizeof(val), "%d", sample);
+
+	rc = write_sysfs_file(modparam_path, "lnet_trace_sample", val,
+			      1, strlen(val) + 1);
+	if (rc)
+		snprintf(err_str, sizeof(err_str),
+			 "\"cannot configure trace sample rate: %s\"",
+			 strerror(errno));
+out:
+	cYAML_build_error(rc, seq_no, ADD_CMD, "trace_sample", err_str, err_rc);
+
+	return rc;
+}
+
+int lustre_lnet_show_trace_sample(int seq_no, struct cYAML **show_rc,
+				  struct cYAML **err_rc)
+{
+	int rc = LUSTRE_CFG_RC_OUT_OF_MEM;
+	char val[LNET_MAX_STR_LEN];
+	int sample = -1, l_errno = 0;
+	char err_str[LNET_MAX_STR_LEN];
+
+	snprintf(err_str, sizeof(err_str), "\"out of memory\"");
+
+	rc = read_sysfs_file(modparam_path, "lnet_trace_sample", val,
+			     1, sizeof(val));
+	if (rc) {
+		l_errno = -errno;
+		snprintf(err_str, sizeof(err_str),
+			 "\"cannot get trace sample rate: %d\"", rc);
+	} else {
+		sample = atoi(val);
+	}
+
+	return build_global_yaml_entry(err_str, sizeof(err_str), seq_no,
+				       "trace_sample", sample, show_rc,
+				       err_rc, l_errno);
+}
+
+/* records requested from the kernel per CPU, the newest ones are kept if
+ * the ring is larger */
+#define LNET_TRACE_DUMP_MAX	65536
+
+int lustre_lnet_trace_dump(char *file, int seq_no, struct cYAML **err_rc)
+{
+	struct lnet_ioctl_trace_dump dump;
+	struct lnet_trace_file_hdr fhdr;
+	struct lnet_trace_rec *recs = NULL;
+	char err_str[LNET_MAX_STR_LEN];
+	int rc = LUSTRE_CFG_RC_OUT_OF_MEM;
+	FILE *fp = NULL;
+	__u32 ncpus = 1;
+	__u32 cpu;
+
+	snprintf(err_str, sizeof(err_str), "\"out of memory\"");
+
+	recs = calloc(LNET_TRACE_DUMP_MAX, sizeof(*recs));
+	if (recs == NULL)
+		goto out;
+
+	fp = fopen(file, "w");
+	if (fp == NULL) {
+		snprintf(err_str, sizeof(err_str),
+			 "\"cannot open %s: %s\"", file, strerror(errno));
+		rc = LUSTRE_CFG_RC_BAD_PARAM;
+		goto out;
+	}
+
+	memset(&fhdr, 0, sizeof(fhdr));
+	fhdr.ltf_magic = LNET_TRACE_FILE_MAGIC;
+	fhdr.ltf_version = LNET_TRACE_FILE_VERSION;
+	fhdr.ltf_rec_size = sizeof(*recs);
+
+	/* the number of CPUs is only known after the first dump, the
+	 * header is rewritten with the record count at the end */
+	for (cpu = 0; cpu < ncpus; cpu++) {
+		memset(&dump, 0, sizeof(dump));
+		LIBCFS_IOC_INIT_V2(dump, ltd_hdr);
+		dump.ltd_cpu = cpu;
+		dump.ltd_count = LNET_TRACE_DUMP_MAX;
+		dump.ltd_buf = recs;
+
+		rc = l_ioctl(LNET_DEV_ID, IOC_LIBCFS_TRACE_DUMP, &dump);
+		if (rc != 0) {
+			rc = -errno;
+			snprintf(err_str, sizeof(err_str),
+				 "\"cannot dump trace ring of CPU %u: %s\"",
+				 cpu, strerror(-rc));
+			goto out;
+		}
+
+		if (cpu == 0) {
+			ncpus = dump.ltd_ncpus;
+			fhdr.ltf_ncpus = ncpus;
+			fhdr.ltf_sample = dump.ltd_sample;
+			if (fwrite(&fhdr, sizeof(fhdr), 1, fp) != 1)
+				goto write_failed;
+		}
+
+		fhdr.ltf_nrecs += dump.ltd_count;
+		fhdr.ltf_lost += dump.ltd_lost;
+		if (dump.ltd_count > 0 &&
+		    fwrite(recs, sizeof(*recs), dump.ltd_count, fp) !=
+		    dump.ltd_count)
+			goto write_failed;
+	}
+
+	if (fseek(fp, 0, SEEK_SET) != 0 ||
+	    fwrite(&fhdr, sizeof(fhdr), 1, fp) != 1 ||
+	    fflush(fp) != 0)
+		goto write_failed;
+
+	snprintf(err_str, sizeof(err_str), "\"success\"");
+	rc = LUSTRE_CFG_RC_NO_ERR;
+	goto out;
+
+write_failed:
+	rc = -errno;
+	snprintf(err_str, sizeof(err_str),
+		 "\"cannot write %s: %s\"", file, strerror(-rc));
+out:
+	if (fp != NULL)
+		fclose(fp);
+	free(recs);
+	cYAML_build_error(rc, seq_no, SHOW_CMD, "trace", err_str, err_rc);
+
+	return rc;
+}
+
+static const char *lnet_trace_event2str(int event)
+{
+	static const char *names[LNET_TRACE_EVENT_MAX] = {
+		[LNET_TRACE_SEND]	= "send",
+		[LNET_TRACE_WAIT_PEER]	= "wait_peer_credit",
+		[LNET_TRACE_WAIT_NI]	= "wait_ni_credit",
+		[LNET_TRACE_WAIT_RTR]	= "wait_router_buffer",
+		[LNET_TRACE_LND_SEND]	= "lnd_send",
+		[LNET_TRACE_RECV]	= "recv",
+		[LNET_TRACE_LND_RECV]	= "lnd_recv",
+		[LNET_TRACE_DONE]	= "done",
+	};
+
+	if (event <= 0 || event >= LNET_TRACE_EVENT_MAX)
+		return "unknown";
+	return names[event];
+}
+
+static const char *lnet_trace_msgtype2str(int type)
+{
+	switch (type) {
+	case LNET_MSG_ACK:
+		return "ACK";
+	case LNET_MSG_PUT:
+		return "PUT";
+	case LNET_MSG_GET:
+		return "GET";
+	case LNET_MSG_REPLY:
+		return "REPLY";
+	case LNET_MSG_HELLO:
+		return "HELLO";
+	default:
+		return "<UNKNOWN>";
+	}
+}
+
+static int lnet_trace_rec_cmp(const void *a, const void *b)
+{
+	const struct lnet_trace_rec *ra = a;
+	const struct lnet_trace_rec *rb = b;
+
+	if (ra->ltr_id != rb->ltr_id)
+		return ra->ltr_id < rb->ltr_id ? -1 : 1;
+	if (ra->ltr_time_ns != rb->ltr_time_ns)
+		return ra->ltr_time_ns < rb->ltr_time_ns ? -1 : 1;
+	return 0;
+}
+
+struct lnet_trace_stage {
+	__u64	lts_count;
+	__u64	lts_total_ns;
+	__u64	lts_max_ns;
+};
+
+int lustre_lnet_trace_decode(char *file, bool verbose, int seq_no,
+			     struct cYAML **err_rc)
+{
+	struct lnet_trace_stage stages[LNET_TRACE_EVENT_MAX]
+				      [LNET_TRACE_EVENT_MAX];
+	struct lnet_trace_stage total;
+	struct lnet_trace_file_hdr fhdr;
+	struct lnet_trace_rec *recs = NULL;
+	struct lnet_trace_rec *rec;
+	char err_str[LNET_MAX_STR_LEN];
+	int rc = LUSTRE_CFG_RC_BAD_PARAM;
+	__u64 nmsgs = 0;
+	__u64 first;
+	__u64 i;
+	__u64 j;
+	FILE *fp;
+	int e1;
+	int e2;
+
+	memset(stages, 0, sizeof(stages));
+	memset(&total, 0, sizeof(total));
+
+	fp = fopen(file, "r");
+	if (fp == NULL) {
+		snprintf(err_str, sizeof(err_str),
+			 "\"cannot open %s: %s\"", file, strerror(errno));
+		goto out;
+	}
+
+	if (fread(&fhdr, sizeof(fhdr), 1, fp) != 1 ||
+	    fhdr.ltf_magic != LNET_TRACE_FILE_MAGIC ||
+	    fhdr.ltf_version != LNET_TRACE_FILE_VERSION ||
+	    fhdr.ltf_rec_size != sizeof(*recs)) {
+		/* dumps are in host byte order, decode on the same arch */
+		snprintf(err_str, sizeof(err_str),
+			 "\"%s is not a trace dump of this architecture\"",
+			 file);
+		goto out;
+	}
+
+	if (fhdr.ltf_nrecs > 0) {
+		recs = calloc(fhdr.ltf_nrecs, sizeof(*recs));
+		if (recs == NULL) {
+			snprintf(err_str, sizeof(err_str), "\"out of memory\"");
+			rc = LUSTRE_CFG_RC_OUT_OF_MEM;
+			goto out;
+		}
+
+		if (fread(recs, sizeof(*recs), fhdr.ltf_nrecs, fp) !=
+		    fhdr.ltf_nrecs) {
+			snprintf(err_str, sizeof(err_str),
+				 "\"%s is truncated\"", file);
+			goto out;
+		}
+	}
+
+	/* one message may have been handled on several CPUs */
+	qsort(recs, fhdr.ltf_nrecs, sizeof(*recs), lnet_trace_rec_cmp);
+
+	printf("trace:\n");
+	printf("    sample: %u\n", fhdr.ltf_sample);
+	printf("    cpus: %u\n", fhdr.ltf_ncpus);
+	printf("    records: %llu\n", (unsigned long long)fhdr.ltf_nrecs);
+	printf("    lost: %llu\n", (unsigned long long)fhdr.ltf_lost);
+	if (verbose)
+		printf("    messages:\n");
+
+	for (i = 0; i < fhdr.ltf_nrecs; i = j) {
+		first = i;
+		for (j = i + 1; j < fhdr.ltf_nrecs &&
+		     recs[j].ltr_id == recs[first].ltr_id; j++) {
+			e1 = recs[j - 1].ltr_event;
+			e2 = recs[j].ltr_event;
+			if (e1 <= 0 || e1 >= LNET_TRACE_EVENT_MAX ||
+			    e2 <= 0 || e2 >= LNET_TRACE_EVENT_MAX)
+				continue;
+
+			stages[e1][e2].lts_count++;
+			stages[e1][e2].lts_total_ns +=
+				recs[j].ltr_time_ns - recs[j - 1].ltr_time_ns;
+			if (recs[j].ltr_time_ns - recs[j - 1].ltr_time_ns >
+			    stages[e1][e2].lts_max_ns)
+				stages[e1][e2].lts_max_ns =
+					recs[j].ltr_time_ns -
+					recs[j - 1].ltr_time_ns;
+		}
+
+		nmsgs++;
+		if (j - first > 1) {
+			__u64 ns = recs[j - 1].ltr_time_ns -
+				   recs[first].ltr_time_ns;
+
+			total.lts_count++;
+			total.lts_total_ns += ns;
+			if (ns > total.lts_max_ns)
+				total.lts_max_ns = ns;
+		}
+
+		if (!verbose)
+			continue;
+
+		printf("    - id: %#llx\n",
+		       (unsigned long long)recs[first].ltr_id);
+		printf("      type: %s\n",
+		       lnet_trace_msgtype2str(recs[first].ltr_msg_type));
+		printf("      length: %u\n", recs[first].ltr_len);
+		if (recs[first].ltr_cookie != 0)
+			printf("      cookie: %#llx\n",
+			       (unsigned long long)recs[first].ltr_cookie);
+		printf("      events:\n");
+		for (rec = &recs[first]; rec < &recs[j]; rec++) {
+			printf("        - event: %s\n",
+			       lnet_trace_event2str(rec->ltr_event));
+			printf("          usec: %.3f\n",
+			       (rec->ltr_time_ns - recs[first].ltr_time_ns) /
+			       1000.0);
+			printf("          cpu: %u\n", rec->ltr_cpu);
+			printf("          ni: %s\n",
+			       libcfs_nid2str(rec->ltr_ni_nid));
+			printf("          peer: %s\n",
+			       libcfs_nid2str(rec->ltr_peer_nid));
+			if (rec->ltr_flags & LNET_TRACE_F_ROUTING)
+				printf("          routing: 1\n");
+			if (rec->ltr_flags & LNET_TRACE_F_RESEND)
+				printf("          resend: 1\n");
+			if (rec->ltr_event == LNET_TRACE_DONE ||
+			    rec->ltr_status != 0)
+				printf("          status: %d\n",
+				       rec->ltr_status);
+		}
+	}
+
+	printf("    traced messages: %llu\n", (unsigned long long)nmsgs);
+	printf("    stages:\n");
+	for (e1 = 1; e1 < LNET_TRACE_EVENT_MAX; e1++) {
+		for (e2 = 1; e2 < LNET_TRACE_EVENT_MAX; e2++) {
+			struct lnet_trace_stage *st = &stages[e1][e2];
+
+			if (st->lts_count == 0)
+				continue;
+
+			printf("        - from: %s\n",
+			       lnet_trace_event2str(e1));
+			printf("          to: %s\n",
+			       lnet_trace_event2str(e2));
+			printf("          count: %llu\n",
+			       (unsigned long long)st->lts_count);
+			printf("          avg_usec: %.3f\n",
+			       st->lts_total_ns / 1000.0 / st->lts_count);
+			printf("          max_usec: %.3f\n",
+			       st->lts_max_ns / 1000.0);
+		}
+	}
+	if (total.lts_count > 0) {
+		printf("    lifetime:\n");
+		printf("        count: %llu\n",
+		       (unsigned long long)total.lts_count);
+		printf("        avg_usec: %.3f\n",
+		       total.lts_total_ns / 1000.0 / total.lts_count);
+		printf("        max_usec: %.3f\n",
+		       total.lts_max_ns / 1000.0);
+	}
+
+	snprintf(err_str, sizeof(err_str), "\"success\"");
+	rc = LUSTRE_CFG_RC_NO_ERR;
+out:
+	if (fp != NULL)
+		fclose(fp);
+	free(recs);
+	cYAML_build_error(rc, seq_no, SHOW_CMD, "trace", err_str, err_rc);
+
+	return rc;
+}
+
 int lustre_lnet_show_retry_count(int seq_no, struct cYAML **show_rc,
 				 struct cYAML **err_rc)
 {
@@ -3891,6 +4372,22 @@ int lustre_lnet_show_stats(int seq_no, struct cYAML **show_rc,
 				 cntrs->lct_health.lch_network_timeout_count))
 		goto out;
 
+	if (!cYAML_create_number(stats, "net_lock_contended",
+				 cntrs->lct_lock.lcl_net_lock_contended))
+		goto out;
+
+	if (!cYAML_create_number(stats, "res_lock_contended",
+				 cntrs->lct_lock.lcl_res_lock_contended))
+		goto out;
+
+	if (!cYAML_create_number(stats, "peer_credit_fast",
+				 cntrs->lct_lock.lcl_peer_credit_fast))
+		goto out;
+
+	if (!cYAML_create_number(stats, "peer_credit_locked",
+				 cntrs->lct_lock.lcl_peer_credit_locked))
+		goto out;
+
 	if (!cYAML_create_number(stats, "recv_count",
 				 cntrs->lct_common.lcc_recv_count))
 		goto out;
@@ -4692,7 +5189,7 @@ static int handle_yaml_config_global_settings(struct cYAML *tree,
 					      struct cYAML **err_rc)
 {
 	struct cYAML *max_intf, *numa, *discovery, *retry, *tto, *seq_no,
-		     *sen, *recov, *rsen, *drop_asym_route;
+		     *sen, *recov, *rsen, *drop_asym_route, *sample;
 	int rc = 0;
 
 	seq_no = cYAML_get_object_item(tree, "seq_no");
@@ -4738,6 +5235,13 @@ static int handle_yaml_config_global_settings(struct cYAML *tree,
 								: -1,
 						       err_rc);
 
+	sample = cYAML_get_object_item(tree, "trace_sample");
+	if (sample)
+		rc = lustre_lnet_config_trace_sample(sample->cy_valueint,
+						     seq_no ? seq_no->cy_valueint
+							: -1,
+						     err_rc);
+
 	sen = cYAML_get_object_item(tree, "health_sensitivity");
 	if (sen)
 		rc = lustre_lnet_config_hsensitivity(sen->cy_valueint,
@@ -240,6 +240,26 @@ int lustre_lnet_show_numa_range(int seq_no, struct cYAML **show_rc,
 int lustre_lnet_config_ni_healthv(int value, bool all, char *ni_nid,
 				  int seq_no, struct cYAML **err_rc);
 
+/*
+ * lustre_lnet_config_net_sel_policy
+ *   set how the NIs and peer NIs of a net are selected for sending.
+ *
+ *   nw: net to configure, e.g. "tcp0"
+ *   policy: "default" (health, NUMA distance, credits, round-robin) or
+ *   "latency" (health, then lowest expected completion time)
+ *   seq_no - sequence number of the request
+ *   err_rc - [OUT] struct cYAML tree describing the error. Freed by
+ *   caller
+ */
+int lustre_lnet_config_net_sel_policy(char *nw, char *policy, int seq_no,
+				      struct cYAML **err_rc);
+
+/*
+ * lustre_lnet_get_net_sel_policy
+ *   get the enum lnet_sel_policy of a net into @policy; 0 or -errno.
+ */
+int lustre_lnet_get_net_sel_policy(__u32 net, int *policy);
+
 /*
  * lustre_lnet_config_peer_ni_healthv
  *   set the health value of the peer NI. -1 resets the value to maximum.
@@ -351,6 +371,71 @@ int lustre_lnet_config_transaction_to(int timeout, int seq_no, struct cYAML **er
 int lustre_lnet_show_transaction_to(int seq_no, struct cYAML **show_rc,
 				    struct cYAML **err_rc);
 
+/*
+ * lustre_lnet_config_trace_sample
+ *   trace 1 in @sample messages in the LNet message trace rings, 0
+ *   disables message tracing.
+ *
+ *   sample - sampling rate to configure
+ *   seq_no - sequence number of the request
+ *   err_rc - [OUT] struct cYAML tree describing the error. Freed by
+ *   caller
+ */
+int lustre_lnet_config_trace_sample(int sample, int seq_no,
+				    struct cYAML **err_rc);
+
+/*
+ * lustre_lnet_show_trace_sample
+ *    show the message trace sampling rate in the system
+ *
+ *   seq_no - sequence number of the request
+ *   show_rc - [OUT] struct cYAML tree containing the sampling rate
+ *   err_rc - [OUT] struct cYAML tree describing the error. Freed by
+ *   caller
+ */
+int lustre_lnet_show_trace_sample(int seq_no, struct cYAML **show_rc,
+				  struct cYAML **err_rc);
+
+/* header of a file written by lustre_lnet_trace_dump(), followed by
+ * ltf_nrecs struct lnet_trace_rec in host byte order */
+#define LNET_TRACE_FILE_MAGIC	0x4c4e5452	/* "LNTR" */
+#define LNET_TRACE_FILE_VERSION	1
+
+struct lnet_trace_file_hdr {
+	__u32 ltf_magic;
+	__u16 ltf_version;
+	__u16 ltf_rec_size;
+	__u32 ltf_sample;
+	__u32 ltf_ncpus;
+	__u64 ltf_nrecs;
+	__u64 ltf_lost;
+};
+
+/*
+ * lustre_lnet_trace_dump
+ *   copy the message trace ring of every CPU into @file.
+ *
+ *   file - file to write
+ *   seq_no - sequence number of the request
+ *   err_rc - [OUT] struct cYAML tree describing the error. Freed by
+ *   caller
+ */
+int lustre_lnet_trace_dump(char *file, int seq_no, struct cYAML **err_rc);
+
+/*
+ * lustre_lnet_trace_decode
+ *   print the time spent between consecutive trace points of the
+ *   messages in a file written by lustre_lnet_trace_dump().
+ *
+ *   file - file to read
+ *   verbose - also print every record, grouped by message
+ *   seq_no - sequence number of the request
+ *   err_rc - [OUT] struct cYAML tree describing the error. Freed by
+ *   caller
+ */
+int lustre_lnet_trace_decode(char *file, bool verbose, int seq_no,
+			     struct cYAML **err_rc);
+
 /*
  * lustre_lnet_config_retry_count
  *   sets the maximum number of retries to resend a message
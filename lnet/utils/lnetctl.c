@@ -64,6 +64,9 @@ static int jt_del_peer_nid(int argc, char **argv);
 static int jt_set_max_intf(int argc, char **argv);
 static int jt_set_discovery(int argc, char **argv);
 static int jt_set_drop_asym_route(int argc, char **argv);
+static int jt_set_trace_sample(int argc, char **argv);
+static int jt_trace_dump(int argc, char **argv);
+static int jt_trace_decode(int argc, char **argv);
 static int jt_list_peer(int argc, char **argv);
 /*static int jt_show_peer(int argc, char **argv);*/
 static int lnetctl_list_commands(int argc, char **argv);
@@ -80,6 +83,7 @@ static int jt_debug(int argc, char **argv);
 static int jt_stats(int argc, char **argv);
 static int jt_global(int argc, char **argv);
 static int jt_peers(int argc, char **argv);
+static int jt_trace(int argc, char **argv);
 static int jt_set_ni_value(int argc, char **argv);
 static int jt_set_peer_ni_value(int argc, char **argv);
 
@@ -90,7 +94,7 @@ command_t cmd_list[] = {
 	{"routing", jt_routing, 0, "routing {show | help}"},
 	{"set", jt_set, 0, "set {tiny_buffers | small_buffers | large_buffers"
 			   " | routing | numa_range | max_interfaces"
-			   " | discovery}"},
+			   " | discovery | trace_sample}"},
 	{"import", jt_import, 0, "import FILE.yaml"},
 	{"export", jt_export, 0, "export FILE.yaml"},
 	{"stats", jt_stats, 0, "stats {show | help}"},
@@ -99,6 +103,7 @@ command_t cmd_list[] = {
 	{"peer", jt_peers, 0, "peer {add | del | show | help}"},
 	{"ping", jt_ping, 0, "ping nid,[nid,...]"},
 	{"discover", jt_discover, 0, "discover nid[,nid,...]"},
+	{"trace", jt_trace, 0, "trace {dump | decode | help}"},
 	{"help", Parser_help, 0, "help"},
 	{"exit", Parser_quit, 0, "quit"},
 	{"quit", Parser_quit, 0, "quit"},
@@ -153,7 +158,10 @@ command_t net_cmds[] = {
 	{"set", jt_set_ni_value, 0, "set local NI specific parameter\n"
 	 "\t--nid: NI NID to set the\n"
 	 "\t--health: specify health value to set\n"
-	 "\t--all: set all NIs value to the one specified\n"},
+	 "\t--all: set all NIs value to the one specified\n"
+	 "\t--net: net to set the selection policy of (e.g. tcp0)\n"
+	 "\t--selection: NI selection policy of the net, 'default' or\n"
+	 "\t             'latency' (lowest expected completion time)\n"},
 	{ 0, 0, 0, NULL }
 };
 
@@ -214,6 +222,18 @@ command_t set_cmds[] = {
 	{"router_sensitivity", jt_set_rtr_sensitivity, 0, "router sensitivity %\n"
 	 "\t100 - router interfaces need to be fully healthy to be used\n"
 	 "\t<100 - router interfaces can be used even if not healthy\n"},
+	{"trace_sample", jt_set_trace_sample, 0, "message tracing rate\n"
+	 "\t0 - turn off message tracing\n"
+	 "\t>0 - trace 1 in VALUE messages\n"},
+	{ 0, 0, 0, NULL }
+};
+
+command_t trace_cmds[] = {
+	{"dump", jt_trace_dump, 0, "save the message trace rings\n"
+	 "\tFILE: binary file to write the trace records to\n"},
+	{"decode", jt_trace_decode, 0, "summarize a trace dump\n"
+	 "\t--verbose: also list the trace points of every message\n"
+	 "\tFILE: file written by \"trace dump\"\n"},
 	{ 0, 0, 0, NULL }
 };
 
@@ -484,6 +504,34 @@ static int jt_set_transaction_to(int argc, char **argv)
 	return rc;
 }
 
+static int jt_set_trace_sample(int argc, char **argv)
+{
+	long int value;
+	int rc;
+	struct cYAML *err_rc = NULL;
+
+	rc = check_cmd(set_cmds, "set", "trace_sample", 2, argc, argv);
+	if (rc)
+		return rc;
+
+	rc = parse_long(argv[1], &value);
+	if (rc != 0) {
+		cYAML_build_error(-1, -1, "parser", "set",
+				  "cannot parse trace sample value", &err_rc);
+		cYAML_print_tree2file(stderr, err_rc);
+		cYAML_free_tree(err_rc);
+		return -1;
+	}
+
+	rc = lustre_lnet_config_trace_sample(value, -1, &err_rc);
+	if (rc != LUSTRE_CFG_RC_NO_ERR)
+		cYAML_print_tree2file(stderr, err_rc);
+
+	cYAML_free_tree(err_rc);
+
+	return rc;
+}
+
 static int jt_set_retry_count(int argc, char **argv)
 {
 	long int value;
@@ -1140,8 +1188,59 @@ static int set_value_helper(int argc, char **argv,
 	return rc;
 }
 
+static int jt_set_net_sel_policy(int argc, char **argv)
+{
+	char *net = NULL;
+	char *policy = NULL;
+	int rc, opt;
+	struct cYAML *err_rc = NULL;
+
+	const char *const short_options = "N:s:";
+	static const struct option long_options[] = {
+		{ .name = "net", .has_arg = required_argument, .val = 'N' },
+		{ .name = "selection", .has_arg = required_argument, .val = 's' },
+		{ .name = NULL } };
+
+	while ((opt = getopt_long(argc, argv, short_options,
+				   long_options, NULL)) != -1) {
+		switch (opt) {
+		case 'N':
+			net = optarg;
+			break;
+		case 's':
+			policy = optarg;
+			break;
+		default:
+			return 0;
+		}
+	}
+
+	rc = lustre_lnet_config_net_sel_policy(net, policy, -1, &err_rc);
+
+	if (rc != LUSTRE_CFG_RC_NO_ERR)
+		cYAML_print_tree2file(stderr, err_rc);
+
+	cYAML_free_tree(err_rc);
+
+	return rc;
+}
+
 static int jt_set_ni_value(int argc, char **argv)
 {
+	int i;
+
+	for (i = 1; i < argc; i++) {
+		if (!strncmp(argv[i], "--selection", strlen("--selection")) ||
+		    !strncmp(argv[i], "--net", strlen("--net"))) {
+			int rc = check_cmd(net_cmds, "net", "set", 0,
+					   argc, argv);
+
+			if (rc)
+				return rc;
+			return jt_set_net_sel_policy(argc, argv);
+		}
+	}
+
 	return set_value_helper(argc, argv, lustre_lnet_config_ni_healthv);
 }
 
@@ -1350,6 +1449,12 @@ static int jt_show_global(int argc, char **argv)
 		goto out;
 	}
 
+	rc = lustre_lnet_show_trace_sample(-1, &show_rc, &err_rc);
+	if (rc != LUSTRE_CFG_RC_NO_ERR) {
+		cYAML_print_tree2file(stderr, err_rc);
+		goto out;
+	}
+
 	if (show_rc)
 		cYAML_print_tree(show_rc);
 
@@ -1448,6 +1553,76 @@ static int jt_peers(int argc, char **argv)
 	return Parser_execarg(argc - 1, &argv[1], peer_cmds);
 }
 
+static int jt_trace(int argc, char **argv)
+{
+	int rc;
+
+	rc = check_cmd(trace_cmds, "trace", NULL, 2, argc, argv);
+	if (rc)
+		return rc;
+
+	return Parser_execarg(argc - 1, &argv[1], trace_cmds);
+}
+
+static int jt_trace_dump(int argc, char **argv)
+{
+	struct cYAML *err_rc = NULL;
+	int rc;
+
+	rc = check_cmd(trace_cmds, "trace", "dump", 2, argc, argv);
+	if (rc)
+		return rc;
+
+	rc = lustre_lnet_trace_dump(argv[1], -1, &err_rc);
+	if (rc != LUSTRE_CFG_RC_NO_ERR)
+		cYAML_print_tree2file(stderr, err_rc);
+
+	cYAML_free_tree(err_rc);
+
+	return rc;
+}
+
+static int jt_trace_decode(int argc, char **argv)
+{
+	struct cYAML *err_rc = NULL;
+	bool verbose = false;
+	int rc, opt;
+
+	const char *const short_options = "v";
+	static const struct option long_options[] = {
+		{ .name = "verbose", .has_arg = no_argument, .val = 'v' },
+		{ .name = NULL } };
+
+	rc = check_cmd(trace_cmds, "trace", "decode", 2, argc, argv);
+	if (rc)
+		return rc;
+
+	while ((opt = getopt_long(argc, argv, short_options,
+				   long_options, NULL)) != -1) {
+		switch (opt) {
+		case 'v':
+			verbose = true;
+			break;
+		default:
+			print_help(trace_cmds, "trace", "decode");
+			return -1;
+		}
+	}
+
+	if (optind >= argc) {
+		print_help(trace_cmds, "trace", "decode");
+		return -1;
+	}
+
+	rc = lustre_lnet_trace_decode(argv[optind], verbose, -1, &err_rc);
+	if (rc != LUSTRE_CFG_RC_NO_ERR)
+		cYAML_print_tree2file(stderr, err_rc);
+
+	cYAML_free_tree(err_rc);
+
+	return rc;
+}
+
 static int jt_set(int argc, char **argv)
 {
 	int rc;
@@ -58,7 +58,10 @@ static struct lst_sid session_id;
 static int                 session_key;
 static int lst_list_commands(int argc, char **argv);
 
-/* All nodes running 2.6.50 or later understand feature LST_FEAT_BULK_LEN */
+/* All nodes running 2.6.50 or later understand feature LST_FEAT_BULK_LEN;
+ * LST_FEAT_LATENCY needs a newer lnet_selftest, sessions that include older
+ * nodes have to be created with LST_FEATURES=1.
+ */
 static unsigned		session_features = LST_FEATS_MASK;
 static struct lstcon_trans_stat	trans_stat;
 
@@ -1486,11 +1489,12 @@ jt_lst_list_group(int argc, char **argv)
 
 int
 lst_stat_ioctl(char *name, int count, struct lnet_process_id *idsp,
-	       int timeout, struct list_head *resultp)
+	       int timeout, int type, struct list_head *resultp)
 {
 	struct lstio_stat_args args = { 0 };
 
 	args.lstio_sta_key     = session_key;
+	args.lstio_sta_type    = type;
 	args.lstio_sta_timeout = timeout;
 	args.lstio_sta_nmlen   = strlen(name);
 	args.lstio_sta_namep   = name;
@@ -1524,7 +1528,8 @@ lst_stat_req_param_free(lst_stat_req_param_t *srp)
 }
 
 static int
-lst_stat_req_param_alloc(char *name, lst_stat_req_param_t **srpp, int save_old)
+lst_stat_req_param_alloc(char *name, lst_stat_req_param_t **srpp,
+			 int save_old, int lat)
 {
         lst_stat_req_param_t *srp = NULL;
         int                   count = save_old ? 2 : 1;
@@ -1559,6 +1564,7 @@ lst_stat_req_param_alloc(char *name, lst_stat_req_param_t **srpp, int save_old)
 
 	for (i = 0; i < count; i++) {
 		rc = lst_alloc_rpcent(&srp->srp_result[i], srp->srp_count,
+				      lat ? sizeof(struct sfw_lat_counters) :
 				      sizeof(struct sfw_counters)  +
 				      sizeof(struct srpc_counters) +
 				      sizeof(struct lnet_counters_common));
@@ -1874,6 +1880,71 @@ lst_print_stat(char *name, struct list_head *resultp,
 	lst_print_lnet_stat(name, bwrt, rdwr, type, mbs);
 }
 
+/* Latency counters are read-and-clear on the remote node, so unlike
+ * lst_print_stat() no diff against the previous sample is needed.  The
+ * percentiles of a group are approximated from the per-node ones: p50 and
+ * avg are weighted by sample count, the tail is the worst node's.
+ */
+static void
+lst_print_lat(char *name, struct list_head *resultp)
+{
+	struct lstcon_rpc_ent *ent;
+	struct sfw_lat_counters *lat;
+	__u64 count = 0;
+	__u64 late = 0;
+	__u64 min = ~0ULL;
+	__u64 max = 0;
+	__u64 p99 = 0;
+	__u64 p999 = 0;
+	double avg = 0;
+	double p50 = 0;
+	int errcount = 0;
+
+	list_for_each_entry(ent, resultp, rpe_link) {
+		if (ent->rpe_peer.nid == LNET_NID_ANY)
+			continue;
+
+		if (ent->rpe_rpc_errno != 0 || ent->rpe_fwk_errno != 0) {
+			errcount++;
+			continue;
+		}
+
+		lat = (struct sfw_lat_counters *)&ent->rpe_payload[0];
+		late += lat->lat_late;
+		if (lat->lat_count == 0)
+			continue;
+
+		count += lat->lat_count;
+		avg += (double)lat->lat_avg_ns * lat->lat_count;
+		p50 += (double)lat->lat_p50_ns * lat->lat_count;
+		if (lat->lat_min_ns < min)
+			min = lat->lat_min_ns;
+		if (lat->lat_max_ns > max)
+			max = lat->lat_max_ns;
+		if (lat->lat_p99_ns > p99)
+			p99 = lat->lat_p99_ns;
+		if (lat->lat_p999_ns > p999)
+			p999 = lat->lat_p999_ns;
+	}
+
+	if (errcount > 0)
+		fprintf(stdout, "Failed to stat on %d nodes\n", errcount);
+
+	fprintf(stdout, "[Latency of %s]\n", name);
+	if (count == 0) {
+		fprintf(stdout, "No RPC completed, late: %llu\n",
+			(unsigned long long)late);
+		return;
+	}
+
+	fprintf(stdout,
+		"count: %-10llu min: %-8.1f avg: %-8.1f p50: %-8.1f "
+		"p99: %-8.1f p999: %-8.1f max: %-8.1f usec, late: %llu\n",
+		(unsigned long long)count, min / 1000.0, avg / count / 1000.0,
+		p50 / count / 1000.0, p99 / 1000.0, p999 / 1000.0,
+		max / 1000.0, (unsigned long long)late);
+}
+
 int
 jt_lst_stat(int argc, char **argv)
 {
@@ -1892,6 +1963,7 @@ jt_lst_stat(int argc, char **argv)
 	int		      rc;
 	int		      c;
 	int		      mbs     = 0; /* report as MB/s */
+	int		      lat     = 0; /* latency percentiles */
 
 	static const struct option stat_opts[] = {
 		{ .name = "timeout", .has_arg = required_argument, .val = 't' },
@@ -1907,6 +1979,7 @@ jt_lst_stat(int argc, char **argv)
 		{ .name = "min",     .has_arg = no_argument,       .val = 'n' },
 		{ .name = "max",     .has_arg = no_argument,       .val = 'x' },
 		{ .name = "mbs",     .has_arg = no_argument,       .val = 'm' },
+		{ .name = "lat",     .has_arg = no_argument,       .val = 'L' },
 		{ .name = NULL } };
 
         if (session_key == 0) {
@@ -1916,7 +1989,7 @@ jt_lst_stat(int argc, char **argv)
         }
 
         while (1) {
-		c = getopt_long(argc, argv, "t:d:lcbarwgnxm", stat_opts,
+		c = getopt_long(argc, argv, "t:d:lcbarwgnxmL", stat_opts,
 				&optidx);
 
                 if (c == -1)
@@ -1974,6 +2047,9 @@ jt_lst_stat(int argc, char **argv)
 		case 'm':
 			mbs = 1;
 			break;
+		case 'L':
+			lat = 1;
+			break;
 
 		default:
 			lst_print_usage(argv[0]);
@@ -1996,14 +2072,16 @@ jt_lst_stat(int argc, char **argv)
             return -1;
         }
 
-        /* extra count to get first data point */
-        if (count != -1)
-            count++;
+	/* extra count to get first data point, latency counters are
+	 * read-and-clear so the first sample is already meaningful
+	 */
+	if (count != -1 && !lat)
+		count++;
 
 	INIT_LIST_HEAD(&head);
 
         while (optind < argc) {
-                rc = lst_stat_req_param_alloc(argv[optind++], &srp, 1);
+		rc = lst_stat_req_param_alloc(argv[optind++], &srp, !lat, lat);
                 if (rc != 0)
                         goto out;
 
@@ -2020,14 +2098,28 @@ jt_lst_stat(int argc, char **argv)
 		last = now;
 
 		list_for_each_entry(srp, &head, srp_link) {
-                        rc = lst_stat_ioctl(srp->srp_name,
-                                            srp->srp_count, srp->srp_ids,
-                                            timeout, &srp->srp_result[idx]);
-                        if (rc == -1) {
-                                lst_print_error("stat", "Failed to stat %s: %s\n",
-                                                srp->srp_name, strerror(errno));
-                                goto out;
-                        }
+			rc = lst_stat_ioctl(srp->srp_name,
+					    srp->srp_count, srp->srp_ids,
+					    timeout, lat ? LST_STAT_LATENCY :
+							   LST_STAT_COUNTERS,
+					    &srp->srp_result[idx]);
+			if (rc == -1) {
+				if (lat && errno == EOPNOTSUPP)
+					fprintf(stderr,
+						"session was created without latency support, "
+						"re-create it with LST_FEATURES=%x\n",
+						LST_FEATS_MASK);
+				lst_print_error("stat", "Failed to stat %s: %s\n",
+						srp->srp_name, strerror(errno));
+				goto out;
+			}
+
+			if (lat) {
+				lst_print_lat(srp->srp_name,
+					      &srp->srp_result[idx]);
+				lst_reset_rpcent(&srp->srp_result[idx]);
+				continue;
+			}
 
 			lst_print_stat(srp->srp_name, srp->srp_result,
 				       idx, lnet, bwrt, rdwr, type, mbs);
@@ -2035,7 +2127,8 @@ jt_lst_stat(int argc, char **argv)
 			lst_reset_rpcent(&srp->srp_result[1 - idx]);
 		}
 
-                idx = 1 - idx;
+		if (!lat)
+			idx = 1 - idx;
 
                 if (count > 0)
                         count--;
@@ -2101,7 +2194,7 @@ jt_lst_show_error(int argc, char **argv)
 	INIT_LIST_HEAD(&head);
 
         while (optind < argc) {
-                rc = lst_stat_req_param_alloc(argv[optind++], &srp, 0);
+		rc = lst_stat_req_param_alloc(argv[optind++], &srp, 0, 0);
                 if (rc != 0)
                         goto out;
 
@@ -2109,8 +2202,9 @@ jt_lst_show_error(int argc, char **argv)
         }
 
 	list_for_each_entry(srp, &head, srp_link) {
-                rc = lst_stat_ioctl(srp->srp_name, srp->srp_count,
-                                    srp->srp_ids, 10, &srp->srp_result[0]);
+		rc = lst_stat_ioctl(srp->srp_name, srp->srp_count,
+				    srp->srp_ids, 10, LST_STAT_COUNTERS,
+				    &srp->srp_result[0]);
 
                 if (rc == -1) {
                         lst_print_error(srp->srp_name, "Failed to show errors of %s: %s\n",
@@ -3062,8 +3156,8 @@ lst_get_test_param(char *test, int argc, char **argv, void **param, int *plen)
 }
 
 int
-lst_add_test_ioctl(char *batch, int type, int loop, int concur,
-                   int dist, int span, char *sgrp, char *dgrp,
+lst_add_test_ioctl(char *batch, int type, int loop, int concur, int rate,
+		   int dist, int span, char *sgrp, char *dgrp,
 		   void *param, int plen, int *retp, struct list_head *resultp)
 {
 	struct lstio_test_args args = { 0 };
@@ -3085,6 +3179,7 @@ lst_add_test_ioctl(char *batch, int type, int loop, int concur,
         args.lstio_tes_param      = param;
         args.lstio_tes_retp       = retp;
         args.lstio_tes_resultp    = resultp;
+	args.lstio_tes_rate	  = rate;
 
         return lst_ioctl(LSTIO_TEST_ADD, &args, sizeof(args));
 }
@@ -3101,6 +3196,7 @@ jt_lst_add_test(int argc, char **argv)
 	void *param  = NULL;
 	int   optidx = 0;
 	int   concur = 1;
+	int   rate   = 0;
 	int   loop   = -1;
 	int   dist   = 1;
 	int   span   = 1;
@@ -3119,6 +3215,7 @@ jt_lst_add_test(int argc, char **argv)
 	{ .name = "from",	 .has_arg = required_argument, .val = 'f' },
 	{ .name = "to",		 .has_arg = required_argument, .val = 't' },
 	{ .name = "loop",	 .has_arg = required_argument, .val = 'l' },
+	{ .name = "rate",	 .has_arg = required_argument, .val = 'r' },
 	{ .name = NULL } };
 
         if (session_key == 0) {
@@ -3128,7 +3225,7 @@ jt_lst_add_test(int argc, char **argv)
         }
 
         while (1) {
-                c = getopt_long(argc, argv, "b:c:d:f:l:t:",
+		c = getopt_long(argc, argv, "b:c:d:f:l:r:t:",
                                 add_test_opts, &optidx);
 
                 /* Detect the end of the options. */
@@ -3151,6 +3248,9 @@ jt_lst_add_test(int argc, char **argv)
                 case 'l':
                         loop = atoi(optarg);
                         break;
+		case 'r':
+			rate = atoi(optarg);
+			break;
                 case 't':
                         to = optarg;
                         break;
@@ -3170,6 +3270,11 @@ jt_lst_add_test(int argc, char **argv)
                 return -1;
         }
 
+	if (rate < 0) {
+		fprintf(stderr, "Invalid rate of test: %d\n", rate);
+		return -1;
+	}
+
         if (batch == NULL)
                 batch = LST_DEFAULT_BATCH;
 
@@ -3214,8 +3319,8 @@ jt_lst_add_test(int argc, char **argv)
                 goto out;
         }
 
-        rc = lst_add_test_ioctl(batch, type, loop, concur,
-                                dist, span, from, to, param, plen, &ret, &head);
+	rc = lst_add_test_ioctl(batch, type, loop, concur, rate,
+				dist, span, from, to, param, plen, &ret, &head);
 
         if (rc == 0) {
                 fprintf(stdout, "Test was added successfully\n");
@@ -3263,7 +3368,7 @@ static command_t lst_cmdlist[] = {
           "Usage: lst list_group [--active] [--busy] [--down] [--unknown] GROUP ..."    },
 	{"stat",                jt_lst_stat,            NULL,
 	 "Usage: lst stat [--bw] [--rate] [--read] [--write] [--max] [--min] [--avg] "
-	 " [--mbs] [--timeout #] [--delay #] [--count #] GROUP [GROUP]"                 },
+	 " [--mbs] [--lat] [--timeout #] [--delay #] [--count #] GROUP [GROUP]"         },
         {"show_error",          jt_lst_show_error,      NULL,
          "Usage: lst show_error NAME | IDS ..."                                         },
         {"add_batch",           jt_lst_add_batch,       NULL,
@@ -3278,7 +3383,7 @@ static command_t lst_cmdlist[] = {
          "Usage: lst query [--test ID] [--server] [--timeout TIME] NAME"                },
         {"add_test",            jt_lst_add_test,        NULL,
          "Usage: lst add_test [--batch BATCH] [--loop #] [--concurrency #] "
-         " [--distribute #:#] [--from GROUP] [--to GROUP] TEST..."                      },
+	 " [--rate RPCs/s] [--distribute #:#] [--from GROUP] [--to GROUP] TEST..."    },
         {"help",                Parser_help,            0,     "help"                   },
 	{"--list-commands",     lst_list_commands,      0,     "list commands"          },
         {0,                     0,                      0,      NULL                    }
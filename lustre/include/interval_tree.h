@@ -47,7 +47,8 @@ struct interval_node {
         unsigned                in_color:1,
                                 in_intree:1, /** set if the node is in tree */
                                 in_res1:30;
-        __u8                    in_res2[4];  /** tags, 8-bytes aligned */
+	__u16			in_mask;     /** caller tag, e.g. lock mode */
+	__u16			in_max_mask; /** OR of in_mask in the subtree */
         __u64                   in_max_high;
         struct interval_node_extent {
                 __u64 start;
@@ -86,6 +87,20 @@ static inline int interval_set(struct interval_node *node,
 	return 0;
 }
 
+/* Tag @node with @mask before it is inserted. Nodes with the same extent but
+ * different masks are kept as separate nodes, and the *_mask() lookups below
+ * only report the nodes whose tag intersects the mask they are given. */
+static inline void interval_set_mask(struct interval_node *node, __u16 mask)
+{
+	node->in_mask = mask;
+	node->in_max_mask = mask;
+}
+
+static inline __u16 interval_mask(struct interval_node *node)
+{
+	return node->in_mask;
+}
+
 static inline void interval_init(struct interval_node *node)
 {
 	memset(node, 0, sizeof(*node));
@@ -107,6 +122,8 @@ typedef enum interval_iter (*interval_callback_t)(struct interval_node *node,
 
 struct interval_node *interval_insert(struct interval_node *node,
                                       struct interval_node **root);
+void interval_insert_dup(struct interval_node *node,
+			 struct interval_node **root);
 void interval_erase(struct interval_node *node, struct interval_node **root);
 
 /* Search the extents in the tree and call @func for each overlapped
@@ -115,17 +132,35 @@ enum interval_iter interval_search(struct interval_node *root,
                                    struct interval_node_extent *ex,
                                    interval_callback_t func, void *data);
 
+/* Same as interval_search(), but only the nodes whose tag intersects @mask
+ * are reported. Subtrees without such nodes are skipped entirely, so one
+ * walk of a tree holding several kinds of nodes costs no more than a walk of
+ * a tree holding only the interesting ones. A zero @mask matches all nodes. */
+enum interval_iter interval_search_mask(struct interval_node *root,
+					struct interval_node_extent *ex,
+					__u16 mask, interval_callback_t func,
+					void *data);
+
 /* Iterate every node in the tree - by reverse order or regular order. */
 enum interval_iter interval_iterate(struct interval_node *root, 
                                     interval_callback_t func, void *data);
 enum interval_iter interval_iterate_reverse(struct interval_node *root,
                                     interval_callback_t func,void *data);
+enum interval_iter interval_iterate_reverse_mask(struct interval_node *root,
+						 __u16 mask,
+						 interval_callback_t func,
+						 void *data);
 
 void interval_expand(struct interval_node *root, 
                      struct interval_node_extent *ext,
                      struct interval_node_extent *limiter);
 int interval_is_overlapped(struct interval_node *root, 
                            struct interval_node_extent *ex);
+void interval_expand_mask(struct interval_node *root,
+			  struct interval_node_extent *ext,
+			  struct interval_node_extent *limiter, __u16 mask);
+int interval_is_overlapped_mask(struct interval_node *root,
+				struct interval_node_extent *ex, __u16 mask);
 struct interval_node *interval_find(struct interval_node *root,
                                     struct interval_node_extent *ex);
 #endif
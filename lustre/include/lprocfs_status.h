@@ -355,6 +355,7 @@ enum {
         PTLRPC_REQACTIVE_CNTR,
         PTLRPC_TIMEOUT,
         PTLRPC_REQBUF_AVAIL_CNTR,
+	PTLRPC_REPLY_BUNDLE_CNTR,
         PTLRPC_LAST_CNTR
 };
 
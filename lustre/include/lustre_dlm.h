@@ -44,6 +44,7 @@
 #ifndef _LUSTRE_DLM_H__
 #define _LUSTRE_DLM_H__
 
+#include <libcfs/linux/linux-hash.h>
 #include <lustre_lib.h>
 #include <lustre_net.h>
 #include <lustre_import.h>
@@ -68,6 +69,9 @@ extern struct kset *ldlm_svc_kset;
  * client shows interest in that lock, e.g. glimpse is occured. */
 #define LDLM_DIRTY_AGE_LIMIT (10)
 #define LDLM_DEFAULT_PARALLEL_AST_LIMIT 1024
+/* locks of one client carried by a single blocking AST RPC */
+#define LDLM_DEFAULT_BL_AST_BATCH	64
+#define LDLM_MAX_BL_AST_BATCH		512
 
 /**
  * LDLM non-error return states
@@ -264,6 +268,13 @@ struct ldlm_pool {
 	struct ldlm_pool_ops	*pl_ops;
 	/** Number of planned locks for next period. */
 	int			pl_grant_plan;
+	/** Server: scale of the lock budget, LDLM_POOL_BUDGET_SCALE is 1.
+	 *  Protected by pl_lock. */
+	int			pl_budget_scale;
+	/** Server: number of exports holding locks in this pool. */
+	atomic_t		pl_budget_exports;
+	/** Client: lock budget given by the server, 0 if none. */
+	__u32			pl_budget;
 	/** Pool statistics. */
 	struct lprocfs_stats	*pl_stats;
 
@@ -329,15 +340,21 @@ struct ldlm_ns_bucket {
 	 * fact the network or overall system load is at fault
 	 */
 	struct adaptive_timeout     nsb_at_estimate;
-	/**
-	 * Which res in the bucket should we start with the reclaim.
-	 */
-	int			    nsb_reclaim_start;
+	/** Number of resources hashed to this bucket */
+	atomic_t		    nsb_count;
 };
 
 enum {
 	/** LDLM namespace lock stats */
 	LDLM_NSS_LOCKS          = 0,
+	/** ldlm_resource_get() calls */
+	LDLM_NSS_RES_LOOKUPS,
+	/** resources created by ldlm_resource_get() */
+	LDLM_NSS_RES_CREATES,
+	/** inserts that lost the race against another thread */
+	LDLM_NSS_RES_RACES,
+	/** lookups that found a resource being freed and had to retry */
+	LDLM_NSS_RES_RETRIES,
 	LDLM_NSS_LAST
 };
 
@@ -351,6 +368,36 @@ enum ldlm_ns_type {
 	LDLM_NS_TYPE_MGT,		/**< MGT namespace */
 };
 
+/**
+ * Replacement policy of the client lock LRU.
+ */
+enum ldlm_lru_policy {
+	/** cancel the least recently used locks first */
+	LDLM_LRU_POLICY_LRU = 0,
+	/**
+	 * 2Q: locks used once are cancelled before the locks which were
+	 * taken again from the LRU, the latter are kept in the protected
+	 * part of the LRU, up to LDLM_LRU_PROTECTED_PCT of it
+	 */
+	LDLM_LRU_POLICY_2Q,
+};
+
+#define LDLM_LRU_PROTECTED_PCT	75
+
+/** Client lock LRU statistics, protected by ns_lock */
+struct ldlm_lru_stats {
+	/** locks put in the LRU */
+	__u64	ls_inserts;
+	/** locks taken back from the LRU for reuse */
+	__u64	ls_hits;
+	/** locks moved to, and pushed out of the protected part of the LRU */
+	__u64	ls_promotions;
+	__u64	ls_demotions;
+	/** locks cancelled from the LRU, never reused or reused */
+	__u64	ls_cancel_once;
+	__u64	ls_cancel_reused;
+};
+
 /**
  * LDLM Namespace.
  *
@@ -379,11 +426,33 @@ struct ldlm_namespace {
 	/** Flag indicating if namespace is on client instead of server */
 	enum ldlm_side		ns_client;
 
+	/** What the namespace is for, see ldlm_namespace_new() */
+	enum ldlm_ns_type	ns_type;
+
 	/** name of this namespace */
 	char			*ns_name;
 
-	/** Resource hash table for namespace. */
-	struct cfs_hash		*ns_rs_hash;
+	/**
+	 * Resource hash table for namespace. Lookups are done under RCU
+	 * and the table is resized on the fly as resources come and go.
+	 */
+	struct rhashtable	ns_rs_hash;
+
+	/**
+	 * Per-bucket state (AT estimate, resource count) for resources,
+	 * indexed by a hash of the resource name. Unlike the buckets of
+	 * ns_rs_hash these never move, so resources can point at them.
+	 */
+	struct ldlm_ns_bucket	*ns_rs_buckets;
+	/** log2 of the number of ns_rs_buckets */
+	unsigned int		ns_rs_bucket_bits;
+
+	/**
+	 * Blocked flock requests keyed by owner and client nid, that is
+	 * the waits-for graph walked by flock deadlock detection. Only
+	 * for MDT namespaces.
+	 */
+	struct cfs_hash		*ns_flock_waiters;
 
 	/** serialize */
 	spinlock_t		ns_lock;
@@ -423,6 +492,18 @@ struct ldlm_namespace {
 	/** Number of locks in the LRU list above */
 	int			ns_nr_unused;
 	struct list_head	*ns_last_pos;
+	/**
+	 * LRU replacement policy. With LDLM_LRU_POLICY_2Q the protected
+	 * locks are kept in ns_lru_protected, the others in ns_unused_list.
+	 * Both lists are in the order of l_last_used and are scanned one
+	 * after the other, ns_protected_pos is ns_last_pos of the former.
+	 */
+	enum ldlm_lru_policy	ns_lru_policy;
+	struct list_head	ns_lru_protected;
+	struct list_head	*ns_protected_pos;
+	/** Number of locks in ns_lru_protected, counted in ns_nr_unused */
+	int			ns_nr_protected;
+	struct ldlm_lru_stats	ns_lru_stats;
 
 	/**
 	 * Maximum number of locks permitted in the LRU. If 0, means locks
@@ -509,6 +590,18 @@ struct ldlm_namespace {
 	/** Limit of parallel AST RPC count. */
 	unsigned		ns_max_parallel_ast;
 
+	/** Max locks of one client sent in a blocking AST, 1 to disable */
+	unsigned int		ns_max_bl_ast_batch;
+	/** Multi-lock blocking AST RPCs sent and the locks they carried */
+	atomic64_t		ns_bl_ast_batch_rpcs;
+	atomic64_t		ns_bl_ast_batch_locks;
+
+	/** Last ibits_bench run: locks per queue, and ns per enqueue check
+	 * walking the queues and with the resource indexed */
+	unsigned int		ns_ibits_bench_locks;
+	__u64			ns_ibits_bench_walk_ns;
+	__u64			ns_ibits_bench_indexed_ns;
+
 	/**
 	 * Callback to check if a lock is good to be canceled by ELC or
 	 * during recovery.
@@ -525,7 +618,7 @@ struct ldlm_namespace {
 	unsigned		ns_stopping:1;
 
 	/**
-	 * Which bucket should we start with the lock reclaim.
+	 * Which resource should we start with the lock reclaim.
 	 */
 	int			ns_reclaim_start;
 
@@ -620,11 +713,18 @@ struct ldlm_cb_set_arg {
 	ptlrpc_interpterer_t		 gl_interpret_reply;
 	void				*gl_interpret_data;
 	struct ldlm_bl_desc		*bl_desc;
+	/* locks of the same client blocked by the same lock, which may be
+	 * sent in the blocking AST of the lock being processed */
+	struct list_head		*bl_batch;
 };
 
 struct ldlm_cb_async_args {
 	struct ldlm_cb_set_arg	*ca_set_arg;
 	struct ldlm_lock	*ca_lock;
+	/* other locks carried by a batched blocking AST */
+	struct ldlm_lock	**ca_batch;
+	int			 ca_batch_count;
+	int			 ca_batch_size;
 };
 
 /** The ldlm_glimpse_work was slab allocated & must be freed accordingly.*/
@@ -641,13 +741,14 @@ struct ldlm_interval {
 /**
  * Interval tree for extent locks.
  * The interval tree must be accessed under the resource lock.
- * Interval trees are used for granted extent locks to speed up conflicts
- * lookup. See ldlm/interval_tree.c for more details.
+ * The interval tree is used for granted extent locks to speed up conflicts
+ * lookup. Locks of all modes share one tree, each node is tagged with the
+ * granted mode of its locks so that the locks conflicting with a request
+ * are found in a single walk. See ldlm/interval_tree.c for more details.
  */
 struct ldlm_interval_tree {
-	/** Tree size. */
-	int			lit_size;
-	enum ldlm_mode		lit_mode;  /* lock mode */
+	/** Number of granted locks of each mode. */
+	int			lit_size[LCK_MODE_NUM];
 	struct interval_node	*lit_root; /* actual ldlm_interval */
 };
 
@@ -666,9 +767,10 @@ struct ldlm_flock {
 	__u64 start;
 	__u64 end;
 	__u64 owner;
+	/* edge of the waits-for graph while the request is blocked: the
+	 * owner and client nid of the first lock it conflicts with */
 	__u64 blocking_owner;
-	struct obd_export *blocking_export;
-	atomic_t blocking_refs;
+	lnet_nid_t blocking_nid;
 	__u32 pid;
 };
 
@@ -740,6 +842,13 @@ struct ldlm_lock {
 	 * Protected by ns_lock in struct ldlm_namespace.
 	 */
 	struct list_head	l_lru;
+	/**
+	 * Number of times the lock was taken back from the LRU, and whether
+	 * it is in the protected part of the LRU.
+	 * Protected by ns_lock in struct ldlm_namespace.
+	 */
+	unsigned int		l_lru_hits;
+	unsigned int		l_lru_protected;
 	/**
 	 * Linkage to resource's lock queues according to current lock state.
 	 * (could be granted or waiting)
@@ -747,7 +856,7 @@ struct ldlm_lock {
 	 */
 	struct list_head	l_res_link;
 	/**
-	 * Tree node for ldlm_extent.
+	 * Tree node for ldlm_extent and ldlm_flock.
 	 */
 	struct ldlm_interval	*l_tree_node;
 	/**
@@ -755,11 +864,20 @@ struct ldlm_lock {
 	 * Protected by per-bucket exp->exp_lock_hash locks.
 	 */
 	struct hlist_node	l_exp_hash;
-	/**
-	 * Per export hash of flock locks.
-	 * Protected by per-bucket exp->exp_flock_hash locks.
-	 */
-	struct hlist_node	l_exp_flock_hash;
+	union {
+		/**
+		 * Namespace hash of blocked flock requests, for deadlock
+		 * detection.
+		 * Protected by per-bucket ns->ns_flock_waiters locks.
+		 */
+		struct hlist_node	l_flock_waiter_hash;
+		/**
+		 * Per export hash of the first granted flock lock of each
+		 * owner on a resource.
+		 * Protected by per-bucket exp->exp_flock_hash locks.
+		 */
+		struct hlist_node	l_exp_flock_hash;
+	};
 	/**
 	 * Requested mode.
 	 * Protected by lr_lock.
@@ -795,6 +913,11 @@ struct ldlm_lock {
 	 * to clients. Used server-side.
 	 */
 	struct obd_export	*l_export;
+	/**
+	 * Whether the lock is counted in the granted locks of l_export.
+	 * Protected by lr_lock.
+	 */
+	bool			l_export_counted;
 	/**
 	 * Lock connection export.
 	 * Pointer to server export on a client.
@@ -928,6 +1051,13 @@ struct ldlm_lock {
 	 */
 	struct list_head	l_sl_mode;
 	struct list_head	l_sl_policy;
+	/**
+	 * Protected by lr_lock. For an IBITS lock on an indexed resource,
+	 * the per-bit counters of its queue and mode which it was counted
+	 * in, and the bits it was counted with.
+	 */
+	__u32			*l_ibits_counts;
+	__u64			l_ibits_counted;
 
 	/** Reference tracking structure to debug leaked locks. */
 	struct lu_ref		l_reference;
@@ -965,6 +1095,17 @@ struct lustre_handle_array {
 	struct lustre_handle	ha_handles[0];
 };
 
+/**
+ * Number of locks on each queue of an IBITS resource, per lock mode and
+ * per inodebit. Built for a resource once its queues get long so that
+ * ldlm_inodebits_compat_queue() can tell a queue has nothing in it that
+ * conflicts with a request without walking it.
+ */
+struct ldlm_ibits_queues {
+	__u32	liq_granted[LCK_MODE_NUM][MDS_INODELOCK_NUMBITS];
+	__u32	liq_waiting[LCK_MODE_NUM][MDS_INODELOCK_NUMBITS];
+};
+
 /**
  * LDLM resource description.
  * Basically, resource is a representation for a single object.
@@ -979,11 +1120,10 @@ struct lustre_handle_array {
 struct ldlm_resource {
 	struct ldlm_ns_bucket	*lr_ns_bucket;
 
-	/**
-	 * List item for list in namespace hash.
-	 * protected by ns_lock
-	 */
-	struct hlist_node	lr_hash;
+	/** Linkage into the namespace resource hash ns_rs_hash */
+	struct rhash_head	lr_hash;
+	/** Resources are freed after an RCU grace period, see lookup */
+	struct rcu_head		lr_rcu;
 
 	/** Reference count for this resource */
 	atomic_t		lr_refcount;
@@ -1006,10 +1146,14 @@ struct ldlm_resource {
 	struct ldlm_res_id	lr_name;
 
 	/**
-	 * Interval trees (only for extent locks) for all modes of this resource
+	 * Interval tree of granted locks for all modes of this resource,
+	 * only for extent and flock locks
 	 */
 	struct ldlm_interval_tree *lr_itree;
 
+	/** Per mode and bit lock counts, only for long IBITS queues */
+	struct ldlm_ibits_queues *lr_ibits_queues;
+
 	union {
 		/**
 		 * When the resource was considered as contended,
@@ -1293,6 +1437,8 @@ int ldlm_resource_foreach(struct ldlm_resource *res, ldlm_iterator_t iter,
 			  void *closure);
 void ldlm_namespace_foreach(struct ldlm_namespace *ns, ldlm_iterator_t iter,
 			    void *closure);
+void ldlm_namespace_foreach_res(struct ldlm_namespace *ns,
+				ldlm_res_iterator_t iter, void *arg);
 int ldlm_resource_iterate(struct ldlm_namespace *, const struct ldlm_res_id *,
 			  ldlm_iterator_t iter, void *data);
 /** @} ldlm_iterator */
@@ -1684,6 +1830,8 @@ int ldlm_cli_cancel_list(struct list_head *head, int count,
 int ldlm_inodebits_drop(struct ldlm_lock *lock, __u64 to_drop);
 int ldlm_cli_dropbits(struct ldlm_lock *lock, __u64 drop_bits);
 int ldlm_cli_dropbits_list(struct list_head *converts, __u64 drop_bits);
+int ldlm_cli_extent_convert(struct ldlm_lock *lock,
+			    const struct ldlm_lock_desc *bl);
 
 /** @} ldlm_cli_api */
 
@@ -1747,6 +1895,9 @@ __u32 ldlm_pool_get_lvf(struct ldlm_pool *pl);
 __u64 ldlm_pool_get_slv(struct ldlm_pool *pl);
 __u64 ldlm_pool_get_clv(struct ldlm_pool *pl);
 __u32 ldlm_pool_get_limit(struct ldlm_pool *pl);
+__u32 ldlm_pool_get_budget(struct ldlm_pool *pl);
+int ldlm_export_lock_budget(struct obd_export *exp);
+void ldlm_pool_add_export(struct ldlm_lock *lock);
 void ldlm_pool_set_slv(struct ldlm_pool *pl, __u64 slv);
 void ldlm_pool_set_clv(struct ldlm_pool *pl, __u64 clv);
 void ldlm_pool_set_limit(struct ldlm_pool *pl, __u32 limit);
@@ -200,6 +200,9 @@ struct obd_export {
 	/** Number of queued replay requests to be processes */
 	atomic_t		exp_replay_count;
 	atomic_t		exp_locks_count; /** Lock references */
+	/** Number of locks granted to this export and counted by the
+	 * namespace pool, used to work out its lock budget */
+	atomic_t		exp_pool_granted;
 #if LUSTRE_TRACKS_LOCK_EXP_REFS
 	struct list_head	exp_locks_list;
 	spinlock_t		exp_locks_list_guard;
@@ -237,8 +240,8 @@ struct obd_export {
 	/** Hash list of all ldlm locks granted on this export */
 	struct cfs_hash		 *exp_lock_hash;
 	/**
-	 * Hash list for Posix lock deadlock detection, added with
-	 * ldlm_lock::l_exp_flock_hash.
+	 * Hash of the first granted Posix lock of each owner on a resource,
+	 * added with ldlm_lock::l_exp_flock_hash.
 	 */
 	struct cfs_hash	       *exp_flock_hash;
 	struct list_head	exp_outstanding_replies;
@@ -384,6 +387,15 @@ static inline int imp_connect_lru_resize(struct obd_import *imp)
         return !!(ocd->ocd_connect_flags & OBD_CONNECT_LRU_RESIZE);
 }
 
+static inline int imp_connect_lock_budget(struct obd_import *imp)
+{
+	struct obd_connect_data *ocd;
+
+	LASSERT(imp != NULL);
+	ocd = &imp->imp_connect_data;
+	return !!(ocd->ocd_connect_flags2 & OBD_CONNECT2_LOCK_BUDGET);
+}
+
 static inline int exp_connect_layout(struct obd_export *exp)
 {
 	return !!(exp_connect_flags(exp) & OBD_CONNECT_LAYOUTLOCK);
@@ -464,6 +476,21 @@ static inline int exp_connect_lock_convert(struct obd_export *exp)
 	return !!(exp_connect_flags2(exp) & OBD_CONNECT2_LOCK_CONVERT);
 }
 
+static inline int exp_connect_batch_bl_ast(struct obd_export *exp)
+{
+	return !!(exp_connect_flags2(exp) & OBD_CONNECT2_BATCH_BL_AST);
+}
+
+static inline int exp_connect_lock_budget(struct obd_export *exp)
+{
+	return !!(exp_connect_flags2(exp) & OBD_CONNECT2_LOCK_BUDGET);
+}
+
+static inline int exp_connect_extent_convert(struct obd_export *exp)
+{
+	return !!(exp_connect_flags2(exp) & OBD_CONNECT2_EXTENT_CONVERT);
+}
+
 extern struct obd_export *class_conn2export(struct lustre_handle *conn);
 
 static inline int exp_connect_archive_id_array(struct obd_export *exp)
@@ -534,6 +534,8 @@ struct ptlrpc_connection {
 	struct obd_uuid         c_remote_uuid;
 	/** reference counter for this connection */
 	atomic_t            c_refcount;
+	/** CPT LNet uses for traffic to c_peer, for ptlrpcd affinity */
+	int			c_cpt;
 };
 
 /** Client definition for PortalRPC */
@@ -777,6 +779,8 @@ struct ptlrpc_cli_req {
 	time64_t			 cr_delay_limit;
 	/** time request was first queued */
 	time64_t			 cr_queued_time;
+	/** time request was handed to a ptlrpcd thread */
+	ktime_t				 cr_pc_queued_ns;
 	/** request sent in nanoseconds */
 	ktime_t				 cr_sent_ns;
 	/** time for request really sent out */
@@ -826,6 +830,8 @@ struct ptlrpc_cli_req {
 	void				*cr_cb_data;
 	/** Link to the imp->imp_unreplied_list */
 	struct list_head		 cr_unreplied_list;
+	/** Link to the xid hash for replies delivered in a bundle */
+	struct hlist_node		 cr_bundle_hnode;
 	/**
 	 * Commit callback, called when request is committed and about to be
 	 * freed.
@@ -1720,6 +1726,11 @@ struct ptlrpc_service {
         unsigned                        srv_is_stopping:1;
 	/** Whether or not to restrict service threads to CPUs in this CPT */
 	unsigned			srv_cpt_bind:1;
+	/**
+	 * how long (usec) a small reply may wait to be coalesced with other
+	 * replies to the same client, 0 disables reply bundling
+	 */
+	unsigned int			srv_rep_bundle_usec;
 
 	/** max # request buffers */
 	int				srv_nrqbds_max;
@@ -1929,6 +1940,14 @@ struct ptlrpcd_ctl {
 	 * Error code if the thread failed to fully start.
 	 */
 	int				pc_error;
+	/**
+	 * Number of requests taken from partners' queues.
+	 */
+	atomic64_t			pc_stolen;
+	/**
+	 * Time (usec, log2) requests waited before this thread took them.
+	 */
+	struct obd_histogram		pc_queue_hist;
 };
 
 /* Bits for pc_flags */
@@ -2008,6 +2027,8 @@ extern void reply_in_callback(struct lnet_event *ev);
 extern void client_bulk_callback(struct lnet_event *ev);
 extern void request_in_callback(struct lnet_event *ev);
 extern void reply_out_callback(struct lnet_event *ev);
+extern void reply_bundle_in_callback(struct lnet_event *ev);
+extern void reply_bundle_out_callback(struct lnet_event *ev);
 #ifdef HAVE_SERVER_SUPPORT
 extern void server_bulk_callback(struct lnet_event *ev);
 #endif
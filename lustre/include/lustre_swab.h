@@ -54,6 +54,8 @@ void lustre_swab_orphan_ent(struct lu_orphan_ent *ent);
 void lustre_swab_orphan_ent_v2(struct lu_orphan_ent_v2 *ent);
 void lustre_swab_orphan_ent_v3(struct lu_orphan_ent_v3 *ent);
 void lustre_swab_ptlrpc_body(struct ptlrpc_body *pb);
+void lustre_swab_ptlrpc_bundle_hdr(struct ptlrpc_bundle_hdr *pbh);
+void lustre_swab_ptlrpc_bundle_ent(struct ptlrpc_bundle_ent *pbe);
 void lustre_swab_connect(struct obd_connect_data *ocd);
 void lustre_swab_hsm_user_state(struct hsm_user_state *hus);
 void lustre_swab_hsm_state_set(struct hsm_state_set *hss);
@@ -325,6 +325,13 @@ struct client_obd {
 	unsigned long		*cl_mod_tag_bitmap;
 	struct obd_histogram	 cl_mod_rpcs_hist;
 
+	/* identical read-only intents in flight, see mdc_intent_lock() */
+	spinlock_t		 cl_intent_lock;
+	struct list_head	 cl_intent_list;
+	unsigned int		 cl_intent_dedup:1;
+	__u64			 cl_intent_dedup_waits;
+	__u64			 cl_intent_dedup_hits;
+
         /* mgc datastruct */
 	struct mutex		  cl_mgc_mutex;
 	struct local_oid_storage *cl_mgc_los;
@@ -730,6 +737,13 @@ struct obd_device {
 	rwlock_t			obd_pool_lock;
 	__u64				obd_pool_slv;
 	int				obd_pool_limit;
+	/**
+	 * Lock budget. On the server these are the fair share of the pool
+	 * limit and the scale applied to what each export holds, on the
+	 * client the budget granted by the server (0 if none).
+	 */
+	int				obd_pool_budget;
+	int				obd_pool_budget_scale;
 
 	int				obd_conn_inprogress;
 
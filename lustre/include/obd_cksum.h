@@ -134,6 +134,20 @@ int obd_page_dif_generate_buffer(const char *obd_name, struct page *page,
 				 __u16 *guard_start, int guard_number,
 				 int *used_number, int sector_size,
 				 obd_dif_csum_fn *fn);
+
+/* one page of a bulk RPC to generate guard tags for */
+struct obd_dif_page {
+	struct page	*odp_page;
+	__u32		 odp_offset;
+	__u32		 odp_len;
+	__u16		*odp_guards;
+};
+
+bool obd_dif_parallel(int npages);
+int obd_dif_generate_pages(const char *obd_name, struct obd_dif_page *pages,
+			   int npages, int sector_size, obd_dif_csum_fn *fn);
+int obd_dif_init(void);
+void obd_dif_fini(void);
 /*
  * If checksum type is one T10 checksum types, init the csum_fn and sector
  * size. Otherwise, init them to NULL/zero.
@@ -132,6 +132,7 @@ extern "C" {
 #define SEQ_DATA_PORTAL                31
 #define SEQ_CONTROLLER_PORTAL          32
 #define MGS_BULK_PORTAL                33
+#define REPLY_BUNDLE_PORTAL            34
 /* #define DVS_PORTAL			63 */
 /* reserved for Cray DVS - spitzcor@cray.com, roe@cray.com, n8851@cray.com */
 
@@ -599,6 +600,8 @@ enum lustre_msghdr {
 					 * in early reply messages */
 	MSGHDR_CKSUM_INCOMPAT18	= 0x2,	/* compat for 1.8, needs to be set well
 					 * beyond 2.8.0 for compatibility */
+	MSGHDR_REPLY_BUNDLE	= 0x4,	/* client accepts this reply packed in
+					 * a bundle on REPLY_BUNDLE_PORTAL */
 };
 
 #define lustre_msg lustre_msg_v2
@@ -621,6 +624,29 @@ struct lustre_msg_v2 {
 	 */
 };
 
+/*
+ * Several small replies to the same client may be coalesced by the server
+ * into one LNet message sent to REPLY_BUNDLE_PORTAL.  The message starts
+ * with a ptlrpc_bundle_hdr followed by pbh_count entries, each one being a
+ * ptlrpc_bundle_ent immediately followed by pbe_len bytes of reply data
+ * (exactly what would have been PUT into the request's reply buffer at
+ * offset pbe_offset), padded to a multiple of 8 bytes.
+ */
+#define PTLRPC_BUNDLE_MAGIC		0x0BD0B0DE
+#define PTLRPC_BUNDLE_MAGIC_SWABBED	0xDEB0D00B
+
+struct ptlrpc_bundle_hdr {
+	__u32 pbh_magic;	/* PTLRPC_BUNDLE_MAGIC */
+	__u32 pbh_count;	/* number of replies in this bundle */
+	__u64 pbh_padding;	/* unused */
+};
+
+struct ptlrpc_bundle_ent {
+	__u64 pbe_xid;		/* xid of the request being replied */
+	__u32 pbe_offset;	/* offset of the reply in the reply buffer */
+	__u32 pbe_len;		/* length of the reply data */
+};
+
 /* ptlrpc_body packet pb_types */
 #define PTL_RPC_MSG_REQUEST	4711	/* normal RPC request message */
 #define PTL_RPC_MSG_ERR		4712	/* error reply if request unprocessed */
@@ -840,6 +866,9 @@ struct ptlrpc_body_v2 {
 #define OBD_CONNECT2_PCC		0x1000ULL /* Persistent Client Cache */
 #define OBD_CONNECT2_PLAIN_LAYOUT	0x2000ULL /* Plain Directory Layout */
 #define OBD_CONNECT2_ASYNC_DISCARD	0x4000ULL /* support async DoM data discard */
+#define OBD_CONNECT2_BATCH_BL_AST	0x8000ULL /* multi-lock blocking ASTs */
+#define OBD_CONNECT2_LOCK_BUDGET	0x10000ULL /* per-client lock budget */
+#define OBD_CONNECT2_EXTENT_CONVERT	0x20000ULL /* extent lock convert */
 
 /* XXX README XXX:
  * Please DO NOT add flag values here before first ensuring that this same
@@ -900,7 +929,9 @@ struct ptlrpc_body_v2 {
 				OBD_CONNECT2_SELINUX_POLICY | \
 				OBD_CONNECT2_LSOM | \
 				OBD_CONNECT2_ASYNC_DISCARD | \
-				OBD_CONNECT2_PCC)
+				OBD_CONNECT2_PCC | \
+				OBD_CONNECT2_BATCH_BL_AST | \
+				OBD_CONNECT2_LOCK_BUDGET)
 
 #define OST_CONNECT_SUPPORTED  (OBD_CONNECT_SRVLOCK | OBD_CONNECT_GRANT | \
 				OBD_CONNECT_REQPORTAL | OBD_CONNECT_VERSION | \
@@ -921,7 +952,10 @@ struct ptlrpc_body_v2 {
 				OBD_CONNECT_GRANT_PARAM | \
 				OBD_CONNECT_SHORTIO | OBD_CONNECT_FLAGS2)
 
-#define OST_CONNECT_SUPPORTED2 OBD_CONNECT2_LOCKAHEAD
+#define OST_CONNECT_SUPPORTED2 (OBD_CONNECT2_LOCKAHEAD | \
+				OBD_CONNECT2_BATCH_BL_AST | \
+				OBD_CONNECT2_LOCK_BUDGET | \
+				OBD_CONNECT2_EXTENT_CONVERT)
 
 #define ECHO_CONNECT_SUPPORTED (OBD_CONNECT_FID)
 #define ECHO_CONNECT_SUPPORTED2 0
@@ -100,15 +100,43 @@ static inline int extent_overlapped(struct interval_node_extent *e1,
 	return (e1->start <= e2->end) && (e2->start <= e1->end);
 }
 
+/* nodes with the same extent are ordered by their tag */
 static inline int node_compare(struct interval_node *n1,
 			       struct interval_node *n2)
 {
-	return extent_compare(&n1->in_extent, &n2->in_extent);
+	int rc = extent_compare(&n1->in_extent, &n2->in_extent);
+
+	if (rc == 0 && n1->in_mask != n2->in_mask)
+		rc = n1->in_mask < n2->in_mask ? -1 : 1;
+	return rc;
 }
 
 int node_equal(struct interval_node *n1, struct interval_node *n2)
 {
-	return extent_equal(&n1->in_extent, &n2->in_extent);
+	return extent_equal(&n1->in_extent, &n2->in_extent) &&
+	       n1->in_mask == n2->in_mask;
+}
+
+/* does @node itself, or anything in its subtree, carry a tag from @mask */
+static inline int node_match(struct interval_node *node, __u16 mask)
+{
+	return mask == 0 || (node->in_mask & mask);
+}
+
+static inline int node_may_match(struct interval_node *node, __u16 mask)
+{
+	return mask == 0 || (node->in_max_mask & mask);
+}
+
+static inline __u16 node_subtree_mask(struct interval_node *node)
+{
+	__u16 mask = node->in_mask;
+
+	if (node->in_left)
+		mask |= node->in_left->in_max_mask;
+	if (node->in_right)
+		mask |= node->in_right->in_max_mask;
+	return mask;
 }
 
 static inline __u64 max_u64(__u64 x, __u64 y)
@@ -218,6 +246,80 @@ enum interval_iter interval_iterate_reverse(struct interval_node *root,
 }
 EXPORT_SYMBOL(interval_iterate_reverse);
 
+/* the rightmost node of the subtree tagged with @mask */
+static struct interval_node *interval_last_mask(struct interval_node *node,
+						__u16 mask)
+{
+	while (node && node_may_match(node, mask)) {
+		if (node->in_right && node_may_match(node->in_right, mask)) {
+			node = node->in_right;
+			continue;
+		}
+		if (node_match(node, mask))
+			return node;
+		node = node->in_left;
+	}
+	return NULL;
+}
+
+/* the leftmost node of the subtree tagged with @mask */
+static struct interval_node *interval_first_mask(struct interval_node *node,
+						 __u16 mask)
+{
+	while (node && node_may_match(node, mask)) {
+		if (node->in_left && node_may_match(node->in_left, mask)) {
+			node = node->in_left;
+			continue;
+		}
+		if (node_match(node, mask))
+			return node;
+		node = node->in_right;
+	}
+	return NULL;
+}
+
+static struct interval_node *interval_prev_mask(struct interval_node *node,
+						__u16 mask)
+{
+	struct interval_node *prev;
+
+	while (node) {
+		prev = interval_last_mask(node->in_left, mask);
+		if (prev)
+			return prev;
+
+		while (node->in_parent && node_is_left_child(node))
+			node = node->in_parent;
+		node = node->in_parent;
+		if (node && node_match(node, mask))
+			return node;
+	}
+	return NULL;
+}
+
+/* Like interval_iterate_reverse(), but only the nodes tagged with @mask are
+ * visited, and the subtrees without such nodes are not walked at all. */
+enum interval_iter interval_iterate_reverse_mask(struct interval_node *root,
+						 __u16 mask,
+						 interval_callback_t func,
+						 void *data)
+{
+	struct interval_node *node;
+	enum interval_iter rc = INTERVAL_ITER_CONT;
+
+	ENTRY;
+
+	for (node = interval_last_mask(root, mask); node != NULL;
+	     node = interval_prev_mask(node, mask)) {
+		rc = func(node, data);
+		if (rc == INTERVAL_ITER_STOP)
+			break;
+	}
+
+	RETURN(rc);
+}
+EXPORT_SYMBOL(interval_iterate_reverse_mask);
+
 /* try to find a node with same interval in the tree,
  * if found, return the pointer to the node, otherwise return NULL
  */
@@ -249,10 +351,12 @@ static void __rotate_change_maxhigh(struct interval_node *node,
 	__u64 left_max, right_max;
 
 	rotate->in_max_high = node->in_max_high;
+	rotate->in_max_mask = node->in_max_mask;
 	left_max = node->in_left ? node->in_left->in_max_high : 0;
 	right_max = node->in_right ? node->in_right->in_max_high : 0;
 	node->in_max_high  = max_u64(interval_high(node),
 				     max_u64(left_max, right_max));
+	node->in_max_mask = node_subtree_mask(node);
 }
 
 /* The left rotation "pivots" around the link from node to node->right, and
@@ -383,8 +487,9 @@ static void interval_insert_color(struct interval_node *node,
 	EXIT;
 }
 
-struct interval_node *interval_insert(struct interval_node *node,
-                                      struct interval_node **root)
+static struct interval_node *__interval_insert(struct interval_node *node,
+					       struct interval_node **root,
+					       int unique)
 {
 	struct interval_node **p, *parent = NULL;
 
@@ -394,16 +499,17 @@ struct interval_node *interval_insert(struct interval_node *node,
 	p = root;
         while (*p) {
                 parent = *p;
-                if (node_equal(parent, node))
+                if (unique && node_equal(parent, node))
                         RETURN(parent);
 
                 /* max_high field must be updated after each iteration */
                 if (parent->in_max_high < interval_high(node))
                         parent->in_max_high = interval_high(node);
+		parent->in_max_mask |= node->in_mask;
 
                 if (node_compare(node, parent) < 0)
                         p = &parent->in_left;
-                else 
+                else
                         p = &parent->in_right;
         }
 
@@ -411,6 +517,7 @@ struct interval_node *interval_insert(struct interval_node *node,
 	node->in_parent = parent;
 	node->in_color = INTERVAL_RED;
 	node->in_left = node->in_right = NULL;
+	node->in_max_mask = node->in_mask;
 	*p = node;
 
 	interval_insert_color(node, root);
@@ -418,8 +525,26 @@ struct interval_node *interval_insert(struct interval_node *node,
 
 	RETURN(NULL);
 }
+
+struct interval_node *interval_insert(struct interval_node *node,
+				      struct interval_node **root)
+{
+	return __interval_insert(node, root, 1);
+}
 EXPORT_SYMBOL(interval_insert);
 
+/*
+ * Insert @node even if a node with the same extent and mask is already in
+ * the tree, for users which need one node per object because they change
+ * the extent of single objects in place (erase, interval_set, insert).
+ */
+void interval_insert_dup(struct interval_node *node,
+			 struct interval_node **root)
+{
+	__interval_insert(node, root, 0);
+}
+EXPORT_SYMBOL(interval_insert_dup);
+
 static inline int node_is_black_or_0(struct interval_node *node)
 {
 	return !node || node_is_black(node);
@@ -508,10 +633,11 @@ static void interval_erase_color(struct interval_node *node,
 
 /*
  * if the @max_high value of @node is changed, this function traverse a path
- * from node  up to the root to update max_high for the whole tree.
+ * from node  up to the root to update max_high and max_mask for the whole
+ * tree. @old_maxhigh and @old_mask describe the subtree that was removed.
  */
 static void update_maxhigh(struct interval_node *node,
-			   __u64  old_maxhigh)
+			   __u64  old_maxhigh, __u16 old_mask)
 {
 	__u64 left_max, right_max;
 
@@ -522,8 +648,10 @@ static void update_maxhigh(struct interval_node *node,
 		right_max = node->in_right ? node->in_right->in_max_high : 0;
 		node->in_max_high = max_u64(interval_high(node),
 					    max_u64(left_max, right_max));
+		node->in_max_mask = node_subtree_mask(node);
 
-		if (node->in_max_high >= old_maxhigh)
+		if (node->in_max_high >= old_maxhigh &&
+		    (node->in_max_mask & old_mask) == old_mask)
 			break;
 		node = node->in_parent;
 	}
@@ -576,10 +704,12 @@ void interval_erase(struct interval_node *node,
 		old->in_left->in_parent = node;
 		if (old->in_right)
 			old->in_right->in_parent = node;
-		update_maxhigh(child ? : parent, node->in_max_high);
-		update_maxhigh(node, old->in_max_high);
+		/* @old is out of the tree, don't walk up from it */
 		if (parent == old)
 			parent = node;
+		update_maxhigh(child ? : parent, node->in_max_high,
+			       node->in_max_mask);
+		update_maxhigh(node, old->in_max_high, old->in_max_mask);
 		goto color;
 	}
 	parent = node->in_parent;
@@ -596,7 +726,7 @@ void interval_erase(struct interval_node *node,
 		*root = child;
 	}
 
-	update_maxhigh(child ? : parent, node->in_max_high);
+	update_maxhigh(child ? : parent, node->in_max_high, node->in_max_mask);
 
 color:
 	if (color == INTERVAL_BLACK)
@@ -632,11 +762,13 @@ static inline int interval_may_overlap(struct interval_node *node,
  *       return 0;
  * }
  *
+ * Subtrees holding no node tagged with @mask are skipped, the rest of the
+ * walk is the same as above.
  */
-enum interval_iter interval_search(struct interval_node *node,
-				   struct interval_node_extent *ext,
-				   interval_callback_t func,
-				   void *data)
+enum interval_iter interval_search_mask(struct interval_node *node,
+					struct interval_node_extent *ext,
+					__u16 mask, interval_callback_t func,
+					void *data)
 {
 	struct interval_node *parent;
 	enum interval_iter rc = INTERVAL_ITER_CONT;
@@ -647,13 +779,16 @@ enum interval_iter interval_search(struct interval_node *node,
 	LASSERT(func != NULL);
 
 	while (node) {
-		if (ext->end < interval_low(node)) {
+		if (!node_may_match(node, mask)) {
+			/* nothing of interest below, go back up */
+		} else if (ext->end < interval_low(node)) {
 			if (node->in_left) {
 				node = node->in_left;
 				continue;
 			}
 		} else if (interval_may_overlap(node, ext)) {
-			if (extent_overlapped(ext, &node->in_extent)) {
+			if (node_match(node, mask) &&
+			    extent_overlapped(ext, &node->in_extent)) {
 				rc = func(node, data);
 				if (rc == INTERVAL_ITER_STOP)
 					break;
@@ -691,6 +826,15 @@ enum interval_iter interval_search(struct interval_node *node,
 
 	RETURN(rc);
 }
+EXPORT_SYMBOL(interval_search_mask);
+
+enum interval_iter interval_search(struct interval_node *node,
+				   struct interval_node_extent *ext,
+				   interval_callback_t func,
+				   void *data)
+{
+	return interval_search_mask(node, ext, 0, func, data);
+}
 EXPORT_SYMBOL(interval_search);
 
 static enum interval_iter interval_overlap_cb(struct interval_node *n,
@@ -700,13 +844,20 @@ static enum interval_iter interval_overlap_cb(struct interval_node *n,
 	return INTERVAL_ITER_STOP;
 }
 
-int interval_is_overlapped(struct interval_node *root,
-			   struct interval_node_extent *ext)
+int interval_is_overlapped_mask(struct interval_node *root,
+				struct interval_node_extent *ext, __u16 mask)
 {
 	int has = 0;
-	(void)interval_search(root, ext, interval_overlap_cb, &has);
+	(void)interval_search_mask(root, ext, mask, interval_overlap_cb, &has);
 	return has;
 }
+EXPORT_SYMBOL(interval_is_overlapped_mask);
+
+int interval_is_overlapped(struct interval_node *root,
+			   struct interval_node_extent *ext)
+{
+	return interval_is_overlapped_mask(root, ext, 0);
+}
 EXPORT_SYMBOL(interval_is_overlapped);
 
 /* Don't expand to low. Expanding downwards is expensive, and meaningless to
@@ -738,24 +889,33 @@ EXPORT_SYMBOL(interval_is_overlapped);
  * It's much easy to eliminate the recursion, see interval_search for
  * an example. -jay
  */
-static inline __u64 interval_expand_low(struct interval_node *root, __u64 low)
+static inline __u64 interval_expand_low(struct interval_node *root, __u64 low,
+				       __u16 mask)
 {
 	/* we only concern the empty tree right now. */
-	if (root == NULL)
+	if (root == NULL || !node_may_match(root, mask))
 		return 0;
 	return low;
 }
 
-static inline __u64 interval_expand_high(struct interval_node *node, __u64 high)
+static inline __u64 interval_expand_high(struct interval_node *node, __u64 high,
+					__u16 mask)
 {
+	struct interval_node *first;
 	__u64 result = ~0;
 
 	while (node != NULL) {
-		if (node->in_max_high < high)
+		if (node->in_max_high < high || !node_may_match(node, mask))
 			break;
 
 		if (interval_low(node) > high) {
-			result = interval_low(node) - 1;
+			/* @node and its right subtree all start above @high,
+			 * the first tagged one of them limits the expansion */
+			first = node_match(node, mask) ? node :
+				interval_first_mask(node->in_right, mask);
+			if (first != NULL)
+				result = min_u64(result,
+						 interval_low(first) - 1);
 			node = node->in_left;
 		} else {
 			node = node->in_right;
@@ -765,18 +925,26 @@ static inline __u64 interval_expand_high(struct interval_node *node, __u64 high)
 	return result;
 }
 
-/* expanding the extent based on @ext. */
-void interval_expand(struct interval_node *root,
-		     struct interval_node_extent *ext,
-		     struct interval_node_extent *limiter)
+/* expanding the extent based on @ext, only the nodes tagged with @mask are
+ * taken into account. */
+void interval_expand_mask(struct interval_node *root,
+			  struct interval_node_extent *ext,
+			  struct interval_node_extent *limiter, __u16 mask)
 {
 	/* The assertion of interval_is_overlapped is expensive because we may
 	 * travel many nodes to find the overlapped node.
 	 */
-	LASSERT(interval_is_overlapped(root, ext) == 0);
+	LASSERT(interval_is_overlapped_mask(root, ext, mask) == 0);
 	if (!limiter || limiter->start < ext->start)
-		ext->start = interval_expand_low(root, ext->start);
+		ext->start = interval_expand_low(root, ext->start, mask);
 	if (!limiter || limiter->end > ext->end)
-		ext->end = interval_expand_high(root, ext->end);
-	LASSERT(interval_is_overlapped(root, ext) == 0);
+		ext->end = interval_expand_high(root, ext->end, mask);
+	LASSERT(interval_is_overlapped_mask(root, ext, mask) == 0);
+}
+
+void interval_expand(struct interval_node *root,
+		     struct interval_node_extent *ext,
+		     struct interval_node_extent *limiter)
+{
+	interval_expand_mask(root, ext, limiter, 0);
 }
@@ -129,43 +129,33 @@ static void ldlm_extent_internal_policy_granted(struct ldlm_lock *req,
 	enum ldlm_mode req_mode = req->l_req_mode;
 	__u64 req_start = req->l_req_extent.start;
 	__u64 req_end = req->l_req_extent.end;
-	struct ldlm_interval_tree *tree;
+	struct ldlm_interval_tree *tree = res->lr_itree;
 	struct interval_node_extent limiter = {
 		.start	= new_ex->start,
 		.end	= new_ex->end,
 	};
+	struct interval_node_extent ext = {
+		.start	= req_start,
+		.end	= req_end,
+	};
+	__u16 mask = ldlm_conflict_mask(req_mode);
 	int conflicting = 0;
 	int idx;
 	ENTRY;
 
 	lockmode_verify(req_mode);
 
-	/* Using interval tree to handle the LDLM extent granted locks. */
-        for (idx = 0; idx < LCK_MODE_NUM; idx++) {
-		struct interval_node_extent ext = {
-			.start	= req_start,
-			.end	= req_end,
-		};
-
-                tree = &res->lr_itree[idx];
-                if (lockmode_compat(tree->lit_mode, req_mode))
-                        continue;
+	for (idx = 0; idx < LCK_MODE_NUM; idx++)
+		if (mask & (1 << idx))
+			conflicting += tree->lit_size[idx];
+	if (conflicting > 4)
+		limiter.start = req_start;
 
-                conflicting += tree->lit_size;
-                if (conflicting > 4)
-                        limiter.start = req_start;
-
-                if (interval_is_overlapped(tree->lit_root, &ext))
-                        CDEBUG(D_INFO, 
-                               "req_mode = %d, tree->lit_mode = %d, "
-                               "tree->lit_size = %d\n",
-                               req_mode, tree->lit_mode, tree->lit_size);
-                interval_expand(tree->lit_root, &ext, &limiter);
-                limiter.start = max(limiter.start, ext.start);
-                limiter.end = min(limiter.end, ext.end);
-                if (limiter.start == req_start && limiter.end == req_end)
-                        break;
-        }
+	/* Using interval tree to handle the LDLM extent granted locks, all
+	 * conflicting modes are expanded against in one walk. */
+	interval_expand_mask(tree->lit_root, &ext, &limiter, mask);
+	limiter.start = max(limiter.start, ext.start);
+	limiter.end = min(limiter.end, ext.end);
 
         new_ex->start = limiter.start;
         new_ex->end = limiter.end;
@@ -327,7 +317,6 @@ static int ldlm_check_contention(struct ldlm_lock *lock, int contended_locks)
 struct ldlm_extent_compat_args {
 	struct list_head *work_list;
 	struct ldlm_lock *lock;
-	enum ldlm_mode mode;
 	int *locks;
 	int *compat;
 };
@@ -340,7 +329,7 @@ static enum interval_iter ldlm_extent_compat_cb(struct interval_node *n,
 	struct ldlm_extent *extent;
 	struct list_head *work_list = priv->work_list;
 	struct ldlm_lock *lock, *enq = priv->lock;
-	enum ldlm_mode mode = priv->mode;
+	enum ldlm_mode mode = interval_mask(n);
 	int count = 0;
 	ENTRY;
 
@@ -370,6 +359,13 @@ static enum interval_iter ldlm_extent_compat_cb(struct interval_node *n,
         RETURN(INTERVAL_ITER_CONT);
 }
 
+static enum interval_iter ldlm_extent_first_cb(struct interval_node *n,
+					       void *data)
+{
+	*(struct interval_node **)data = n;
+	return INTERVAL_ITER_STOP;
+}
+
 /**
  * Determine if the lock is compatible with all locks on the queue.
  *
@@ -401,81 +397,88 @@ ldlm_extent_compat_queue(struct list_head *queue, struct ldlm_lock *req,
 
         /* Using interval tree for granted lock */
         if (queue == &res->lr_granted) {
-                struct ldlm_interval_tree *tree;
-                struct ldlm_extent_compat_args data = {.work_list = work_list,
-                                               .lock = req,
-                                               .locks = contended_locks,
-                                               .compat = &compat };
-                struct interval_node_extent ex = { .start = req_start,
-                                                   .end = req_end };
-                int idx, rc;
-
-                for (idx = 0; idx < LCK_MODE_NUM; idx++) {
-                        tree = &res->lr_itree[idx];
-                        if (tree->lit_root == NULL) /* empty tree, skipped */
-                                continue;
-
-                        data.mode = tree->lit_mode;
-                        if (lockmode_compat(req_mode, tree->lit_mode)) {
-                                struct ldlm_interval *node;
-                                struct ldlm_extent *extent;
-
-                                if (req_mode != LCK_GROUP)
-                                        continue;
-
-                                /* group lock, grant it immediately if
-                                 * compatible */
-                                node = to_ldlm_interval(tree->lit_root);
-                                extent = ldlm_interval_extent(node);
-                                if (req->l_policy_data.l_extent.gid ==
-                                    extent->gid)
-                                        RETURN(2);
-                        }
+		struct ldlm_interval_tree *tree = res->lr_itree;
+		struct ldlm_extent_compat_args data = {.work_list = work_list,
+						       .lock = req,
+						       .locks = contended_locks,
+						       .compat = &compat };
+		struct interval_node_extent ex = { .start = req_start,
+						   .end = req_end };
+		struct interval_node_extent whole = { .start = 0,
+						      .end = OBD_OBJECT_EOF };
+		__u16 mask = ldlm_conflict_mask(req_mode);
+		int rc;
+
+		/* Granted locks of all modes share one tree, every node is
+		 * tagged with its granted mode, so one walk restricted to the
+		 * conflicting modes finds all the blocking locks. GROUP locks
+		 * conflict whatever their extent and are handled first. */
+		if (tree->lit_size[ldlm_mode_to_index(LCK_GROUP)] > 0) {
+			if (req_mode == LCK_GROUP) {
+				struct interval_node *n = NULL;
+				struct ldlm_extent *extent;
+
+				/* group lock, grant it immediately if
+				 * compatible */
+				interval_iterate_reverse_mask(tree->lit_root,
+					LCK_GROUP, ldlm_extent_first_cb, &n);
+				LASSERT(n != NULL);
+				extent = ldlm_interval_extent(
+						to_ldlm_interval(n));
+				if (req->l_policy_data.l_extent.gid ==
+				    extent->gid)
+					RETURN(2);
+				mask |= LCK_GROUP;
+			}
 
-                        if (tree->lit_mode == LCK_GROUP) {
+			if (mask & LCK_GROUP) {
 				if (*flags & (LDLM_FL_BLOCK_NOWAIT |
 					      LDLM_FL_SPECULATIVE)) {
-                                        compat = -EWOULDBLOCK;
-                                        goto destroylock;
-                                }
-
-                                *flags |= LDLM_FL_NO_TIMEOUT;
-                                if (!work_list)
-                                        RETURN(0);
-
-                                /* if work list is not NULL,add all
-                                   locks in the tree to work list */
-                                compat = 0;
-                                interval_iterate(tree->lit_root,
-                                                 ldlm_extent_compat_cb, &data);
-                                continue;
-                        }
+					compat = -EWOULDBLOCK;
+					goto destroylock;
+				}
 
-			/* We've found a potentially blocking lock, check
-			 * compatibility.  This handles locks other than GROUP
-			 * locks, which are handled separately above.
-			 *
-			 * Locks with FL_SPECULATIVE are asynchronous requests
-			 * which must never wait behind another lock, so they
-			 * fail if any conflicting lock is found. */
-			if (!work_list || (*flags & LDLM_FL_SPECULATIVE)) {
-				rc = interval_is_overlapped(tree->lit_root,
-							    &ex);
-				if (rc) {
-					if (!work_list) {
-						RETURN(0);
-					} else {
-						compat = -EWOULDBLOCK;
-						goto destroylock;
-					}
+				*flags |= LDLM_FL_NO_TIMEOUT;
+				if (!work_list)
+					RETURN(0);
+
+				/* if work list is not NULL,add all
+				   group locks in the tree to work list */
+				compat = 0;
+				interval_search_mask(tree->lit_root, &whole,
+						     LCK_GROUP,
+						     ldlm_extent_compat_cb,
+						     &data);
+			}
+		}
+		mask &= ~LCK_GROUP;
+
+		/* We've found a potentially blocking lock, check
+		 * compatibility.  This handles locks other than GROUP
+		 * locks, which are handled separately above.
+		 *
+		 * Locks with FL_SPECULATIVE are asynchronous requests
+		 * which must never wait behind another lock, so they
+		 * fail if any conflicting lock is found. */
+		if (tree->lit_root == NULL || mask == 0) {
+			/* no granted lock of a conflicting mode */
+		} else if (!work_list || (*flags & LDLM_FL_SPECULATIVE)) {
+			rc = interval_is_overlapped_mask(tree->lit_root, &ex,
+							 mask);
+			if (rc) {
+				if (!work_list) {
+					RETURN(0);
+				} else {
+					compat = -EWOULDBLOCK;
+					goto destroylock;
 				}
-                        } else {
-                                interval_search(tree->lit_root, &ex,
-                                                ldlm_extent_compat_cb, &data);
-				if (!list_empty(work_list) && compat)
-                                        compat = 0;
-                        }
-                }
+			}
+		} else {
+			interval_search_mask(tree->lit_root, &ex, mask,
+					     ldlm_extent_compat_cb, &data);
+			if (!list_empty(work_list) && compat)
+				compat = 0;
+		}
         } else { /* for waiting queue */
 		list_for_each_entry(lock, queue, l_res_link) {
                         check_contention = 1;
@@ -732,11 +735,9 @@ static enum interval_iter ldlm_resource_prolong_cb(struct interval_node *n,
  */
 void ldlm_resource_prolong(struct ldlm_prolong_args *arg)
 {
-	struct ldlm_interval_tree *tree;
 	struct ldlm_resource *res;
 	struct interval_node_extent ex = { .start = arg->lpa_extent.start,
 					   .end = arg->lpa_extent.end };
-	int idx;
 
 	ENTRY;
 
@@ -749,22 +750,15 @@ void ldlm_resource_prolong(struct ldlm_prolong_args *arg)
 	}
 
 	lock_res(res);
-	for (idx = 0; idx < LCK_MODE_NUM; idx++) {
-		tree = &res->lr_itree[idx];
-		if (tree->lit_root == NULL) /* empty tree, skipped */
-			continue;
-
-		/* There is no possibility to check for the groupID
-		 * so all the group locks are considered as valid
-		 * here, especially because the client is supposed
-		 * to check it has such a lock before sending an RPC.
-		 */
-		if (!(tree->lit_mode & arg->lpa_mode))
-			continue;
-
-		interval_search(tree->lit_root, &ex,
-				ldlm_resource_prolong_cb, arg);
-	}
+	/* There is no possibility to check for the groupID
+	 * so all the group locks are considered as valid
+	 * here, especially because the client is supposed
+	 * to check it has such a lock before sending an RPC.
+	 */
+	if (arg->lpa_mode != 0)
+		interval_search_mask(res->lr_itree->lit_root, &ex,
+				     arg->lpa_mode, ldlm_resource_prolong_cb,
+				     arg);
 
 	unlock_res(res);
 	ldlm_resource_putref(res);
@@ -899,7 +893,7 @@ static enum interval_iter ldlm_kms_shift_cb(struct interval_node *n,
 	if (lock->l_policy_data.l_extent.end + 1 > arg->kms)
 		arg->kms = lock->l_policy_data.l_extent.end + 1;
 
-	/* Since interval_iterate_reverse starts with the highest lock and
+	/* Since interval_iterate_reverse_mask starts with the highest lock and
 	 * works down, for PW locks, we only need to check if we should update
 	 * the kms, then stop walking the tree.  PR locks are not exclusive, so
 	 * the highest start does not imply the highest end and we must
@@ -921,7 +915,7 @@ static enum interval_iter ldlm_kms_shift_cb(struct interval_node *n,
 __u64 ldlm_extent_shift_kms(struct ldlm_lock *lock, __u64 old_kms)
 {
 	struct ldlm_resource *res = lock->l_resource;
-	struct ldlm_interval_tree *tree;
+	struct ldlm_interval_tree *tree = res->lr_itree;
 	struct ldlm_kms_shift_args args;
 	int idx = 0;
 
@@ -936,23 +930,24 @@ __u64 ldlm_extent_shift_kms(struct ldlm_lock *lock, __u64 old_kms)
 	 * calculation of the kms */
 	ldlm_set_kms_ignore(lock);
 
-	/* We iterate over the lock trees, looking for the largest kms smaller
-	 * than the current one. */
+	/* We iterate over the locks of each mode, looking for the largest kms
+	 * smaller than the current one. */
 	for (idx = 0; idx < LCK_MODE_NUM; idx++) {
-		tree = &res->lr_itree[idx];
-
 		/* If our already known kms is >= than the highest 'end' in
-		 * this tree, we don't need to check this tree, because
+		 * the tree, we don't need to check any further, because
 		 * the kms from a tree can be lower than in_max_high (due to
 		 * kms_ignore), but it can never be higher. */
 		if (!tree->lit_root || args.kms >= tree->lit_root->in_max_high)
+			break;
+
+		if (tree->lit_size[idx] == 0)
 			continue;
 
-		interval_iterate_reverse(tree->lit_root, ldlm_kms_shift_cb,
-					 &args);
+		interval_iterate_reverse_mask(tree->lit_root, 1 << idx,
+					      ldlm_kms_shift_cb, &args);
 
 		/* this tells us we're not the highest lock, so we don't need
-		 * to check the remaining trees */
+		 * to check the remaining modes */
 		if (args.complete)
 			break;
 	}
@@ -970,7 +965,8 @@ struct ldlm_interval *ldlm_interval_alloc(struct ldlm_lock *lock)
 	struct ldlm_interval *node;
 	ENTRY;
 
-	LASSERT(lock->l_resource->lr_type == LDLM_EXTENT);
+	LASSERT(lock->l_resource->lr_type == LDLM_EXTENT ||
+		lock->l_resource->lr_type == LDLM_FLOCK);
 	OBD_SLAB_ALLOC_PTR_GFP(node, ldlm_interval_slab, GFP_NOFS);
 	if (node == NULL)
 		RETURN(NULL);
@@ -989,12 +985,13 @@ void ldlm_interval_free(struct ldlm_interval *node)
         }
 }
 
-/* interval tree, for LDLM_EXTENT. */
+/* interval tree, for LDLM_EXTENT and LDLM_FLOCK. */
 void ldlm_interval_attach(struct ldlm_interval *n,
                           struct ldlm_lock *l)
 {
         LASSERT(l->l_tree_node == NULL);
-        LASSERT(l->l_resource->lr_type == LDLM_EXTENT);
+	LASSERT(l->l_resource->lr_type == LDLM_EXTENT ||
+		l->l_resource->lr_type == LDLM_FLOCK);
 
 	list_add_tail(&l->l_sl_policy, &n->li_group);
         l->l_tree_node = n;
@@ -1014,18 +1011,6 @@ struct ldlm_interval *ldlm_interval_detach(struct ldlm_lock *l)
 	return list_empty(&n->li_group) ? n : NULL;
 }
 
-static inline int ldlm_mode_to_index(enum ldlm_mode mode)
-{
-	int index;
-
-	LASSERT(mode != 0);
-	LASSERT(is_power_of_2(mode));
-	for (index = -1; mode != 0; index++, mode >>= 1)
-		/* do nothing */;
-	LASSERT(index < LCK_MODE_NUM);
-	return index;
-}
-
 /** Add newly granted lock into interval tree for the resource. */
 void ldlm_extent_add_lock(struct ldlm_resource *res,
                           struct ldlm_lock *lock)
@@ -1043,15 +1028,17 @@ void ldlm_extent_add_lock(struct ldlm_resource *res,
 
 	idx = ldlm_mode_to_index(lock->l_granted_mode);
 	LASSERT(lock->l_granted_mode == 1 << idx);
-	LASSERT(lock->l_granted_mode == res->lr_itree[idx].lit_mode);
 
         /* node extent initialize */
         extent = &lock->l_policy_data.l_extent;
 
 	rc = interval_set(&node->li_node, extent->start, extent->end);
 	LASSERT(!rc);
+	/* locks of different modes with the same extent are kept in
+	 * separate nodes, the policy group is (extent, mode) */
+	interval_set_mask(&node->li_node, lock->l_granted_mode);
 
-        root = &res->lr_itree[idx].lit_root;
+        root = &res->lr_itree->lit_root;
         found = interval_insert(&node->li_node, root);
         if (found) { /* The policy group found. */
                 struct ldlm_interval *tmp = ldlm_interval_detach(lock);
@@ -1059,7 +1046,7 @@ void ldlm_extent_add_lock(struct ldlm_resource *res,
                 ldlm_interval_free(tmp);
                 ldlm_interval_attach(to_ldlm_interval(found), lock);
         }
-        res->lr_itree[idx].lit_size++;
+	res->lr_itree->lit_size[idx]++;
 
         /* even though we use interval tree to manage the extent lock, we also
          * add the locks into grant list, for debug purpose, .. */
@@ -1099,11 +1086,12 @@ void ldlm_extent_unlink_lock(struct ldlm_lock *lock)
 
 	idx = ldlm_mode_to_index(lock->l_granted_mode);
 	LASSERT(lock->l_granted_mode == 1 << idx);
-	tree = &res->lr_itree[idx];
+	tree = res->lr_itree;
 
 	LASSERT(tree->lit_root != NULL); /* assure the tree is not null */
+	LASSERT(tree->lit_size[idx] > 0);
 
-	tree->lit_size--;
+	tree->lit_size[idx]--;
 	node = ldlm_interval_detach(lock);
 	if (node) {
 		interval_erase(&node->li_node, &tree->lit_root);
@@ -1111,6 +1099,273 @@ void ldlm_extent_unlink_lock(struct ldlm_lock *lock)
 	}
 }
 
+/**
+ * Change the mode and the extent of a granted extent lock in place.
+ *
+ * The lock is taken out of the interval tree and added back with its new
+ * policy group, \a node is a preallocated interval node for it, it is
+ * always consumed. Caller must hold the resource lock.
+ */
+void ldlm_extent_shrink(struct ldlm_lock *lock, enum ldlm_mode mode,
+			const struct ldlm_extent *extent,
+			struct ldlm_interval *node)
+{
+	struct ldlm_extent *req = &lock->l_req_extent;
+
+	check_res_locked(lock->l_resource);
+	LASSERT(ldlm_is_granted(lock));
+	LASSERT(ldlm_extent_contain(&lock->l_policy_data.l_extent, extent));
+
+	ldlm_resource_unlink_lock(lock);
+
+	lock->l_req_mode = mode;
+	lock->l_granted_mode = mode;
+	lock->l_policy_data.l_extent.start = extent->start;
+	lock->l_policy_data.l_extent.end = extent->end;
+	/* the requested extent must stay within the granted one */
+	if (ldlm_extent_overlap(req, extent)) {
+		req->start = max(req->start, extent->start);
+		req->end = min(req->end, extent->end);
+	} else {
+		req->start = extent->start;
+		req->end = extent->end;
+	}
+
+	INIT_LIST_HEAD(&node->li_group);
+	ldlm_interval_attach(node, lock);
+	ldlm_extent_add_lock(lock->l_resource, lock);
+}
+
+#ifdef HAVE_SERVER_SUPPORT
+/**
+ * Server side of extent lock conversion, the client has shrunk its lock to
+ * the extent and mode in \a desc and tells us about it.
+ *
+ * Only a subset of the granted extent and a downgrade from PW to PR are
+ * accepted, anything else is answered with an error so the client cancels
+ * the lock instead.
+ */
+int ldlm_extent_convert(struct ldlm_lock *lock,
+			const struct ldlm_lock_desc *desc)
+{
+	struct ldlm_extent extent;
+	struct ldlm_interval *node;
+	enum ldlm_mode mode = desc->l_req_mode;
+	enum ldlm_mode granted;
+
+	ENTRY;
+
+	extent.start = desc->l_policy_data.l_extent.start;
+	extent.end = desc->l_policy_data.l_extent.end;
+	extent.gid = 0;
+
+	OBD_SLAB_ALLOC_PTR_GFP(node, ldlm_interval_slab, GFP_NOFS);
+	if (node == NULL)
+		RETURN(-ENOMEM);
+
+	lock_res_and_lock(lock);
+	granted = lock->l_granted_mode;
+	if (!ldlm_is_granted(lock) || !(granted & (LCK_PW | LCK_PR)) ||
+	    (mode != granted && !(granted == LCK_PW && mode == LCK_PR)) ||
+	    extent.start > extent.end ||
+	    !ldlm_extent_contain(&lock->l_policy_data.l_extent, &extent)) {
+		unlock_res_and_lock(lock);
+		OBD_SLAB_FREE_PTR(node, ldlm_interval_slab);
+		LDLM_ERROR(lock, "cannot convert to mode %d [%llu->%llu]",
+			   mode, extent.start, extent.end);
+		RETURN(-EINVAL);
+	}
+
+	if (mode == granted &&
+	    extent.start == lock->l_policy_data.l_extent.start &&
+	    extent.end == lock->l_policy_data.l_extent.end) {
+		/* CONVERT RPCs may be re-ordered, nothing to do */
+		unlock_res_and_lock(lock);
+		OBD_SLAB_FREE_PTR(node, ldlm_interval_slab);
+		LDLM_DEBUG(lock, "lock is converted already!");
+		RETURN(ELDLM_OK);
+	}
+
+	if (ldlm_is_waited(lock))
+		ldlm_del_waiting_lock(lock);
+
+	ldlm_clear_cbpending(lock);
+	ldlm_extent_shrink(lock, mode, &extent, node);
+	ldlm_clear_blocking_data(lock);
+	unlock_res_and_lock(lock);
+
+	LDLM_DEBUG(lock, "server-side extent convert done");
+	ldlm_reprocess_all(lock->l_resource);
+
+	RETURN(ELDLM_OK);
+}
+#endif /* HAVE_SERVER_SUPPORT */
+
+/* number of bytes of \a ex within [start, end] */
+static __u64 ldlm_extent_overlap_len(const struct ldlm_extent *ex,
+				     __u64 start, __u64 end)
+{
+	start = max(start, ex->start);
+	end = min(end, ex->end);
+	return start <= end ? end - start + 1 : 0;
+}
+
+/**
+ * Work out how \a lock could be converted so that it doesn't conflict with
+ * the lock described by \a bl any more: a PW lock is downgraded to PR if
+ * that is enough, otherwise the extent is trimmed to its part below or
+ * above \a bl, on page boundaries. The part kept is the one covering more
+ * of the extent the lock was requested for, where the holder does IO,
+ * or the larger one.
+ *
+ * \retval true if such a conversion exists, returned in \a mode and \a extent
+ */
+static bool ldlm_extent_convert_target(struct ldlm_lock *lock,
+				       const struct ldlm_lock_desc *bl,
+				       enum ldlm_mode *mode,
+				       struct ldlm_extent *extent)
+{
+	const struct ldlm_extent *cur = &lock->l_policy_data.l_extent;
+	__u64 start = bl->l_policy_data.l_extent.start;
+	__u64 end = bl->l_policy_data.l_extent.end;
+	__u64 mask = PAGE_SIZE - 1;
+	__u64 below = 0;
+	__u64 above = 0;
+	__u64 lo;
+	__u64 hi;
+
+	/* the description must be of a valid lock on the same resource */
+	if (!ldlm_res_eq(&bl->l_resource.lr_name,
+			 &lock->l_resource->lr_name) ||
+	    !(bl->l_req_mode & (LCK_PR | LCK_PW | LCK_CW | LCK_CR | LCK_EX)) ||
+	    start > end)
+		return false;
+
+	if (!(lock->l_granted_mode & (LCK_PW | LCK_PR)) ||
+	    ldlm_is_discard_data(lock))
+		return false;
+
+	*mode = lock->l_granted_mode;
+	*extent = *cur;
+
+	if (*mode == LCK_PW && lockmode_compat(LCK_PR, bl->l_req_mode)) {
+		*mode = LCK_PR;
+		return true;
+	}
+
+	/* [cur->start, lo - 1] is left below the conflicting extent */
+	lo = start & ~mask;
+	if (lo > cur->start)
+		below = lo - cur->start;
+
+	/* [hi, cur->end] is left above it, hi is 0 if it wraps */
+	hi = (end | mask) + 1;
+	if (end < cur->end && hi != 0 && hi <= cur->end)
+		above = cur->end - hi + 1;
+
+	if (below == 0 && above == 0)
+		return false;
+
+	if (below != 0 && above != 0) {
+		__u64 req_below;
+		__u64 req_above;
+
+		req_below = ldlm_extent_overlap_len(&lock->l_req_extent,
+						    cur->start, lo - 1);
+		req_above = ldlm_extent_overlap_len(&lock->l_req_extent,
+						    hi, cur->end);
+		if (req_below != req_above) {
+			below = req_below;
+			above = req_above;
+		}
+	}
+
+	if (below >= above)
+		extent->end = lo - 1;
+	else
+		extent->start = hi;
+	return true;
+}
+
+/**
+ * Client-side extent lock conversion.
+ *
+ * Instead of cancelling an unused lock blocking \a bl, downgrade it from PW
+ * to PR or trim its extent, flush only the pages it doesn't cover any more
+ * and inform the server. As with IBITS lock convert, the lock is converted
+ * locally first and the server is told asynchronously.
+ *
+ * The upper layer is told which pages to flush by a LDLM_CB_CANCELING call
+ * of l_blocking_ast with the converting flag set and the description of the
+ * lock before conversion.
+ *
+ * \retval 0 if the lock was converted
+ * \retval negative if it has to be cancelled instead
+ */
+int ldlm_cli_extent_convert(struct ldlm_lock *lock,
+			    const struct ldlm_lock_desc *bl)
+{
+	struct ldlm_lock_desc old;
+	struct ldlm_extent extent;
+	struct ldlm_interval *node;
+	enum ldlm_mode mode;
+	__u32 flags = 0;
+	int rc;
+
+	ENTRY;
+
+	if (lock->l_conn_export == NULL ||
+	    !exp_connect_extent_convert(lock->l_conn_export) ||
+	    lock->l_resource->lr_type != LDLM_EXTENT)
+		RETURN(-EINVAL);
+
+	OBD_SLAB_ALLOC_PTR_GFP(node, ldlm_interval_slab, GFP_NOFS);
+	if (node == NULL)
+		RETURN(-ENOMEM);
+
+	LDLM_DEBUG(lock, "client extent convert START");
+
+	lock_res_and_lock(lock);
+	if (!ldlm_is_granted(lock) || lock->l_readers || lock->l_writers ||
+	    ldlm_is_canceling(lock) || ldlm_is_cancel(lock) ||
+	    ldlm_is_converting(lock) ||
+	    !ldlm_extent_convert_target(lock, bl, &mode, &extent)) {
+		unlock_res_and_lock(lock);
+		OBD_SLAB_FREE_PTR(node, ldlm_interval_slab);
+		GOTO(exit, rc = -EINVAL);
+	}
+
+	ldlm_lock2desc(lock, &old);
+
+	/* safe to match right after conversion, it only drops rights */
+	ldlm_clear_cbpending(lock);
+	ldlm_clear_bl_ast(lock);
+	ldlm_set_converting(lock);
+	ldlm_extent_shrink(lock, mode, &extent, node);
+	unlock_res_and_lock(lock);
+
+	if (lock->l_blocking_ast)
+		lock->l_blocking_ast(lock, &old, lock->l_ast_data,
+				     LDLM_CB_CANCELING);
+
+	rc = ldlm_cli_convert(lock, &flags);
+	if (rc) {
+		lock_res_and_lock(lock);
+		if (ldlm_is_converting(lock)) {
+			ldlm_clear_converting(lock);
+			ldlm_set_cbpending(lock);
+			ldlm_set_bl_ast(lock);
+		}
+		unlock_res_and_lock(lock);
+		GOTO(exit, rc);
+	}
+	EXIT;
+exit:
+	LDLM_DEBUG(lock, "client extent convert END, rc = %d", rc);
+	return rc;
+}
+EXPORT_SYMBOL(ldlm_cli_extent_convert);
+
 void ldlm_extent_policy_wire_to_local(const union ldlm_wire_policy_data *wpolicy,
 				      union ldlm_policy_data *lpolicy)
 {
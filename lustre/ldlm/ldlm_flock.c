@@ -91,38 +91,223 @@ ldlm_flocks_overlap(struct ldlm_lock *lock, struct ldlm_lock *new)
                 lock->l_policy_data.l_flock.start));
 }
 
+static inline lnet_nid_t ldlm_flock_nid(struct ldlm_lock *lock)
+{
+	return lock->l_export != NULL ?
+	       lock->l_export->exp_connection->c_peer.nid : LNET_NID_ANY;
+}
+
+static inline struct ldlm_lock *ldlm_flock_node2lock(struct interval_node *n)
+{
+	return list_first_entry(&to_ldlm_interval(n)->li_group,
+				struct ldlm_lock, l_sl_policy);
+}
+
+/* granted locks are in the resource interval tree, waiting ones are not */
+static inline bool ldlm_flock_in_tree(struct ldlm_lock *lock)
+{
+	return lock->l_tree_node != NULL &&
+	       interval_is_intree(&lock->l_tree_node->li_node);
+}
+
+/**
+ * Granted flock locks of one owner are kept next to each other in
+ * lr_granted, sorted by start. On the server the first lock of each owner
+ * is indexed in the export exp_flock_hash, so the owner's locks are found
+ * without scanning the whole granted list. Clients only see their own
+ * locks and scan.
+ */
+static struct list_head *
+ldlm_flock_ownlocks(struct ldlm_resource *res, struct ldlm_lock *req)
+{
+	struct obd_export *exp = req->l_export;
+	struct ldlm_lock *lock;
+
+	if (exp != NULL && exp->exp_flock_hash != NULL) {
+		lock = cfs_hash_lookup(exp->exp_flock_hash, req);
+		if (lock == NULL)
+			return NULL;
+		/* the hash still holds a reference */
+		cfs_hash_put(exp->exp_flock_hash, &lock->l_exp_flock_hash);
+		return &lock->l_res_link;
+	}
+
+	list_for_each_entry(lock, &res->lr_granted, l_res_link) {
+		if (ldlm_same_flock_owner(lock, req))
+			return &lock->l_res_link;
+	}
+	return NULL;
+}
+
+/**
+ * Add granted flock \a lock to \a res before \a head, and to the interval
+ * tree and owner index.
+ */
+static void ldlm_flock_insert_lock(struct ldlm_resource *res,
+				   struct list_head *head,
+				   struct ldlm_lock *lock)
+{
+	struct cfs_hash *hs = lock->l_export ? lock->l_export->exp_flock_hash :
+					       NULL;
+	struct interval_node *node = &lock->l_tree_node->li_node;
+	struct ldlm_flock *flock = &lock->l_policy_data.l_flock;
+	struct ldlm_lock *prev;
+	struct ldlm_lock *next;
+
+	ldlm_resource_add_lock(res, head, lock);
+	if (list_empty(&lock->l_res_link))
+		return;
+
+	LASSERT(!interval_is_intree(node));
+	interval_set(node, flock->start, flock->end);
+	interval_set_mask(node, lock->l_granted_mode);
+	interval_insert_dup(node, &res->lr_itree->lit_root);
+	res->lr_itree->lit_size[ldlm_mode_to_index(lock->l_granted_mode)]++;
+
+	if (hs == NULL)
+		return;
+
+	LASSERT(hlist_unhashed(&lock->l_exp_flock_hash));
+	prev = list_entry(lock->l_res_link.prev, struct ldlm_lock, l_res_link);
+	if (&prev->l_res_link != &res->lr_granted &&
+	    ldlm_same_flock_owner(prev, lock))
+		return;
+
+	/* first lock of the owner now, replace the old first one */
+	next = list_entry(lock->l_res_link.next, struct ldlm_lock, l_res_link);
+	if (&next->l_res_link != &res->lr_granted &&
+	    ldlm_same_flock_owner(next, lock))
+		cfs_hash_del(hs, next, &next->l_exp_flock_hash);
+	cfs_hash_add(hs, lock, &lock->l_exp_flock_hash);
+}
+
+/**
+ * Add a lock granted outside of ldlm_process_flock_lock() (replay, or the
+ * client trusting the server) to \a res, next to the locks of its owner.
+ */
+void ldlm_flock_add_lock(struct ldlm_resource *res, struct ldlm_lock *lock)
+{
+	struct list_head *pos = ldlm_flock_ownlocks(res, lock);
+	struct ldlm_lock *own;
+
+	if (pos == NULL) {
+		ldlm_flock_insert_lock(res, &res->lr_granted, lock);
+		return;
+	}
+
+	for (; pos != &res->lr_granted; pos = pos->next) {
+		own = list_entry(pos, struct ldlm_lock, l_res_link);
+		if (!ldlm_same_flock_owner(own, lock) ||
+		    own->l_policy_data.l_flock.start >
+		    lock->l_policy_data.l_flock.start)
+			break;
+	}
+	ldlm_flock_insert_lock(res, pos, lock);
+}
+
+/**
+ * Remove granted flock \a lock from the interval tree and owner index,
+ * the caller removes it from the resource list.
+ */
+void ldlm_flock_unlink_lock(struct ldlm_lock *lock)
+{
+	struct ldlm_resource *res = lock->l_resource;
+	struct cfs_hash *hs = lock->l_export ? lock->l_export->exp_flock_hash :
+					       NULL;
+	struct ldlm_lock *next;
+
+	check_res_locked(res);
+	if (!ldlm_flock_in_tree(lock))
+		return;
+
+	res->lr_itree->lit_size[ldlm_mode_to_index(lock->l_granted_mode)]--;
+	interval_erase(&lock->l_tree_node->li_node, &res->lr_itree->lit_root);
+
+	if (hs == NULL || hlist_unhashed(&lock->l_exp_flock_hash))
+		return;
+
+	cfs_hash_del(hs, lock, &lock->l_exp_flock_hash);
+	next = list_entry(lock->l_res_link.next, struct ldlm_lock, l_res_link);
+	if (&next->l_res_link != &res->lr_granted &&
+	    ldlm_same_flock_owner(next, lock))
+		cfs_hash_add(hs, next, &next->l_exp_flock_hash);
+}
+
+/* change the range of \a lock, keeping the interval tree in order */
+static void ldlm_flock_range_set(struct ldlm_lock *lock, __u64 start,
+				 __u64 end)
+{
+	struct ldlm_interval_tree *tree = lock->l_resource->lr_itree;
+	struct interval_node *node;
+
+	lock->l_policy_data.l_flock.start = start;
+	lock->l_policy_data.l_flock.end = end;
+	if (!ldlm_flock_in_tree(lock))
+		return;
+
+	node = &lock->l_tree_node->li_node;
+	interval_erase(node, &tree->lit_root);
+	interval_set(node, start, end);
+	interval_insert_dup(node, &tree->lit_root);
+}
+
+/**
+ * Key of ns_flock_waiters. It starts with the owner, so that
+ * ldlm_flock::owner of a lock can be used as key for hashing, but the
+ * full key must be passed for lookup, add and delete as the nid is
+ * compared too.
+ */
+struct ldlm_flock_waiter_key {
+	__u64		fwk_owner;
+	lnet_nid_t	fwk_nid;
+};
+
+static inline void ldlm_flock_waiter_key_init(struct ldlm_flock_waiter_key *key,
+					      struct ldlm_lock *lock)
+{
+	key->fwk_owner = lock->l_policy_data.l_flock.owner;
+	key->fwk_nid = ldlm_flock_nid(lock);
+}
+
 static inline void ldlm_flock_blocking_link(struct ldlm_lock *req,
 					    struct ldlm_lock *lock)
 {
-        /* For server only */
-        if (req->l_export == NULL)
+	struct cfs_hash *hs = ldlm_lock_to_ns(req)->ns_flock_waiters;
+	struct ldlm_flock_waiter_key key;
+
+	/* For server only */
+	if (req->l_export == NULL || hs == NULL)
 		return;
 
-	LASSERT(hlist_unhashed(&req->l_exp_flock_hash));
+	LASSERT(hlist_unhashed(&req->l_flock_waiter_hash));
 
-        req->l_policy_data.l_flock.blocking_owner =
-                lock->l_policy_data.l_flock.owner;
-        req->l_policy_data.l_flock.blocking_export =
-		lock->l_export;
-	atomic_set(&req->l_policy_data.l_flock.blocking_refs, 0);
+	req->l_policy_data.l_flock.blocking_owner =
+		lock->l_policy_data.l_flock.owner;
+	req->l_policy_data.l_flock.blocking_nid = ldlm_flock_nid(lock);
 
-	cfs_hash_add(req->l_export->exp_flock_hash,
-		     &req->l_policy_data.l_flock.owner,
-		     &req->l_exp_flock_hash);
+	ldlm_flock_waiter_key_init(&key, req);
+	cfs_hash_add(hs, &key, &req->l_flock_waiter_hash);
 }
 
 static inline void ldlm_flock_blocking_unlink(struct ldlm_lock *req)
 {
-        /* For server only */
-        if (req->l_export == NULL)
-                return;
+	struct ldlm_flock_waiter_key key;
+	struct cfs_hash *hs;
+
+	/* For server only */
+	if (req->l_export == NULL)
+		return;
 
 	check_res_locked(req->l_resource);
-	if (req->l_export->exp_flock_hash != NULL &&
-	    !hlist_unhashed(&req->l_exp_flock_hash))
-		cfs_hash_del(req->l_export->exp_flock_hash,
-			     &req->l_policy_data.l_flock.owner,
-			     &req->l_exp_flock_hash);
+	/* granted locks reuse the hash linkage for the owner index */
+	if (ldlm_flock_in_tree(req))
+		return;
+
+	hs = ldlm_lock_to_ns(req)->ns_flock_waiters;
+	if (hs != NULL && !hlist_unhashed(&req->l_flock_waiter_hash)) {
+		ldlm_flock_waiter_key_init(&key, req);
+		cfs_hash_del(hs, &key, &req->l_flock_waiter_hash);
+	}
 }
 
 static inline void
@@ -133,8 +318,9 @@ ldlm_flock_destroy(struct ldlm_lock *lock, enum ldlm_mode mode, __u64 flags)
 	LDLM_DEBUG(lock, "ldlm_flock_destroy(mode: %d, flags: %#llx)",
 		   mode, flags);
 
+	ldlm_flock_unlink_lock(lock);
 	/* Safe to not lock here, since it should be empty anyway */
-	LASSERT(hlist_unhashed(&lock->l_exp_flock_hash));
+	LASSERT(hlist_unhashed(&lock->l_flock_waiter_hash));
 
 	list_del_init(&lock->l_res_link);
 	if (flags == LDLM_FL_WAIT_NOREPROC) {
@@ -154,93 +340,57 @@ ldlm_flock_destroy(struct ldlm_lock *lock, enum ldlm_mode mode, __u64 flags)
  * POSIX locks deadlock detection code.
  *
  * Given a new lock \a req and an existing lock \a bl_lock it conflicts
- * with, we need to iterate through all blocked POSIX locks for this
- * export and see if there is a deadlock condition arising. (i.e. when
- * one client holds a lock on something and want a lock on something
- * else and at the same time another client has the opposite situation).
+ * with, follow the waits-for graph from the owner of \a bl_lock and see
+ * if it leads back to the owner of \a req (i.e. when one client holds a
+ * lock on something and want a lock on something else and at the same
+ * time another client has the opposite situation).
+ *
+ * Each blocked request is an edge of the graph, from its owner to the
+ * owner of the first lock it conflicts with. The edges are kept in the
+ * namespace ns_flock_waiters hash as requests block and get granted, so
+ * each step of the walk is a single hash lookup.
  */
-
-struct ldlm_flock_lookup_cb_data {
-	__u64 *bl_owner;
-	struct ldlm_lock *lock;
-	struct obd_export *exp;
-};
-
-static int ldlm_flock_lookup_cb(struct cfs_hash *hs, struct cfs_hash_bd *bd,
-				struct hlist_node *hnode, void *data)
+static int
+ldlm_flock_deadlock(struct ldlm_lock *req, struct ldlm_lock *bl_lock)
 {
-	struct ldlm_flock_lookup_cb_data *cb_data = data;
-	struct obd_export *exp = cfs_hash_object(hs, hnode);
-	struct ldlm_lock *lock;
-
-	lock = cfs_hash_lookup(exp->exp_flock_hash, cb_data->bl_owner);
-	if (lock == NULL)
+	struct cfs_hash *hs = ldlm_lock_to_ns(req)->ns_flock_waiters;
+	struct ldlm_flock_waiter_key key;
+	__u64 req_owner = req->l_policy_data.l_flock.owner;
+	lnet_nid_t req_nid;
+	__u64 hops;
+
+	/* For server only */
+	if (req->l_export == NULL || hs == NULL)
 		return 0;
 
-	/* Stop on first found lock. Same process can't sleep twice */
-	cb_data->lock = lock;
-	cb_data->exp = class_export_get(exp);
-
-	return 1;
-}
+	req_nid = ldlm_flock_nid(req);
+	ldlm_flock_waiter_key_init(&key, bl_lock);
 
-static int
-ldlm_flock_deadlock(struct ldlm_lock *req, struct ldlm_lock *bl_lock)
-{
-        struct obd_export *req_exp = req->l_export;
-        struct obd_export *bl_exp = bl_lock->l_export;
-        __u64 req_owner = req->l_policy_data.l_flock.owner;
-        __u64 bl_owner = bl_lock->l_policy_data.l_flock.owner;
-
-        /* For server only */
-        if (req_exp == NULL)
-                return 0;
-
-        class_export_get(bl_exp);
-	while (1) {
-		struct ldlm_flock_lookup_cb_data cb_data = {
-					.bl_owner = &bl_owner,
-					.lock = NULL,
-					.exp = NULL };
-		struct obd_export *bl_exp_new;
-		struct ldlm_lock *lock = NULL;
+	/* a path longer than the number of waiters is a cycle which does not
+	 * involve \a req, stop there */
+	for (hops = cfs_hash_size_get(hs); ; hops--) {
+		struct ldlm_lock *lock;
 		struct ldlm_flock *flock;
 
-		if (bl_exp->exp_flock_hash != NULL) {
-			cfs_hash_for_each_key(bl_exp->exp_obd->obd_nid_hash,
-				&bl_exp->exp_connection->c_peer.nid,
-				ldlm_flock_lookup_cb, &cb_data);
-			lock = cb_data.lock;
-		}
-		if (lock == NULL)
+		if (key.fwk_owner == req_owner && key.fwk_nid == req_nid)
+			return 1;
+
+		if (hops == 0)
 			break;
 
-		class_export_put(bl_exp);
-		bl_exp = cb_data.exp;
+		/* Stop on first found lock. Same process can't sleep twice */
+		lock = cfs_hash_lookup(hs, &key);
+		if (lock == NULL)
+			break;
 
 		LASSERT(req != lock);
 		flock = &lock->l_policy_data.l_flock;
-		LASSERT(flock->owner == bl_owner);
-                bl_owner = flock->blocking_owner;
-                bl_exp_new = class_export_get(flock->blocking_export);
-                class_export_put(bl_exp);
-
-		cfs_hash_put(bl_exp->exp_flock_hash, &lock->l_exp_flock_hash);
-                bl_exp = bl_exp_new;
-
-		if (bl_exp->exp_failed)
-			break;
-
-		if (bl_owner == req_owner &&
-		    (bl_exp->exp_connection->c_peer.nid ==
-		     req_exp->exp_connection->c_peer.nid)) {
-                        class_export_put(bl_exp);
-                        return 1;
-                }
-        }
-        class_export_put(bl_exp);
+		key.fwk_owner = flock->blocking_owner;
+		key.fwk_nid = flock->blocking_nid;
+		cfs_hash_put(hs, &lock->l_flock_waiter_hash);
+	}
 
-        return 0;
+	return 0;
 }
 
 static void ldlm_flock_cancel_on_deadlock(struct ldlm_lock *lock,
@@ -263,6 +413,36 @@ static void ldlm_flock_cancel_on_deadlock(struct ldlm_lock *lock,
 	}
 }
 
+struct ldlm_flock_conflict_arg {
+	struct ldlm_lock	*fca_req;
+	/* first conflicting lock found */
+	struct ldlm_lock	*fca_lock;
+	/* check each conflicting lock for a deadlock */
+	bool			 fca_reprocess;
+	bool			 fca_deadlock;
+};
+
+static enum interval_iter ldlm_flock_conflict_cb(struct interval_node *n,
+						 void *data)
+{
+	struct ldlm_flock_conflict_arg *arg = data;
+	struct ldlm_lock *lock = ldlm_flock_node2lock(n);
+
+	if (ldlm_same_flock_owner(lock, arg->fca_req))
+		return INTERVAL_ITER_CONT;
+
+	if (arg->fca_lock == NULL)
+		arg->fca_lock = lock;
+	if (!arg->fca_reprocess)
+		return INTERVAL_ITER_STOP;
+
+	if (ldlm_flock_deadlock(arg->fca_req, lock)) {
+		arg->fca_deadlock = true;
+		return INTERVAL_ITER_STOP;
+	}
+	return INTERVAL_ITER_CONT;
+}
+
 /**
  * Process a granting attempt for flock lock.
  * Must be called under ns lock held.
@@ -279,11 +459,13 @@ ldlm_process_flock_lock(struct ldlm_lock *req, __u64 *flags,
 	struct ldlm_resource *res = req->l_resource;
 	struct ldlm_namespace *ns = ldlm_res_to_ns(res);
 	struct list_head *tmp;
-	struct list_head *ownlocks = NULL;
+	struct list_head *ownlocks;
 	struct ldlm_lock *lock = NULL;
 	struct ldlm_lock *new = req;
 	struct ldlm_lock *new2 = NULL;
 	enum ldlm_mode mode = req->l_req_mode;
+	__u64 start;
+	__u64 end;
 	int local = ns_is_client(ns);
 	int added = (mode == LCK_NL);
 	int overlaps = 0;
@@ -312,68 +494,61 @@ ldlm_process_flock_lock(struct ldlm_lock *req, __u64 *flags,
         }
 
 reprocess:
-        if ((*flags == LDLM_FL_WAIT_NOREPROC) || (mode == LCK_NL)) {
-                /* This loop determines where this processes locks start
-                 * in the resource lr_granted list. */
-		list_for_each(tmp, &res->lr_granted) {
-			lock = list_entry(tmp, struct ldlm_lock,
-                                              l_res_link);
-                        if (ldlm_same_flock_owner(lock, req)) {
-                                ownlocks = tmp;
-                                break;
-                        }
-                }
-        } else {
-		int reprocess_failed = 0;
-                lockmode_verify(mode);
-
-                /* This loop determines if there are existing locks
-                 * that conflict with the new lock request. */
-		list_for_each(tmp, &res->lr_granted) {
-			lock = list_entry(tmp, struct ldlm_lock,
-                                              l_res_link);
-
-                        if (ldlm_same_flock_owner(lock, req)) {
-                                if (!ownlocks)
-                                        ownlocks = tmp;
-                                continue;
-                        }
-
-                        /* locks are compatible, overlap doesn't matter */
-                        if (lockmode_compat(lock->l_granted_mode, mode))
-                                continue;
+	/* Where this process locks start in the resource lr_granted list. */
+	ownlocks = ldlm_flock_ownlocks(res, req);
+
+	if ((*flags != LDLM_FL_WAIT_NOREPROC) && (mode != LCK_NL)) {
+		struct ldlm_flock_conflict_arg arg = {
+			.fca_req = req,
+			.fca_reprocess = intention != LDLM_PROCESS_ENQUEUE,
+		};
+		struct interval_node_extent ext = {
+			.start = req->l_policy_data.l_flock.start,
+			.end = req->l_policy_data.l_flock.end,
+		};
+
+		lockmode_verify(mode);
+
+		/* Look for existing locks that conflict with the new lock
+		 * request. */
+		interval_search_mask(res->lr_itree->lit_root, &ext,
+				     ldlm_conflict_mask(mode),
+				     ldlm_flock_conflict_cb, &arg);
+		lock = arg.fca_lock;
+
+		if (arg.fca_deadlock) {
+			ldlm_flock_cancel_on_deadlock(req, grant_work);
+			RETURN(LDLM_ITER_CONTINUE);
+		}
 
-                        if (!ldlm_flocks_overlap(lock, req))
-                                continue;
+		if (lock != NULL && intention != LDLM_PROCESS_ENQUEUE) {
+			/* keep the waits-for edge up to date */
+			req->l_policy_data.l_flock.blocking_owner =
+				lock->l_policy_data.l_flock.owner;
+			req->l_policy_data.l_flock.blocking_nid =
+				ldlm_flock_nid(lock);
+			RETURN(LDLM_ITER_CONTINUE);
+		}
 
-			if (intention != LDLM_PROCESS_ENQUEUE) {
-				reprocess_failed = 1;
-				if (ldlm_flock_deadlock(req, lock)) {
-					ldlm_flock_cancel_on_deadlock(req,
-							grant_work);
-					RETURN(LDLM_ITER_CONTINUE);
-				}
-				continue;
+		if (lock != NULL) {
+			if (*flags & LDLM_FL_BLOCK_NOWAIT) {
+				ldlm_flock_destroy(req, mode, *flags);
+				*err = -EAGAIN;
+				RETURN(LDLM_ITER_STOP);
 			}
 
-                        if (*flags & LDLM_FL_BLOCK_NOWAIT) {
-                                ldlm_flock_destroy(req, mode, *flags);
-                                *err = -EAGAIN;
-                                RETURN(LDLM_ITER_STOP);
-                        }
-
-                        if (*flags & LDLM_FL_TEST_LOCK) {
-                                ldlm_flock_destroy(req, mode, *flags);
-                                req->l_req_mode = lock->l_granted_mode;
-                                req->l_policy_data.l_flock.pid =
-                                        lock->l_policy_data.l_flock.pid;
-                                req->l_policy_data.l_flock.start =
-                                        lock->l_policy_data.l_flock.start;
-                                req->l_policy_data.l_flock.end =
-                                        lock->l_policy_data.l_flock.end;
-                                *flags |= LDLM_FL_LOCK_CHANGED;
-                                RETURN(LDLM_ITER_STOP);
-                        }
+			if (*flags & LDLM_FL_TEST_LOCK) {
+				ldlm_flock_destroy(req, mode, *flags);
+				req->l_req_mode = lock->l_granted_mode;
+				req->l_policy_data.l_flock.pid =
+					lock->l_policy_data.l_flock.pid;
+				req->l_policy_data.l_flock.start =
+					lock->l_policy_data.l_flock.start;
+				req->l_policy_data.l_flock.end =
+					lock->l_policy_data.l_flock.end;
+				*flags |= LDLM_FL_LOCK_CHANGED;
+				RETURN(LDLM_ITER_STOP);
+			}
 
 			/* add lock to blocking list before deadlock
 			 * check to prevent race */
@@ -386,13 +561,11 @@ reprocess:
 				RETURN(LDLM_ITER_STOP);
 			}
 
-                        ldlm_resource_add_lock(res, &res->lr_waiting, req);
-                        *flags |= LDLM_FL_BLOCK_GRANTED;
-                        RETURN(LDLM_ITER_STOP);
-                }
-		if (reprocess_failed)
-			RETURN(LDLM_ITER_CONTINUE);
-        }
+			ldlm_resource_add_lock(res, &res->lr_waiting, req);
+			*flags |= LDLM_FL_BLOCK_GRANTED;
+			RETURN(LDLM_ITER_STOP);
+		}
+	}
 
         if (*flags & LDLM_FL_TEST_LOCK) {
                 ldlm_flock_destroy(req, mode, *flags);
@@ -433,23 +606,13 @@ reprocess:
                             && (lock->l_policy_data.l_flock.start != 0))
                                 break;
 
-                        if (new->l_policy_data.l_flock.start <
-                            lock->l_policy_data.l_flock.start) {
-                                lock->l_policy_data.l_flock.start =
-                                        new->l_policy_data.l_flock.start;
-                        } else {
-                                new->l_policy_data.l_flock.start =
-                                        lock->l_policy_data.l_flock.start;
-                        }
-
-                        if (new->l_policy_data.l_flock.end >
-                            lock->l_policy_data.l_flock.end) {
-                                lock->l_policy_data.l_flock.end =
-                                        new->l_policy_data.l_flock.end;
-                        } else {
-                                new->l_policy_data.l_flock.end =
-                                        lock->l_policy_data.l_flock.end;
-                        }
+			/* both get the merged range */
+			start = min(new->l_policy_data.l_flock.start,
+				    lock->l_policy_data.l_flock.start);
+			end = max(new->l_policy_data.l_flock.end,
+				  lock->l_policy_data.l_flock.end);
+			ldlm_flock_range_set(lock, start, end);
+			ldlm_flock_range_set(new, start, end);
 
                         if (added) {
                                 ldlm_flock_destroy(lock, mode, *flags);
@@ -474,8 +637,9 @@ reprocess:
                     lock->l_policy_data.l_flock.start) {
                         if (new->l_policy_data.l_flock.end <
                             lock->l_policy_data.l_flock.end) {
-                                lock->l_policy_data.l_flock.start =
-                                        new->l_policy_data.l_flock.end + 1;
+				ldlm_flock_range_set(lock,
+					new->l_policy_data.l_flock.end + 1,
+					lock->l_policy_data.l_flock.end);
                                 break;
                         }
                         ldlm_flock_destroy(lock, lock->l_req_mode, *flags);
@@ -483,8 +647,9 @@ reprocess:
                 }
                 if (new->l_policy_data.l_flock.end >=
                     lock->l_policy_data.l_flock.end) {
-                        lock->l_policy_data.l_flock.end =
-                                new->l_policy_data.l_flock.start - 1;
+			ldlm_flock_range_set(lock,
+					     lock->l_policy_data.l_flock.start,
+					     new->l_policy_data.l_flock.start - 1);
                         continue;
                 }
 
@@ -526,8 +691,8 @@ reprocess:
                         lock->l_policy_data.l_flock.start;
                 new2->l_policy_data.l_flock.end =
                         new->l_policy_data.l_flock.start - 1;
-                lock->l_policy_data.l_flock.start =
-                        new->l_policy_data.l_flock.end + 1;
+		ldlm_flock_range_set(lock, new->l_policy_data.l_flock.end + 1,
+				     lock->l_policy_data.l_flock.end);
                 new2->l_conn_export = lock->l_conn_export;
                 if (lock->l_export != NULL) {
                         new2->l_export = class_export_lock_get(lock->l_export, new2);
@@ -542,7 +707,7 @@ reprocess:
                                                          lock->l_granted_mode);
 
                 /* insert new2 at lock */
-                ldlm_resource_add_lock(res, ownlocks, new2);
+		ldlm_flock_insert_lock(res, ownlocks, new2);
                 LDLM_LOCK_RELEASE(new2);
                 break;
         }
@@ -558,7 +723,7 @@ reprocess:
         if (!added) {
 		list_del_init(&req->l_res_link);
                 /* insert new lock before ownlocks in list. */
-                ldlm_resource_add_lock(res, ownlocks, req);
+		ldlm_flock_insert_lock(res, ownlocks, req);
         }
 
         if (*flags != LDLM_FL_WAIT_NOREPROC) {
@@ -849,27 +1014,33 @@ void ldlm_flock_policy_local_to_wire(const union ldlm_policy_data *lpolicy,
 }
 
 /*
- * Export handle<->flock hash operations.
+ * Export owner index operations, the key is a flock lock and the locks
+ * of the same owner on the same resource match.
  */
 static unsigned
 ldlm_export_flock_hash(struct cfs_hash *hs, const void *key, unsigned mask)
 {
-	return cfs_hash_u64_hash(*(__u64 *)key, mask);
+	const struct ldlm_lock *lock = key;
+
+	return cfs_hash_u64_hash(lock->l_policy_data.l_flock.owner ^
+				 (__u64)(unsigned long)lock->l_resource, mask);
 }
 
 static void *
 ldlm_export_flock_key(struct hlist_node *hnode)
 {
-	struct ldlm_lock *lock;
-
-	lock = hlist_entry(hnode, struct ldlm_lock, l_exp_flock_hash);
-	return &lock->l_policy_data.l_flock.owner;
+	return hlist_entry(hnode, struct ldlm_lock, l_exp_flock_hash);
 }
 
 static int
 ldlm_export_flock_keycmp(const void *key, struct hlist_node *hnode)
 {
-	return !memcmp(ldlm_export_flock_key(hnode), key, sizeof(__u64));
+	const struct ldlm_lock *req = key;
+	struct ldlm_lock *lock = ldlm_export_flock_key(hnode);
+
+	return lock->l_policy_data.l_flock.owner ==
+	       req->l_policy_data.l_flock.owner &&
+	       lock->l_resource == req->l_resource;
 }
 
 static void *
@@ -882,32 +1053,17 @@ static void
 ldlm_export_flock_get(struct cfs_hash *hs, struct hlist_node *hnode)
 {
 	struct ldlm_lock *lock;
-	struct ldlm_flock *flock;
 
 	lock = hlist_entry(hnode, struct ldlm_lock, l_exp_flock_hash);
 	LDLM_LOCK_GET(lock);
-
-	flock = &lock->l_policy_data.l_flock;
-	LASSERT(flock->blocking_export != NULL);
-	class_export_get(flock->blocking_export);
-	atomic_inc(&flock->blocking_refs);
 }
 
 static void
 ldlm_export_flock_put(struct cfs_hash *hs, struct hlist_node *hnode)
 {
 	struct ldlm_lock *lock;
-	struct ldlm_flock *flock;
 
 	lock = hlist_entry(hnode, struct ldlm_lock, l_exp_flock_hash);
-
-	flock = &lock->l_policy_data.l_flock;
-	LASSERT(flock->blocking_export != NULL);
-	class_export_put(flock->blocking_export);
-	if (atomic_dec_and_test(&flock->blocking_refs)) {
-		flock->blocking_owner = 0;
-		flock->blocking_export = NULL;
-	}
 	LDLM_LOCK_RELEASE(lock);
 }
 
@@ -949,3 +1105,93 @@ void ldlm_destroy_flock_export(struct obd_export *exp)
 	}
 	EXIT;
 }
+
+/*
+ * Namespace waiters hash operations, see struct ldlm_flock_waiter_key.
+ * Only the owner is hashed, the client nid is compared.
+ */
+static unsigned
+ldlm_ns_flock_hash(struct cfs_hash *hs, const void *key, unsigned mask)
+{
+	return cfs_hash_u64_hash(*(__u64 *)key, mask);
+}
+
+static void *
+ldlm_ns_flock_key(struct hlist_node *hnode)
+{
+	struct ldlm_lock *lock;
+
+	lock = hlist_entry(hnode, struct ldlm_lock, l_flock_waiter_hash);
+	return &lock->l_policy_data.l_flock.owner;
+}
+
+static int
+ldlm_ns_flock_keycmp(const void *key, struct hlist_node *hnode)
+{
+	const struct ldlm_flock_waiter_key *fwk = key;
+	struct ldlm_lock *lock;
+
+	lock = hlist_entry(hnode, struct ldlm_lock, l_flock_waiter_hash);
+	return lock->l_policy_data.l_flock.owner == fwk->fwk_owner &&
+	       ldlm_flock_nid(lock) == fwk->fwk_nid;
+}
+
+static void *
+ldlm_ns_flock_object(struct hlist_node *hnode)
+{
+	return hlist_entry(hnode, struct ldlm_lock, l_flock_waiter_hash);
+}
+
+static void
+ldlm_ns_flock_get(struct cfs_hash *hs, struct hlist_node *hnode)
+{
+	struct ldlm_lock *lock;
+
+	lock = hlist_entry(hnode, struct ldlm_lock, l_flock_waiter_hash);
+	LDLM_LOCK_GET(lock);
+}
+
+static void
+ldlm_ns_flock_put(struct cfs_hash *hs, struct hlist_node *hnode)
+{
+	struct ldlm_lock *lock;
+
+	lock = hlist_entry(hnode, struct ldlm_lock, l_flock_waiter_hash);
+	LDLM_LOCK_RELEASE(lock);
+}
+
+static struct cfs_hash_ops ldlm_ns_flock_ops = {
+	.hs_hash        = ldlm_ns_flock_hash,
+	.hs_key         = ldlm_ns_flock_key,
+	.hs_keycmp      = ldlm_ns_flock_keycmp,
+	.hs_object      = ldlm_ns_flock_object,
+	.hs_get         = ldlm_ns_flock_get,
+	.hs_put         = ldlm_ns_flock_put,
+	.hs_put_locked  = ldlm_ns_flock_put,
+};
+
+int ldlm_init_flock_namespace(struct ldlm_namespace *ns)
+{
+	ns->ns_flock_waiters =
+		cfs_hash_create(ns->ns_name,
+				HASH_EXP_LOCK_CUR_BITS,
+				HASH_EXP_LOCK_MAX_BITS,
+				HASH_EXP_LOCK_BKT_BITS, 0,
+				CFS_HASH_MIN_THETA, CFS_HASH_MAX_THETA,
+				&ldlm_ns_flock_ops,
+				CFS_HASH_DEFAULT | CFS_HASH_NBLK_CHANGE);
+	if (!ns->ns_flock_waiters)
+		RETURN(-ENOMEM);
+
+	RETURN(0);
+}
+
+void ldlm_destroy_flock_namespace(struct ldlm_namespace *ns)
+{
+	ENTRY;
+	if (ns->ns_flock_waiters) {
+		cfs_hash_putref(ns->ns_flock_waiters);
+		ns->ns_flock_waiters = NULL;
+	}
+	EXIT;
+}
@@ -56,16 +56,118 @@
 
 #include "ldlm_internal.h"
 
-#ifdef HAVE_SERVER_SUPPORT
+/* bits a lock is counted with; unknown bits are taken to overlap all */
+static inline __u64 ldlm_ibits_index_bits(struct ldlm_lock *lock)
+{
+	__u64 bits = lock->l_policy_data.l_inodebits.bits |
+		     lock->l_policy_data.l_inodebits.try_bits;
+
+	return bits & ~MDS_INODELOCK_FULL ? MDS_INODELOCK_FULL : bits;
+}
 
 /**
- * Determine if the lock is compatible with all locks on the queue.
+ * Count \a lock, just linked on \a queue, if its resource is indexed.
  *
- * If \a work_list is provided, conflicting locks are linked there.
- * If \a work_list is not provided, we exit this function on first conflict.
+ * The bits are remembered with the lock, so it is uncounted with exactly
+ * what it was counted with even if its try_bits are trimmed meanwhile.
+ * That leaves the counters overestimating, which only costs a walk.
+ */
+void ldlm_ibits_index_add(struct ldlm_lock *lock, struct list_head *queue)
+{
+	struct ldlm_resource *res = lock->l_resource;
+	struct ldlm_ibits_queues *liq = res->lr_ibits_queues;
+	int idx;
+	int i;
+
+	if (liq == NULL)
+		return;
+
+	LASSERT(lock->l_ibits_counts == NULL);
+	idx = ldlm_mode_to_index(lock->l_req_mode);
+	lock->l_ibits_counts = queue == &res->lr_granted ?
+			       liq->liq_granted[idx] : liq->liq_waiting[idx];
+	lock->l_ibits_counted = ldlm_ibits_index_bits(lock);
+	for (i = 0; i < MDS_INODELOCK_NUMBITS; i++)
+		if (lock->l_ibits_counted & BIT(i))
+			lock->l_ibits_counts[i]++;
+}
+
+void ldlm_ibits_index_del(struct ldlm_lock *lock)
+{
+	int i;
+
+	if (lock->l_ibits_counts == NULL)
+		return;
+
+	for (i = 0; i < MDS_INODELOCK_NUMBITS; i++) {
+		if (!(lock->l_ibits_counted & BIT(i)))
+			continue;
+		LASSERT(lock->l_ibits_counts[i] > 0);
+		lock->l_ibits_counts[i]--;
+	}
+	lock->l_ibits_counts = NULL;
+}
+
+#ifdef HAVE_SERVER_SUPPORT
+
+/* queues shorter than this are cheaper to walk than to keep counted */
+#define LDLM_IBITS_INDEX_MIN	32
+
+static void ldlm_ibits_index_build(struct ldlm_resource *res)
+{
+	struct ldlm_ibits_queues *liq;
+	struct ldlm_lock *lock;
+
+	/* under lr_lock */
+	OBD_ALLOC_GFP(liq, sizeof(*liq), GFP_ATOMIC);
+	if (liq == NULL)
+		return;
+
+	res->lr_ibits_queues = liq;
+	list_for_each_entry(lock, &res->lr_granted, l_res_link)
+		ldlm_ibits_index_add(lock, &res->lr_granted);
+	list_for_each_entry(lock, &res->lr_waiting, l_res_link)
+		ldlm_ibits_index_add(lock, &res->lr_waiting);
+}
+
+/**
+ * Check the counters of an indexed resource for locks on \a queue of a
+ * mode incompatible with \a req which share a bit with it. Only those can
+ * conflict with \a req or trim try_bits, on either side.
  *
- * \retval 0 if there are conflicting locks in the \a queue
- * \retval 1 if the lock is compatible to all locks in \a queue
+ * \retval false if \a queue doesn't need to be walked
+ */
+static bool
+ldlm_ibits_queue_may_conflict(struct list_head *queue, struct ldlm_lock *req)
+{
+	struct ldlm_resource *res = req->l_resource;
+	struct ldlm_ibits_queues *liq = res->lr_ibits_queues;
+	__u32 (*counts)[MDS_INODELOCK_NUMBITS];
+	__u64 bits;
+	int idx;
+	int i;
+
+	if (liq == NULL)
+		return true;
+
+	bits = ldlm_ibits_index_bits(req);
+	counts = queue == &res->lr_granted ? liq->liq_granted :
+					     liq->liq_waiting;
+	for (idx = 0; idx < LCK_MODE_NUM; idx++) {
+		if (lockmode_compat(1 << idx, req->l_req_mode))
+			continue;
+		for (i = 0; i < MDS_INODELOCK_NUMBITS; i++)
+			if ((bits & BIT(i)) && counts[idx][i] != 0)
+				return true;
+	}
+
+	return false;
+}
+
+/**
+ * Walk \a queue for locks conflicting with \a req, see
+ * ldlm_inodebits_compat_queue(). \a walked counts the mode and policy
+ * groups looked at.
  *
  * IBITS locks in granted queue are organized in bunches of
  * same-mode/same-bits locks called "skip lists". The First lock in the
@@ -74,8 +176,8 @@
  * locks if first lock of the bunch is not conflicting with us.
  */
 static int
-ldlm_inodebits_compat_queue(struct list_head *queue, struct ldlm_lock *req,
-			    struct list_head *work_list)
+ldlm_inodebits_compat_walk(struct list_head *queue, struct ldlm_lock *req,
+			   struct list_head *work_list, int *walked)
 {
 	struct list_head *tmp;
 	struct ldlm_lock *lock;
@@ -85,17 +187,10 @@ ldlm_inodebits_compat_queue(struct list_head *queue, struct ldlm_lock *req,
 
 	ENTRY;
 
-	/* There is no sense in lock with no bits set. Also such a lock
-	 * would be compatible with any other bit lock.
-	 * Meanwhile that can be true if there were just try_bits and all
-	 * are failed, so just exit gracefully and let the caller to care.
-	 */
-	if ((req_bits | *try_bits) == 0)
-		RETURN(0);
-
 	list_for_each(tmp, queue) {
 		struct list_head *mode_tail;
 
+		(*walked)++;
 		lock = list_entry(tmp, struct ldlm_lock, l_res_link);
 
 		/* We stop walking the queue if we hit ourselves so we don't
@@ -129,6 +224,7 @@ ldlm_inodebits_compat_queue(struct list_head *queue, struct ldlm_lock *req,
 		for (;;) {
 			struct list_head *head;
 
+			(*walked)++;
 			/* Advance loop cursor to last lock in policy group. */
 			tmp = &list_entry(lock->l_sl_policy.prev,
 					  struct ldlm_lock,
@@ -190,6 +286,46 @@ not_conflicting:
 	RETURN(compat);
 }
 
+/**
+ * Determine if the lock is compatible with all locks on the queue.
+ *
+ * If \a work_list is provided, conflicting locks are linked there.
+ * If \a work_list is not provided, we exit this function on first conflict.
+ *
+ * \retval 0 if there are conflicting locks in the \a queue
+ * \retval 1 if the lock is compatible to all locks in \a queue
+ *
+ * Once the queues of a resource get long, they are counted per mode and
+ * bit in lr_ibits_queues, and a queue with nothing to conflict with isn't
+ * walked at all, so a request costs O(conflicts) and not O(locks).
+ */
+static int
+ldlm_inodebits_compat_queue(struct list_head *queue, struct ldlm_lock *req,
+			    struct list_head *work_list)
+{
+	struct ldlm_resource *res = req->l_resource;
+	int walked = 0;
+	int rc;
+
+	/* There is no sense in lock with no bits set. Also such a lock
+	 * would be compatible with any other bit lock.
+	 * Meanwhile that can be true if there were just try_bits and all
+	 * are failed, so just exit gracefully and let the caller to care.
+	 */
+	if ((req->l_policy_data.l_inodebits.bits |
+	     req->l_policy_data.l_inodebits.try_bits) == 0)
+		return 0;
+
+	if (!ldlm_ibits_queue_may_conflict(queue, req))
+		return 1;
+
+	rc = ldlm_inodebits_compat_walk(queue, req, work_list, &walked);
+	if (walked >= LDLM_IBITS_INDEX_MIN && res->lr_ibits_queues == NULL)
+		ldlm_ibits_index_build(res);
+
+	return rc;
+}
+
 /**
  * Process a granting attempt for IBITS lock.
  * Must be called with ns lock held
@@ -294,6 +430,126 @@ int ldlm_process_inodebits_lock(struct ldlm_lock *lock, __u64 *flags,
 
 	RETURN(LDLM_ITER_CONTINUE);
 }
+
+#define LDLM_IBITS_BENCH_LOOPS	16
+
+static DEFINE_MUTEX(ldlm_ibits_bench_mutex);
+
+/**
+ * Microbenchmark of the compatibility check on a hot directory.
+ *
+ * A private resource in \a ns gets \a nlocks granted PR LOOKUP locks, a
+ * PR LAYOUT and a PW UPDATE lock, and \a nlocks PR UPDATE requests waiting
+ * for the latter. The time an EX LAYOUT enqueue spends checking both
+ * queues is reported in \a walk_ns by walking them, and in \a indexed_ns
+ * with the resource indexed.
+ */
+int ldlm_ibits_bench(struct ldlm_namespace *ns, int nlocks,
+		     __u64 *walk_ns, __u64 *indexed_ns)
+{
+	const struct ldlm_res_id res_id = { .name = { ~0ULL, ~0ULL } };
+	struct ldlm_resource *res;
+	struct ldlm_lock **locks;
+	struct ldlm_lock *req;
+	int total = 2 * nlocks + 2;
+	int walked = 0;
+	ktime_t start;
+	int rc = 0;
+	int i;
+
+	ENTRY;
+
+	if (!ns_is_server(ns))
+		RETURN(-EOPNOTSUPP);
+
+	OBD_ALLOC_LARGE(locks, total * sizeof(*locks));
+	if (locks == NULL)
+		RETURN(-ENOMEM);
+
+	*walk_ns = 0;
+	*indexed_ns = 0;
+	mutex_lock(&ldlm_ibits_bench_mutex);
+	req = ldlm_lock_create(ns, &res_id, LDLM_IBITS, LCK_EX, NULL, NULL, 0,
+			       LVB_T_NONE);
+	if (IS_ERR(req))
+		GOTO(out_free, rc = PTR_ERR(req));
+	req->l_policy_data.l_inodebits.bits = MDS_INODELOCK_LAYOUT;
+	res = req->l_resource;
+
+	for (i = 0; i < total; i++) {
+		enum ldlm_mode mode = LCK_PR;
+		__u64 bits = MDS_INODELOCK_LOOKUP;
+		struct ldlm_lock *lock;
+
+		if (i == nlocks) {
+			bits = MDS_INODELOCK_LAYOUT;
+		} else if (i == nlocks + 1) {
+			mode = LCK_PW;
+			bits = MDS_INODELOCK_UPDATE;
+		} else if (i > nlocks) {
+			bits = MDS_INODELOCK_UPDATE;
+		}
+
+		lock = ldlm_lock_create(ns, &res_id, LDLM_IBITS, mode, NULL,
+					NULL, 0, LVB_T_NONE);
+		if (IS_ERR(lock))
+			GOTO(out_locks, rc = PTR_ERR(lock));
+		locks[i] = lock;
+		lock->l_policy_data.l_inodebits.bits = bits;
+
+		lock_res(res);
+		if (i <= nlocks + 1) {
+			lock->l_granted_mode = mode;
+			ldlm_grant_lock_with_skiplist(lock);
+		} else {
+			ldlm_resource_add_lock(res, &res->lr_waiting, lock);
+		}
+		unlock_res(res);
+	}
+
+	lock_res(res);
+	if (res->lr_ibits_queues == NULL) {
+		start = ktime_get();
+		for (i = 0; i < LDLM_IBITS_BENCH_LOOPS; i++) {
+			ldlm_inodebits_compat_walk(&res->lr_granted, req,
+						   NULL, &walked);
+			ldlm_inodebits_compat_walk(&res->lr_waiting, req,
+						   NULL, &walked);
+		}
+		*walk_ns = div_u64(ktime_to_ns(ktime_sub(ktime_get(), start)),
+				   LDLM_IBITS_BENCH_LOOPS);
+		ldlm_ibits_index_build(res);
+	}
+	if (res->lr_ibits_queues == NULL) {
+		unlock_res(res);
+		GOTO(out_locks, rc = -ENOMEM);
+	}
+
+	start = ktime_get();
+	for (i = 0; i < LDLM_IBITS_BENCH_LOOPS; i++) {
+		ldlm_inodebits_compat_queue(&res->lr_granted, req, NULL);
+		ldlm_inodebits_compat_queue(&res->lr_waiting, req, NULL);
+	}
+	*indexed_ns = div_u64(ktime_to_ns(ktime_sub(ktime_get(), start)),
+			      LDLM_IBITS_BENCH_LOOPS);
+	unlock_res(res);
+
+	i = total;
+out_locks:
+	while (--i >= 0) {
+		lock_res(res);
+		ldlm_resource_unlink_lock(locks[i]);
+		unlock_res(res);
+		ldlm_lock_destroy(locks[i]);
+		LDLM_LOCK_RELEASE(locks[i]);
+	}
+	ldlm_lock_destroy(req);
+	LDLM_LOCK_RELEASE(req);
+out_free:
+	mutex_unlock(&ldlm_ibits_bench_mutex);
+	OBD_FREE_LARGE(locks, total * sizeof(*locks));
+	RETURN(rc);
+}
 #endif /* HAVE_SERVER_SUPPORT */
 
 void ldlm_ibits_policy_wire_to_local(const union ldlm_wire_policy_data *wpolicy,
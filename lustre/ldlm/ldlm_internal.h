@@ -116,6 +116,7 @@ int ldlm_cancel_lru_local(struct ldlm_namespace *ns,
 			  struct list_head *cancels, int count, int max,
 			  enum ldlm_cancel_flags cancel_flags,
 			  enum ldlm_lru_flags lru_flags);
+int ldlm_request_bufsize(int count, int type);
 extern unsigned int ldlm_enqueue_min;
 /* ldlm_resource.c */
 extern struct kmem_cache *ldlm_resource_slab;
@@ -170,6 +171,8 @@ int ldlm_lock_remove_from_lru_check(struct ldlm_lock *lock, ktime_t last_use);
 #define ldlm_lock_remove_from_lru(lock) \
 		ldlm_lock_remove_from_lru_check(lock, ktime_set(0, 0))
 int ldlm_lock_remove_from_lru_nolock(struct ldlm_lock *lock);
+void ldlm_namespace_set_lru_policy(struct ldlm_namespace *ns,
+				   enum ldlm_lru_policy policy);
 void ldlm_lock_add_to_lru_nolock(struct ldlm_lock *lock);
 void ldlm_lock_add_to_lru(struct ldlm_lock *lock);
 void ldlm_lock_touch_in_lru(struct ldlm_lock *lock);
@@ -187,6 +190,9 @@ int ldlm_bl_to_thread_list(struct ldlm_namespace *ns,
 			   struct list_head *cancels, int count,
 			   enum ldlm_cancel_flags cancel_flags);
 int ldlm_bl_thread_wakeup(void);
+int ldlm_bl_stats_seq_show(struct seq_file *m, void *v);
+ssize_t ldlm_bl_stats_seq_write(struct file *file, const char __user *buffer,
+				size_t count, loff_t *off);
 
 void ldlm_handle_bl_callback(struct ldlm_namespace *ns,
                              struct ldlm_lock_desc *ld, struct ldlm_lock *lock);
@@ -202,13 +208,52 @@ int ldlm_process_inodebits_lock(struct ldlm_lock *lock, __u64 *flags,
 				enum ldlm_process_intention intention,
 				enum ldlm_error *err,
 				struct list_head *work_list);
+int ldlm_ibits_bench(struct ldlm_namespace *ns, int nlocks,
+		     __u64 *walk_ns, __u64 *indexed_ns);
 /* ldlm_extent.c */
 int ldlm_process_extent_lock(struct ldlm_lock *lock, __u64 *flags,
 			     enum ldlm_process_intention intention,
 			     enum ldlm_error *err, struct list_head *work_list);
+int ldlm_extent_convert(struct ldlm_lock *lock,
+			const struct ldlm_lock_desc *desc);
 #endif
+/* ldlm_inodebits.c */
+void ldlm_ibits_index_add(struct ldlm_lock *lock, struct list_head *queue);
+void ldlm_ibits_index_del(struct ldlm_lock *lock);
+
+static inline int ldlm_mode_to_index(enum ldlm_mode mode)
+{
+	int index;
+
+	LASSERT(mode != 0);
+	LASSERT(is_power_of_2(mode));
+	for (index = -1; mode != 0; index++, mode >>= 1)
+		/* do nothing */;
+	LASSERT(index < LCK_MODE_NUM);
+	return index;
+}
+
+/**
+ * Granted lock modes conflicting with \a mode, as a tag mask for the
+ * resource interval tree. Nodes of the tree are tagged with the granted
+ * mode of their locks, see ldlm_extent_add_lock().
+ */
+static inline __u16 ldlm_conflict_mask(enum ldlm_mode mode)
+{
+	__u16 mask = 0;
+	int idx;
+
+	for (idx = 0; idx < LCK_MODE_NUM; idx++)
+		if (!lockmode_compat(1 << idx, mode))
+			mask |= 1 << idx;
+	return mask;
+}
+
 void ldlm_extent_add_lock(struct ldlm_resource *res, struct ldlm_lock *lock);
 void ldlm_extent_unlink_lock(struct ldlm_lock *lock);
+void ldlm_extent_shrink(struct ldlm_lock *lock, enum ldlm_mode mode,
+			const struct ldlm_extent *extent,
+			struct ldlm_interval *node);
 
 /* ldlm_flock.c */
 int ldlm_process_flock_lock(struct ldlm_lock *req, __u64 *flags,
@@ -216,6 +261,10 @@ int ldlm_process_flock_lock(struct ldlm_lock *req, __u64 *flags,
 			    enum ldlm_error *err, struct list_head *work_list);
 int ldlm_init_flock_export(struct obd_export *exp);
 void ldlm_destroy_flock_export(struct obd_export *exp);
+int ldlm_init_flock_namespace(struct ldlm_namespace *ns);
+void ldlm_destroy_flock_namespace(struct ldlm_namespace *ns);
+void ldlm_flock_add_lock(struct ldlm_resource *res, struct ldlm_lock *lock);
+void ldlm_flock_unlink_lock(struct ldlm_lock *lock);
 
 /* l_lock.c */
 void l_check_ns_lock(struct ldlm_namespace *ns);
@@ -408,6 +457,7 @@ void ldlm_reclaim_cleanup(void);
 void ldlm_reclaim_add(struct ldlm_lock *lock);
 void ldlm_reclaim_del(struct ldlm_lock *lock);
 bool ldlm_reclaim_full(void);
+bool ldlm_reclaim_pressure(void);
 
 static inline bool ldlm_res_eq(const struct ldlm_res_id *res0,
 			       const struct ldlm_res_id *res1)
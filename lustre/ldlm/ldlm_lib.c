@@ -464,6 +464,10 @@ int client_obd_setup(struct obd_device *obddev, struct lustre_cfg *lcfg)
 	init_waitqueue_head(&cli->cl_mod_rpcs_waitq);
 	cli->cl_mod_tag_bitmap = NULL;
 
+	spin_lock_init(&cli->cl_intent_lock);
+	INIT_LIST_HEAD(&cli->cl_intent_list);
+	cli->cl_intent_dedup = 1;
+
 	INIT_LIST_HEAD(&cli->cl_chg_dev_linkage);
 
 	if (connect_op == MDS_CONNECT) {
@@ -3055,6 +3059,12 @@ int target_pack_pool_reply(struct ptlrpc_request *req)
 	lustre_msg_set_limit(req->rq_repmsg, obd->obd_pool_limit);
 	read_unlock(&obd->obd_pool_lock);
 
+	/* clients with lock budgets get their own share instead of the
+	 * pool limit */
+	if (exp_connect_lock_budget(req->rq_export))
+		lustre_msg_set_limit(req->rq_repmsg,
+				     ldlm_export_lock_budget(req->rq_export));
+
 	RETURN(0);
 }
 
@@ -234,6 +234,13 @@ int ldlm_lock_remove_from_lru_nolock(struct ldlm_lock *lock)
 		LASSERT(lock->l_resource->lr_type != LDLM_FLOCK);
 		if (ns->ns_last_pos == &lock->l_lru)
 			ns->ns_last_pos = lock->l_lru.prev;
+		if (ns->ns_protected_pos == &lock->l_lru)
+			ns->ns_protected_pos = lock->l_lru.prev;
+		if (lock->l_lru_protected) {
+			lock->l_lru_protected = 0;
+			LASSERT(ns->ns_nr_protected > 0);
+			ns->ns_nr_protected--;
+		}
 		list_del_init(&lock->l_lru);
 		LASSERT(ns->ns_nr_unused > 0);
 		ns->ns_nr_unused--;
@@ -242,6 +249,27 @@ int ldlm_lock_remove_from_lru_nolock(struct ldlm_lock *lock)
 	return rc;
 }
 
+/**
+ * Removes LDLM lock \a lock from LRU as it is being used again, and counts
+ * the LRU hit.
+ */
+static void ldlm_lock_remove_from_lru_hit(struct ldlm_lock *lock)
+{
+	struct ldlm_namespace *ns = ldlm_lock_to_ns(lock);
+
+	if (ldlm_is_ns_srv(lock)) {
+		LASSERT(list_empty(&lock->l_lru));
+		return;
+	}
+
+	spin_lock(&ns->ns_lock);
+	if (ldlm_lock_remove_from_lru_nolock(lock)) {
+		lock->l_lru_hits++;
+		ns->ns_lru_stats.ls_hits++;
+	}
+	spin_unlock(&ns->ns_lock);
+}
+
 /**
  * Removes LDLM lock \a lock from LRU. Obtains the LRU lock first.
  *
@@ -279,13 +307,79 @@ int ldlm_lock_remove_from_lru_check(struct ldlm_lock *lock, ktime_t last_use)
 void ldlm_lock_add_to_lru_nolock(struct ldlm_lock *lock)
 {
 	struct ldlm_namespace *ns = ldlm_lock_to_ns(lock);
+	struct ldlm_lock *oldest;
 
 	lock->l_last_used = ktime_get();
 	LASSERT(list_empty(&lock->l_lru));
 	LASSERT(lock->l_resource->lr_type != LDLM_FLOCK);
-	list_add_tail(&lock->l_lru, &ns->ns_unused_list);
 	LASSERT(ns->ns_nr_unused >= 0);
 	ns->ns_nr_unused++;
+	ns->ns_lru_stats.ls_inserts++;
+
+	if (ns->ns_lru_policy != LDLM_LRU_POLICY_2Q || lock->l_lru_hits == 0) {
+		/* used once, or all locks with plain LRU */
+		list_add_tail(&lock->l_lru, &ns->ns_unused_list);
+		return;
+	}
+
+	list_add_tail(&lock->l_lru, &ns->ns_lru_protected);
+	lock->l_lru_protected = 1;
+	ns->ns_nr_protected++;
+	ns->ns_lru_stats.ls_promotions++;
+
+	/*
+	 * Keep the protected part within its share of the LRU, its oldest
+	 * locks become the most recent unprotected ones.  They restart their
+	 * age there, so that ns_unused_list stays in the order of l_last_used
+	 * and they are still aged out by ns_max_age.
+	 */
+	while (ns->ns_nr_protected >
+	       ns->ns_nr_unused * LDLM_LRU_PROTECTED_PCT / 100) {
+		oldest = list_entry(ns->ns_lru_protected.next,
+				    struct ldlm_lock, l_lru);
+		LASSERT(oldest->l_lru_protected);
+		if (ns->ns_protected_pos == &oldest->l_lru)
+			ns->ns_protected_pos = &ns->ns_lru_protected;
+		oldest->l_lru_protected = 0;
+		oldest->l_last_used = lock->l_last_used;
+		list_move_tail(&oldest->l_lru, &ns->ns_unused_list);
+		ns->ns_nr_protected--;
+		ns->ns_lru_stats.ls_demotions++;
+	}
+}
+
+/**
+ * Changes LRU policy of namespace \a ns. Protected locks lose their status
+ * when the plain LRU policy is set, they are merged back into ns_unused_list
+ * in the order of their last use.
+ */
+void ldlm_namespace_set_lru_policy(struct ldlm_namespace *ns,
+				   enum ldlm_lru_policy policy)
+{
+	struct ldlm_lock *lock;
+	struct ldlm_lock *tmp;
+	struct list_head *pos;
+
+	spin_lock(&ns->ns_lock);
+	if (policy == LDLM_LRU_POLICY_LRU && ns->ns_nr_protected > 0) {
+		pos = ns->ns_unused_list.next;
+		list_for_each_entry_safe(lock, tmp, &ns->ns_lru_protected,
+					 l_lru) {
+			while (pos != &ns->ns_unused_list &&
+			       !ktime_after(list_entry(pos, struct ldlm_lock,
+						       l_lru)->l_last_used,
+					    lock->l_last_used))
+				pos = pos->next;
+			lock->l_lru_protected = 0;
+			list_move_tail(&lock->l_lru, pos);
+		}
+		ns->ns_nr_protected = 0;
+		ns->ns_protected_pos = &ns->ns_lru_protected;
+		/* merged locks may be before it, have no_wait scans see them */
+		ns->ns_last_pos = &ns->ns_unused_list;
+	}
+	ns->ns_lru_policy = policy;
+	spin_unlock(&ns->ns_lock);
 }
 
 /**
@@ -321,6 +415,8 @@ void ldlm_lock_touch_in_lru(struct ldlm_lock *lock)
 	spin_lock(&ns->ns_lock);
 	if (!list_empty(&lock->l_lru)) {
 		ldlm_lock_remove_from_lru_nolock(lock);
+		lock->l_lru_hits++;
+		ns->ns_lru_stats.ls_hits++;
 		ldlm_lock_add_to_lru_nolock(lock);
 	}
 	spin_unlock(&ns->ns_lock);
@@ -737,7 +833,7 @@ EXPORT_SYMBOL(ldlm_lock_addref);
 void ldlm_lock_addref_internal_nolock(struct ldlm_lock *lock,
 				      enum ldlm_mode mode)
 {
-        ldlm_lock_remove_from_lru(lock);
+	ldlm_lock_remove_from_lru_hit(lock);
         if (mode & (LCK_NL | LCK_CR | LCK_PR)) {
                 lock->l_readers++;
                 lu_ref_add_atomic(&lock->l_reference, "reader", lock);
@@ -1070,6 +1166,8 @@ static void ldlm_granted_list_add_lock(struct ldlm_lock *lock,
 		list_add(&lock->l_sl_mode, prev->mode_link);
 	if (&lock->l_sl_policy != prev->policy_link)
 		list_add(&lock->l_sl_policy, prev->policy_link);
+	if (res->lr_type == LDLM_IBITS)
+		ldlm_ibits_index_add(lock, &res->lr_granted);
 
         EXIT;
 }
@@ -1126,7 +1224,7 @@ void ldlm_grant_lock(struct ldlm_lock *lock, struct list_head *work_list)
 		    ldlm_is_test_lock(lock) ||
 		    ldlm_is_flock_deadlock(lock))
 			RETURN_EXIT;
-		ldlm_resource_add_lock(res, &res->lr_granted, lock);
+		ldlm_flock_add_lock(res, lock);
 	} else {
 		LBUG();
 	}
@@ -1263,21 +1361,23 @@ static struct ldlm_lock *search_itree(struct ldlm_resource *res,
 		.start     = data->lmd_policy->l_extent.start,
 		.end       = data->lmd_policy->l_extent.end
 	};
+	struct ldlm_interval_tree *tree = res->lr_itree;
 	int idx;
 
 	data->lmd_lock = NULL;
 
+	/* modes are still searched one at a time to keep the preference
+	 * order, the walk skips subtrees without locks of that mode */
 	for (idx = 0; idx < LCK_MODE_NUM; idx++) {
-		struct ldlm_interval_tree *tree = &res->lr_itree[idx];
-
 		if (tree->lit_root == NULL)
-			continue;
+			break;
 
-		if (!(tree->lit_mode & *data->lmd_mode))
+		if (tree->lit_size[idx] == 0 ||
+		    !((1 << idx) & *data->lmd_mode))
 			continue;
 
-		interval_search(tree->lit_root, &ext,
-				itree_overlap_cb, data);
+		interval_search_mask(tree->lit_root, &ext, 1 << idx,
+				     itree_overlap_cb, data);
 		if (data->lmd_lock)
 			return data->lmd_lock;
 	}
@@ -1667,8 +1767,8 @@ struct ldlm_lock *ldlm_lock_create(struct ldlm_namespace *ns,
 	}
 
 	lock->l_tree_node = NULL;
-	/* if this is the extent lock, allocate the interval tree node */
-	if (type == LDLM_EXTENT)
+	/* extent and flock locks need an interval tree node */
+	if (type == LDLM_EXTENT || type == LDLM_FLOCK)
 		if (ldlm_interval_alloc(lock) == NULL)
 			GOTO(out, rc = -ENOMEM);
 
@@ -2032,6 +2132,51 @@ void ldlm_discard_bl_list(struct list_head *bl_list)
 	EXIT;
 }
 
+/**
+ * Move to \a batch the locks in the ast_work list which belong to the same
+ * client as \a lock and are blocked by the same lock, so that they can be
+ * revoked by the blocking AST RPC of \a lock.
+ *
+ * Called with \a lock resource locked. Locks sharing the blocking lock are
+ * on the same resource, so this also protects them.
+ *
+ * \retval number of locks moved to \a batch
+ */
+static int ldlm_bl_ast_batch_gather(struct ldlm_cb_set_arg *arg,
+				    struct ldlm_lock *lock,
+				    struct list_head *batch)
+{
+	struct ldlm_namespace *ns = ldlm_lock_to_ns(lock);
+	struct ldlm_lock *next;
+	struct ldlm_lock *tmp;
+	unsigned int max = ns->ns_max_bl_ast_batch;
+	int count = 0;
+
+	if (max <= 1 || lock->l_export == NULL ||
+	    !exp_connect_batch_bl_ast(lock->l_export))
+		return 0;
+
+	list_for_each_entry_safe(next, tmp, arg->list, l_bl_ast) {
+		if (count + 1 >= max)
+			break;
+
+		if (next->l_export != lock->l_export ||
+		    next->l_blocking_lock != lock->l_blocking_lock ||
+		    next->l_blocking_ast != lock->l_blocking_ast ||
+		    !ldlm_is_ast_sent(next))
+			continue;
+
+		LASSERT(next->l_resource == lock->l_resource);
+		LASSERT(next->l_bl_ast_run == 0);
+		next->l_bl_ast_run++;
+		ldlm_clear_blocking_lock(next);
+		list_move_tail(&next->l_bl_ast, batch);
+		count++;
+	}
+
+	return count;
+}
+
 /**
  * Process a call to blocking AST callback for a lock in ast_work list
  */
@@ -2040,8 +2185,10 @@ ldlm_work_bl_ast_lock(struct ptlrpc_request_set *rqset, void *opaq)
 {
 	struct ldlm_cb_set_arg *arg = opaq;
 	struct ldlm_lock *lock;
+	struct ldlm_lock *next;
 	struct ldlm_lock_desc d;
 	struct ldlm_bl_desc bld;
+	struct list_head batch = LIST_HEAD_INIT(batch);
 	int rc;
 
 	ENTRY;
@@ -2089,13 +2236,26 @@ ldlm_work_bl_ast_lock(struct ptlrpc_request_set *rqset, void *opaq)
 	LASSERT(ldlm_is_ast_sent(lock));
 	LASSERT(lock->l_bl_ast_run == 0);
 	lock->l_bl_ast_run++;
+	if (arg->type == LDLM_BL_CALLBACK &&
+	    ldlm_bl_ast_batch_gather(arg, lock, &batch) > 0)
+		arg->bl_batch = &batch;
 	ldlm_clear_blocking_lock(lock);
 	unlock_res_and_lock(lock);
 
 	rc = lock->l_blocking_ast(lock, &d, (void *)arg, LDLM_CB_BLOCKING);
+	arg->bl_batch = NULL;
 
 	LDLM_LOCK_RELEASE(lock);
 
+	/* locks taken by the batched AST are removed from the list along with
+	 * their reference, the rest are sent one by one */
+	while (!list_empty(&batch)) {
+		next = list_entry(batch.next, struct ldlm_lock, l_bl_ast);
+		list_del_init(&next->l_bl_ast);
+		next->l_blocking_ast(next, &d, (void *)arg, LDLM_CB_BLOCKING);
+		LDLM_LOCK_RELEASE(next);
+	}
+
 	RETURN(rc);
 }
 
@@ -2339,11 +2499,8 @@ void ldlm_reprocess_all(struct ldlm_resource *res)
 }
 EXPORT_SYMBOL(ldlm_reprocess_all);
 
-static int ldlm_reprocess_res(struct cfs_hash *hs, struct cfs_hash_bd *bd,
-			      struct hlist_node *hnode, void *arg)
+static int ldlm_reprocess_res(struct ldlm_resource *res, void *arg)
 {
-	struct ldlm_resource *res = cfs_hash_object(hs, hnode);
-
 	/* This is only called once after recovery done. LU-8306. */
 	__ldlm_reprocess_all(res, LDLM_PROCESS_RECOVERY);
 	return 0;
@@ -2357,10 +2514,8 @@ void ldlm_reprocess_recovery_done(struct ldlm_namespace *ns)
 {
 	ENTRY;
 
-	if (ns != NULL) {
-		cfs_hash_for_each_nolock(ns->ns_rs_hash,
-					 ldlm_reprocess_res, NULL, 0);
-	}
+	if (ns != NULL)
+		ldlm_namespace_foreach_res(ns, ldlm_reprocess_res, NULL);
 	EXIT;
 }
 
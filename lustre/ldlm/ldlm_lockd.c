@@ -82,28 +82,65 @@ static inline time_t ldlm_get_rq_timeout(void)
 	return timeout < 1 ? 1 : timeout;
 }
 
-struct ldlm_bl_pool {
-	spinlock_t blp_lock;
-
+/*
+ * Classes of blocking callback work, in the order they are served.
+ */
+enum ldlm_bl_class {
 	/*
-	 * blp_prio_list is used for callbacks that should be handled
-	 * as a priority. It is used for LDLM_FL_DISCARD_DATA requests.
-	 * see b=13843
+	 * LDLM_FL_DISCARD_DATA requests, which are quick as there is
+	 * nothing to flush, see b=13843.
 	 */
-	struct list_head blp_prio_list;
-
+	LDLM_BL_PRIO,
 	/*
-	 * blp_list is used for all other callbacks which are likely
-	 * to take longer to process.
+	 * Metadata and config locks, other clients' metadata operations
+	 * wait for their cancel.
 	 */
-	struct list_head blp_list;
-
-	wait_queue_head_t blp_waitq;
-	struct completion blp_comp;
-	atomic_t blp_num_threads;
-	atomic_t blp_busy_threads;
-	int blp_min_threads;
-	int blp_max_threads;
+	LDLM_BL_MD,
+	/* Data locks, their cancel may have to flush dirty pages. */
+	LDLM_BL_DATA,
+	LDLM_BL_NR
+};
+
+static const char * const ldlm_bl_class_names[LDLM_BL_NR] = {
+	[LDLM_BL_PRIO]	= "prio",
+	[LDLM_BL_MD]	= "metadata",
+	[LDLM_BL_DATA]	= "data",
+};
+
+struct ldlm_bl_queue_stats {
+	__u64	bqs_count;
+	/* time spent queued, in microseconds */
+	__u64	bqs_wait_total;
+	__u64	bqs_wait_max;
+};
+
+/*
+ * One partition of the blocking callback pool per CPT, work is queued on
+ * the partition of the CPU it comes from and handled by threads bound to
+ * that CPT.
+ */
+struct ldlm_bl_part {
+	spinlock_t			bp_lock;
+	struct list_head		bp_lists[LDLM_BL_NR];
+	int				bp_queued[LDLM_BL_NR];
+	struct ldlm_bl_queue_stats	bp_stats[LDLM_BL_NR];
+	/* items handled in the current data fairness period */
+	int				bp_num_bl;
+	/* stale exports handled since the last work item */
+	unsigned int			bp_num_stale;
+	wait_queue_head_t		bp_waitq;
+	atomic_t			bp_num_threads;
+	atomic_t			bp_busy_threads;
+	int				bp_cpt;
+};
+
+struct ldlm_bl_pool {
+	struct completion	blp_comp;
+	/* thread limits are per partition */
+	int			blp_min_threads;
+	int			blp_max_threads;
+	int			blp_nparts;
+	struct ldlm_bl_part	**blp_parts;
 };
 
 struct ldlm_bl_work_item {
@@ -116,6 +153,7 @@ struct ldlm_bl_work_item {
 	struct completion	blwi_comp;
 	enum ldlm_cancel_flags	blwi_flags;
 	int			blwi_mem_pressure;
+	ktime_t			blwi_queued;
 };
 
 #ifdef HAVE_SERVER_SUPPORT
@@ -735,6 +773,67 @@ static int ldlm_handle_ast_error(struct ldlm_lock *lock,
 	return rc;
 }
 
+/* whether the client listed \a lock in the reply to a batched blocking AST */
+static bool ldlm_bl_batch_gone(struct ldlm_request *gone, int nr_gone,
+			       struct ldlm_lock *lock)
+{
+	int i;
+
+	for (i = 0; i < nr_gone; i++)
+		if (gone->lock_handle[i].cookie == lock->l_remote_handle.cookie)
+			return true;
+
+	return false;
+}
+
+/**
+ * Handle the reply to a batched blocking AST for the locks other than
+ * ca_lock, and return the result for ca_lock itself.
+ *
+ * The client replies with the handles of the locks it no longer has, these
+ * are cancelled as for the -EINVAL reply to a single lock AST.
+ */
+static int ldlm_cb_interpret_batch(struct ptlrpc_request *req,
+				   struct ldlm_cb_async_args *ca, int rc)
+{
+	struct ldlm_cb_set_arg *arg = ca->ca_set_arg;
+	struct ldlm_request *gone = NULL;
+	struct ldlm_lock *lock;
+	int nr_gone = 0;
+	int lrc;
+	int i;
+
+	if (rc == 0) {
+		gone = req_capsule_server_get(&req->rq_pill, &RMF_DLM_REQ);
+		if (gone != NULL &&
+		    req_capsule_get_size(&req->rq_pill, &RMF_DLM_REQ,
+					 RCL_SERVER) >=
+		    ldlm_request_bufsize(gone->lock_count, LDLM_BL_CALLBACK))
+			nr_gone = gone->lock_count;
+	}
+
+	for (i = 0; i < ca->ca_batch_count; i++) {
+		lock = ca->ca_batch[i];
+		lrc = rc;
+		if (ldlm_bl_batch_gone(gone, nr_gone, lock))
+			lrc = -EINVAL;
+		if (lrc != 0)
+			lrc = ldlm_handle_ast_error(lock, req, lrc, "blocking");
+		if (lrc == -ERESTART)
+			atomic_inc(&arg->restart);
+		LDLM_LOCK_RELEASE(lock);
+	}
+
+	OBD_FREE(ca->ca_batch, ca->ca_batch_size * sizeof(*ca->ca_batch));
+	ca->ca_batch = NULL;
+	ca->ca_batch_count = 0;
+
+	if (ldlm_bl_batch_gone(gone, nr_gone, ca->ca_lock))
+		rc = -EINVAL;
+
+	return rc;
+}
+
 static int ldlm_cb_interpret(const struct lu_env *env,
 			     struct ptlrpc_request *req, void *args, int rc)
 {
@@ -771,6 +870,8 @@ static int ldlm_cb_interpret(const struct lu_env *env,
 		}
 		break;
 	case LDLM_BL_CALLBACK:
+		if (ca->ca_batch_count > 0)
+			rc = ldlm_cb_interpret_batch(req, ca, rc);
 		if (rc != 0)
 			rc = ldlm_handle_ast_error(lock, req, rc, "blocking");
 		break;
@@ -797,8 +898,12 @@ static void ldlm_update_resend(struct ptlrpc_request *req, void *data)
 {
 	struct ldlm_cb_async_args *ca = data;
 	struct ldlm_lock *lock = ca->ca_lock;
+	int i;
 
 	ldlm_refresh_waiting_lock(lock, ldlm_bl_timeout(lock));
+	for (i = 0; i < ca->ca_batch_count; i++)
+		ldlm_refresh_waiting_lock(ca->ca_batch[i],
+					  ldlm_bl_timeout(ca->ca_batch[i]));
 }
 
 static inline int ldlm_ast_fini(struct ptlrpc_request *req,
@@ -857,12 +962,67 @@ static void ldlm_lock_reorder_req(struct ldlm_lock *lock)
 	EXIT;
 }
 
+/**
+ * Add the locks gathered in arg->bl_batch to the blocking AST \a req.
+ *
+ * Locks which cannot be revoked this way are left in the list, the caller
+ * sends them their own AST. The list reference of the locks taken is passed
+ * to the request and dropped in ldlm_cb_interpret().
+ */
+static void ldlm_bl_ast_batch_add(struct ptlrpc_request *req,
+				  struct ldlm_request *body,
+				  struct list_head *batch, int max)
+{
+	struct ldlm_cb_async_args *ca = ptlrpc_req_async_args(req);
+	struct ldlm_lock *lock;
+	struct ldlm_lock *next;
+	int count = 0;
+
+	OBD_ALLOC(ca->ca_batch, max * sizeof(*ca->ca_batch));
+	if (ca->ca_batch == NULL)
+		return;
+
+	list_for_each_entry_safe(lock, next, batch, l_bl_ast) {
+		if (count == max)
+			break;
+
+		ldlm_lock_reorder_req(lock);
+
+		lock_res_and_lock(lock);
+		if (ldlm_is_destroyed(lock) || !ldlm_is_granted(lock) ||
+		    ldlm_is_cancel_on_block(lock)) {
+			unlock_res_and_lock(lock);
+			continue;
+		}
+
+		body->lock_handle[count + 1] = lock->l_remote_handle;
+		ldlm_set_cbpending(lock);
+		ldlm_add_waiting_lock(lock, ldlm_bl_timeout(lock));
+		list_del_init(&lock->l_bl_ast);
+		unlock_res_and_lock(lock);
+
+		LDLM_DEBUG(lock, "server adding lock to blocking AST");
+		ca->ca_batch[count++] = lock;
+	}
+
+	if (count == 0) {
+		OBD_FREE(ca->ca_batch, max * sizeof(*ca->ca_batch));
+		ca->ca_batch = NULL;
+		return;
+	}
+
+	ca->ca_batch_count = count;
+	ca->ca_batch_size = max;
+	body->lock_count = count + 1;
+}
+
 /**
  * ->l_blocking_ast() method for server-side locks. This is invoked when newly
  * enqueued server lock conflicts with given one.
  *
  * Sends blocking AST RPC to the client owning that lock; arms timeout timer
- * to wait for client response.
+ * to wait for client response. Other locks of the same client blocked by the
+ * same lock, if any are passed in arg->bl_batch, are revoked by the same RPC.
  */
 int ldlm_server_blocking_ast(struct ldlm_lock *lock,
 			     struct ldlm_lock_desc *desc,
@@ -872,7 +1032,9 @@ int ldlm_server_blocking_ast(struct ldlm_lock *lock,
 	struct ldlm_cb_set_arg *arg = data;
 	struct ldlm_request *body;
 	struct ptlrpc_request  *req;
+	struct ldlm_lock *next;
 	int instant_cancel = 0;
+	int batch = 0;
 	int rc = 0;
 
 	ENTRY;
@@ -893,16 +1055,44 @@ int ldlm_server_blocking_ast(struct ldlm_lock *lock,
 
 	ldlm_lock_reorder_req(lock);
 
-	req = ptlrpc_request_alloc_pack(lock->l_export->exp_imp_reverse,
-					&RQF_LDLM_BL_CALLBACK,
-					LUSTRE_DLM_VERSION, LDLM_BL_CALLBACK);
-	if (req == NULL)
-		RETURN(-ENOMEM);
+	if (arg->bl_batch != NULL && !ldlm_is_cancel_on_block(lock))
+		list_for_each_entry(next, arg->bl_batch, l_bl_ast)
+			batch++;
+
+	if (batch == 0) {
+		req = ptlrpc_request_alloc_pack(lock->l_export->exp_imp_reverse,
+						&RQF_LDLM_BL_CALLBACK,
+						LUSTRE_DLM_VERSION,
+						LDLM_BL_CALLBACK);
+		if (req == NULL)
+			RETURN(-ENOMEM);
+	} else {
+		req = ptlrpc_request_alloc(lock->l_export->exp_imp_reverse,
+					   &RQF_LDLM_BL_CALLBACK_BATCH);
+		if (req == NULL)
+			RETURN(-ENOMEM);
+
+		req_capsule_set_size(&req->rq_pill, &RMF_DLM_REQ, RCL_CLIENT,
+				     ldlm_request_bufsize(batch + 1,
+							  LDLM_BL_CALLBACK));
+		rc = ptlrpc_request_pack(req, LUSTRE_DLM_VERSION,
+					 LDLM_BL_CALLBACK);
+		if (rc) {
+			ptlrpc_request_free(req);
+			RETURN(rc);
+		}
+		/* room for the handles of the locks the client has not */
+		req_capsule_set_size(&req->rq_pill, &RMF_DLM_REQ, RCL_SERVER,
+				     ldlm_request_bufsize(batch + 1,
+							  LDLM_BL_CALLBACK));
+	}
 
 	CLASSERT(sizeof(*ca) <= sizeof(req->rq_async_args));
 	ca = ptlrpc_req_async_args(req);
 	ca->ca_set_arg = arg;
 	ca->ca_lock = lock;
+	ca->ca_batch = NULL;
+	ca->ca_batch_count = 0;
 
 	req->rq_interpret_reply = ldlm_cb_interpret;
 
@@ -955,6 +1145,17 @@ int ldlm_server_blocking_ast(struct ldlm_lock *lock,
 		req->rq_resend_cb = ldlm_update_resend;
 	}
 
+	if (batch > 0) {
+		struct ldlm_namespace *ns = ldlm_lock_to_ns(lock);
+
+		ldlm_bl_ast_batch_add(req, body, arg->bl_batch, batch);
+		if (ca->ca_batch_count > 0) {
+			atomic64_inc(&ns->ns_bl_ast_batch_rpcs);
+			atomic64_add(ca->ca_batch_count + 1,
+				     &ns->ns_bl_ast_batch_locks);
+		}
+	}
+
 	req->rq_send_state = LUSTRE_IMP_FULL;
 	/* ptlrpc_request_alloc_pack already set timeout */
 	if (AT_OFF)
@@ -1616,6 +1817,8 @@ int ldlm_handle_convert0(struct ptlrpc_request *req,
 		if (ldlm_is_cancel(lock)) {
 			LDLM_ERROR(lock, "convert on canceled lock!");
 			rc = ELDLM_NO_LOCK_DATA;
+		} else if (lock->l_resource->lr_type == LDLM_EXTENT) {
+			rc = ldlm_extent_convert(lock, &dlm_req->lock_desc);
 		} else if (dlm_req->lock_desc.l_req_mode !=
 			   lock->l_granted_mode) {
 			LDLM_ERROR(lock, "lock mode differs!");
@@ -1645,8 +1848,17 @@ int ldlm_handle_convert0(struct ptlrpc_request *req,
 
 		if (rc == ELDLM_OK) {
 			dlm_rep->lock_handle = lock->l_remote_handle;
-			ldlm_ibits_policy_local_to_wire(&lock->l_policy_data,
+			if (lock->l_resource->lr_type == LDLM_EXTENT) {
+				dlm_rep->lock_desc.l_granted_mode =
+					lock->l_granted_mode;
+				ldlm_extent_policy_local_to_wire(
+					&lock->l_policy_data,
 					&dlm_rep->lock_desc.l_policy_data);
+			} else {
+				ldlm_ibits_policy_local_to_wire(
+					&lock->l_policy_data,
+					&dlm_rep->lock_desc.l_policy_data);
+			}
 		}
 
 		LDLM_DEBUG(lock, "server-side convert handler END, rc = %d",
@@ -2047,25 +2259,49 @@ static int ldlm_callback_reply(struct ptlrpc_request *req, int rc)
 	return ptlrpc_reply(req);
 }
 
+static enum ldlm_bl_class ldlm_bl_class(struct ldlm_bl_work_item *blwi)
+{
+	if (blwi->blwi_lock && ldlm_is_discard_data(blwi->blwi_lock))
+		return LDLM_BL_PRIO;
+
+	if (blwi->blwi_ns == NULL)
+		return LDLM_BL_DATA;
+
+	switch (blwi->blwi_ns->ns_type) {
+	case LDLM_NS_TYPE_MDC:
+	case LDLM_NS_TYPE_MDT:
+	case LDLM_NS_TYPE_MGC:
+	case LDLM_NS_TYPE_MGT:
+		return LDLM_BL_MD;
+	default:
+		return LDLM_BL_DATA;
+	}
+}
+
+static void ldlm_bl_queue(struct ldlm_bl_part *part,
+			  struct ldlm_bl_work_item *blwi)
+{
+	enum ldlm_bl_class class = ldlm_bl_class(blwi);
+
+	blwi->blwi_queued = ktime_get();
+	spin_lock(&part->bp_lock);
+	list_add_tail(&blwi->blwi_entry, &part->bp_lists[class]);
+	part->bp_queued[class]++;
+	spin_unlock(&part->bp_lock);
+
+	wake_up(&part->bp_waitq);
+}
+
 static int __ldlm_bl_to_thread(struct ldlm_bl_work_item *blwi,
 			       enum ldlm_cancel_flags cancel_flags)
 {
 	struct ldlm_bl_pool *blp = ldlm_state->ldlm_bl_pool;
+	int cpt;
 
 	ENTRY;
 
-	spin_lock(&blp->blp_lock);
-	if (blwi->blwi_lock &&
-	    ldlm_is_discard_data(blwi->blwi_lock)) {
-		/* add LDLM_FL_DISCARD_DATA requests to the priority list */
-		list_add_tail(&blwi->blwi_entry, &blp->blp_prio_list);
-	} else {
-		/* other blocking callbacks are added to the regular list */
-		list_add_tail(&blwi->blwi_entry, &blp->blp_list);
-	}
-	spin_unlock(&blp->blp_lock);
-
-	wake_up(&blp->blp_waitq);
+	cpt = cfs_cpt_current(cfs_cpt_table, 1);
+	ldlm_bl_queue(blp->blp_parts[cpt % blp->blp_nparts], blwi);
 
 	/*
 	 * can not check blwi->blwi_flags as blwi could be already freed in
@@ -2159,9 +2395,72 @@ int ldlm_bl_to_thread_list(struct ldlm_namespace *ns, struct ldlm_lock_desc *ld,
 	return ldlm_bl_to_thread(ns, ld, NULL, cancels, count, cancel_flags);
 }
 
+int ldlm_bl_stats_seq_show(struct seq_file *m, void *v)
+{
+	struct ldlm_bl_pool *blp = ldlm_state ? ldlm_state->ldlm_bl_pool : NULL;
+	int cpt;
+	int class;
+
+	seq_printf(m, "%-4s %-9s %8s %12s %12s %12s\n", "cpt", "class",
+		   "queued", "count", "wait_avg_us", "wait_max_us");
+	if (blp == NULL || blp->blp_parts == NULL)
+		return 0;
+
+	for (cpt = 0; cpt < blp->blp_nparts; cpt++) {
+		struct ldlm_bl_part *part = blp->blp_parts[cpt];
+
+		if (part == NULL)
+			continue;
+
+		spin_lock(&part->bp_lock);
+		for (class = 0; class < LDLM_BL_NR; class++) {
+			struct ldlm_bl_queue_stats *stats;
+
+			stats = &part->bp_stats[class];
+			seq_printf(m, "%-4d %-9s %8d %12llu %12llu %12llu\n",
+				   cpt, ldlm_bl_class_names[class],
+				   part->bp_queued[class], stats->bqs_count,
+				   stats->bqs_count ? stats->bqs_wait_total /
+						      stats->bqs_count : 0,
+				   stats->bqs_wait_max);
+		}
+		spin_unlock(&part->bp_lock);
+	}
+
+	return 0;
+}
+
+/* any write resets the wait statistics */
+ssize_t ldlm_bl_stats_seq_write(struct file *file, const char __user *buffer,
+				size_t count, loff_t *off)
+{
+	struct ldlm_bl_pool *blp = ldlm_state ? ldlm_state->ldlm_bl_pool : NULL;
+	int cpt;
+
+	if (blp == NULL || blp->blp_parts == NULL)
+		return count;
+
+	for (cpt = 0; cpt < blp->blp_nparts; cpt++) {
+		struct ldlm_bl_part *part = blp->blp_parts[cpt];
+
+		if (part == NULL)
+			continue;
+
+		spin_lock(&part->bp_lock);
+		memset(part->bp_stats, 0, sizeof(part->bp_stats));
+		spin_unlock(&part->bp_lock);
+	}
+
+	return count;
+}
+
 int ldlm_bl_thread_wakeup(void)
 {
-	wake_up(&ldlm_state->ldlm_bl_pool->blp_waitq);
+	struct ldlm_bl_pool *blp = ldlm_state->ldlm_bl_pool;
+	int i;
+
+	for (i = 0; i < blp->blp_nparts; i++)
+		wake_up(&blp->blp_parts[i]->bp_waitq);
 	return 0;
 }
 
@@ -2224,6 +2523,129 @@ static inline void ldlm_callback_errmsg(struct ptlrpc_request *req,
 		CWARN("Send reply failed, maybe cause b=21636.\n");
 }
 
+/**
+ * Handle a blocking AST carrying several locks of this client, all blocked
+ * by the same lock on the server.
+ *
+ * The locks which are already gone are listed in the reply, so the server
+ * may cancel them at once. Unused locks are then cancelled together with one
+ * batched LDLM_CANCEL, the others follow the usual blocking AST path.
+ */
+static void ldlm_handle_bl_callback_batch(struct ptlrpc_request *req,
+					  struct ldlm_namespace *ns,
+					  struct ldlm_request *dlm_req)
+{
+	struct ldlm_lock_desc *ld = &dlm_req->lock_desc;
+	struct list_head cancels = LIST_HEAD_INIT(cancels);
+	struct ldlm_request *gone;
+	struct ldlm_lock *lock;
+	int count = dlm_req->lock_count;
+	int nr_cancel = 0;
+	int size;
+	int rc;
+	int i;
+
+	ENTRY;
+
+	size = ldlm_request_bufsize(count, LDLM_BL_CALLBACK);
+	if (count > LDLM_MAX_BL_AST_BATCH ||
+	    req_capsule_get_size(&req->rq_pill, &RMF_DLM_REQ,
+				 RCL_CLIENT) < size) {
+		rc = ldlm_callback_reply(req, -EPROTO);
+		ldlm_callback_errmsg(req, "Operate with bad lock count", rc,
+				     NULL);
+		RETURN_EXIT;
+	}
+
+	req_capsule_extend(&req->rq_pill, &RQF_LDLM_BL_CALLBACK_BATCH);
+	req_capsule_set_size(&req->rq_pill, &RMF_DLM_REQ, RCL_SERVER, size);
+	rc = req_capsule_server_pack(&req->rq_pill);
+	if (rc) {
+		ldlm_callback_errmsg(req, "Pack batched blocking AST reply",
+				     rc, NULL);
+		RETURN_EXIT;
+	}
+	gone = req_capsule_server_get(&req->rq_pill, &RMF_DLM_REQ);
+	gone->lock_count = 0;
+
+	for (i = 0; i < count; i++) {
+		struct lustre_handle *lockh = &dlm_req->lock_handle[i];
+
+		lock = ldlm_handle2lock_long(lockh, 0);
+		if (lock == NULL) {
+			CDEBUG(D_DLMTRACE,
+			       "callback on lock %#llx - lock disappeared\n",
+			       lockh->cookie);
+			gone->lock_handle[gone->lock_count++] = *lockh;
+			continue;
+		}
+
+		lock_res_and_lock(lock);
+		lock->l_flags |= ldlm_flags_from_wire(dlm_req->lock_flags &
+						      LDLM_FL_AST_MASK);
+		if ((ldlm_is_canceling(lock) && ldlm_is_bl_done(lock)) ||
+		    ldlm_is_failed(lock)) {
+			LDLM_DEBUG(lock,
+				   "callback on lock %llx - lock disappeared",
+				   lockh->cookie);
+			unlock_res_and_lock(lock);
+			LDLM_LOCK_RELEASE(lock);
+			gone->lock_handle[gone->lock_count++] = *lockh;
+			continue;
+		}
+		ldlm_lock_remove_from_lru(lock);
+		ldlm_set_bl_ast(lock);
+
+		/*
+		 * An unused lock is cancelled right away, unless it is an
+		 * ibits lock which might be converted instead, so the ibits
+		 * conflicting with the server lock must cover it.
+		 */
+		if (lock->l_readers == 0 && lock->l_writers == 0 &&
+		    !ldlm_is_canceling(lock) &&
+		    (lock->l_resource->lr_type != LDLM_IBITS ||
+		     !(lock->l_policy_data.l_inodebits.bits &
+		       ~ld->l_policy_data.l_inodebits.cancel_bits))) {
+			ldlm_set_cbpending(lock);
+			ldlm_set_canceling(lock);
+			unlock_res_and_lock(lock);
+			/* the reference is dropped by ldlm_cli_cancel_list() */
+			list_add_tail(&lock->l_bl_ast, &cancels);
+			nr_cancel++;
+			continue;
+		}
+		unlock_res_and_lock(lock);
+		LDLM_LOCK_RELEASE(lock);
+	}
+
+	rc = ldlm_callback_reply(req, 0);
+	if (req->rq_no_reply || rc)
+		ldlm_callback_errmsg(req, "Normal process", rc, NULL);
+
+	if (nr_cancel > 0 &&
+	    ldlm_bl_to_thread_list(ns, NULL, &cancels, nr_cancel, LCF_ASYNC)) {
+		nr_cancel = ldlm_cli_cancel_list_local(&cancels, nr_cancel,
+						       LCF_BL_AST);
+		ldlm_cli_cancel_list(&cancels, nr_cancel, NULL, 0);
+	}
+
+	/* locks still in use take the usual blocking AST path */
+	for (i = 0; i < count; i++) {
+		lock = ldlm_handle2lock_long(&dlm_req->lock_handle[i], 0);
+		if (lock == NULL)
+			continue;
+
+		if (ldlm_is_canceling(lock) || ldlm_is_failed(lock)) {
+			LDLM_LOCK_RELEASE(lock);
+			continue;
+		}
+		if (ldlm_bl_to_thread_lock(ns, ld, lock))
+			ldlm_handle_bl_callback(ns, ld, lock);
+	}
+
+	EXIT;
+}
+
 /* TODO: handle requests in a similar way as MDT: see mdt_handle_common() */
 static int ldlm_callback_handler(struct ptlrpc_request *req)
 {
@@ -2297,6 +2719,12 @@ static int ldlm_callback_handler(struct ptlrpc_request *req)
 		RETURN(0);
 	}
 
+	if (lustre_msg_get_opc(req->rq_reqmsg) == LDLM_BL_CALLBACK &&
+	    dlm_req->lock_count > 1) {
+		ldlm_handle_bl_callback_batch(req, ns, dlm_req);
+		RETURN(0);
+	}
+
 	/*
 	 * Force a known safe race, send a cancel to the server for a lock
 	 * which the server has already started a blocking callback on.
@@ -2633,43 +3061,59 @@ void ldlm_revoke_export_locks(struct obd_export *exp)
 EXPORT_SYMBOL(ldlm_revoke_export_locks);
 #endif /* HAVE_SERVER_SUPPORT */
 
-static int ldlm_bl_get_work(struct ldlm_bl_pool *blp,
+static int ldlm_bl_get_work(struct ldlm_bl_part *part,
 			    struct ldlm_bl_work_item **p_blwi,
 			    struct obd_export **p_exp)
 {
 	struct ldlm_bl_work_item *blwi = NULL;
-	static unsigned int num_bl;
-	static unsigned int num_stale;
-	int num_th = atomic_read(&blp->blp_num_threads);
+	int num_th = atomic_read(&part->bp_num_threads);
+	int class;
 
 	*p_exp = obd_stale_export_get();
 
-	spin_lock(&blp->blp_lock);
+	spin_lock(&part->bp_lock);
 	if (*p_exp != NULL) {
-		if (num_th == 1 || ++num_stale < num_th) {
-			spin_unlock(&blp->blp_lock);
+		if (num_th == 1 || ++part->bp_num_stale < num_th) {
+			spin_unlock(&part->bp_lock);
 			return 1;
 		}
-		num_stale = 0;
+		part->bp_num_stale = 0;
 	}
 
-	/* process a request from the blp_list at least every blp_num_threads */
-	if (!list_empty(&blp->blp_list) &&
-	    (list_empty(&blp->blp_prio_list) || num_bl == 0))
-		blwi = list_entry(blp->blp_list.next,
-				  struct ldlm_bl_work_item, blwi_entry);
+	/*
+	 * serve the classes in order, but process a data request once every
+	 * bp_num_threads items (at least every other item) so that data
+	 * flushes are not starved
+	 */
+	if (part->bp_num_bl == 0 && part->bp_queued[LDLM_BL_DATA] != 0)
+		class = LDLM_BL_DATA;
 	else
-		if (!list_empty(&blp->blp_prio_list))
-			blwi = list_entry(blp->blp_prio_list.next,
-					  struct ldlm_bl_work_item,
-					  blwi_entry);
-
-	if (blwi) {
-		if (++num_bl >= num_th)
-			num_bl = 0;
+		for (class = 0; class < LDLM_BL_NR; class++)
+			if (part->bp_queued[class] != 0)
+				break;
+
+	if (class < LDLM_BL_NR) {
+		ktime_t now = ktime_get();
+		struct ldlm_bl_queue_stats *stats = &part->bp_stats[class];
+		__u64 wait;
+
+		blwi = list_entry(part->bp_lists[class].next,
+				  struct ldlm_bl_work_item, blwi_entry);
 		list_del(&blwi->blwi_entry);
+		part->bp_queued[class]--;
+
+		if (++part->bp_num_bl >= max(num_th, 2))
+			part->bp_num_bl = 0;
+
+		if (blwi->blwi_ns != NULL) {
+			wait = ktime_us_delta(now, blwi->blwi_queued);
+			stats->bqs_count++;
+			stats->bqs_wait_total += wait;
+			if (wait > stats->bqs_wait_max)
+				stats->bqs_wait_max = wait;
+		}
 	}
-	spin_unlock(&blp->blp_lock);
+	spin_unlock(&part->bp_lock);
 	*p_blwi = blwi;
 
 	if (*p_exp != NULL && *p_blwi != NULL) {
@@ -2683,38 +3127,41 @@ static int ldlm_bl_get_work(struct ldlm_bl_pool *blp,
 /* This only contains temporary data until the thread starts */
 struct ldlm_bl_thread_data {
 	struct ldlm_bl_pool	*bltd_blp;
+	struct ldlm_bl_part	*bltd_part;
 	struct completion	bltd_comp;
 	int			bltd_num;
 };
 
 static int ldlm_bl_thread_main(void *arg);
 
-static int ldlm_bl_thread_start(struct ldlm_bl_pool *blp, bool check_busy)
+static int ldlm_bl_thread_start(struct ldlm_bl_pool *blp,
+				struct ldlm_bl_part *part, bool check_busy)
 {
-	struct ldlm_bl_thread_data bltd = { .bltd_blp = blp };
+	struct ldlm_bl_thread_data bltd = { .bltd_blp = blp,
+					    .bltd_part = part };
 	struct task_struct *task;
 
 	init_completion(&bltd.bltd_comp);
 
-	bltd.bltd_num = atomic_inc_return(&blp->blp_num_threads);
+	bltd.bltd_num = atomic_inc_return(&part->bp_num_threads);
 	if (bltd.bltd_num >= blp->blp_max_threads) {
-		atomic_dec(&blp->blp_num_threads);
+		atomic_dec(&part->bp_num_threads);
 		return 0;
 	}
 
 	LASSERTF(bltd.bltd_num > 0, "thread num:%d\n", bltd.bltd_num);
 	if (check_busy &&
-	    atomic_read(&blp->blp_busy_threads) < (bltd.bltd_num - 1)) {
-		atomic_dec(&blp->blp_num_threads);
+	    atomic_read(&part->bp_busy_threads) < (bltd.bltd_num - 1)) {
+		atomic_dec(&part->bp_num_threads);
 		return 0;
 	}
 
-	task = kthread_run(ldlm_bl_thread_main, &bltd, "ldlm_bl_%02d",
-			   bltd.bltd_num);
+	task = kthread_run(ldlm_bl_thread_main, &bltd, "ldlm_bl_%02d_%02d",
+			   part->bp_cpt, bltd.bltd_num);
 	if (IS_ERR(task)) {
-		CERROR("cannot start LDLM thread ldlm_bl_%02d: rc %ld\n",
-		       bltd.bltd_num, PTR_ERR(task));
-		atomic_dec(&blp->blp_num_threads);
+		CERROR("cannot start LDLM thread ldlm_bl_%02d_%02d: rc %ld\n",
+		       part->bp_cpt, bltd.bltd_num, PTR_ERR(task));
+		atomic_dec(&part->bp_num_threads);
 		return PTR_ERR(task);
 	}
 	wait_for_completion(&bltd.bltd_comp);
@@ -2724,13 +3171,14 @@ static int ldlm_bl_thread_start(struct ldlm_bl_pool *blp, bool check_busy)
 
 /* Not fatal if racy and have a few too many threads */
 static int ldlm_bl_thread_need_create(struct ldlm_bl_pool *blp,
+				      struct ldlm_bl_part *part,
 				      struct ldlm_bl_work_item *blwi)
 {
-	if (atomic_read(&blp->blp_num_threads) >= blp->blp_max_threads)
+	if (atomic_read(&part->bp_num_threads) >= blp->blp_max_threads)
 		return 0;
 
-	if (atomic_read(&blp->blp_busy_threads) <
-	    atomic_read(&blp->blp_num_threads))
+	if (atomic_read(&part->bp_busy_threads) <
+	    atomic_read(&part->bp_num_threads))
 		return 0;
 
 	if (blwi != NULL && (blwi->blwi_ns == NULL ||
@@ -2818,6 +3266,7 @@ static int ldlm_bl_thread_main(void *arg)
 {
 	struct lu_env *env;
 	struct ldlm_bl_pool *blp;
+	struct ldlm_bl_part *part;
 	struct ldlm_bl_thread_data *bltd = arg;
 	int rc;
 
@@ -2834,6 +3283,14 @@ static int ldlm_bl_thread_main(void *arg)
 		GOTO(out_env_fini, rc);
 
 	blp = bltd->bltd_blp;
+	part = bltd->bltd_part;
+
+	if (ldlm_cpu_bind) {
+		rc = cfs_cpt_bind(cfs_cpt_table, part->bp_cpt);
+		if (rc)
+			CWARN("ldlm_bl_%02d_%02d: failed to bind to CPT %d: rc = %d\n",
+			      part->bp_cpt, bltd->bltd_num, part->bp_cpt, rc);
+	}
 
 	complete(&bltd->bltd_comp);
 	/* cannot use bltd after this, it is only on caller's stack */
@@ -2844,25 +3301,25 @@ static int ldlm_bl_thread_main(void *arg)
 		struct obd_export *exp = NULL;
 		int rc;
 
-		rc = ldlm_bl_get_work(blp, &blwi, &exp);
+		rc = ldlm_bl_get_work(part, &blwi, &exp);
 
 		if (rc == 0)
-			l_wait_event_exclusive(blp->blp_waitq,
-					       ldlm_bl_get_work(blp, &blwi,
+			l_wait_event_exclusive(part->bp_waitq,
+					       ldlm_bl_get_work(part, &blwi,
 								&exp),
 					       &lwi);
-		atomic_inc(&blp->blp_busy_threads);
+		atomic_inc(&part->bp_busy_threads);
 
-		if (ldlm_bl_thread_need_create(blp, blwi))
+		if (ldlm_bl_thread_need_create(blp, part, blwi))
 			/* discard the return value, we tried */
-			ldlm_bl_thread_start(blp, true);
+			ldlm_bl_thread_start(blp, part, true);
 
 		if (exp)
 			rc = ldlm_bl_thread_exports(blp, exp);
 		else if (blwi)
 			rc = ldlm_bl_thread_blwi(blp, blwi);
 
-		atomic_dec(&blp->blp_busy_threads);
+		atomic_dec(&part->bp_busy_threads);
 
 		if (rc == LDLM_ITER_STOP)
 			break;
@@ -2875,7 +3332,7 @@ static int ldlm_bl_thread_main(void *arg)
 		cond_resched();
 	}
 
-	atomic_dec(&blp->blp_num_threads);
+	atomic_dec(&part->bp_num_threads);
 	complete(&blp->blp_comp);
 
 	lu_env_remove(env);
@@ -3075,6 +3532,7 @@ static int ldlm_setup(void)
 #ifdef HAVE_SERVER_SUPPORT
 	struct task_struct *task;
 #endif /* HAVE_SERVER_SUPPORT */
+	int cpt;
 	int i;
 	int rc = 0;
 
@@ -3198,13 +3656,12 @@ static int ldlm_setup(void)
 		GOTO(out, rc = -ENOMEM);
 	ldlm_state->ldlm_bl_pool = blp;
 
-	spin_lock_init(&blp->blp_lock);
-	INIT_LIST_HEAD(&blp->blp_list);
-	INIT_LIST_HEAD(&blp->blp_prio_list);
-	init_waitqueue_head(&blp->blp_waitq);
-	atomic_set(&blp->blp_num_threads, 0);
-	atomic_set(&blp->blp_busy_threads, 0);
+	blp->blp_nparts = cfs_cpt_number(cfs_cpt_table);
+	OBD_ALLOC(blp->blp_parts, blp->blp_nparts * sizeof(*blp->blp_parts));
+	if (blp->blp_parts == NULL)
+		GOTO(out, rc = -ENOMEM);
 
+	/* the thread limits are shared among the partitions */
 	if (ldlm_num_threads == 0) {
 		blp->blp_min_threads = LDLM_NTHRS_INIT;
 		blp->blp_max_threads = LDLM_NTHRS_MAX;
@@ -3213,11 +3670,32 @@ static int ldlm_setup(void)
 			min_t(int, LDLM_NTHRS_MAX, max_t(int, LDLM_NTHRS_INIT,
 							 ldlm_num_threads));
 	}
+	blp->blp_min_threads = max(1, blp->blp_min_threads / blp->blp_nparts);
+	blp->blp_max_threads = max(blp->blp_min_threads + 1,
+				   blp->blp_max_threads / blp->blp_nparts);
 
-	for (i = 0; i < blp->blp_min_threads; i++) {
-		rc = ldlm_bl_thread_start(blp, false);
-		if (rc < 0)
-			GOTO(out, rc);
+	for (cpt = 0; cpt < blp->blp_nparts; cpt++) {
+		struct ldlm_bl_part *part;
+		int class;
+
+		OBD_CPT_ALLOC_PTR(part, cfs_cpt_table, cpt);
+		if (part == NULL)
+			GOTO(out, rc = -ENOMEM);
+		blp->blp_parts[cpt] = part;
+
+		spin_lock_init(&part->bp_lock);
+		for (class = 0; class < LDLM_BL_NR; class++)
+			INIT_LIST_HEAD(&part->bp_lists[class]);
+		init_waitqueue_head(&part->bp_waitq);
+		atomic_set(&part->bp_num_threads, 0);
+		atomic_set(&part->bp_busy_threads, 0);
+		part->bp_cpt = cpt;
+
+		for (i = 0; i < blp->blp_min_threads; i++) {
+			rc = ldlm_bl_thread_start(blp, part, false);
+			if (rc < 0)
+				GOTO(out, rc);
+		}
 	}
 
 #ifdef HAVE_SERVER_SUPPORT
@@ -3267,20 +3745,29 @@ static int ldlm_cleanup(void)
 
 	if (ldlm_state->ldlm_bl_pool != NULL) {
 		struct ldlm_bl_pool *blp = ldlm_state->ldlm_bl_pool;
+		int cpt;
 
-		while (atomic_read(&blp->blp_num_threads) > 0) {
-			struct ldlm_bl_work_item blwi = { .blwi_ns = NULL };
+		for (cpt = 0; blp->blp_parts != NULL &&
+			      cpt < blp->blp_nparts; cpt++) {
+			struct ldlm_bl_part *part = blp->blp_parts[cpt];
 
-			init_completion(&blp->blp_comp);
+			if (part == NULL)
+				continue;
 
-			spin_lock(&blp->blp_lock);
-			list_add_tail(&blwi.blwi_entry, &blp->blp_list);
-			wake_up(&blp->blp_waitq);
-			spin_unlock(&blp->blp_lock);
+			while (atomic_read(&part->bp_num_threads) > 0) {
+				struct ldlm_bl_work_item blwi = {
+					.blwi_ns = NULL };
 
-			wait_for_completion(&blp->blp_comp);
+				init_completion(&blp->blp_comp);
+				ldlm_bl_queue(part, &blwi);
+				wait_for_completion(&blp->blp_comp);
+			}
+			OBD_FREE_PTR(part);
 		}
 
+		if (blp->blp_parts != NULL)
+			OBD_FREE(blp->blp_parts,
+				 blp->blp_nparts * sizeof(*blp->blp_parts));
 		OBD_FREE(blp, sizeof(*blp));
 	}
 
@@ -3338,7 +3825,7 @@ int ldlm_init(void)
 		goto out_lock;
 
 	ldlm_interval_tree_slab = kmem_cache_create("interval_tree",
-			sizeof(struct ldlm_interval_tree) * LCK_MODE_NUM,
+			sizeof(struct ldlm_interval_tree),
 			0, SLAB_HWCACHE_ALIGN, NULL);
 	if (ldlm_interval_tree_slab == NULL)
 		goto out_interval;
@@ -3373,13 +3860,13 @@ void ldlm_exit(void)
 {
 	if (ldlm_refcount)
 		CERROR("ldlm_refcount is %d in ldlm_exit!\n", ldlm_refcount);
-	kmem_cache_destroy(ldlm_resource_slab);
 	/*
-	 * ldlm_lock_put() use RCU to call ldlm_lock_free, so need call
-	 * rcu_barrier() to wait all outstanding RCU callbacks to complete,
-	 * so that ldlm_lock_free() get a chance to be called.
+	 * ldlm_lock_put() and ldlm_resource_putref() use RCU to free locks
+	 * and resources, so need call rcu_barrier() to wait all outstanding
+	 * RCU callbacks to complete before their slabs are destroyed.
 	 */
 	rcu_barrier();
+	kmem_cache_destroy(ldlm_resource_slab);
 	kmem_cache_destroy(ldlm_lock_slab);
 	kmem_cache_destroy(ldlm_interval_slab);
 	kmem_cache_destroy(ldlm_interval_tree_slab);
@@ -140,6 +140,24 @@
  */
 #define LDLM_POOL_SLV_SHIFT (10)
 
+/*
+ * The granularity of the lock budget scale, LDLM_POOL_BUDGET_SCALE is 1.
+ */
+#define LDLM_POOL_BUDGET_SHIFT (10)
+#define LDLM_POOL_BUDGET_SCALE (1 << LDLM_POOL_BUDGET_SHIFT)
+
+/*
+ * The budget scale goes down to 1/8 under pressure and up to 2 when the
+ * pool is mostly idle, so a client may double its cache in one period.
+ */
+#define LDLM_POOL_BUDGET_SCALE_MIN (LDLM_POOL_BUDGET_SCALE >> 3)
+#define LDLM_POOL_BUDGET_SCALE_MAX (LDLM_POOL_BUDGET_SCALE << 1)
+
+/*
+ * Lock budget a client always gets, whatever the pool state is.
+ */
+#define LDLM_POOL_BUDGET_MIN (64)
+
 static inline __u64 dru(__u64 val, __u32 shift, int round_up)
 {
 	return (val + (round_up ? (1 << shift) - 1 : 0)) >> shift;
@@ -281,6 +299,35 @@ static void ldlm_pool_recalc_slv(struct ldlm_pool *pl)
 	pl->pl_server_lock_volume = slv;
 }
 
+/**
+ * Recalculates the lock budget scale on passed \a pl.
+ *
+ * The budget of an export is the larger of its fair share of the pool
+ * limit and what it holds now times the budget scale. The scale drops by
+ * 1/8 each period while the pool is above 7/8 of its limit or the server
+ * is above its reclaim watermark, and grows by 1/8 while the pool is below
+ * 3/4 of its limit. Clients holding more than their fair share are thus
+ * moved down gradually rather than having their locks revoked at once.
+ *
+ * \pre ->pl_lock is locked.
+ */
+static void ldlm_pool_recalc_budget(struct ldlm_pool *pl)
+{
+	int granted, limit, scale;
+
+	limit = ldlm_pool_get_limit(pl);
+	granted = ldlm_pool_granted(pl);
+	scale = pl->pl_budget_scale;
+
+	if (granted > limit - (limit >> 3) || ldlm_reclaim_pressure())
+		scale -= scale >> 3;
+	else if (granted < limit - (limit >> 2))
+		scale += scale >> 3;
+
+	pl->pl_budget_scale = clamp_t(int, scale, LDLM_POOL_BUDGET_SCALE_MIN,
+				      LDLM_POOL_BUDGET_SCALE_MAX);
+}
+
 /**
  * Recalculates next stats on passed \a pl.
  *
@@ -324,6 +371,9 @@ static void ldlm_srv_pool_push_slv(struct ldlm_pool *pl)
 	LASSERT(obd != NULL);
 	write_lock(&obd->obd_pool_lock);
 	obd->obd_pool_slv = pl->pl_server_lock_volume;
+	obd->obd_pool_budget = ldlm_pool_get_limit(pl) /
+			       max(atomic_read(&pl->pl_budget_exports), 1);
+	obd->obd_pool_budget_scale = pl->pl_budget_scale;
 	write_unlock(&obd->obd_pool_lock);
 }
 
@@ -354,6 +404,11 @@ static int ldlm_srv_pool_recalc(struct ldlm_pool *pl)
 	 */
 	ldlm_pool_recalc_slv(pl);
 
+	/*
+	 * SLV is still used by clients without lock budget support.
+	 */
+	ldlm_pool_recalc_budget(pl);
+
 	/*
 	 * Make sure that pool informed obd of last SLV changes.
 	 */
@@ -465,6 +520,7 @@ static void ldlm_cli_pool_pop_slv(struct ldlm_pool *pl)
 	read_lock(&obd->obd_pool_lock);
 	pl->pl_server_lock_volume = obd->obd_pool_slv;
 	ldlm_pool_set_limit(pl, obd->obd_pool_limit);
+	pl->pl_budget = obd->obd_pool_budget;
 	read_unlock(&obd->obd_pool_lock);
 }
 
@@ -663,10 +719,10 @@ int ldlm_pool_setup(struct ldlm_pool *pl, int limit)
 static int lprocfs_pool_state_seq_show(struct seq_file *m, void *unused)
 {
 	int granted, grant_rate, cancel_rate, grant_step;
-	int grant_speed, grant_plan, lvf;
+	int grant_speed, grant_plan, lvf, scale;
 	struct ldlm_pool *pl = m->private;
 	__u64 slv, clv;
-	__u32 limit;
+	__u32 limit, budget;
 
 	spin_lock(&pl->pl_lock);
 	slv = pl->pl_server_lock_volume;
@@ -679,6 +735,8 @@ static int lprocfs_pool_state_seq_show(struct seq_file *m, void *unused)
 	grant_speed = grant_rate - cancel_rate;
 	lvf = atomic_read(&pl->pl_lock_volume_factor);
 	grant_step = ldlm_pool_t2gsp(pl->pl_recalc_period);
+	scale = pl->pl_budget_scale;
+	budget = pl->pl_budget;
 	spin_unlock(&pl->pl_lock);
 
 	seq_printf(m, "LDLM pool state (%s):\n"
@@ -690,6 +748,11 @@ static int lprocfs_pool_state_seq_show(struct seq_file *m, void *unused)
 	if (ns_is_server(ldlm_pl2ns(pl))) {
 		seq_printf(m, "  GSP: %d%%\n", grant_step);
 		seq_printf(m, "  GP:  %d\n", grant_plan);
+		seq_printf(m, "  BS:  %d\n", scale);
+		seq_printf(m, "  BE:  %d\n",
+			   atomic_read(&pl->pl_budget_exports));
+	} else {
+		seq_printf(m, "  B:   %u\n", budget);
 	}
 
 	seq_printf(m, "  GR:  %d\n  CR:  %d\n  GS:  %d\n  G:   %d\n  L:   %d\n",
@@ -891,6 +954,9 @@ int ldlm_pool_init(struct ldlm_pool *pl, struct ldlm_namespace *ns,
 	atomic_set(&pl->pl_grant_rate, 0);
 	atomic_set(&pl->pl_cancel_rate, 0);
 	pl->pl_grant_plan = LDLM_POOL_GP(LDLM_POOL_HOST_L);
+	pl->pl_budget_scale = LDLM_POOL_BUDGET_SCALE;
+	atomic_set(&pl->pl_budget_exports, 0);
+	pl->pl_budget = 0;
 
 	snprintf(pl->pl_name, sizeof(pl->pl_name), "ldlm-pool-%s-%d",
 		 ldlm_ns_name(ns), idx);
@@ -935,6 +1001,30 @@ void ldlm_pool_fini(struct ldlm_pool *pl)
 	EXIT;
 }
 
+/*
+ * Count \a lock in the granted locks of its export, at most once and only
+ * if it has one. Called with the resource of \a lock locked.
+ */
+static void ldlm_pool_export_add(struct ldlm_pool *pl, struct ldlm_lock *lock)
+{
+	if (lock->l_export == NULL || lock->l_export_counted)
+		return;
+
+	lock->l_export_counted = true;
+	if (atomic_inc_return(&lock->l_export->exp_pool_granted) == 1)
+		atomic_inc(&pl->pl_budget_exports);
+}
+
+static void ldlm_pool_export_del(struct ldlm_pool *pl, struct ldlm_lock *lock)
+{
+	if (!lock->l_export_counted)
+		return;
+
+	lock->l_export_counted = false;
+	if (atomic_dec_and_test(&lock->l_export->exp_pool_granted))
+		atomic_dec(&pl->pl_budget_exports);
+}
+
 /**
  * Add new taken ldlm lock \a lock into pool \a pl accounting.
  */
@@ -955,6 +1045,8 @@ void ldlm_pool_add(struct ldlm_pool *pl, struct ldlm_lock *lock)
 
 	ldlm_reclaim_add(lock);
 
+	ldlm_pool_export_add(pl, lock);
+
 	atomic_inc(&pl->pl_granted);
 	atomic_inc(&pl->pl_grant_rate);
 	lprocfs_counter_incr(pl->pl_stats, LDLM_POOL_GRANT_STAT);
@@ -983,6 +1075,8 @@ void ldlm_pool_del(struct ldlm_pool *pl, struct ldlm_lock *lock)
 
 	ldlm_reclaim_del(lock);
 
+	ldlm_pool_export_del(pl, lock);
+
 	LASSERT(atomic_read(&pl->pl_granted) > 0);
 	atomic_dec(&pl->pl_granted);
 	atomic_inc(&pl->pl_cancel_rate);
@@ -993,6 +1087,24 @@ void ldlm_pool_del(struct ldlm_pool *pl, struct ldlm_lock *lock)
 		ldlm_pool_recalc(pl);
 }
 
+/**
+ * Count granted \a lock in the granted locks of its export. This is for
+ * locks which were granted locally and given to a client afterwards, such
+ * as the MDT intent locks.
+ *
+ * \pre the resource of \a lock is locked.
+ */
+void ldlm_pool_add_export(struct ldlm_lock *lock)
+{
+	if (!ldlm_is_granted(lock) ||
+	    lock->l_resource->lr_type == LDLM_FLOCK ||
+	    lock->l_resource->lr_type == LDLM_PLAIN)
+		return;
+
+	ldlm_pool_export_add(&ldlm_lock_to_ns(lock)->ns_pool, lock);
+}
+EXPORT_SYMBOL(ldlm_pool_add_export);
+
 /**
  * Returns current \a pl SLV.
  *
@@ -1063,6 +1175,50 @@ void ldlm_pool_set_limit(struct ldlm_pool *pl, __u32 limit)
 	atomic_set(&pl->pl_limit, limit);
 }
 
+/**
+ * Returns the lock budget the server gave to client side \a pl, 0 if the
+ * server does not support lock budgets.
+ */
+__u32 ldlm_pool_get_budget(struct ldlm_pool *pl)
+{
+	__u32 budget;
+
+	spin_lock(&pl->pl_lock);
+	budget = pl->pl_budget;
+	spin_unlock(&pl->pl_lock);
+	return budget;
+}
+
+/**
+ * Returns the lock budget of \a exp, sent to the client in the limit field
+ * of the replies. It is at least the fair share of the pool limit for each
+ * export holding locks and otherwise follows what \a exp holds now, scaled
+ * by the pool budget scale.
+ */
+int ldlm_export_lock_budget(struct obd_export *exp)
+{
+	struct obd_device *obd = exp->exp_obd;
+	int fair, scale, limit;
+	__u64 budget;
+
+	read_lock(&obd->obd_pool_lock);
+	fair = obd->obd_pool_budget;
+	scale = obd->obd_pool_budget_scale;
+	limit = obd->obd_pool_limit;
+	read_unlock(&obd->obd_pool_lock);
+
+	/* the pool was not recalculated yet */
+	if (scale == 0)
+		return limit;
+
+	budget = (__u64)atomic_read(&exp->exp_pool_granted) * scale;
+	budget >>= LDLM_POOL_BUDGET_SHIFT;
+	budget = max_t(__u64, budget, fair);
+	budget = max_t(__u64, budget, LDLM_POOL_BUDGET_MIN);
+
+	return min_t(__u64, budget, limit);
+}
+
 /**
  * Returns current LVF from \a pl.
  */
@@ -1462,6 +1618,12 @@ void ldlm_pool_del(struct ldlm_pool *pl, struct ldlm_lock *lock)
 	return;
 }
 
+void ldlm_pool_add_export(struct ldlm_lock *lock)
+{
+	return;
+}
+EXPORT_SYMBOL(ldlm_pool_add_export);
+
 __u64 ldlm_pool_get_slv(struct ldlm_pool *pl)
 {
 	return 1;
@@ -1497,6 +1659,16 @@ __u32 ldlm_pool_get_lvf(struct ldlm_pool *pl)
 	return 0;
 }
 
+__u32 ldlm_pool_get_budget(struct ldlm_pool *pl)
+{
+	return 0;
+}
+
+int ldlm_export_lock_budget(struct obd_export *exp)
+{
+	return 0;
+}
+
 int ldlm_pools_init(void)
 {
 	return 0;
@@ -74,7 +74,6 @@ struct ldlm_reclaim_cb_data {
 	int			 rcd_start;
 	bool			 rcd_skip;
 	s64			 rcd_age_ns;
-	struct cfs_hash_bd	*rcd_prev_bd;
 };
 
 static inline bool ldlm_lock_reclaimable(struct ldlm_lock *lock)
@@ -95,22 +94,16 @@ static inline bool ldlm_lock_reclaimable(struct ldlm_lock *lock)
 /**
  * Callback function for revoking locks from certain resource.
  *
- * \param [in] hs	ns_rs_hash
- * \param [in] bd	current bucket of ns_rsh_hash
- * \param [in] hnode	hnode of the resource
+ * \param [in] res	the resource
  * \param [in] arg	opaque data
  *
  * \retval 0		continue the scan
  * \retval 1		stop the iteration
  */
-static int ldlm_reclaim_lock_cb(struct cfs_hash *hs, struct cfs_hash_bd *bd,
-				struct hlist_node *hnode, void *arg)
-
+static int ldlm_reclaim_lock_cb(struct ldlm_resource *res, void *arg)
 {
-	struct ldlm_resource		*res;
 	struct ldlm_reclaim_cb_data	*data;
 	struct ldlm_lock		*lock;
-	struct ldlm_ns_bucket		*nsb;
 	int				 rc = 0;
 
 	data = (struct ldlm_reclaim_cb_data *)arg;
@@ -118,24 +111,14 @@ static int ldlm_reclaim_lock_cb(struct cfs_hash *hs, struct cfs_hash_bd *bd,
 	LASSERTF(data->rcd_added < data->rcd_total, "added:%d >= total:%d\n",
 		 data->rcd_added, data->rcd_total);
 
-	nsb = cfs_hash_bd_extra_get(hs, bd);
-	res = cfs_hash_object(hs, hnode);
-
-	if (data->rcd_prev_bd != bd) {
-		if (data->rcd_prev_bd != NULL)
-			ldlm_res_to_ns(res)->ns_reclaim_start++;
-		data->rcd_prev_bd = bd;
-		data->rcd_cursor = 0;
-		data->rcd_start = nsb->nsb_reclaim_start %
-				  cfs_hash_bd_count_get(bd);
-	}
-
+	/* resources scanned last time are skipped, so that the scan goes
+	 * round the namespace rather than revoking from the same ones */
 	if (data->rcd_skip && data->rcd_cursor < data->rcd_start) {
 		data->rcd_cursor++;
 		return 0;
 	}
 
-	nsb->nsb_reclaim_start++;
+	ldlm_res_to_ns(res)->ns_reclaim_start++;
 
 	lock_res(res);
 	list_for_each_entry(lock, &res->lr_granted, l_res_link) {
@@ -148,6 +131,15 @@ static int ldlm_reclaim_lock_cb(struct cfs_hash *hs, struct cfs_hash_bd *bd,
 					      data->rcd_age_ns)))
 			continue;
 
+		/* clients which keep within their lock budget shrink
+		 * their caches themselves as the budget drops, revoke
+		 * only from the ones holding more than they were given */
+		if (lock->l_export != NULL &&
+		    exp_connect_lock_budget(lock->l_export) &&
+		    atomic_read(&lock->l_export->exp_pool_granted) <=
+		    ldlm_export_lock_budget(lock->l_export))
+			continue;
+
 		if (!ldlm_is_ast_sent(lock)) {
 			ldlm_set_ast_sent(lock);
 			LASSERT(list_empty(&lock->l_rk_ast));
@@ -180,7 +172,7 @@ static void ldlm_reclaim_res(struct ldlm_namespace *ns, int *count,
 			     s64 age_ns, bool skip)
 {
 	struct ldlm_reclaim_cb_data	data;
-	int				idx, type, start;
+	int				idx, type, nr;
 	ENTRY;
 
 	LASSERT(*count != 0);
@@ -203,11 +195,11 @@ static void ldlm_reclaim_res(struct ldlm_namespace *ns, int *count,
 	data.rcd_total = *count;
 	data.rcd_age_ns = age_ns;
 	data.rcd_skip = skip;
-	data.rcd_prev_bd = NULL;
-	start = ns->ns_reclaim_start % CFS_HASH_NBKT(ns->ns_rs_hash);
+	data.rcd_cursor = 0;
+	nr = atomic_read(&ns->ns_rs_hash.nelems);
+	data.rcd_start = nr > 0 ? ns->ns_reclaim_start % nr : 0;
 
-	cfs_hash_for_each_nolock(ns->ns_rs_hash, ldlm_reclaim_lock_cb, &data,
-				 start);
+	ldlm_namespace_foreach_res(ns, ldlm_reclaim_lock_cb, &data);
 
 	CDEBUG(D_DLMTRACE, "NS(%s): %d locks to be reclaimed, found %d/%d "
 	       "locks.\n", ldlm_ns_name(ns), *count, data.rcd_added,
@@ -342,6 +334,22 @@ bool ldlm_reclaim_full(void)
 	return false;
 }
 
+/**
+ * Check whether the total granted locks are above the low watermark, this
+ * is used by the server pools to shrink the lock budgets of the clients
+ * before the locks have to be revoked.
+ *
+ * \retval true	low watermark reached.
+ * \retval false	low watermark not reached.
+ */
+bool ldlm_reclaim_pressure(void)
+{
+	__u64 low = ldlm_reclaim_threshold;
+
+	return low != 0 &&
+	       percpu_counter_sum_positive(&ldlm_granted_total) > low;
+}
+
 static inline __u64 ldlm_ratio2locknr(int ratio)
 {
 	__u64 locknr;
@@ -391,6 +399,11 @@ bool ldlm_reclaim_full(void)
 	return false;
 }
 
+bool ldlm_reclaim_pressure(void)
+{
+	return false;
+}
+
 void ldlm_reclaim_add(struct ldlm_lock *lock)
 {
 }
@@ -1156,7 +1156,24 @@ static int lock_convert_interpret(const struct lu_env *env,
 		LDLM_DEBUG(lock,
 			   "convert ACK for lock without converting flag, reply ibits %#llx",
 			   reply->lock_desc.l_policy_data.l_inodebits.bits);
-	} else if (reply->lock_desc.l_policy_data.l_inodebits.bits !=
+	} else if (lock->l_resource->lr_type == LDLM_EXTENT &&
+		   (reply->lock_desc.l_granted_mode != lock->l_granted_mode ||
+		    reply->lock_desc.l_policy_data.l_extent.start !=
+		    lock->l_policy_data.l_extent.start ||
+		    reply->lock_desc.l_policy_data.l_extent.end !=
+		    lock->l_policy_data.l_extent.end)) {
+		/*
+		 * An extent lock is converted once before it is cancelled,
+		 * the server must have the same mode and extent. Cancel it
+		 * if that is not so.
+		 */
+		LDLM_ERROR(lock, "convert ACK with mode %d [%llu->%llu]",
+			   reply->lock_desc.l_granted_mode,
+			   reply->lock_desc.l_policy_data.l_extent.start,
+			   reply->lock_desc.l_policy_data.l_extent.end);
+		rc = -EPROTO;
+	} else if (lock->l_resource->lr_type == LDLM_IBITS &&
+		   reply->lock_desc.l_policy_data.l_inodebits.bits !=
 		   lock->l_policy_data.l_inodebits.bits) {
 		/*
 		 * Compare server returned lock ibits and local lock ibits
@@ -1182,7 +1199,8 @@ static int lock_convert_interpret(const struct lu_env *env,
 			 * and put lock into LRU if it is still not used and
 			 * is not there yet.
 			 */
-			lock->l_policy_data.l_inodebits.cancel_bits = 0;
+			if (lock->l_resource->lr_type == LDLM_IBITS)
+				lock->l_policy_data.l_inodebits.cancel_bits = 0;
 			if (!lock->l_readers && !lock->l_writers &&
 			    !ldlm_is_canceling(lock)) {
 				spin_lock(&ns->ns_lock);
@@ -1203,7 +1221,8 @@ out:
 			ldlm_clear_converting(lock);
 			ldlm_set_cbpending(lock);
 			ldlm_set_bl_ast(lock);
-			lock->l_policy_data.l_inodebits.cancel_bits = 0;
+			if (lock->l_resource->lr_type == LDLM_IBITS)
+				lock->l_policy_data.l_inodebits.cancel_bits = 0;
 		}
 		unlock_res_and_lock(lock);
 
@@ -1226,15 +1245,15 @@ out:
 }
 
 /**
- * Client-side IBITS lock convert.
+ * Client-side IBITS or EXTENT lock convert.
  *
  * Inform server that lock has been converted instead of canceling.
  * Server finishes convert on own side and does reprocess to grant
  * all related waiting locks.
  *
- * Since convert means only ibits downgrading, client doesn't need to
- * wait for server reply to finish local converting process so this request
- * is made asynchronous.
+ * Since convert means only ibits downgrading, or extent shrinking and PW to
+ * PR downgrade, client doesn't need to wait for server reply to finish local
+ * converting process so this request is made asynchronous.
  *
  */
 int ldlm_cli_convert(struct ldlm_lock *lock, __u32 *flags)
@@ -1256,13 +1275,20 @@ int ldlm_cli_convert(struct ldlm_lock *lock, __u32 *flags)
 	 * but this check is kept too as final one to issue an error
 	 * if any new code will miss such check.
 	 */
-	if (!exp_connect_lock_convert(exp)) {
+	if (lock->l_resource->lr_type == LDLM_IBITS &&
+	    !exp_connect_lock_convert(exp)) {
 		LDLM_ERROR(lock, "server doesn't support lock convert\n");
 		RETURN(-EPROTO);
 	}
 
-	if (lock->l_resource->lr_type != LDLM_IBITS) {
-		LDLM_ERROR(lock, "convert works with IBITS locks only.");
+	if (lock->l_resource->lr_type == LDLM_EXTENT) {
+		if (!exp_connect_extent_convert(exp)) {
+			LDLM_ERROR(lock,
+				   "server doesn't support extent lock convert\n");
+			RETURN(-EPROTO);
+		}
+	} else if (lock->l_resource->lr_type != LDLM_IBITS) {
+		LDLM_ERROR(lock, "convert works with IBITS and EXTENT locks only.");
 		RETURN(-EINVAL);
 	}
 
@@ -1280,9 +1306,15 @@ int ldlm_cli_convert(struct ldlm_lock *lock, __u32 *flags)
 	body->lock_desc.l_req_mode = lock->l_req_mode;
 	body->lock_desc.l_granted_mode = lock->l_granted_mode;
 
-	body->lock_desc.l_policy_data.l_inodebits.bits =
+	if (lock->l_resource->lr_type == LDLM_EXTENT) {
+		/* the new mode and extent of the lock */
+		ldlm_extent_policy_local_to_wire(&lock->l_policy_data,
+					&body->lock_desc.l_policy_data);
+	} else {
+		body->lock_desc.l_policy_data.l_inodebits.bits =
 					lock->l_policy_data.l_inodebits.bits;
-	body->lock_desc.l_policy_data.l_inodebits.cancel_bits = 0;
+		body->lock_desc.l_policy_data.l_inodebits.cancel_bits = 0;
+	}
 
 	body->lock_flags = ldlm_flags_to_wire(*flags);
 	body->lock_count = 1;
@@ -1552,6 +1584,9 @@ int ldlm_cli_update_pool(struct ptlrpc_request *req)
 	write_lock(&obd->obd_pool_lock);
 	obd->obd_pool_slv = new_slv;
 	obd->obd_pool_limit = new_limit;
+	/* the limit is our own lock budget if the server supports them */
+	obd->obd_pool_budget = imp_connect_lock_budget(req->rq_import) ?
+			       new_limit : 0;
 	write_unlock(&obd->obd_pool_lock);
 
 	RETURN(0);
@@ -1755,6 +1790,7 @@ static enum ldlm_policy_res ldlm_cancel_lrur_policy(struct ldlm_namespace *ns,
 	ktime_t cur = ktime_get();
 	struct ldlm_pool *pl = &ns->ns_pool;
 	u64 slv, lvf, lv;
+	__u32 budget;
 	s64 la;
 
 	/*
@@ -1772,6 +1808,17 @@ static enum ldlm_policy_res ldlm_cancel_lrur_policy(struct ldlm_namespace *ns,
 			ktime_add(lock->l_last_used, ns->ns_max_age)))
 		return LDLM_POLICY_CANCEL_LOCK;
 
+	/*
+	 * With a lock budget from the server, cancel the oldest locks until
+	 * we hold no more than the budget. SLV is not used then.
+	 */
+	budget = ldlm_pool_get_budget(pl);
+	if (budget != 0) {
+		if (atomic_read(&pl->pl_granted) - added > (int)budget)
+			return LDLM_POLICY_CANCEL_LOCK;
+		return LDLM_POLICY_KEEP_LOCK;
+	}
+
 	slv = ldlm_pool_get_slv(pl);
 	lvf = ldlm_pool_get_lvf(pl);
 	la = div_u64(ktime_to_ns(ktime_sub(cur, lock->l_last_used)),
@@ -1962,6 +2009,8 @@ static int ldlm_prepare_lru_list(struct ldlm_namespace *ns,
 				 enum ldlm_lru_flags lru_flags)
 {
 	ldlm_cancel_lru_policy_t pf;
+	struct list_head *lru = &ns->ns_unused_list;
+	struct list_head **last_pos = &ns->ns_last_pos;
 	int added = 0;
 	int no_wait = lru_flags & LDLM_LRU_FLAG_NO_WAIT;
 
@@ -1973,17 +2022,21 @@ static int ldlm_prepare_lru_list(struct ldlm_namespace *ns,
 	pf = ldlm_cancel_lru_policy(ns, lru_flags);
 	LASSERT(pf != NULL);
 
-	/* For any flags, stop scanning if @max is reached. */
-	while (!list_empty(&ns->ns_unused_list) && (max == 0 || added < max)) {
+	/*
+	 * For any flags, stop scanning if @max is reached. The protected locks
+	 * of the 2Q policy are scanned once ns_unused_list is done with, each
+	 * list is in the order of last use.
+	 */
+	while (max == 0 || added < max) {
 		struct ldlm_lock *lock;
 		struct list_head *item, *next;
 		enum ldlm_policy_res result;
 		ktime_t last_use = ktime_set(0, 0);
 
 		spin_lock(&ns->ns_lock);
-		item = no_wait ? ns->ns_last_pos : &ns->ns_unused_list;
+		item = no_wait ? *last_pos : lru;
 		for (item = item->next, next = item->next;
-		     item != &ns->ns_unused_list;
+		     item != lru;
 		     item = next, next = item->next) {
 			lock = list_entry(item, struct ldlm_lock, l_lru);
 
@@ -2000,9 +2053,13 @@ static int ldlm_prepare_lru_list(struct ldlm_namespace *ns,
 			 */
 			ldlm_lock_remove_from_lru_nolock(lock);
 		}
-		if (item == &ns->ns_unused_list) {
+		if (item == lru) {
 			spin_unlock(&ns->ns_lock);
-			break;
+			if (lru == &ns->ns_lru_protected)
+				break;
+			lru = &ns->ns_lru_protected;
+			last_pos = &ns->ns_protected_pos;
+			continue;
 		}
 
 		last_use = lock->l_last_used;
@@ -2030,7 +2087,12 @@ static int ldlm_prepare_lru_list(struct ldlm_namespace *ns,
 		if (result == LDLM_POLICY_KEEP_LOCK) {
 			lu_ref_del(&lock->l_reference, __func__, current);
 			LDLM_LOCK_RELEASE(lock);
-			break;
+			/* protected locks can be older than this one */
+			if (lru == &ns->ns_lru_protected)
+				break;
+			lru = &ns->ns_lru_protected;
+			last_pos = &ns->ns_protected_pos;
+			continue;
 		}
 
 		if (result == LDLM_POLICY_SKIP_LOCK) {
@@ -2038,8 +2100,8 @@ static int ldlm_prepare_lru_list(struct ldlm_namespace *ns,
 			if (no_wait) {
 				spin_lock(&ns->ns_lock);
 				if (!list_empty(&lock->l_lru) &&
-				    lock->l_lru.prev == ns->ns_last_pos)
-					ns->ns_last_pos = &lock->l_lru;
+				    lock->l_lru.prev == *last_pos)
+					*last_pos = &lock->l_lru;
 				spin_unlock(&ns->ns_lock);
 			}
 
@@ -2066,6 +2128,13 @@ static int ldlm_prepare_lru_list(struct ldlm_namespace *ns,
 		}
 		LASSERT(!lock->l_readers && !lock->l_writers);
 
+		spin_lock(&ns->ns_lock);
+		if (lock->l_lru_hits > 0)
+			ns->ns_lru_stats.ls_cancel_reused++;
+		else
+			ns->ns_lru_stats.ls_cancel_once++;
+		spin_unlock(&ns->ns_lock);
+
 		/*
 		 * If we have chosen to cancel this lock voluntarily, we
 		 * better send cancel notification to server, so that it
@@ -2329,10 +2398,8 @@ struct ldlm_cli_cancel_arg {
 };
 
 static int
-ldlm_cli_hash_cancel_unused(struct cfs_hash *hs, struct cfs_hash_bd *bd,
-			    struct hlist_node *hnode, void *arg)
+ldlm_cli_hash_cancel_unused(struct ldlm_resource *res, void *arg)
 {
-	struct ldlm_resource           *res = cfs_hash_object(hs, hnode);
 	struct ldlm_cli_cancel_arg     *lc = arg;
 
 	ldlm_cli_cancel_unused_resource(ldlm_res_to_ns(res), &res->lr_name,
@@ -2368,8 +2435,8 @@ int ldlm_cli_cancel_unused(struct ldlm_namespace *ns,
 						       LCK_MINMODE, flags,
 						       opaque));
 	} else {
-		cfs_hash_for_each_nolock(ns->ns_rs_hash,
-					 ldlm_cli_hash_cancel_unused, &arg, 0);
+		ldlm_namespace_foreach_res(ns, ldlm_cli_hash_cancel_unused,
+					   &arg);
 		RETURN(ELDLM_OK);
 	}
 }
@@ -2419,12 +2486,8 @@ static int ldlm_iter_helper(struct ldlm_lock *lock, void *closure)
 	return helper->iter(lock, helper->closure);
 }
 
-static int ldlm_res_iter_helper(struct cfs_hash *hs, struct cfs_hash_bd *bd,
-				struct hlist_node *hnode, void *arg)
-
+static int ldlm_res_iter_helper(struct ldlm_resource *res, void *arg)
 {
-	struct ldlm_resource *res = cfs_hash_object(hs, hnode);
-
 	return ldlm_resource_foreach(res, ldlm_iter_helper, arg) ==
 				     LDLM_ITER_STOP;
 }
@@ -2435,8 +2498,7 @@ void ldlm_namespace_foreach(struct ldlm_namespace *ns,
 {
 	struct iter_helper_data helper = { .iter = iter, .closure = closure };
 
-	cfs_hash_for_each_nolock(ns->ns_rs_hash,
-				 ldlm_res_iter_helper, &helper, 0);
+	ldlm_namespace_foreach_res(ns, ldlm_res_iter_helper, &helper);
 
 }
 
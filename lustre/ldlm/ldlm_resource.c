@@ -97,6 +97,7 @@ ldlm_rw_uint_seq_write(struct file *file, const char __user *buffer,
 }
 
 LDEBUGFS_SEQ_FOPS(ldlm_rw_uint);
+LDEBUGFS_SEQ_FOPS(ldlm_bl_stats);
 
 #ifdef HAVE_SERVER_SUPPORT
 
@@ -204,6 +205,8 @@ static struct lprocfs_vars ldlm_debugfs_list[] = {
 	{ .name	=	"dump_granted_max",
 	  .fops	=	&ldlm_rw_uint_fops,
 	  .data	=	&ldlm_dump_granted_max },
+	{ .name	=	"bl_queue_stats",
+	  .fops	=	&ldlm_bl_stats_fops },
 #ifdef HAVE_SERVER_SUPPORT
 	{ .name =	"lock_reclaim_threshold_mb",
 	  .fops =	&ldlm_watermark_fops,
@@ -294,17 +297,45 @@ static ssize_t resource_count_show(struct kobject *kobj, struct attribute *attr,
 {
 	struct ldlm_namespace *ns = container_of(kobj, struct ldlm_namespace,
 						 ns_kobj);
-	__u64			res = 0;
-	struct cfs_hash_bd		bd;
-	int			i;
 
-	/* result is not strictly consistant */
-	cfs_hash_for_each_bucket(ns->ns_rs_hash, &bd, i)
-		res += cfs_hash_bd_count_get(&bd);
-	return sprintf(buf, "%lld\n", res);
+	return sprintf(buf, "%d\n", atomic_read(&ns->ns_rs_hash.nelems));
 }
 LUSTRE_RO_ATTR(resource_count);
 
+/*
+ * Shape of the resource hash and how lookups fared: the number of hash
+ * buckets against the number of resources gives the average chain length,
+ * races and retries show threads contending on the same resource name.
+ */
+static ssize_t resource_hash_stats_show(struct kobject *kobj,
+					struct attribute *attr, char *buf)
+{
+	struct ldlm_namespace *ns = container_of(kobj, struct ldlm_namespace,
+						 ns_kobj);
+	const struct bucket_table *tbl;
+	unsigned int buckets;
+	__u64 stats[LDLM_NSS_LAST];
+	int i;
+
+	rcu_read_lock();
+	tbl = rht_dereference_rcu(ns->ns_rs_hash.tbl, &ns->ns_rs_hash);
+	buckets = tbl->size;
+	rcu_read_unlock();
+
+	for (i = LDLM_NSS_RES_LOOKUPS; i < LDLM_NSS_LAST; i++)
+		stats[i] = lprocfs_stats_collector(ns->ns_stats, i,
+						   LPROCFS_FIELDS_FLAGS_SUM);
+
+	return sprintf(buf, "buckets: %u resources: %d lookups: %llu "
+		       "creates: %llu races: %llu retries: %llu\n",
+		       buckets, atomic_read(&ns->ns_rs_hash.nelems),
+		       stats[LDLM_NSS_RES_LOOKUPS],
+		       stats[LDLM_NSS_RES_CREATES],
+		       stats[LDLM_NSS_RES_RACES],
+		       stats[LDLM_NSS_RES_RETRIES]);
+}
+LUSTRE_RO_ATTR(resource_hash_stats);
+
 static ssize_t lock_count_show(struct kobject *kobj, struct attribute *attr,
 			       char *buf)
 {
@@ -458,6 +489,75 @@ static ssize_t lru_max_age_store(struct kobject *kobj, struct attribute *attr,
 }
 LUSTRE_RW_ATTR(lru_max_age);
 
+static const char *const ldlm_lru_policy_names[] = {
+	[LDLM_LRU_POLICY_LRU]	= "lru",
+	[LDLM_LRU_POLICY_2Q]	= "2q",
+};
+
+static ssize_t lru_cancel_policy_show(struct kobject *kobj,
+				      struct attribute *attr, char *buf)
+{
+	struct ldlm_namespace *ns = container_of(kobj, struct ldlm_namespace,
+						 ns_kobj);
+
+	return sprintf(buf, "%s\n", ldlm_lru_policy_names[ns->ns_lru_policy]);
+}
+
+static ssize_t lru_cancel_policy_store(struct kobject *kobj,
+				       struct attribute *attr,
+				       const char *buffer, size_t count)
+{
+	struct ldlm_namespace *ns = container_of(kobj, struct ldlm_namespace,
+						 ns_kobj);
+	int i;
+
+	for (i = 0; i < ARRAY_SIZE(ldlm_lru_policy_names); i++) {
+		if (sysfs_streq(buffer, ldlm_lru_policy_names[i])) {
+			ldlm_namespace_set_lru_policy(ns, i);
+			return count;
+		}
+	}
+
+	return -EINVAL;
+}
+LUSTRE_RW_ATTR(lru_cancel_policy);
+
+static ssize_t lru_stats_show(struct kobject *kobj, struct attribute *attr,
+			      char *buf)
+{
+	struct ldlm_namespace *ns = container_of(kobj, struct ldlm_namespace,
+						 ns_kobj);
+	struct ldlm_lru_stats stats;
+	int protected;
+
+	spin_lock(&ns->ns_lock);
+	stats = ns->ns_lru_stats;
+	protected = ns->ns_nr_protected;
+	spin_unlock(&ns->ns_lock);
+
+	return sprintf(buf, "inserts: %llu hits: %llu promotions: %llu demotions: %llu cancel_once: %llu cancel_reused: %llu protected: %d\n",
+		       stats.ls_inserts, stats.ls_hits, stats.ls_promotions,
+		       stats.ls_demotions, stats.ls_cancel_once,
+		       stats.ls_cancel_reused, protected);
+}
+
+static ssize_t lru_stats_store(struct kobject *kobj, struct attribute *attr,
+			       const char *buffer, size_t count)
+{
+	struct ldlm_namespace *ns = container_of(kobj, struct ldlm_namespace,
+						 ns_kobj);
+
+	if (strncmp(buffer, "clear", 5) != 0)
+		return -EINVAL;
+
+	spin_lock(&ns->ns_lock);
+	memset(&ns->ns_lru_stats, 0, sizeof(ns->ns_lru_stats));
+	spin_unlock(&ns->ns_lock);
+
+	return count;
+}
+LUSTRE_RW_ATTR(lru_stats);
+
 static ssize_t early_lock_cancel_show(struct kobject *kobj,
 				      struct attribute *attr,
 				      char *buf)
@@ -663,15 +763,107 @@ static ssize_t max_parallel_ast_store(struct kobject *kobj,
 }
 LUSTRE_RW_ATTR(max_parallel_ast);
 
+static ssize_t max_bl_ast_batch_show(struct kobject *kobj,
+				     struct attribute *attr, char *buf)
+{
+	struct ldlm_namespace *ns = container_of(kobj, struct ldlm_namespace,
+						 ns_kobj);
+
+	return sprintf(buf, "%u\n", ns->ns_max_bl_ast_batch);
+}
+
+static ssize_t max_bl_ast_batch_store(struct kobject *kobj,
+				      struct attribute *attr,
+				      const char *buffer, size_t count)
+{
+	struct ldlm_namespace *ns = container_of(kobj, struct ldlm_namespace,
+						 ns_kobj);
+	unsigned int tmp;
+	int err;
+
+	err = kstrtouint(buffer, 10, &tmp);
+	if (err != 0)
+		return -EINVAL;
+	if (tmp == 0 || tmp > LDLM_MAX_BL_AST_BATCH)
+		return -ERANGE;
+
+	ns->ns_max_bl_ast_batch = tmp;
+
+	return count;
+}
+LUSTRE_RW_ATTR(max_bl_ast_batch);
+
+static ssize_t bl_ast_batch_stats_show(struct kobject *kobj,
+				       struct attribute *attr, char *buf)
+{
+	struct ldlm_namespace *ns = container_of(kobj, struct ldlm_namespace,
+						 ns_kobj);
+
+	return sprintf(buf, "rpcs: %lld locks: %lld\n",
+		       (long long)atomic64_read(&ns->ns_bl_ast_batch_rpcs),
+		       (long long)atomic64_read(&ns->ns_bl_ast_batch_locks));
+}
+LUSTRE_RO_ATTR(bl_ast_batch_stats);
+
+static ssize_t ibits_bench_show(struct kobject *kobj, struct attribute *attr,
+				char *buf)
+{
+	struct ldlm_namespace *ns = container_of(kobj, struct ldlm_namespace,
+						 ns_kobj);
+
+	return sprintf(buf, "locks: %u walk_ns: %llu indexed_ns: %llu\n",
+		       ns->ns_ibits_bench_locks, ns->ns_ibits_bench_walk_ns,
+		       ns->ns_ibits_bench_indexed_ns);
+}
+
+/*
+ * Run the inodebits compatibility microbenchmark with this many locks.
+ * It creates twice as many locks in this namespace, so it is for testing
+ * only and needs fail_loc OBD_FAIL_LDLM_IBITS_BENCH set.
+ */
+static ssize_t ibits_bench_store(struct kobject *kobj, struct attribute *attr,
+				 const char *buffer, size_t count)
+{
+	struct ldlm_namespace *ns = container_of(kobj, struct ldlm_namespace,
+						 ns_kobj);
+	__u64 walk_ns;
+	__u64 indexed_ns;
+	unsigned int tmp;
+	int err;
+
+	if (!OBD_FAIL_CHECK(OBD_FAIL_LDLM_IBITS_BENCH))
+		return -EPERM;
+
+	err = kstrtouint(buffer, 10, &tmp);
+	if (err != 0)
+		return -EINVAL;
+	if (tmp == 0 || tmp > 100000)
+		return -ERANGE;
+
+	err = ldlm_ibits_bench(ns, tmp, &walk_ns, &indexed_ns);
+	if (err != 0)
+		return err;
+
+	ns->ns_ibits_bench_locks = tmp;
+	ns->ns_ibits_bench_walk_ns = walk_ns;
+	ns->ns_ibits_bench_indexed_ns = indexed_ns;
+
+	return count;
+}
+LUSTRE_RW_ATTR(ibits_bench);
+
 #endif /* HAVE_SERVER_SUPPORT */
 
 /* These are for namespaces in /sys/fs/lustre/ldlm/namespaces/ */
 static struct attribute *ldlm_ns_attrs[] = {
 	&lustre_attr_resource_count.attr,
+	&lustre_attr_resource_hash_stats.attr,
 	&lustre_attr_lock_count.attr,
 	&lustre_attr_lock_unused_count.attr,
 	&lustre_attr_lru_size.attr,
 	&lustre_attr_lru_max_age.attr,
+	&lustre_attr_lru_cancel_policy.attr,
+	&lustre_attr_lru_stats.attr,
 	&lustre_attr_early_lock_cancel.attr,
 	&lustre_attr_dirty_age_limit.attr,
 #ifdef HAVE_SERVER_SUPPORT
@@ -681,6 +873,9 @@ static struct attribute *ldlm_ns_attrs[] = {
 	&lustre_attr_contention_seconds.attr,
 	&lustre_attr_contended_locks.attr,
 	&lustre_attr_max_parallel_ast.attr,
+	&lustre_attr_max_bl_ast_batch.attr,
+	&lustre_attr_bl_ast_batch_stats.attr,
+	&lustre_attr_ibits_bench.attr,
 #endif
 	NULL,
 };
@@ -733,10 +928,51 @@ int ldlm_namespace_sysfs_register(struct ldlm_namespace *ns)
 
 	lprocfs_counter_init(ns->ns_stats, LDLM_NSS_LOCKS,
 			     LPROCFS_CNTR_AVGMINMAX, "locks", "locks");
+	lprocfs_counter_init(ns->ns_stats, LDLM_NSS_RES_LOOKUPS, 0,
+			     "res_lookups", "lookups");
+	lprocfs_counter_init(ns->ns_stats, LDLM_NSS_RES_CREATES, 0,
+			     "res_creates", "resources");
+	lprocfs_counter_init(ns->ns_stats, LDLM_NSS_RES_RACES, 0,
+			     "res_races", "inserts");
+	lprocfs_counter_init(ns->ns_stats, LDLM_NSS_RES_RETRIES, 0,
+			     "res_retries", "lookups");
 
 	return err;
 }
 
+#ifdef HAVE_SERVER_SUPPORT
+/* Locks granted to each client of a server namespace and their budgets */
+static int ldlm_ns_exports_seq_show(struct seq_file *m, void *v)
+{
+	struct ldlm_namespace *ns = m->private;
+	struct obd_device *obd = ns->ns_obd;
+	struct obd_export *exp;
+
+	if (obd == NULL)
+		return 0;
+
+	spin_lock(&obd->obd_dev_lock);
+	list_for_each_entry(exp, &obd->obd_exports, exp_obd_chain) {
+		if (exp == obd->obd_self_export)
+			continue;
+
+		seq_printf(m, "%s:\n"
+			   "    nid: %s\n"
+			   "    locks: %d\n"
+			   "    budget: %d\n",
+			   exp->exp_client_uuid.uuid,
+			   obd_export_nid2str(exp),
+			   atomic_read(&exp->exp_pool_granted),
+			   exp_connect_lock_budget(exp) ?
+			   ldlm_export_lock_budget(exp) : 0);
+	}
+	spin_unlock(&obd->obd_dev_lock);
+
+	return 0;
+}
+LDEBUGFS_SEQ_FOPS_RO(ldlm_ns_exports);
+#endif /* HAVE_SERVER_SUPPORT */
+
 static int ldlm_namespace_debugfs_register(struct ldlm_namespace *ns)
 {
 	struct dentry *ns_entry;
@@ -751,119 +987,31 @@ static int ldlm_namespace_debugfs_register(struct ldlm_namespace *ns)
 		ns->ns_debugfs_entry = ns_entry;
 	}
 
-	return 0;
-}
-#undef MAX_STRING_SIZE
-
-static unsigned ldlm_res_hop_hash(struct cfs_hash *hs,
-				  const void *key, unsigned int mask)
-{
-	const struct ldlm_res_id *id = key;
-	unsigned int val = 0;
-	unsigned int i;
-
-	for (i = 0; i < RES_NAME_SIZE; i++)
-		val += id->name[i];
-	return val & mask;
-}
-
-static unsigned ldlm_res_hop_fid_hash(struct cfs_hash *hs,
-                                      const void *key, unsigned mask)
-{
-	const struct ldlm_res_id *id = key;
-	struct lu_fid       fid;
-	__u32               hash;
-	__u32               val;
-
-	fid.f_seq = id->name[LUSTRE_RES_ID_SEQ_OFF];
-	fid.f_oid = (__u32)id->name[LUSTRE_RES_ID_VER_OID_OFF];
-	fid.f_ver = (__u32)(id->name[LUSTRE_RES_ID_VER_OID_OFF] >> 32);
+#ifdef HAVE_SERVER_SUPPORT
+	if (ns_is_server(ns)) {
+		struct lprocfs_vars ns_vars[2];
 
-	hash = fid_flatten32(&fid);
-	hash += (hash >> 4) + (hash << 12); /* mixing oid and seq */
-	if (id->name[LUSTRE_RES_ID_HSH_OFF] != 0) {
-		val = id->name[LUSTRE_RES_ID_HSH_OFF];
-		hash += (val >> 5) + (val << 11);
-	} else {
-		val = fid_oid(&fid);
+		memset(ns_vars, 0, sizeof(ns_vars));
+		ldlm_add_var(&ns_vars[0], ns_entry, "exports", ns,
+			     &ldlm_ns_exports_fops);
 	}
-	hash = hash_long(hash, hs->hs_bkt_bits);
-	/* give me another random factor */
-	hash -= hash_long((unsigned long)hs, val % 11 + 3);
-
-	hash <<= hs->hs_cur_bits - hs->hs_bkt_bits;
-	hash |= ldlm_res_hop_hash(hs, key, CFS_HASH_NBKT(hs) - 1);
-
-	return hash & mask;
-}
-
-static void *ldlm_res_hop_key(struct hlist_node *hnode)
-{
-	struct ldlm_resource   *res;
-
-	res = hlist_entry(hnode, struct ldlm_resource, lr_hash);
-	return &res->lr_name;
-}
-
-static int ldlm_res_hop_keycmp(const void *key, struct hlist_node *hnode)
-{
-	struct ldlm_resource   *res;
-
-	res = hlist_entry(hnode, struct ldlm_resource, lr_hash);
-	return ldlm_res_eq((const struct ldlm_res_id *)key,
-			   (const struct ldlm_res_id *)&res->lr_name);
-}
-
-static void *ldlm_res_hop_object(struct hlist_node *hnode)
-{
-	return hlist_entry(hnode, struct ldlm_resource, lr_hash);
-}
-
-static void
-ldlm_res_hop_get_locked(struct cfs_hash *hs, struct hlist_node *hnode)
-{
-	struct ldlm_resource *res;
-
-	res = hlist_entry(hnode, struct ldlm_resource, lr_hash);
-	ldlm_resource_getref(res);
-}
-
-static void ldlm_res_hop_put(struct cfs_hash *hs, struct hlist_node *hnode)
-{
-	struct ldlm_resource *res;
+#endif
 
-	res = hlist_entry(hnode, struct ldlm_resource, lr_hash);
-	ldlm_resource_putref(res);
+	return 0;
 }
+#undef MAX_STRING_SIZE
 
-static struct cfs_hash_ops ldlm_ns_hash_ops = {
-	.hs_hash        = ldlm_res_hop_hash,
-	.hs_key         = ldlm_res_hop_key,
-	.hs_keycmp      = ldlm_res_hop_keycmp,
-	.hs_keycpy      = NULL,
-	.hs_object      = ldlm_res_hop_object,
-	.hs_get         = ldlm_res_hop_get_locked,
-	.hs_put         = ldlm_res_hop_put
-};
-
-static struct cfs_hash_ops ldlm_ns_fid_hash_ops = {
-	.hs_hash        = ldlm_res_hop_fid_hash,
-	.hs_key         = ldlm_res_hop_key,
-	.hs_keycmp      = ldlm_res_hop_keycmp,
-	.hs_keycpy      = NULL,
-	.hs_object      = ldlm_res_hop_object,
-	.hs_get         = ldlm_res_hop_get_locked,
-	.hs_put         = ldlm_res_hop_put
+static const struct rhashtable_params ldlm_ns_rs_hash_params = {
+	.key_len		= sizeof(struct ldlm_res_id),
+	.key_offset		= offsetof(struct ldlm_resource, lr_name),
+	.head_offset		= offsetof(struct ldlm_resource, lr_hash),
+	.automatic_shrinking	= true,
 };
 
 typedef struct ldlm_ns_hash_def {
 	enum ldlm_ns_type	nsd_type;
-	/** hash bucket bits */
+	/** ldlm_ns_bucket bits */
 	unsigned		nsd_bkt_bits;
-	/** hash bits */
-	unsigned		nsd_all_bits;
-	/** hash operations */
-	struct cfs_hash_ops *nsd_hops;
 } ldlm_ns_hash_def_t;
 
 static struct ldlm_ns_hash_def ldlm_ns_hash_defs[] =
@@ -871,44 +1019,42 @@ static struct ldlm_ns_hash_def ldlm_ns_hash_defs[] =
 	{
 		.nsd_type       = LDLM_NS_TYPE_MDC,
 		.nsd_bkt_bits   = 11,
-		.nsd_all_bits   = 16,
-		.nsd_hops       = &ldlm_ns_fid_hash_ops,
 	},
 	{
 		.nsd_type       = LDLM_NS_TYPE_MDT,
 		.nsd_bkt_bits   = 14,
-		.nsd_all_bits   = 21,
-		.nsd_hops       = &ldlm_ns_fid_hash_ops,
 	},
 	{
 		.nsd_type       = LDLM_NS_TYPE_OSC,
 		.nsd_bkt_bits   = 8,
-		.nsd_all_bits   = 12,
-		.nsd_hops       = &ldlm_ns_hash_ops,
 	},
 	{
 		.nsd_type       = LDLM_NS_TYPE_OST,
 		.nsd_bkt_bits   = 11,
-		.nsd_all_bits   = 17,
-		.nsd_hops       = &ldlm_ns_hash_ops,
 	},
 	{
 		.nsd_type       = LDLM_NS_TYPE_MGC,
 		.nsd_bkt_bits   = 4,
-		.nsd_all_bits   = 4,
-		.nsd_hops       = &ldlm_ns_hash_ops,
 	},
 	{
 		.nsd_type       = LDLM_NS_TYPE_MGT,
 		.nsd_bkt_bits   = 4,
-		.nsd_all_bits   = 4,
-		.nsd_hops       = &ldlm_ns_hash_ops,
 	},
 	{
 		.nsd_type       = LDLM_NS_TYPE_UNKNOWN,
 	},
 };
 
+static struct ldlm_ns_bucket *
+ldlm_ns_bucket_find(struct ldlm_namespace *ns, const struct ldlm_res_id *name)
+{
+	__u32 hash;
+
+	hash = jhash2((const __u32 *)name->name,
+		      sizeof(name->name) / sizeof(__u32), 0);
+	return &ns->ns_rs_buckets[hash & ((1U << ns->ns_rs_bucket_bits) - 1)];
+}
+
 /**
  * Create and initialize new empty namespace.
  */
@@ -920,7 +1066,6 @@ struct ldlm_namespace *ldlm_namespace_new(struct obd_device *obd, char *name,
 	struct ldlm_namespace *ns = NULL;
 	struct ldlm_ns_bucket *nsb;
 	struct ldlm_ns_hash_def *nsd;
-	struct cfs_hash_bd bd;
 	int idx;
 	int rc;
 
@@ -948,35 +1093,34 @@ struct ldlm_namespace *ldlm_namespace_new(struct obd_device *obd, char *name,
 	if (!ns)
 		GOTO(out_ref, NULL);
 
-	ns->ns_rs_hash = cfs_hash_create(name,
-					 nsd->nsd_all_bits, nsd->nsd_all_bits,
-					 nsd->nsd_bkt_bits, sizeof(*nsb),
-					 CFS_HASH_MIN_THETA,
-					 CFS_HASH_MAX_THETA,
-					 nsd->nsd_hops,
-					 CFS_HASH_DEPTH |
-					 CFS_HASH_BIGNAME |
-					 CFS_HASH_SPIN_BKTLOCK |
-					 CFS_HASH_NO_ITEMREF);
-	if (ns->ns_rs_hash == NULL)
+	rc = rhashtable_init(&ns->ns_rs_hash, &ldlm_ns_rs_hash_params);
+	if (rc)
 		GOTO(out_ns, NULL);
 
-	cfs_hash_for_each_bucket(ns->ns_rs_hash, &bd, idx) {
-		nsb = cfs_hash_bd_extra_get(ns->ns_rs_hash, &bd);
+	ns->ns_rs_bucket_bits = nsd->nsd_bkt_bits;
+	OBD_ALLOC_LARGE(ns->ns_rs_buckets,
+			sizeof(*nsb) << ns->ns_rs_bucket_bits);
+	if (!ns->ns_rs_buckets)
+		GOTO(out_hash, NULL);
+
+	for (idx = 0; idx < (1 << ns->ns_rs_bucket_bits); idx++) {
+		nsb = &ns->ns_rs_buckets[idx];
 		at_init(&nsb->nsb_at_estimate, ldlm_enqueue_min, 0);
 		nsb->nsb_namespace = ns;
-		nsb->nsb_reclaim_start = 0;
+		atomic_set(&nsb->nsb_count, 0);
 	}
 
 	ns->ns_obd = obd;
 	ns->ns_appetite = apt;
 	ns->ns_client = client;
+	ns->ns_type = ns_type;
 	ns->ns_name = kstrdup(name, GFP_KERNEL);
 	if (!ns->ns_name)
-		goto out_hash;
+		goto out_buckets;
 
 	INIT_LIST_HEAD(&ns->ns_list_chain);
 	INIT_LIST_HEAD(&ns->ns_unused_list);
+	INIT_LIST_HEAD(&ns->ns_lru_protected);
 	spin_lock_init(&ns->ns_lock);
 	atomic_set(&ns->ns_bref, 0);
 	init_waitqueue_head(&ns->ns_waitq);
@@ -986,6 +1130,9 @@ struct ldlm_namespace *ldlm_namespace_new(struct obd_device *obd, char *name,
 	ns->ns_contended_locks    = NS_DEFAULT_CONTENDED_LOCKS;
 
 	ns->ns_max_parallel_ast   = LDLM_DEFAULT_PARALLEL_AST_LIMIT;
+	ns->ns_max_bl_ast_batch   = LDLM_DEFAULT_BL_AST_BATCH;
+	atomic64_set(&ns->ns_bl_ast_batch_rpcs, 0);
+	atomic64_set(&ns->ns_bl_ast_batch_locks, 0);
 	ns->ns_nr_unused          = 0;
 	ns->ns_max_unused         = LDLM_DEFAULT_LRU_SIZE;
 	ns->ns_max_age            = ktime_set(LDLM_DEFAULT_MAX_ALIVE, 0);
@@ -997,11 +1144,20 @@ struct ldlm_namespace *ldlm_namespace_new(struct obd_device *obd, char *name,
 	ns->ns_stopping           = 0;
 	ns->ns_reclaim_start	  = 0;
 	ns->ns_last_pos		  = &ns->ns_unused_list;
+	ns->ns_protected_pos	  = &ns->ns_lru_protected;
+	ns->ns_lru_policy	  = LDLM_LRU_POLICY_LRU;
+
+	/* flock deadlock detection */
+	if (client == LDLM_NAMESPACE_SERVER && ns_type == LDLM_NS_TYPE_MDT) {
+		rc = ldlm_init_flock_namespace(ns);
+		if (rc)
+			GOTO(out_name, rc);
+	}
 
 	rc = ldlm_namespace_sysfs_register(ns);
 	if (rc) {
 		CERROR("Can't initialize ns sysfs, rc %d\n", rc);
-		GOTO(out_hash, rc);
+		GOTO(out_flock, rc);
 	}
 
 	rc = ldlm_namespace_debugfs_register(ns);
@@ -1024,9 +1180,15 @@ out_proc:
 out_sysfs:
 	ldlm_namespace_sysfs_unregister(ns);
 	ldlm_namespace_cleanup(ns, 0);
-out_hash:
+out_flock:
+	ldlm_destroy_flock_namespace(ns);
+out_name:
 	kfree(ns->ns_name);
-	cfs_hash_putref(ns->ns_rs_hash);
+out_buckets:
+	OBD_FREE_LARGE(ns->ns_rs_buckets,
+		       sizeof(*nsb) << ns->ns_rs_bucket_bits);
+out_hash:
+	rhashtable_destroy(&ns->ns_rs_hash);
 out_ns:
         OBD_FREE_PTR(ns);
 out_ref:
@@ -1122,10 +1284,58 @@ static void cleanup_resource(struct ldlm_resource *res, struct list_head *q,
 	} while (1);
 }
 
-static int ldlm_resource_clean(struct cfs_hash *hs, struct cfs_hash_bd *bd,
-			       struct hlist_node *hnode, void *arg)
+/**
+ * Call \a iter for every resource in namespace \a ns, until it returns
+ * non-zero.
+ *
+ * \a iter is called with a reference held on the resource and outside of
+ * RCU, so it may block. Resources added or removed during the walk may or
+ * may not be seen, and a resize of the hash may cause a resource to be
+ * visited more than once.
+ */
+void ldlm_namespace_foreach_res(struct ldlm_namespace *ns,
+				ldlm_res_iterator_t iter, void *arg)
+{
+	struct rhashtable_iter hiter;
+	struct ldlm_resource *prev = NULL;
+	struct ldlm_resource *res;
+	int rc;
+
+	rhashtable_walk_enter(&ns->ns_rs_hash, &hiter);
+	rhashtable_walk_start(&hiter);
+	while ((res = rhashtable_walk_next(&hiter)) != NULL) {
+		if (IS_ERR(res)) {
+			if (PTR_ERR(res) == -EAGAIN)
+				continue;
+			break;
+		}
+
+		/* being freed, just skip it */
+		if (!atomic_inc_not_zero(&res->lr_refcount))
+			continue;
+
+		rhashtable_walk_stop(&hiter);
+		/* keep the reference on the current resource until the walk
+		 * is restarted, so it cannot go away under the walker */
+		if (prev != NULL)
+			ldlm_resource_putref(prev);
+		prev = res;
+
+		rc = iter(res, arg);
+		rhashtable_walk_start(&hiter);
+		if (rc)
+			break;
+	}
+	rhashtable_walk_stop(&hiter);
+	rhashtable_walk_exit(&hiter);
+
+	if (prev != NULL)
+		ldlm_resource_putref(prev);
+}
+EXPORT_SYMBOL(ldlm_namespace_foreach_res);
+
+static int ldlm_resource_clean(struct ldlm_resource *res, void *arg)
 {
-	struct ldlm_resource *res = cfs_hash_object(hs, hnode);
 	__u64 flags = *(__u64 *)arg;
 
 	cleanup_resource(res, &res->lr_granted, flags);
@@ -1134,11 +1344,8 @@ static int ldlm_resource_clean(struct cfs_hash *hs, struct cfs_hash_bd *bd,
 	return 0;
 }
 
-static int ldlm_resource_complain(struct cfs_hash *hs, struct cfs_hash_bd *bd,
-				  struct hlist_node *hnode, void *arg)
+static int ldlm_resource_complain(struct ldlm_resource *res, void *arg)
 {
-	struct ldlm_resource  *res = cfs_hash_object(hs, hnode);
-
 	lock_res(res);
 	CERROR("%s: namespace resource "DLDLMRES" (%p) refcount nonzero "
 	       "(%d) after lock cleanup; forcing cleanup.\n",
@@ -1165,10 +1372,8 @@ int ldlm_namespace_cleanup(struct ldlm_namespace *ns, __u64 flags)
 		return ELDLM_OK;
 	}
 
-	cfs_hash_for_each_nolock(ns->ns_rs_hash, ldlm_resource_clean,
-				 &flags, 0);
-	cfs_hash_for_each_nolock(ns->ns_rs_hash, ldlm_resource_complain,
-				 NULL, 0);
+	ldlm_namespace_foreach_res(ns, ldlm_resource_clean, &flags);
+	ldlm_namespace_foreach_res(ns, ldlm_resource_complain, NULL);
 	return ELDLM_OK;
 }
 EXPORT_SYMBOL(ldlm_namespace_cleanup);
@@ -1291,7 +1496,10 @@ void ldlm_namespace_free_post(struct ldlm_namespace *ns)
 
 	ldlm_namespace_debugfs_unregister(ns);
 	ldlm_namespace_sysfs_unregister(ns);
-	cfs_hash_putref(ns->ns_rs_hash);
+	ldlm_destroy_flock_namespace(ns);
+	rhashtable_destroy(&ns->ns_rs_hash);
+	OBD_FREE_LARGE(ns->ns_rs_buckets,
+		       sizeof(*ns->ns_rs_buckets) << ns->ns_rs_bucket_bits);
 	kfree(ns->ns_name);
 	/* Namespace \a ns should be not on list at this time, otherwise
 	 * this will cause issues related to using freed \a ns in poold
@@ -1405,25 +1613,19 @@ struct ldlm_namespace *ldlm_namespace_first_locked(enum ldlm_side client)
 static struct ldlm_resource *ldlm_resource_new(enum ldlm_type ldlm_type)
 {
 	struct ldlm_resource *res;
-	int idx;
 
 	OBD_SLAB_ALLOC_PTR_GFP(res, ldlm_resource_slab, GFP_NOFS);
 	if (res == NULL)
 		return NULL;
 
-	if (ldlm_type == LDLM_EXTENT) {
-		OBD_SLAB_ALLOC(res->lr_itree, ldlm_interval_tree_slab,
-			       sizeof(*res->lr_itree) * LCK_MODE_NUM);
+	if (ldlm_type == LDLM_EXTENT || ldlm_type == LDLM_FLOCK) {
+		/* one zeroed interval tree shared by all lock modes */
+		OBD_SLAB_ALLOC_PTR_GFP(res->lr_itree, ldlm_interval_tree_slab,
+				       GFP_NOFS);
 		if (res->lr_itree == NULL) {
 			OBD_SLAB_FREE_PTR(res, ldlm_resource_slab);
 			return NULL;
 		}
-		/* Initialize interval trees for each lock mode. */
-		for (idx = 0; idx < LCK_MODE_NUM; idx++) {
-			res->lr_itree[idx].lit_size = 0;
-			res->lr_itree[idx].lit_mode = 1 << idx;
-			res->lr_itree[idx].lit_root = NULL;
-		}
 	}
 
 	INIT_LIST_HEAD(&res->lr_granted);
@@ -1444,7 +1646,7 @@ static struct ldlm_resource *ldlm_resource_new(enum ldlm_type ldlm_type)
 /**
  * Return a reference to resource with given name, creating it if necessary.
  * Args: namespace with ns_lock unlocked
- * Locks: takes and releases NS hash-lock and res->lr_lock
+ * Locks: none, the lookup is done under RCU
  * Returns: referenced, unlocked ldlm_resource or NULL
  */
 struct ldlm_resource *
@@ -1452,26 +1654,25 @@ ldlm_resource_get(struct ldlm_namespace *ns, struct ldlm_resource *parent,
 		  const struct ldlm_res_id *name, enum ldlm_type type,
 		  int create)
 {
-	struct hlist_node	*hnode;
-	struct ldlm_resource	*res = NULL;
-	struct cfs_hash_bd		bd;
-	__u64			version;
+	struct ldlm_resource	*res;
+	struct ldlm_resource	*old;
 	int			ns_refcount = 0;
 
 	LASSERT(ns != NULL);
 	LASSERT(parent == NULL);
-	LASSERT(ns->ns_rs_hash != NULL);
 	LASSERT(name->name[0] != 0);
 
-	cfs_hash_bd_get_and_lock(ns->ns_rs_hash, (void *)name, &bd, 0);
-	hnode = cfs_hash_bd_lookup_locked(ns->ns_rs_hash, &bd, (void *)name);
-	if (hnode != NULL) {
-		cfs_hash_bd_unlock(ns->ns_rs_hash, &bd, 0);
-		GOTO(found, res);
-	}
+	lprocfs_counter_incr(ns->ns_stats, LDLM_NSS_RES_LOOKUPS);
 
-	version = cfs_hash_bd_version_get(&bd);
-	cfs_hash_bd_unlock(ns->ns_rs_hash, &bd, 0);
+	rcu_read_lock();
+	res = rhashtable_lookup_fast(&ns->ns_rs_hash, name,
+				     ldlm_ns_rs_hash_params);
+	/* a resource without references is on its way out of the hash */
+	if (res != NULL && atomic_inc_not_zero(&res->lr_refcount)) {
+		rcu_read_unlock();
+		return res;
+	}
+	rcu_read_unlock();
 
 	if (create == 0)
 		return ERR_PTR(-ENOENT);
@@ -1482,33 +1683,51 @@ ldlm_resource_get(struct ldlm_namespace *ns, struct ldlm_resource *parent,
 	if (res == NULL)
 		return ERR_PTR(-ENOMEM);
 
-	res->lr_ns_bucket = cfs_hash_bd_extra_get(ns->ns_rs_hash, &bd);
+	res->lr_ns_bucket = ldlm_ns_bucket_find(ns, name);
 	res->lr_name = *name;
 	res->lr_type = type;
 
-	cfs_hash_bd_lock(ns->ns_rs_hash, &bd, 1);
-	hnode = (version == cfs_hash_bd_version_get(&bd)) ? NULL :
-		cfs_hash_bd_lookup_locked(ns->ns_rs_hash, &bd, (void *)name);
+	rcu_read_lock();
+	while ((old = rhashtable_lookup_get_insert_fast(&ns->ns_rs_hash,
+					&res->lr_hash,
+					ldlm_ns_rs_hash_params)) != NULL) {
+		if (IS_ERR(old))
+			break;
 
-	if (hnode != NULL) {
-		/* Someone won the race and already added the resource. */
-		cfs_hash_bd_unlock(ns->ns_rs_hash, &bd, 1);
+		if (atomic_inc_not_zero(&old->lr_refcount)) {
+			/* Someone won the race and already added the
+			 * resource. */
+			lprocfs_counter_incr(ns->ns_stats, LDLM_NSS_RES_RACES);
+			break;
+		}
+
+		/* The resource found is being freed, take its place in the
+		 * hash rather than wait for it to be removed. If it is gone
+		 * already, insert again. */
+		lprocfs_counter_incr(ns->ns_stats, LDLM_NSS_RES_RETRIES);
+		if (rhashtable_replace_fast(&ns->ns_rs_hash, &old->lr_hash,
+					    &res->lr_hash,
+					    ldlm_ns_rs_hash_params) == 0) {
+			old = NULL;
+			break;
+		}
+	}
+	rcu_read_unlock();
+
+	if (old != NULL) {
 		/* Clean lu_ref for failed resource. */
 		lu_ref_fini(&res->lr_reference);
 		if (res->lr_itree != NULL)
-			OBD_SLAB_FREE(res->lr_itree, ldlm_interval_tree_slab,
-				      sizeof(*res->lr_itree) * LCK_MODE_NUM);
+			OBD_SLAB_FREE_PTR(res->lr_itree,
+					  ldlm_interval_tree_slab);
 		OBD_SLAB_FREE(res, ldlm_resource_slab, sizeof *res);
-found:
-		res = hlist_entry(hnode, struct ldlm_resource, lr_hash);
-		return res;
+		return old;
 	}
-	/* We won! Let's add the resource. */
-	cfs_hash_bd_add_locked(ns->ns_rs_hash, &bd, &res->lr_hash);
-	if (cfs_hash_bd_count_get(&bd) == 1)
-		ns_refcount = ldlm_namespace_get_return(ns);
 
-	cfs_hash_bd_unlock(ns->ns_rs_hash, &bd, 1);
+	/* We won! The resource is in the hash. */
+	lprocfs_counter_incr(ns->ns_stats, LDLM_NSS_RES_CREATES);
+	if (atomic_inc_return(&res->lr_ns_bucket->nsb_count) == 1)
+		ns_refcount = ldlm_namespace_get_return(ns);
 
 	OBD_FAIL_TIMEOUT(OBD_FAIL_LDLM_CREATE_RESOURCE, 2);
 
@@ -1536,10 +1755,17 @@ struct ldlm_resource *ldlm_resource_getref(struct ldlm_resource *res)
 	return res;
 }
 
-static void __ldlm_resource_putref_final(struct cfs_hash_bd *bd,
-                                         struct ldlm_resource *res)
+static void ldlm_resource_free_rcu(struct rcu_head *head)
 {
-	struct ldlm_ns_bucket *nsb = res->lr_ns_bucket;
+	struct ldlm_resource *res = container_of(head, struct ldlm_resource,
+						 lr_rcu);
+
+	OBD_SLAB_FREE(res, ldlm_resource_slab, sizeof *res);
+}
+
+static void __ldlm_resource_putref_final(struct ldlm_resource *res)
+{
+	struct ldlm_namespace *ns = ldlm_res_to_ns(res);
 
 	if (!list_empty(&res->lr_granted)) {
 		ldlm_resource_dump(D_ERROR, res);
@@ -1551,36 +1777,38 @@ static void __ldlm_resource_putref_final(struct cfs_hash_bd *bd,
 		LBUG();
 	}
 
-	cfs_hash_bd_del_locked(nsb->nsb_namespace->ns_rs_hash,
-			       bd, &res->lr_hash);
+	/* -ENOENT if a new resource with the same name replaced it */
+	rhashtable_remove_fast(&ns->ns_rs_hash, &res->lr_hash,
+			       ldlm_ns_rs_hash_params);
 	lu_ref_fini(&res->lr_reference);
-	if (cfs_hash_bd_count_get(bd) == 0)
-		ldlm_namespace_put(nsb->nsb_namespace);
 }
 
 /* Returns 1 if the resource was freed, 0 if it remains. */
 int ldlm_resource_putref(struct ldlm_resource *res)
 {
 	struct ldlm_namespace *ns = ldlm_res_to_ns(res);
-	struct cfs_hash_bd   bd;
+	struct ldlm_ns_bucket *nsb = res->lr_ns_bucket;
 
 	LASSERT_ATOMIC_GT_LT(&res->lr_refcount, 0, LI_POISON);
 	CDEBUG(D_INFO, "putref res: %p count: %d\n",
 	       res, atomic_read(&res->lr_refcount) - 1);
 
-	cfs_hash_bd_get(ns->ns_rs_hash, &res->lr_name, &bd);
-	if (cfs_hash_bd_dec_and_lock(ns->ns_rs_hash, &bd, &res->lr_refcount)) {
-		__ldlm_resource_putref_final(&bd, res);
-		cfs_hash_bd_unlock(ns->ns_rs_hash, &bd, 1);
-		if (ns->ns_lvbo && ns->ns_lvbo->lvbo_free)
-			ns->ns_lvbo->lvbo_free(res);
-		if (res->lr_itree != NULL)
-			OBD_SLAB_FREE(res->lr_itree, ldlm_interval_tree_slab,
-				      sizeof(*res->lr_itree) * LCK_MODE_NUM);
-		OBD_SLAB_FREE(res, ldlm_resource_slab, sizeof *res);
-		return 1;
-	}
-	return 0;
+	if (!atomic_dec_and_test(&res->lr_refcount))
+		return 0;
+
+	__ldlm_resource_putref_final(res);
+	if (ns->ns_lvbo && ns->ns_lvbo->lvbo_free)
+		ns->ns_lvbo->lvbo_free(res);
+	if (res->lr_itree != NULL)
+		OBD_SLAB_FREE_PTR(res->lr_itree, ldlm_interval_tree_slab);
+	if (res->lr_ibits_queues != NULL)
+		OBD_FREE_PTR(res->lr_ibits_queues);
+	/* lockless lookups may still be looking at it */
+	call_rcu(&res->lr_rcu, ldlm_resource_free_rcu);
+
+	if (atomic_dec_and_test(&nsb->nsb_count))
+		ldlm_namespace_put(ns);
+	return 1;
 }
 EXPORT_SYMBOL(ldlm_resource_putref);
 
@@ -1602,6 +1830,8 @@ void ldlm_resource_add_lock(struct ldlm_resource *res, struct list_head *head,
 	LASSERT(list_empty(&lock->l_res_link));
 
 	list_add_tail(&lock->l_res_link, head);
+	if (res->lr_type == LDLM_IBITS)
+		ldlm_ibits_index_add(lock, head);
 }
 
 /**
@@ -1635,10 +1865,14 @@ void ldlm_resource_unlink_lock(struct ldlm_lock *lock)
 	int type = lock->l_resource->lr_type;
 
 	check_res_locked(lock->l_resource);
+	if (type == LDLM_IBITS)
+		ldlm_ibits_index_del(lock);
 	if (type == LDLM_IBITS || type == LDLM_PLAIN)
 		ldlm_unlink_lock_skiplist(lock);
 	else if (type == LDLM_EXTENT)
 		ldlm_extent_unlink_lock(lock);
+	else if (type == LDLM_FLOCK)
+		ldlm_flock_unlink_lock(lock);
 	list_del_init(&lock->l_res_link);
 }
 EXPORT_SYMBOL(ldlm_resource_unlink_lock);
@@ -1672,10 +1906,8 @@ void ldlm_dump_all_namespaces(enum ldlm_side client, int level)
 	mutex_unlock(ldlm_namespace_lock(client));
 }
 
-static int ldlm_res_hash_dump(struct cfs_hash *hs, struct cfs_hash_bd *bd,
-			      struct hlist_node *hnode, void *arg)
+static int ldlm_res_hash_dump(struct ldlm_resource *res, void *arg)
 {
-	struct ldlm_resource *res = cfs_hash_object(hs, hnode);
 	int    level = (int)(unsigned long)arg;
 
 	lock_res(res);
@@ -1701,9 +1933,8 @@ void ldlm_namespace_dump(int level, struct ldlm_namespace *ns)
 	if (ktime_get_seconds() < ns->ns_next_dump)
 		return;
 
-	cfs_hash_for_each_nolock(ns->ns_rs_hash,
-				 ldlm_res_hash_dump,
-				 (void *)(unsigned long)level, 0);
+	ldlm_namespace_foreach_res(ns, ldlm_res_hash_dump,
+				   (void *)(unsigned long)level);
 	spin_lock(&ns->ns_lock);
 	ns->ns_next_dump = ktime_get_seconds() + 10;
 	spin_unlock(&ns->ns_lock);
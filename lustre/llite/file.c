@@ -1441,6 +1441,120 @@ static void ll_heat_add(struct inode *inode, enum cl_io_type iot,
 	spin_unlock(&lli->lli_heat_lock);
 }
 
+/* Writes in a row of the same size and stride before locks are requested
+ * ahead */
+#define LL_LOCKAHEAD_AUTO_HITS	3
+
+static bool ll_lockahead_auto_enabled(struct file *file)
+{
+	struct ll_file_data *fd = LUSTRE_FPRIVATE(file);
+
+	return ll_i2sbi(file_inode(file))->ll_lockahead_auto_depth != 0 &&
+	       !fd->fd_las.las_disabled && !ll_file_nolock(file) &&
+	       !(file->f_flags & O_APPEND) &&
+	       !(fd->fd_flags & LL_FILE_GROUP_LOCKED);
+}
+
+/**
+ * Check whether a write of \a count bytes at \a pos continues the strided
+ * write pattern of \a file.
+ *
+ * N-to-1 writers of a shared file each write a chunk and skip the chunks of
+ * the other writers. Their write locks are expanded by the server over the
+ * skipped chunks and conflict with the neighbours on every write. A file
+ * descriptor writing chunks of the same size at a constant stride larger
+ * than the chunks is such a writer.
+ *
+ * \retval true	the write is part of a strided pattern
+ * \retval false	otherwise
+ */
+static bool ll_lockahead_auto_check(struct file *file, loff_t pos,
+				    size_t count)
+{
+	struct ll_file_data *fd = LUSTRE_FPRIVATE(file);
+	struct ll_lockahead_state *las = &fd->fd_las;
+
+	if (!ll_lockahead_auto_enabled(file))
+		return false;
+
+	return las->las_hits + 1 >= LL_LOCKAHEAD_AUTO_HITS &&
+	       count == las->las_count && pos - las->las_pos == las->las_stride;
+}
+
+/**
+ * Record a write of \a count bytes done at \a pos in the write pattern of
+ * \a file. Failed writes are not recorded, and a short write is recorded
+ * with the size it did, so neither counts towards the pattern.
+ *
+ * \retval true	\a file is a strided writer
+ * \retval false	otherwise
+ */
+static bool ll_lockahead_auto_update(struct file *file, loff_t pos,
+				     size_t count)
+{
+	struct ll_file_data *fd = LUSTRE_FPRIVATE(file);
+	struct ll_lockahead_state *las = &fd->fd_las;
+	loff_t stride = pos - las->las_pos;
+
+	if (!ll_lockahead_auto_enabled(file))
+		return false;
+
+	/* the second write of a pattern sets its stride */
+	if (las->las_hits > 0 && count == las->las_count &&
+	    stride > (loff_t)count &&
+	    (las->las_hits == 1 || stride == las->las_stride)) {
+		if (las->las_hits < LL_LOCKAHEAD_AUTO_HITS)
+			las->las_hits++;
+	} else {
+		las->las_hits = 1;
+		las->las_ahead_pos = 0;
+	}
+	las->las_pos = pos;
+	las->las_count = count;
+	las->las_stride = stride;
+
+	return las->las_hits >= LL_LOCKAHEAD_AUTO_HITS;
+}
+
+/**
+ * Request write locks for the next chunks of the strided pattern of \a file,
+ * as ladvise lockahead would. The locks are not expanded and are requested
+ * asynchronously, so the next writes find them granted and do not conflict
+ * with the other writers.
+ */
+static void ll_lockahead_auto(struct file *file)
+{
+	struct ll_sb_info *sbi = ll_i2sbi(file_inode(file));
+	struct ll_file_data *fd = LUSTRE_FPRIVATE(file);
+	struct ll_lockahead_state *las = &fd->fd_las;
+	struct llapi_lu_ladvise ladvise;
+	loff_t pos;
+	loff_t last;
+	int rc;
+
+	last = las->las_pos + las->las_stride * sbi->ll_lockahead_auto_depth;
+	pos = max(las->las_ahead_pos, las->las_pos + las->las_stride);
+
+	memset(&ladvise, 0, sizeof(ladvise));
+	ladvise.lla_advice = LU_LADVISE_LOCKAHEAD;
+	ladvise.lla_lockahead_mode = MODE_WRITE_USER;
+	ladvise.lla_peradvice_flags = LF_ASYNC;
+
+	for (; pos <= last; pos += las->las_stride) {
+		ladvise.lla_start = pos;
+		ladvise.lla_end = pos + las->las_count - 1;
+		rc = ll_file_lock_ahead(file, &ladvise);
+		if (rc == -EOPNOTSUPP) {
+			las->las_disabled = true;
+			break;
+		}
+		if (rc < 0)
+			break;
+		ll_stats_ops_tally(sbi, LPROC_LL_LOCKAHEAD_AUTO, 1);
+	}
+	las->las_ahead_pos = pos;
+}
+
 static ssize_t
 ll_file_io_generic(const struct lu_env *env, struct vvp_io_args *args,
 		   struct file *file, enum cl_io_type iot,
@@ -1456,6 +1570,8 @@ ll_file_io_generic(const struct lu_env *env, struct vvp_io_args *args,
 	int			rc = 0;
 	unsigned		retried = 0;
 	bool			restarted = false;
+	bool			strided = false;
+	loff_t			pos = *ppos;
 
 	ENTRY;
 
@@ -1463,10 +1579,17 @@ ll_file_io_generic(const struct lu_env *env, struct vvp_io_args *args,
 		file_dentry(file)->d_name.name,
 		iot == CIT_READ ? "read" : "write", *ppos, count);
 
+	if (iot == CIT_WRITE)
+		strided = ll_lockahead_auto_check(file, *ppos, count);
+
 restart:
 	io = vvp_env_thread_io(env);
 	ll_io_init(io, file, iot);
 	io->ci_ndelay_tried = retried;
+	/* the locks ahead of a strided writer are not expanded, neither is
+	 * its own so that it does not take the chunks of the others */
+	if (strided && fd->fd_las.las_ahead_pos != 0)
+		io->ci_lock_no_expand = 1;
 
 	if (cl_io_rw_init(env, io, iot, *ppos, count) == 0) {
 		bool range_locked = false;
@@ -1574,6 +1697,10 @@ out:
 	if (result > 0)
 		ll_heat_add(inode, iot, result);
 
+	if (iot == CIT_WRITE && result > 0 &&
+	    ll_lockahead_auto_update(file, pos, result))
+		ll_lockahead_auto(file);
+
 	RETURN(result > 0 ? result : rc);
 }
 
@@ -605,6 +605,9 @@ struct ll_sb_info {
 	unsigned int		  ll_heat_decay_weight;
 	unsigned int		  ll_heat_period_second;
 
+	/* locks requested ahead of strided writers, 0 to disable */
+	unsigned int		  ll_lockahead_auto_depth;
+
 	/* filesystem fsname */
 	char			  ll_fsname[LUSTRE_MAXFSNAME + 1];
 
@@ -614,6 +617,9 @@ struct ll_sb_info {
 
 #define SBI_DEFAULT_HEAT_DECAY_WEIGHT	((80 * 256 + 50) / 100)
 #define SBI_DEFAULT_HEAT_PERIOD_SECOND	(60)
+
+#define SBI_DEFAULT_LOCKAHEAD_AUTO_DEPTH	(4)
+#define SBI_MAX_LOCKAHEAD_AUTO_DEPTH		(64)
 /*
  * per file-descriptor read-ahead data.
  */
@@ -713,10 +719,27 @@ struct ll_readahead_work {
 	struct work_struct		 lrw_readahead_work;
 };
 
+/* Write pattern of a file descriptor, used to request locks ahead of
+ * strided writers, see ll_lockahead_auto() */
+struct ll_lockahead_state {
+	/* start and size of the last write */
+	loff_t		las_pos;
+	size_t		las_count;
+	/* distance between the starts of the last two writes */
+	loff_t		las_stride;
+	/* number of writes in a row of las_count bytes at las_stride */
+	unsigned int	las_hits;
+	/* start of the next chunk to request a lock for, 0 if none yet */
+	loff_t		las_ahead_pos;
+	/* the servers do not support lockahead */
+	bool		las_disabled;
+};
+
 extern struct kmem_cache *ll_file_data_slab;
 struct lustre_handle;
 struct ll_file_data {
 	struct ll_readahead_state fd_ras;
+	struct ll_lockahead_state fd_las;
 	struct ll_grouplock fd_grouplock;
 	__u64 lfd_pos;
 	__u32 fd_flags;
@@ -841,6 +864,7 @@ enum {
 	LPROC_LL_LISTXATTR,
 	LPROC_LL_REMOVEXATTR,
 	LPROC_LL_INODE_PERM,
+	LPROC_LL_LOCKAHEAD_AUTO,
 	LPROC_LL_FILE_OPCODES
 };
 
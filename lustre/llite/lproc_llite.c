@@ -1303,6 +1303,39 @@ static ssize_t heat_period_second_store(struct kobject *kobj,
 }
 LUSTRE_RW_ATTR(heat_period_second);
 
+static ssize_t lockahead_auto_depth_show(struct kobject *kobj,
+					 struct attribute *attr,
+					 char *buf)
+{
+	struct ll_sb_info *sbi = container_of(kobj, struct ll_sb_info,
+					      ll_kset.kobj);
+
+	return snprintf(buf, PAGE_SIZE, "%u\n", sbi->ll_lockahead_auto_depth);
+}
+
+static ssize_t lockahead_auto_depth_store(struct kobject *kobj,
+					  struct attribute *attr,
+					  const char *buffer,
+					  size_t count)
+{
+	struct ll_sb_info *sbi = container_of(kobj, struct ll_sb_info,
+					      ll_kset.kobj);
+	unsigned int val;
+	int rc;
+
+	rc = kstrtouint(buffer, 10, &val);
+	if (rc)
+		return rc;
+
+	if (val > SBI_MAX_LOCKAHEAD_AUTO_DEPTH)
+		return -ERANGE;
+
+	sbi->ll_lockahead_auto_depth = val;
+
+	return count;
+}
+LUSTRE_RW_ATTR(lockahead_auto_depth);
+
 static int ll_unstable_stats_seq_show(struct seq_file *m, void *v)
 {
 	struct super_block	*sb    = m->private;
@@ -1516,6 +1549,7 @@ static struct attribute *llite_attrs[] = {
 	&lustre_attr_file_heat.attr,
 	&lustre_attr_heat_decay_percentage.attr,
 	&lustre_attr_heat_period_second.attr,
+	&lustre_attr_lockahead_auto_depth.attr,
 	&lustre_attr_max_read_ahead_async_active.attr,
 	&lustre_attr_read_ahead_async_file_threshold_mb.attr,
 	NULL,
@@ -1582,6 +1616,7 @@ static const struct llite_file_opcode {
         { LPROC_LL_LISTXATTR,      LPROCFS_TYPE_REGS, "listxattr" },
         { LPROC_LL_REMOVEXATTR,    LPROCFS_TYPE_REGS, "removexattr" },
         { LPROC_LL_INODE_PERM,     LPROCFS_TYPE_REGS, "inode_permission" },
+	{ LPROC_LL_LOCKAHEAD_AUTO, LPROCFS_TYPE_REGS, "lockahead_auto" },
 };
 
 void ll_stats_ops_tally(struct ll_sb_info *sbi, int op, int count)
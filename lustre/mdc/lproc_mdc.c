@@ -221,6 +221,33 @@ static ssize_t contention_seconds_store(struct kobject *kobj,
 }
 LUSTRE_RW_ATTR(contention_seconds);
 
+static ssize_t intent_dedup_show(struct kobject *kobj, struct attribute *attr,
+				 char *buf)
+{
+	struct obd_device *dev = container_of(kobj, struct obd_device,
+					      obd_kset.kobj);
+
+	return sprintf(buf, "%u\n", dev->u.cli.cl_intent_dedup);
+}
+
+static ssize_t intent_dedup_store(struct kobject *kobj, struct attribute *attr,
+				  const char *buffer, size_t count)
+{
+	struct obd_device *dev = container_of(kobj, struct obd_device,
+					      obd_kset.kobj);
+	bool val;
+	int rc;
+
+	rc = kstrtobool(buffer, &val);
+	if (rc)
+		return rc;
+
+	dev->u.cli.cl_intent_dedup = val;
+
+	return count;
+}
+LUSTRE_RW_ATTR(intent_dedup);
+
 LUSTRE_ATTR(mds_conn_uuid, 0444, conn_uuid_show, NULL);
 LUSTRE_RO_ATTR(conn_uuid);
 
@@ -451,6 +478,40 @@ static ssize_t mdc_stats_seq_write(struct file *file,
 }
 LPROC_SEQ_FOPS(mdc_stats);
 
+static int mdc_intent_dedup_stats_seq_show(struct seq_file *m, void *v)
+{
+	struct obd_device *dev = m->private;
+	struct client_obd *cli = &dev->u.cli;
+	__u64 waits, hits;
+
+	spin_lock(&cli->cl_intent_lock);
+	waits = cli->cl_intent_dedup_waits;
+	hits = cli->cl_intent_dedup_hits;
+	spin_unlock(&cli->cl_intent_lock);
+
+	seq_printf(m, "waits: %llu\n", waits);
+	seq_printf(m, "hits:  %llu\n", hits);
+
+	return 0;
+}
+
+static ssize_t mdc_intent_dedup_stats_seq_write(struct file *file,
+						const char __user *buffer,
+						size_t count, loff_t *off)
+{
+	struct seq_file *seq = file->private_data;
+	struct obd_device *dev = seq->private;
+	struct client_obd *cli = &dev->u.cli;
+
+	spin_lock(&cli->cl_intent_lock);
+	cli->cl_intent_dedup_waits = 0;
+	cli->cl_intent_dedup_hits = 0;
+	spin_unlock(&cli->cl_intent_lock);
+
+	return count;
+}
+LPROC_SEQ_FOPS(mdc_intent_dedup_stats);
+
 static int mdc_dom_min_repsize_seq_show(struct seq_file *m, void *v)
 {
 	struct obd_device *dev = m->private;
@@ -516,6 +577,8 @@ struct lprocfs_vars lprocfs_mdc_obd_vars[] = {
 	  .fops	=	&mdc_stats_fops			},
 	{ .name	=	"mdc_dom_min_repsize",
 	  .fops	=	&mdc_dom_min_repsize_fops	},
+	{ .name	=	"intent_dedup_stats",
+	  .fops	=	&mdc_intent_dedup_stats_fops	},
 	{ NULL }
 };
 
@@ -524,6 +587,7 @@ static struct attribute *mdc_attrs[] = {
 	&lustre_attr_max_rpcs_in_flight.attr,
 	&lustre_attr_max_mod_rpcs_in_flight.attr,
 	&lustre_attr_contention_seconds.attr,
+	&lustre_attr_intent_dedup.attr,
 	&lustre_attr_mds_conn_uuid.attr,
 	&lustre_attr_conn_uuid.attr,
 	&lustre_attr_ping.attr,
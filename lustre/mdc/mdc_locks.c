@@ -1244,6 +1244,165 @@ int mdc_revalidate_lock(struct obd_export *exp, struct lookup_intent *it,
 	RETURN(!!mode);
 }
 
+/*
+ * Identical read-only intents (e.g. a herd of threads stat'ing the same
+ * file after its UPDATE lock was cancelled) used to send one RPC each.
+ * The first such intent is registered on cl_intent_list and the others
+ * wait for it to complete, then try to match the lock it was granted
+ * before falling back to an RPC of their own.
+ */
+struct mdc_intent_inflight {
+	struct list_head	 mii_list;
+	struct lu_fid		 mii_fid;
+	int			 mii_op;
+	__u64			 mii_it_flags;
+	__u64			 mii_lock_flags;
+	enum ldlm_mode		 mii_mode;
+	int			 mii_refs;
+	bool			 mii_done;
+	wait_queue_head_t	 mii_waitq;
+};
+
+static struct mdc_intent_inflight *
+mdc_intent_inflight_find(struct client_obd *cli, const struct lu_fid *fid,
+			 struct lookup_intent *it, enum ldlm_mode mode,
+			 __u64 lock_flags)
+{
+	struct mdc_intent_inflight *mii;
+
+	assert_spin_locked(&cli->cl_intent_lock);
+	list_for_each_entry(mii, &cli->cl_intent_list, mii_list) {
+		if (lu_fid_eq(&mii->mii_fid, fid) &&
+		    mii->mii_op == it->it_op &&
+		    mii->mii_it_flags == it->it_flags &&
+		    mii->mii_mode == mode &&
+		    mii->mii_lock_flags == lock_flags)
+			return mii;
+	}
+
+	return NULL;
+}
+
+static void mdc_intent_inflight_put(struct client_obd *cli,
+				    struct mdc_intent_inflight *mii)
+{
+	bool last;
+
+	spin_lock(&cli->cl_intent_lock);
+	last = --mii->mii_refs == 0;
+	spin_unlock(&cli->cl_intent_lock);
+
+	if (last)
+		OBD_FREE_PTR(mii);
+}
+
+static void mdc_intent_inflight_done(struct client_obd *cli,
+				     struct mdc_intent_inflight *mii)
+{
+	spin_lock(&cli->cl_intent_lock);
+	list_del_init(&mii->mii_list);
+	mii->mii_done = true;
+	spin_unlock(&cli->cl_intent_lock);
+
+	wake_up_all(&mii->mii_waitq);
+	mdc_intent_inflight_put(cli, mii);
+}
+
+/**
+ * Wait for an identical intent already in flight, if any.
+ *
+ * \retval 1	the lock granted to the other intent matched, \a it is
+ *		filled in as by mdc_revalidate_lock()
+ * \retval 0	an RPC has to be sent; if \a leader is set on return the
+ *		caller must call mdc_intent_inflight_done() once finished.
+ *		This is also returned if the other intent did not finish
+ *		within obd_timeout
+ * \retval -EINTR	interrupted by a fatal signal while waiting
+ */
+static int mdc_intent_dedup(struct obd_export *exp, struct md_op_data *op_data,
+			    struct lookup_intent *it, enum ldlm_mode mode,
+			    __u64 lock_flags,
+			    struct mdc_intent_inflight **leader)
+{
+	struct client_obd *cli = &exp->exp_obd->u.cli;
+	struct mdc_intent_inflight *mii;
+	struct mdc_intent_inflight *new = NULL;
+	struct l_wait_info lwi;
+	int rc;
+	ENTRY;
+
+	*leader = NULL;
+	if (!cli->cl_intent_dedup)
+		RETURN(0);
+
+again:
+	spin_lock(&cli->cl_intent_lock);
+	mii = mdc_intent_inflight_find(cli, &op_data->op_fid2, it, mode,
+				       lock_flags);
+	if (mii != NULL) {
+		mii->mii_refs++;
+		cli->cl_intent_dedup_waits++;
+	} else if (new != NULL) {
+		list_add_tail(&new->mii_list, &cli->cl_intent_list);
+		*leader = new;
+	}
+	spin_unlock(&cli->cl_intent_lock);
+
+	if (mii == NULL) {
+		if (*leader != NULL)
+			RETURN(0);
+
+		/* allocation failure just means no deduplication */
+		OBD_ALLOC_PTR(new);
+		if (new == NULL)
+			RETURN(0);
+
+		INIT_LIST_HEAD(&new->mii_list);
+		new->mii_fid = op_data->op_fid2;
+		new->mii_op = it->it_op;
+		new->mii_it_flags = it->it_flags;
+		new->mii_lock_flags = lock_flags;
+		new->mii_mode = mode;
+		new->mii_refs = 1;
+		init_waitqueue_head(&new->mii_waitq);
+		goto again;
+	}
+
+	if (new != NULL)
+		OBD_FREE_PTR(new);
+
+	CDEBUG(D_DLMTRACE, "%s: wait for %s intent on "DFID" in flight\n",
+	       exp->exp_obd->obd_name, ldlm_it2str(it->it_op),
+	       PFID(&op_data->op_fid2));
+
+	/*
+	 * The leader RPC may be stuck on recovery or resent for a long
+	 * time; after obd_timeout stop waiting for it and send our own.
+	 */
+	lwi = LWI_TIMEOUT_INTR(cfs_time_seconds(obd_timeout), NULL, NULL,
+			       NULL);
+	rc = l_wait_event(mii->mii_waitq, mii->mii_done, &lwi);
+	mdc_intent_inflight_put(cli, mii);
+	if (rc == -EINTR)
+		RETURN(rc);
+	if (rc < 0) {
+		CDEBUG(D_DLMTRACE, "%s: %s intent on "DFID" still in flight "
+		       "after %us, send our own: rc = %d\n",
+		       exp->exp_obd->obd_name, ldlm_it2str(it->it_op),
+		       PFID(&op_data->op_fid2), obd_timeout, rc);
+		RETURN(0);
+	}
+
+	rc = mdc_revalidate_lock(exp, it, &op_data->op_fid2, NULL);
+	if (rc) {
+		spin_lock(&cli->cl_intent_lock);
+		cli->cl_intent_dedup_hits++;
+		spin_unlock(&cli->cl_intent_lock);
+	}
+
+	RETURN(rc);
+}
+
 /*
  * This long block is all about fixing up the lock and request state
  * so that it is correct as of the moment _before_ the operation was
@@ -1282,6 +1441,7 @@ int mdc_intent_lock(struct obd_export *exp, struct md_op_data *op_data,
 		.ei_cb_cp	= ldlm_completion_ast,
 		.ei_cb_gl	= mdc_ldlm_glimpse_ast,
 	};
+	struct mdc_intent_inflight *mii = NULL;
 	struct lustre_handle lockh;
 	int rc = 0;
 	ENTRY;
@@ -1305,6 +1465,11 @@ int mdc_intent_lock(struct obd_export *exp, struct md_op_data *op_data,
 		   (from inode_revalidate) */
 		if (rc || op_data->op_namelen != 0)
 			RETURN(rc);
+
+		rc = mdc_intent_dedup(exp, op_data, it, einfo.ei_mode,
+				      extra_lock_flags, &mii);
+		if (rc)
+			RETURN(rc);
 	}
 
 	/* For case if upper layer did not alloc fid, do it now. */
@@ -1312,18 +1477,23 @@ int mdc_intent_lock(struct obd_export *exp, struct md_op_data *op_data,
 		rc = mdc_fid_alloc(NULL, exp, &op_data->op_fid2, op_data);
 		if (rc < 0) {
 			CERROR("Can't alloc new fid, rc %d\n", rc);
-			RETURN(rc);
+			GOTO(out, rc);
 		}
 	}
 
 	rc = mdc_enqueue_base(exp, &einfo, NULL, it, op_data, &lockh,
 			      extra_lock_flags);
 	if (rc < 0)
-		RETURN(rc);
+		GOTO(out, rc);
 
 	*reqp = it->it_request;
-        rc = mdc_finish_intent_lock(exp, *reqp, op_data, it, &lockh);
-        RETURN(rc);
+	rc = mdc_finish_intent_lock(exp, *reqp, op_data, it, &lockh);
+	EXIT;
+out:
+	if (mii != NULL)
+		mdc_intent_inflight_done(&exp->exp_obd->u.cli, mii);
+
+	return rc;
 }
 
 static int mdc_intent_getattr_async_interpret(const struct lu_env *env,
@@ -3640,6 +3640,8 @@ int mdt_intent_lock_replace(struct mdt_thread_info *info,
         }
 
         new_lock->l_export = class_export_lock_get(req->rq_export, new_lock);
+	/* granted before it had an export, count it for the client now */
+	ldlm_pool_add_export(new_lock);
         new_lock->l_blocking_ast = lock->l_blocking_ast;
         new_lock->l_completion_ast = lock->l_completion_ast;
 	if (ldlm_has_dom(new_lock))
@@ -42,6 +42,7 @@
 
 #include <obd_support.h>
 #include <obd_class.h>
+#include <obd_cksum.h>
 #include <uapi/linux/lnet/lnetctl.h>
 #include <lustre_debug.h>
 #include <lustre_kernelcomm.h>
@@ -695,6 +696,10 @@ static int __init obdclass_init(void)
 		goto cleanup_cl_global;
 #endif /* HAVE_SERVER_SUPPORT */
 
+	err = obd_dif_init();
+	if (err)
+		goto cleanup_llog_info;
+
 	err = lustre_register_fs();
 
 	/* simulate a late OOM situation now to require all
@@ -707,10 +712,13 @@ static int __init obdclass_init(void)
 	}
 
 	if (err)
-		goto cleanup_llog_info;
+		goto cleanup_dif;
 
 	return 0;
 
+cleanup_dif:
+	obd_dif_fini();
+
 cleanup_llog_info:
 	llog_info_fini();
 
@@ -789,6 +797,7 @@ static void __exit obdclass_exit(void)
 	lustre_unregister_fs();
 
 	misc_deregister(&obd_psdev);
+	obd_dif_fini();
 	llog_info_fini();
 #ifdef HAVE_SERVER_SUPPORT
 	lu_ucred_global_fini();
@@ -416,6 +416,8 @@ struct obd_device *class_newdev(const char *type_name, const char *name,
 	rwlock_init(&newdev->obd_pool_lock);
 	newdev->obd_pool_limit = 0;
 	newdev->obd_pool_slv = 0;
+	newdev->obd_pool_budget = 0;
+	newdev->obd_pool_budget_scale = 0;
 
 	INIT_LIST_HEAD(&newdev->obd_exports);
 	INIT_LIST_HEAD(&newdev->obd_unlinked_exports);
@@ -1081,6 +1083,7 @@ struct obd_export *__class_new_export(struct obd_device *obd,
 	atomic_set(&export->exp_rpc_count, 0);
 	atomic_set(&export->exp_cb_count, 0);
 	atomic_set(&export->exp_locks_count, 0);
+	atomic_set(&export->exp_pool_granted, 0);
 #if LUSTRE_TRACKS_LOCK_EXP_REFS
 	INIT_LIST_HEAD(&export->exp_locks_list);
 	spin_lock_init(&export->exp_locks_list_guard);
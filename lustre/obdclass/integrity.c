@@ -28,6 +28,7 @@
 #include <linux/blkdev.h>
 #include <linux/crc-t10dif.h>
 #include <asm/checksum.h>
+#include <libcfs/libcfs_workitem.h>
 #include <obd_class.h>
 #include <obd_cksum.h>
 
@@ -80,6 +81,163 @@ int obd_page_dif_generate_buffer(const char *obd_name, struct page *page,
 }
 EXPORT_SYMBOL(obd_page_dif_generate_buffer);
 
+/*
+ * Guard tags of large bulk RPCs are generated in parallel by a pool of
+ * workitem schedulers on each CPT, the calling thread takes a share of
+ * the pages too.
+ */
+static unsigned int obd_dif_threads = 2;
+module_param(obd_dif_threads, uint, 0444);
+MODULE_PARM_DESC(obd_dif_threads,
+		 "Threads per CPT generating T10-PI guards of bulk RPCs (0 to disable)");
+
+static unsigned int obd_dif_parallel_pages = 64;
+module_param(obd_dif_parallel_pages, uint, 0644);
+MODULE_PARM_DESC(obd_dif_parallel_pages,
+		 "Minimum pages for T10-PI guards to be generated in parallel");
+
+/* a share of the pages needs at least this many to be worth a thread */
+#define OBD_DIF_CHUNK_MIN_PAGES	16
+
+static struct cfs_wi_sched **obd_dif_scheds;
+
+struct obd_dif_chunk {
+	struct cfs_workitem	 odc_wi;
+	struct cfs_wi_sched	*odc_sched;
+	const char		*odc_obd_name;
+	struct obd_dif_page	*odc_pages;
+	int			 odc_npages;
+	int			 odc_sector_size;
+	obd_dif_csum_fn		*odc_fn;
+	int			 odc_rc;
+	struct completion	*odc_done;
+	atomic_t		*odc_pending;
+};
+
+static int obd_dif_chunk_generate(struct obd_dif_chunk *odc)
+{
+	struct obd_dif_page *odp;
+	int used;
+	int rc;
+	int i;
+
+	for (i = 0; i < odc->odc_npages; i++) {
+		odp = &odc->odc_pages[i];
+		rc = obd_page_dif_generate_buffer(odc->odc_obd_name,
+						  odp->odp_page,
+						  odp->odp_offset,
+						  odp->odp_len,
+						  odp->odp_guards,
+						  DIV_ROUND_UP(odp->odp_len,
+							odc->odc_sector_size),
+						  &used, odc->odc_sector_size,
+						  odc->odc_fn);
+		if (rc)
+			return rc;
+	}
+
+	return 0;
+}
+
+static int obd_dif_chunk_action(struct cfs_workitem *wi)
+{
+	struct obd_dif_chunk *odc = container_of(wi, struct obd_dif_chunk,
+						 odc_wi);
+
+	odc->odc_rc = obd_dif_chunk_generate(odc);
+	cfs_wi_exit(odc->odc_sched, wi);
+	if (atomic_dec_and_test(odc->odc_pending))
+		complete(odc->odc_done);
+
+	/* odc may be freed by now */
+	return 1;
+}
+
+/* whether guards of \a npages pages are worth generating in parallel */
+bool obd_dif_parallel(int npages)
+{
+	return obd_dif_scheds != NULL && npages >= obd_dif_parallel_pages &&
+	       npages >= 2 * OBD_DIF_CHUNK_MIN_PAGES;
+}
+EXPORT_SYMBOL(obd_dif_parallel);
+
+/**
+ * Generate the guard tags of \a npages pages, each into its own
+ * odp_guards buffer which must hold DIV_ROUND_UP(odp_len, sector_size)
+ * tags. Large requests are split between the caller and the obd_dif
+ * threads of the current CPT.
+ */
+int obd_dif_generate_pages(const char *obd_name, struct obd_dif_page *pages,
+			   int npages, int sector_size, obd_dif_csum_fn *fn)
+{
+	struct obd_dif_chunk *chunks;
+	struct cfs_wi_sched *sched;
+	DECLARE_COMPLETION_ONSTACK(done);
+	atomic_t pending;
+	int nchunks;
+	int per_chunk;
+	int rc;
+	int i;
+
+	if (!obd_dif_parallel(npages))
+		goto serial;
+
+	nchunks = min_t(int, obd_dif_threads + 1,
+			npages / OBD_DIF_CHUNK_MIN_PAGES);
+
+	OBD_ALLOC(chunks, nchunks * sizeof(*chunks));
+	if (chunks == NULL)
+		goto serial;
+
+	sched = obd_dif_scheds[cfs_cpt_current(cfs_cpt_table, 1)];
+	per_chunk = DIV_ROUND_UP(npages, nchunks);
+	atomic_set(&pending, nchunks - 1);
+	for (i = 0; i < nchunks; i++) {
+		struct obd_dif_chunk *odc = &chunks[i];
+
+		odc->odc_sched = sched;
+		odc->odc_obd_name = obd_name;
+		odc->odc_pages = pages + i * per_chunk;
+		odc->odc_npages = min(per_chunk, npages - i * per_chunk);
+		odc->odc_sector_size = sector_size;
+		odc->odc_fn = fn;
+		odc->odc_done = &done;
+		odc->odc_pending = &pending;
+		/* the first chunk is done by the caller */
+		if (i > 0) {
+			cfs_wi_init(&odc->odc_wi, obd_dif_chunk_action);
+			cfs_wi_schedule(sched, &odc->odc_wi);
+		}
+	}
+
+	rc = obd_dif_chunk_generate(&chunks[0]);
+	wait_for_completion(&done);
+	for (i = 1; i < nchunks && rc == 0; i++)
+		rc = chunks[i].odc_rc;
+
+	OBD_FREE(chunks, nchunks * sizeof(*chunks));
+
+	return rc;
+
+serial:
+	for (i = 0; i < npages; i++) {
+		int used;
+
+		rc = obd_page_dif_generate_buffer(obd_name, pages[i].odp_page,
+						  pages[i].odp_offset,
+						  pages[i].odp_len,
+						  pages[i].odp_guards,
+						  DIV_ROUND_UP(pages[i].odp_len,
+							       sector_size),
+						  &used, sector_size, fn);
+		if (rc)
+			return rc;
+	}
+
+	return 0;
+}
+EXPORT_SYMBOL(obd_dif_generate_pages);
+
 static int __obd_t10_performance_test(const char *obd_name,
 				      enum cksum_types cksum_type,
 				      struct page *data_page,
@@ -275,3 +433,57 @@ int obd_t10_cksum_speed(const char *obd_name,
 #endif /* !CONFIG_CRC_T10DIF */
 }
 EXPORT_SYMBOL(obd_t10_cksum_speed);
+
+#if IS_ENABLED(CONFIG_CRC_T10DIF)
+int obd_dif_init(void)
+{
+	int ncpts = cfs_cpt_number(cfs_cpt_table);
+	int rc;
+	int i;
+
+	if (obd_dif_threads == 0)
+		return 0;
+
+	OBD_ALLOC(obd_dif_scheds, ncpts * sizeof(obd_dif_scheds[0]));
+	if (obd_dif_scheds == NULL)
+		return -ENOMEM;
+
+	for (i = 0; i < ncpts; i++) {
+		rc = cfs_wi_sched_create("obd_dif", cfs_cpt_table, i,
+					 obd_dif_threads, &obd_dif_scheds[i]);
+		if (rc) {
+			CERROR("cannot start T10-PI threads on CPT %d: rc = %d\n",
+			       i, rc);
+			obd_dif_fini();
+			return rc;
+		}
+	}
+
+	return 0;
+}
+
+void obd_dif_fini(void)
+{
+	int ncpts = cfs_cpt_number(cfs_cpt_table);
+	int i;
+
+	if (obd_dif_scheds == NULL)
+		return;
+
+	for (i = 0; i < ncpts; i++)
+		if (obd_dif_scheds[i] != NULL)
+			cfs_wi_sched_destroy(obd_dif_scheds[i]);
+
+	OBD_FREE(obd_dif_scheds, ncpts * sizeof(obd_dif_scheds[0]));
+	obd_dif_scheds = NULL;
+}
+#else /* !CONFIG_CRC_T10DIF */
+int obd_dif_init(void)
+{
+	return 0;
+}
+
+void obd_dif_fini(void)
+{
+}
+#endif /* !CONFIG_CRC_T10DIF */
@@ -786,6 +786,9 @@ static const char *obd_connect_names[] = {
 	"pcc",			/* 0x1000 */
 	"plain_layout",		/* 0x2000 */
 	"async_discard",	/* 0x4000 */
+	"batch_bl_ast",		/* 0x8000 */
+	"lock_budget",		/* 0x10000 */
+	"extent_convert",	/* 0x20000 */
 	NULL
 };
 
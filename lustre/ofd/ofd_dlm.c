@@ -54,13 +54,13 @@ struct ofd_intent_args {
 /**
  * OFD interval callback.
  *
- * The interval_callback_t is part of interval_iterate_reverse() and is called
- * for each interval in tree. The OFD interval callback searches for locks
- * covering extents beyond the given args->size. This is used to decide if the
- * size is too small and needs to be updated.  Note that we are only interested
- * in growing the size, as truncate is the only operation which can shrink it,
- * and it is handled differently.  This is why we only look at locks beyond the
- * current size.
+ * The interval_callback_t is part of interval_iterate_reverse_mask() and is
+ * called for each interval of one lock mode in the tree. The OFD interval
+ * callback searches for locks covering extents beyond the given args->size.
+ * This is used to decide if the size is too small and needs to be updated.
+ * Note that we are only interested in growing the size, as truncate is the
+ * only operation which can shrink it, and it is handled differently.  This is
+ * why we only look at locks beyond the current size.
  *
  * It finds the highest lock (by starting point) in this interval, and adds it
  * to the list of locks to glimpse.  We must glimpse a list of locks - rather
@@ -322,12 +322,13 @@ int ofd_intent_policy(const struct lu_env *env, struct ldlm_namespace *ns,
 
 	/* Check for PW locks beyond the size in the LVB, build the list
 	 * of locks to glimpse (arg.gl_list) */
+	tree = res->lr_itree;
 	for (idx = 0; idx < LCK_MODE_NUM; idx++) {
-		tree = &res->lr_itree[idx];
-		if (tree->lit_mode == LCK_PR)
+		if ((1 << idx) == LCK_PR || tree->lit_size[idx] == 0)
 			continue;
 
-		interval_iterate_reverse(tree->lit_root, ofd_intent_cb, &arg);
+		interval_iterate_reverse_mask(tree->lit_root, 1 << idx,
+					      ofd_intent_cb, &arg);
 		if (arg.error) {
 			unlock_res(res);
 			GOTO(out, rc = arg.error);
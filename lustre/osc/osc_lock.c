@@ -457,6 +457,84 @@ static int osc_dlm_blocking_ast0(const struct lu_env *env,
 	RETURN(result);
 }
 
+/**
+ * Flush the pages a converted dlm lock doesn't protect any more, see
+ * ldlm_cli_extent_convert(). \a old describes the lock before conversion.
+ *
+ * Pages out of the new extent are written back and dropped, while after a
+ * PW to PR downgrade the dirty pages in the new extent are written back and
+ * stay cached.
+ */
+static int osc_dlm_convert_ast(const struct lu_env *env,
+			       struct ldlm_lock *dlmlock,
+			       const struct ldlm_lock_desc *old)
+{
+	const struct ldlm_extent *oext = &old->l_policy_data.l_extent;
+	struct ldlm_extent *extent = &dlmlock->l_policy_data.l_extent;
+	struct cl_object *obj = NULL;
+	enum cl_lock_mode mode = CLM_READ;
+	int result = 0;
+	int rc;
+
+	ENTRY;
+
+	lock_res_and_lock(dlmlock);
+	if (dlmlock->l_ast_data != NULL) {
+		obj = osc2cl(dlmlock->l_ast_data);
+		cl_object_get(obj);
+	}
+	unlock_res_and_lock(dlmlock);
+
+	/* no pages cached under an AGL lock or a destroyed object */
+	if (obj == NULL)
+		RETURN(0);
+
+	if (old->l_granted_mode & (LCK_PW | LCK_GROUP))
+		mode = CLM_WRITE;
+
+	if (oext->start < extent->start)
+		result = osc_lock_flush(cl2osc(obj),
+					cl_index(obj, oext->start),
+					cl_index(obj, extent->start) - 1,
+					mode, false);
+
+	if (oext->end > extent->end) {
+		struct cl_attr *attr = &osc_env_info(env)->oti_attr;
+		__u64 old_kms;
+
+		rc = osc_lock_flush(cl2osc(obj),
+				    cl_index(obj, extent->end + 1),
+				    cl_index(obj, oext->end), mode, false);
+		if (result == 0)
+			result = rc;
+
+		/* the lock may not protect the kms any more */
+		lock_res_and_lock(dlmlock);
+		cl_object_attr_lock(obj);
+		old_kms = cl2osc(obj)->oo_oinfo->loi_kms;
+		attr->cat_kms = ldlm_extent_shift_kms(dlmlock, old_kms);
+		ldlm_clear_kms_ignore(dlmlock);
+		attr->cat_kms = max(attr->cat_kms,
+				    min(old_kms, extent->end + 1));
+		cl_object_attr_update(env, obj, attr, CAT_KMS);
+		cl_object_attr_unlock(obj);
+		unlock_res_and_lock(dlmlock);
+	}
+
+	if (old->l_granted_mode == LCK_PW &&
+	    dlmlock->l_granted_mode == LCK_PR) {
+		rc = osc_cache_writeback_range(env, cl2osc(obj),
+					       cl_index(obj, extent->start),
+					       cl_index(obj, extent->end),
+					       1, 0);
+		if (rc < 0 && result == 0)
+			result = rc;
+	}
+
+	cl_object_put(env, obj);
+	RETURN(result);
+}
+
 /**
  * Blocking ast invoked by ldlm when dlm lock is either blocking progress of
  * some other lock, or is canceled. This function is installed as a
@@ -482,7 +560,14 @@ static int osc_dlm_blocking_ast0(const struct lu_env *env,
  *
  *     - ldlm calls dlmlock->l_blocking_ast(..., LDLM_CB_BLOCKING) to notify
  *       us that dlmlock conflicts with another lock that some client is
- *       enqueuing. Lock is canceled.
+ *       enqueuing. Lock is converted if possible, canceled otherwise.
+ *
+ *           - ldlm_cli_extent_convert() shrinks the lock or downgrades it
+ *             to PR, then calls
+ *
+ *                  dlmlock->l_blocking_ast(..., LDLM_CB_CANCELING)
+ *
+ *             with the old lock description to flush the dropped pages.
  *
  *           - cl_lock_cancel() is called. osc_lock_cancel() calls
  *             ldlm_cli_cancel() that calls
@@ -510,6 +595,10 @@ static int osc_ldlm_blocking_ast(struct ldlm_lock *dlmlock,
 	case LDLM_CB_BLOCKING: {
 		struct lustre_handle lockh;
 
+		/* give up only what the conflicting lock needs */
+		if (new != NULL && ldlm_cli_extent_convert(dlmlock, new) == 0)
+			break;
+
 		ldlm_lock2handle(dlmlock, &lockh);
 		result = ldlm_cli_cancel(&lockh, LCF_ASYNC);
 		if (result == -ENODATA)
@@ -537,7 +626,11 @@ static int osc_ldlm_blocking_ast(struct ldlm_lock *dlmlock,
 			break;
 		}
 
-		result = osc_dlm_blocking_ast0(env, dlmlock, data, flag);
+		if (new != NULL && ldlm_is_converting(dlmlock))
+			result = osc_dlm_convert_ast(env, dlmlock, new);
+		else
+			result = osc_dlm_blocking_ast0(env, dlmlock, data,
+						       flag);
 		cl_env_put(env, &refcheck);
 		break;
 	}
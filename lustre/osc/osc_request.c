@@ -1120,13 +1120,15 @@ static int osc_checksum_bulk_t10pi(const char *obd_name, int nob,
 	struct ahash_request *req;
 	/* Used Adler as the default checksum type on top of DIF tags */
 	unsigned char cfs_alg = cksum_obd2cfs(OBD_CKSUM_T10_TOP);
+	struct obd_dif_page *odp;
 	struct page *__page;
 	unsigned char *buffer;
 	__u16 *guard_start;
 	unsigned int bufsize;
 	int guard_number;
 	int used_number = 0;
-	int used;
+	int odp_max;
+	int odp_nr = 0;
 	u32 cksum;
 	int rc = 0;
 	int i = 0;
@@ -1137,6 +1139,14 @@ static int osc_checksum_bulk_t10pi(const char *obd_name, int nob,
 	if (__page == NULL)
 		return -ENOMEM;
 
+	/* the pages whose guards fit in __page are generated together */
+	odp_max = min_t(int, pg_count, PAGE_SIZE / sizeof(*guard_start));
+	OBD_ALLOC_LARGE(odp, odp_max * sizeof(*odp));
+	if (odp == NULL) {
+		__free_page(__page);
+		return -ENOMEM;
+	}
+
 	req = cfs_crypto_hash_init(cfs_alg, NULL, 0);
 	if (IS_ERR(req)) {
 		rc = PTR_ERR(req);
@@ -1163,30 +1173,36 @@ static int osc_checksum_bulk_t10pi(const char *obd_name, int nob,
 		}
 
 		/*
-		 * The left guard number should be able to hold checksums of a
-		 * whole page
+		 * Generate the guards of the pages gathered so far once the
+		 * left guard number cannot hold checksums of this page. The
+		 * hash is streamed, so where it is flushed does not matter.
 		 */
-		rc = obd_page_dif_generate_buffer(obd_name, pga[i]->pg,
-						  pga[i]->off & ~PAGE_MASK,
-						  count,
-						  guard_start + used_number,
-						  guard_number - used_number,
-						  &used, sector_size,
-						  fn);
-		if (rc)
-			break;
-
-		used_number += used;
-		if (used_number == guard_number) {
+		if (used_number + DIV_ROUND_UP(count, sector_size) >
+		    guard_number) {
+			rc = obd_dif_generate_pages(obd_name, odp, odp_nr,
+						    sector_size, fn);
+			if (rc)
+				break;
 			cfs_crypto_hash_update_page(req, __page, 0,
 				used_number * sizeof(*guard_start));
 			used_number = 0;
+			odp_nr = 0;
 		}
 
+		odp[odp_nr].odp_page = pga[i]->pg;
+		odp[odp_nr].odp_offset = pga[i]->off & ~PAGE_MASK;
+		odp[odp_nr].odp_len = count;
+		odp[odp_nr].odp_guards = guard_start + used_number;
+		odp_nr++;
+		used_number += DIV_ROUND_UP(count, sector_size);
+
 		nob -= pga[i]->count;
 		pg_count--;
 		i++;
 	}
+	if (rc == 0 && odp_nr != 0)
+		rc = obd_dif_generate_pages(obd_name, odp, odp_nr,
+					    sector_size, fn);
 	kunmap(__page);
 	if (rc)
 		GOTO(out, rc);
@@ -1205,6 +1221,7 @@ static int osc_checksum_bulk_t10pi(const char *obd_name, int nob,
 
 	*check_sum = cksum;
 out:
+	OBD_FREE_LARGE(odp, odp_max * sizeof(*odp));
 	__free_page(__page);
 	return rc;
 }
@@ -3044,11 +3061,9 @@ int osc_disconnect(struct obd_export *exp)
 }
 EXPORT_SYMBOL(osc_disconnect);
 
-int osc_ldlm_resource_invalidate(struct cfs_hash *hs, struct cfs_hash_bd *bd,
-				 struct hlist_node *hnode, void *arg)
+int osc_ldlm_resource_invalidate(struct ldlm_resource *res, void *arg)
 {
 	struct lu_env *env = arg;
-	struct ldlm_resource *res = cfs_hash_object(hs, hnode);
 	struct ldlm_lock *lock;
 	struct osc_object *osc = NULL;
 	ENTRY;
@@ -3110,9 +3125,9 @@ static int osc_import_event(struct obd_device *obd,
                 if (!IS_ERR(env)) {
 			osc_io_unplug(env, &obd->u.cli, NULL);
 
-			cfs_hash_for_each_nolock(ns->ns_rs_hash,
-						 osc_ldlm_resource_invalidate,
-						 env, 0);
+			ldlm_namespace_foreach_res(ns,
+						   osc_ldlm_resource_invalidate,
+						   env);
 			cl_env_put(env, &refcheck);
 
 			ldlm_namespace_cleanup(ns, LDLM_FL_LOCAL_ONLY);
@@ -1188,6 +1188,7 @@ void ptlrpc_set_add_new_req(struct ptlrpcd_ctl *pc,
 	 */
 	req->rq_set = set;
 	req->rq_queued_time = ktime_get_seconds();
+	req->rq_cli.cr_pc_queued_ns = ktime_get();
 	list_add_tail(&req->rq_set_chain, &set->set_new_requests);
 	count = atomic_inc_return(&set->set_new_count);
 	spin_unlock(&set->set_new_req_lock);
@@ -2061,8 +2062,13 @@ int ptlrpc_check_set(const struct lu_env *env, struct ptlrpc_request_set *set)
 				continue;
 			}
 
-			/* Still waiting for a reply? */
-			if (ptlrpc_client_recv(req)) {
+			/*
+			 * Still waiting for a reply?  A reply delivered from
+			 * a bundle leaves the reply MD posted until
+			 * ptlrpc_unregister_reply() below unlinks it.
+			 */
+			if (ptlrpc_client_recv(req) &&
+			    !ptlrpc_client_replied(req)) {
 				spin_unlock(&req->rq_lock);
 				continue;
 			}
@@ -2566,6 +2572,7 @@ static void __ptlrpc_free_req(struct ptlrpc_request *request, int locked)
 	LASSERTF(list_empty(&request->rq_set_chain), "req %p\n", request);
 	LASSERTF(!request->rq_replay, "req %p\n", request);
 
+	ptlrpc_bundle_req_del(request);
 	req_capsule_fini(&request->rq_pill);
 
 	/*
@@ -2714,6 +2721,9 @@ static int ptlrpc_unregister_reply(struct ptlrpc_request *request, int async)
 	 */
 	LASSERT(!in_interrupt());
 
+	/* No reply can be delivered from a bundle anymore */
+	ptlrpc_bundle_req_del(request);
+
 	/* Let's setup deadline for reply unlink. */
 	if (OBD_FAIL_CHECK(OBD_FAIL_PTLRPC_LONG_REPL_UNLINK) &&
 	    async && request->rq_reply_deadline == 0 && cfs_fail_val == 0)
@@ -34,6 +34,7 @@
 #include <obd_support.h>
 #include <obd_class.h>
 #include <lustre_net.h>
+#include <lnet/lib-lnet.h> /* for lnet_cpt_of_nid() */
 
 #include "ptlrpc_internal.h"
 
@@ -58,6 +59,7 @@ ptlrpc_connection_get(struct lnet_process_id peer, lnet_nid_t self,
 
 	conn->c_peer = peer;
 	conn->c_self = self;
+	conn->c_cpt = lnet_cpt_of_nid(peer.nid, NULL);
 	INIT_HLIST_NODE(&conn->c_hash);
 	atomic_set(&conn->c_refcount, 1);
 	if (uuid)
@@ -33,14 +33,21 @@
 #define DEBUG_SUBSYSTEM S_RPC
 
 #include <libcfs/libcfs.h>
+#include <linux/hash.h>
 #include <linux/kernel.h>
 #include <obd_class.h>
 #include <lustre_net.h>
 #include <lustre_sec.h>
+#include <lustre_swab.h>
 #include "ptlrpc_internal.h"
 
 struct lnet_handle_eq ptlrpc_eq_h;
 
+static int reply_bundle_buffers;
+module_param(reply_bundle_buffers, int, 0444);
+MODULE_PARM_DESC(reply_bundle_buffers,
+		 "Number of buffers posted to receive coalesced replies");
+
 /*
  *  Client's outgoing request callback
  */
@@ -172,6 +179,367 @@ out_wake:
 	EXIT;
 }
 
+/*
+ * Client side of reply bundling.
+ *
+ * Requests which may be replied in a bundle are hashed by xid, and a few
+ * large buffers are posted on REPLY_BUNDLE_PORTAL.  When a bundle arrives
+ * each reply it carries is copied into the reply buffer of its request as
+ * if LNet had put it there, see reply_in_callback().
+ */
+#define PTLRPC_BUNDLE_HASH_BITS	8
+#define PTLRPC_BUNDLE_BUF_SIZE	(16 * PTLRPC_BUNDLE_SIZE)
+
+struct ptlrpc_bundle_bucket {
+	spinlock_t		pbk_lock;
+	struct hlist_head	pbk_head;
+};
+
+struct ptlrpc_bundle_buf {
+	struct ptlrpc_cb_id	pbb_cbid;
+	struct lnet_handle_md	pbb_md_h;
+	/* repost the buffer once LNet is done with it */
+	struct work_struct	pbb_work;
+	char			*pbb_buffer;
+};
+
+static struct ptlrpc_bundle_bucket	*ptlrpc_bundle_hash;
+static struct ptlrpc_bundle_buf		*ptlrpc_bundle_bufs;
+/* # of bundle buffers currently attached to the portal */
+static atomic_t				ptlrpc_bundle_nposted;
+static wait_queue_head_t		ptlrpc_bundle_waitq;
+static bool				ptlrpc_bundle_stopping;
+
+static inline struct ptlrpc_bundle_bucket *ptlrpc_bundle_xid2bkt(__u64 xid)
+{
+	return &ptlrpc_bundle_hash[hash_64(xid, PTLRPC_BUNDLE_HASH_BITS)];
+}
+
+/**
+ * Make request \a req findable by reply_bundle_in_callback().
+ *
+ * \retval true if the server may reply \a req in a bundle
+ */
+bool ptlrpc_bundle_req_add(struct ptlrpc_request *req)
+{
+	struct ptlrpc_bundle_bucket *pbk;
+
+	if (ptlrpc_bundle_hash == NULL ||
+	    atomic_read(&ptlrpc_bundle_nposted) == 0)
+		return false;
+
+	pbk = ptlrpc_bundle_xid2bkt(req->rq_xid);
+	spin_lock(&pbk->pbk_lock);
+	if (hlist_unhashed(&req->rq_cli.cr_bundle_hnode))
+		hlist_add_head(&req->rq_cli.cr_bundle_hnode, &pbk->pbk_head);
+	spin_unlock(&pbk->pbk_lock);
+
+	return true;
+}
+
+void ptlrpc_bundle_req_del(struct ptlrpc_request *req)
+{
+	struct ptlrpc_bundle_bucket *pbk;
+
+	if (hlist_unhashed(&req->rq_cli.cr_bundle_hnode))
+		return;
+
+	pbk = ptlrpc_bundle_xid2bkt(req->rq_xid);
+	spin_lock(&pbk->pbk_lock);
+	hlist_del_init(&req->rq_cli.cr_bundle_hnode);
+	spin_unlock(&pbk->pbk_lock);
+}
+
+/**
+ * Deliver one reply of a bundle sent by \a peer to the request it belongs
+ * to.  This mirrors what reply_in_callback() does for a reply PUT directly
+ * into rq_repbuf, except that the reply MD stays posted: rq_receiving_reply
+ * is only cleared by the unlink event once ptlrpc_check_set() has called
+ * ptlrpc_unregister_reply().  LNetMDUnlink() can't be called from here as
+ * LNet callbacks run under lnet_res_lock.
+ */
+static void ptlrpc_bundle_deliver(lnet_nid_t peer, __u64 xid,
+				  unsigned int offset, void *data,
+				  unsigned int len)
+{
+	struct ptlrpc_bundle_bucket *pbk = ptlrpc_bundle_xid2bkt(xid);
+	struct ptlrpc_request *req;
+	lnet_nid_t expected;
+	bool found = false;
+
+	spin_lock(&pbk->pbk_lock);
+	hlist_for_each_entry(req, &pbk->pbk_head, rq_cli.cr_bundle_hnode) {
+		if (req->rq_xid == xid) {
+			found = true;
+			break;
+		}
+	}
+	if (!found) {
+		spin_unlock(&pbk->pbk_lock);
+		CDEBUG(D_RPCTRACE, "no request for bundled reply x%llu\n", xid);
+		return;
+	}
+
+	/* only the server the request was sent to may reply to it */
+	expected = req->rq_import->imp_connection->c_peer.nid;
+	if (expected != peer) {
+		spin_unlock(&pbk->pbk_lock);
+		CERROR("bundled reply x%llu from %s, expected %s\n", xid,
+		       libcfs_nid2str(peer), libcfs_nid2str(expected));
+		return;
+	}
+
+	spin_lock(&req->rq_lock);
+	if (!req->rq_receiving_reply || req->rq_reply_unlinked ||
+	    req->rq_replied) {
+		DEBUG_REQ(D_RPCTRACE, req, "not waiting for bundled reply");
+		goto out;
+	}
+
+	req->rq_early = 0;
+	req->rq_replied = 1;
+
+	/* offset and len come from the wire, their sum may wrap */
+	if (offset > req->rq_repbuf_len ||
+	    len > req->rq_repbuf_len - offset) {
+		CDEBUG(D_RPCTRACE, "truncate req %p rpc %d - %d+%d\n", req,
+		       req->rq_replen, len, offset);
+		req->rq_reply_truncated = 1;
+		req->rq_status = -EOVERFLOW;
+		req->rq_nob_received = len + offset;
+		goto out_wake;
+	}
+
+	memcpy(req->rq_repbuf + offset, data, len);
+	req->rq_rep_swab_mask = 0;
+	/* Got reply, no resend required */
+	req->rq_resend = 0;
+	req->rq_reply_off = offset;
+	req->rq_nob_received = len;
+	DEBUG_REQ(D_INFO, req, "bundled reply in len=%u offset=%u replen=%d",
+		  len, offset, req->rq_replen);
+
+	if (lustre_msg_get_opc(req->rq_reqmsg) != OBD_PING)
+		req->rq_import->imp_last_reply_time = ktime_get_real_seconds();
+out_wake:
+	ptlrpc_client_wake_req(req);
+out:
+	spin_unlock(&req->rq_lock);
+	spin_unlock(&pbk->pbk_lock);
+}
+
+static void ptlrpc_bundle_unpack(lnet_nid_t peer, void *buf, unsigned int nob)
+{
+	struct ptlrpc_bundle_hdr *pbh = buf;
+	struct ptlrpc_bundle_ent *pbe;
+	unsigned int offset;
+	bool swab;
+	__u32 i;
+
+	if (nob < sizeof(*pbh)) {
+		CERROR("short reply bundle: %u bytes\n", nob);
+		return;
+	}
+
+	switch (pbh->pbh_magic) {
+	case PTLRPC_BUNDLE_MAGIC:
+		swab = false;
+		break;
+	case PTLRPC_BUNDLE_MAGIC_SWABBED:
+		swab = true;
+		lustre_swab_ptlrpc_bundle_hdr(pbh);
+		break;
+	default:
+		CERROR("bad reply bundle magic %#x\n", pbh->pbh_magic);
+		return;
+	}
+
+	offset = sizeof(*pbh);
+	for (i = 0; i < pbh->pbh_count; i++) {
+		if (offset + sizeof(*pbe) > nob)
+			break;
+
+		pbe = buf + offset;
+		if (swab)
+			lustre_swab_ptlrpc_bundle_ent(pbe);
+		offset += sizeof(*pbe);
+		if (pbe->pbe_len > nob - offset)
+			break;
+
+		ptlrpc_bundle_deliver(peer, pbe->pbe_xid, pbe->pbe_offset,
+				      buf + offset, pbe->pbe_len);
+		offset += cfs_size_round(pbe->pbe_len);
+	}
+
+	if (i != pbh->pbh_count)
+		CERROR("reply bundle truncated at entry %u/%u\n",
+		       i, pbh->pbh_count);
+}
+
+/*
+ * Client's incoming reply bundle callback
+ */
+void reply_bundle_in_callback(struct lnet_event *ev)
+{
+	struct ptlrpc_cb_id *cbid = ev->md.user_ptr;
+	struct ptlrpc_bundle_buf *pbb = cbid->cbid_arg;
+	ENTRY;
+
+	LASSERT(ev->type == LNET_EVENT_PUT || ev->type == LNET_EVENT_UNLINK);
+	LASSERT(ev->md.start == pbb->pbb_buffer);
+
+	CDEBUG(D_NET, "type %d, status %d, mlength %u, unlinked %d\n",
+	       ev->type, ev->status, ev->mlength, ev->unlinked);
+
+	if (ev->type == LNET_EVENT_PUT && ev->status == 0) {
+		if (ev->mlength < ev->rlength)
+			CERROR("reply bundle from %s truncated: %u < %u\n",
+			       libcfs_id2str(ev->initiator), ev->mlength,
+			       ev->rlength);
+		else
+			ptlrpc_bundle_unpack(ev->initiator.nid,
+					     ev->md.start + ev->offset,
+					     ev->mlength);
+	}
+
+	if (ev->unlinked) {
+		/* LNetMDAttach() can't be called from the callback */
+		if (!ptlrpc_bundle_stopping)
+			schedule_work(&pbb->pbb_work);
+		if (atomic_dec_and_test(&ptlrpc_bundle_nposted))
+			wake_up(&ptlrpc_bundle_waitq);
+	}
+	EXIT;
+}
+
+static int ptlrpc_bundle_post(struct ptlrpc_bundle_buf *pbb)
+{
+	static struct lnet_process_id match_id = {
+		.nid = LNET_NID_ANY,
+		.pid = LNET_PID_ANY
+	};
+	struct lnet_handle_me me_h;
+	struct lnet_md md;
+	int rc;
+
+	rc = LNetMEAttach(REPLY_BUNDLE_PORTAL, match_id, 0, ~0, LNET_UNLINK,
+			  LNET_INS_AFTER, &me_h);
+	if (rc != 0) {
+		CERROR("LNetMEAttach failed: %d\n", rc);
+		return rc;
+	}
+
+	md.start     = pbb->pbb_buffer;
+	md.length    = PTLRPC_BUNDLE_BUF_SIZE;
+	md.max_size  = PTLRPC_BUNDLE_SIZE;
+	md.threshold = LNET_MD_THRESH_INF;
+	md.options   = PTLRPC_MD_OPTIONS | LNET_MD_OP_PUT | LNET_MD_MAX_SIZE;
+	md.user_ptr  = &pbb->pbb_cbid;
+	md.eq_handle = ptlrpc_eq_h;
+
+	atomic_inc(&ptlrpc_bundle_nposted);
+	rc = LNetMDAttach(me_h, md, LNET_UNLINK, &pbb->pbb_md_h);
+	if (rc == 0)
+		return 0;
+
+	CERROR("LNetMDAttach failed: %d\n", rc);
+	atomic_dec(&ptlrpc_bundle_nposted);
+	LNetMEUnlink(me_h);
+	return rc;
+}
+
+static void ptlrpc_bundle_repost(struct work_struct *work)
+{
+	struct ptlrpc_bundle_buf *pbb = container_of(work,
+						     struct ptlrpc_bundle_buf,
+						     pbb_work);
+
+	if (!ptlrpc_bundle_stopping)
+		ptlrpc_bundle_post(pbb);
+}
+
+static void ptlrpc_bundle_fini(void)
+{
+	int i;
+
+	ptlrpc_bundle_stopping = true;
+	if (ptlrpc_bundle_bufs != NULL) {
+		for (i = 0; i < reply_bundle_buffers; i++)
+			cancel_work_sync(&ptlrpc_bundle_bufs[i].pbb_work);
+		for (i = 0; i < reply_bundle_buffers; i++)
+			LNetMDUnlink(ptlrpc_bundle_bufs[i].pbb_md_h);
+		wait_event(ptlrpc_bundle_waitq,
+			   atomic_read(&ptlrpc_bundle_nposted) == 0);
+
+		for (i = 0; i < reply_bundle_buffers; i++) {
+			if (ptlrpc_bundle_bufs[i].pbb_buffer != NULL)
+				OBD_FREE_LARGE(ptlrpc_bundle_bufs[i].pbb_buffer,
+					       PTLRPC_BUNDLE_BUF_SIZE);
+		}
+		OBD_FREE(ptlrpc_bundle_bufs,
+			 reply_bundle_buffers * sizeof(*ptlrpc_bundle_bufs));
+		ptlrpc_bundle_bufs = NULL;
+	}
+
+	if (ptlrpc_bundle_hash != NULL) {
+		OBD_FREE_LARGE(ptlrpc_bundle_hash, sizeof(*ptlrpc_bundle_hash) <<
+						   PTLRPC_BUNDLE_HASH_BITS);
+		ptlrpc_bundle_hash = NULL;
+	}
+}
+
+static int ptlrpc_bundle_init(void)
+{
+	struct ptlrpc_bundle_buf *pbb;
+	int rc = 0;
+	int i;
+
+	atomic_set(&ptlrpc_bundle_nposted, 0);
+	init_waitqueue_head(&ptlrpc_bundle_waitq);
+	ptlrpc_bundle_stopping = false;
+
+	if (reply_bundle_buffers <= 0)
+		return 0;
+
+	OBD_ALLOC_LARGE(ptlrpc_bundle_hash,
+			sizeof(*ptlrpc_bundle_hash) << PTLRPC_BUNDLE_HASH_BITS);
+	if (ptlrpc_bundle_hash == NULL)
+		return -ENOMEM;
+
+	for (i = 0; i < (1 << PTLRPC_BUNDLE_HASH_BITS); i++) {
+		spin_lock_init(&ptlrpc_bundle_hash[i].pbk_lock);
+		INIT_HLIST_HEAD(&ptlrpc_bundle_hash[i].pbk_head);
+	}
+
+	OBD_ALLOC(ptlrpc_bundle_bufs,
+		  reply_bundle_buffers * sizeof(*ptlrpc_bundle_bufs));
+	if (ptlrpc_bundle_bufs == NULL)
+		GOTO(out, rc = -ENOMEM);
+
+	for (i = 0; i < reply_bundle_buffers; i++) {
+		pbb = &ptlrpc_bundle_bufs[i];
+		pbb->pbb_cbid.cbid_fn = reply_bundle_in_callback;
+		pbb->pbb_cbid.cbid_arg = pbb;
+		INIT_WORK(&pbb->pbb_work, ptlrpc_bundle_repost);
+		LNetInvalidateMDHandle(&pbb->pbb_md_h);
+	}
+
+	for (i = 0; i < reply_bundle_buffers; i++) {
+		pbb = &ptlrpc_bundle_bufs[i];
+		OBD_ALLOC_LARGE(pbb->pbb_buffer, PTLRPC_BUNDLE_BUF_SIZE);
+		if (pbb->pbb_buffer == NULL)
+			GOTO(out, rc = -ENOMEM);
+
+		rc = ptlrpc_bundle_post(pbb);
+		if (rc != 0)
+			GOTO(out, rc);
+	}
+out:
+	if (rc != 0)
+		ptlrpc_bundle_fini();
+	return rc;
+}
+
 /*
  * Client's bulk has been written/read
  */
@@ -428,6 +796,27 @@ void reply_out_callback(struct lnet_event *ev)
 	EXIT;
 }
 
+/*
+ * Server's outgoing reply bundle callback
+ */
+void reply_bundle_out_callback(struct lnet_event *ev)
+{
+	struct ptlrpc_cb_id *cbid = ev->md.user_ptr;
+	struct ptlrpc_reply_bundle *rb = cbid->cbid_arg;
+	ENTRY;
+
+	LASSERT(ev->type == LNET_EVENT_SEND || ev->type == LNET_EVENT_UNLINK);
+	/* bundles are fire-and-forget, like 'easy' replies */
+	LASSERT(ev->unlinked);
+
+	CDEBUG(ev->status == 0 ? D_NET : D_ERROR,
+	       "bundle of %u replies to %s: type %d, status %d\n",
+	       rb->rb_count, libcfs_id2str(rb->rb_peer), ev->type, ev->status);
+
+	ptlrpc_reply_bundle_free(rb);
+	EXIT;
+}
+
 #ifdef HAVE_SERVER_SUPPORT
 /*
  * Server's bulk completion callback
@@ -489,7 +878,9 @@ static void ptlrpc_master_callback(struct lnet_event *ev)
                  callback == reply_in_callback ||
                  callback == client_bulk_callback ||
                  callback == request_in_callback ||
-                 callback == reply_out_callback
+                 callback == reply_out_callback ||
+                 callback == reply_bundle_in_callback ||
+                 callback == reply_bundle_out_callback
 #ifdef HAVE_SERVER_SUPPORT
                  || callback == server_bulk_callback
 #endif
@@ -625,11 +1016,20 @@ int ptlrpc_init_portals(void)
                 CERROR("network initialisation failed\n");
 		return rc;
         }
+	rc = ptlrpc_bundle_init();
+	if (rc != 0) {
+		CERROR("reply bundle buffers initialisation failed: rc = %d\n",
+		       rc);
+		ptlrpc_ni_fini();
+		return rc;
+	}
+
         rc = ptlrpcd_addref();
         if (rc == 0)
                 return 0;
 
         CERROR("rpcd initialisation failed\n");
+	ptlrpc_bundle_fini();
         ptlrpc_ni_fini();
         return rc;
 }
@@ -637,5 +1037,6 @@ int ptlrpc_init_portals(void)
 void ptlrpc_exit_portals(void)
 {
         ptlrpcd_decref();
+	ptlrpc_bundle_fini();
         ptlrpc_ni_fini();
 }
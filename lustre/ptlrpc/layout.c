@@ -44,9 +44,11 @@
 
 #define DEBUG_SUBSYSTEM S_RPC
 
+#include <linux/debugfs.h>
 #include <linux/module.h>
 
 #include <llog_swab.h>
+#include <lprocfs_status.h>
 #include <lustre_debug.h>
 #include <lustre_swab.h>
 #include <obd.h>
@@ -390,6 +392,12 @@ static const struct req_msg_field *ldlm_enqueue_lvb_server[] = {
         &RMF_DLM_LVB
 };
 
+/* the reply to a batched BL AST lists the handles the client no longer has */
+static const struct req_msg_field *ldlm_bl_callback_batch_server[] = {
+	&RMF_PTLRPC_BODY,
+	&RMF_DLM_REQ
+};
+
 static const struct req_msg_field *ldlm_cp_callback_client[] = {
         &RMF_PTLRPC_BODY,
         &RMF_DLM_REQ,
@@ -811,6 +819,7 @@ static struct req_format *req_formats[] = {
 	&RQF_LDLM_CALLBACK,
 	&RQF_LDLM_CP_CALLBACK,
 	&RQF_LDLM_BL_CALLBACK,
+	&RQF_LDLM_BL_CALLBACK_BATCH,
 	&RQF_LDLM_GL_CALLBACK,
 	&RQF_LDLM_GL_CALLBACK_DESC,
 	&RQF_LDLM_INTENT,
@@ -1285,6 +1294,14 @@ struct req_format {
 		size_t			     nr;
 		const struct req_msg_field **d;
 	} rf_fields[RCL_NR];
+	/*
+	 * Computed by req_layout_init() from rf_fields, so that packing
+	 * does not need to walk the field descriptors on every request.
+	 */
+	struct {
+		/* message size with variable-sized fields left empty */
+		__u32			     rl_msg_size;
+	} rf_layout[RCL_NR];
 };
 
 #define DEFINE_REQ_FMT(name, client, client_nr, server, server_nr) {    \
@@ -1527,6 +1544,11 @@ struct req_format RQF_LDLM_BL_CALLBACK =
         DEFINE_REQ_FMT0("LDLM_BL_CALLBACK", ldlm_enqueue_client, empty);
 EXPORT_SYMBOL(RQF_LDLM_BL_CALLBACK);
 
+struct req_format RQF_LDLM_BL_CALLBACK_BATCH =
+	DEFINE_REQ_FMT0("LDLM_BL_CALLBACK_BATCH", ldlm_enqueue_client,
+			ldlm_bl_callback_batch_server);
+EXPORT_SYMBOL(RQF_LDLM_BL_CALLBACK_BATCH);
+
 struct req_format RQF_LDLM_GL_CALLBACK =
         DEFINE_REQ_FMT0("LDLM_GL_CALLBACK", ldlm_enqueue_client,
                         ldlm_gl_callback_server);
@@ -1736,9 +1758,12 @@ EXPORT_SYMBOL(RQF_OST_LADVISE);
 /* Convenience macro */
 #define FMT_FIELD(fmt, i, j) (fmt)->rf_fields[(i)].d[(j)]
 
+static int req_layout_bench_init(void);
+static void req_layout_bench_fini(void);
+
 /**
  * Initializes the capsule abstraction by computing and setting the \a rf_idx
- * field of RQFs and the \a rmf_offset field of RMFs.
+ * field and \a rf_layout tables of RQFs and the \a rmf_offset field of RMFs.
  */
 int req_layout_init(void)
 {
@@ -1752,6 +1777,9 @@ int req_layout_init(void)
                 rf->rf_idx = i;
                 for (j = 0; j < RCL_NR; ++j) {
                         LASSERT(rf->rf_fields[j].nr <= REQ_MAX_FIELD_NR);
+			rf->rf_layout[j].rl_msg_size =
+				lustre_msg_hdr_size(LUSTRE_MSG_MAGIC_V2,
+						    rf->rf_fields[j].nr);
                         for (k = 0; k < rf->rf_fields[j].nr; ++k) {
                                 struct req_msg_field *field;
 
@@ -1764,15 +1792,24 @@ int req_layout_init(void)
                                  * combinations.
                                  */
                                 field->rmf_offset[i][j] = k + 1;
+
+				if (field->rmf_size != -1)
+					rf->rf_layout[j].rl_msg_size +=
+						cfs_size_round(field->rmf_size);
                         }
                 }
         }
+
+	/* the benchmark is a debugging aid, do not fail module load */
+	req_layout_bench_init();
+
         return 0;
 }
 EXPORT_SYMBOL(req_layout_init);
 
 void req_layout_fini(void)
 {
+	req_layout_bench_fini();
 }
 EXPORT_SYMBOL(req_layout_fini);
 
@@ -1786,12 +1823,8 @@ EXPORT_SYMBOL(req_layout_fini);
  */
 void req_capsule_init_area(struct req_capsule *pill)
 {
-	size_t i;
-
-        for (i = 0; i < ARRAY_SIZE(pill->rc_area[RCL_CLIENT]); i++) {
-                pill->rc_area[RCL_CLIENT][i] = -1;
-                pill->rc_area[RCL_SERVER][i] = -1;
-        }
+	/* every element becomes (__u32)-1 */
+	memset(pill->rc_area, 0xff, sizeof(pill->rc_area));
 }
 EXPORT_SYMBOL(req_capsule_init_area);
 
@@ -1882,8 +1915,7 @@ size_t req_capsule_filled_sizes(struct req_capsule *pill,
 
         for (i = 0; i < fmt->rf_fields[loc].nr; ++i) {
                 if (pill->rc_area[loc][i] == -1) {
-                        pill->rc_area[loc][i] =
-                                            fmt->rf_fields[loc].d[i]->rmf_size;
+			pill->rc_area[loc][i] = fmt->rf_fields[loc].d[i]->rmf_size;
                         if (pill->rc_area[loc][i] == -1) {
                                 /*
                                  * Skip the following fields.
@@ -2338,9 +2370,6 @@ __u32 req_capsule_msg_size(struct req_capsule *pill, enum req_location loc)
 __u32 req_capsule_fmt_size(__u32 magic, const struct req_format *fmt,
                          enum req_location loc)
 {
-	__u32 size;
-	size_t i = 0;
-
         /*
          * This function should probably LASSERT() that fmt has no fields with
          * RMF_F_STRUCT_ARRAY in rmf_flags, since we can't know here how many
@@ -2348,15 +2377,10 @@ __u32 req_capsule_fmt_size(__u32 magic, const struct req_format *fmt,
          * assume that there will be at least one element, and that's just what
          * we do.
          */
-        size = lustre_msg_hdr_size(magic, fmt->rf_fields[loc].nr);
-	if (size == 0)
-		return size;
-
-	for (; i < fmt->rf_fields[loc].nr; ++i)
-		if (fmt->rf_fields[loc].d[i]->rmf_size != -1)
-			size += cfs_size_round(fmt->rf_fields[loc].d[i]->
-					       rmf_size);
-	return size;
+	if (lustre_msg_hdr_size(magic, fmt->rf_fields[loc].nr) == 0)
+		return 0;
+
+	return fmt->rf_layout[loc].rl_msg_size;
 }
 EXPORT_SYMBOL(req_capsule_fmt_size);
 
@@ -2595,3 +2619,190 @@ nm:
 	return rc;
 }
 EXPORT_SYMBOL(req_check_sepol);
+
+/*
+ * Microbenchmark of the capsule field lookup of every request format:
+ * "lctl set_param req_layout_bench=<iterations>" runs it, and
+ * "lctl get_param req_layout_bench" shows the average time in nsec to
+ * look up the size (req_capsule_get_size()) and the buffer
+ * (req_capsule_client_get()/req_capsule_server_get()) of all fields of
+ * the request and of the reply. Variable-sized fields are left empty,
+ * apart from the trailing NUL that string fields need.
+ */
+#define REQ_LAYOUT_BENCH_ITERS_MAX	1000000
+
+enum {
+	RLB_REQ_SIZE,
+	RLB_REQ_GET,
+	RLB_REP_SIZE,
+	RLB_REP_GET,
+	RLB_NR
+};
+
+static DEFINE_MUTEX(req_layout_bench_mutex);
+static unsigned int req_layout_bench_iters;
+static __u64 req_layout_bench_ns[ARRAY_SIZE(req_formats)][RLB_NR];
+static struct dentry *req_layout_bench_entry;
+
+static int req_layout_bench_one(struct ptlrpc_request *req,
+				const struct req_format *fmt,
+				enum req_location loc, unsigned int iters,
+				__u64 *size_ns, __u64 *get_ns)
+{
+	const struct req_msg_field *field;
+	struct req_capsule *pill = &req->rq_pill;
+	__u32 lens[REQ_MAX_FIELD_NR];
+	int count = fmt->rf_fields[loc].nr;
+	struct lustre_msg *msg;
+	unsigned int n;
+	ktime_t start;
+	__u32 len;
+	int rc = 0;
+	int i;
+
+	*size_ns = 0;
+	*get_ns = 0;
+	if (count == 0)
+		return 0;
+
+	for (i = 0; i < count; i++) {
+		field = fmt->rf_fields[loc].d[i];
+		if (field->rmf_size > 0)
+			lens[i] = field->rmf_size;
+		else
+			lens[i] = field->rmf_flags & RMF_F_STRING ? 1 : 0;
+	}
+	len = lustre_msg_size_v2(count, lens);
+
+	/* zeroed, so that every string field holds an empty string */
+	OBD_ALLOC_LARGE(msg, len);
+	if (msg == NULL)
+		return -ENOMEM;
+	lustre_init_msg_v2(msg, count, lens, NULL);
+
+	if (loc == RCL_CLIENT)
+		req->rq_reqmsg = msg;
+	else
+		req->rq_repmsg = msg;
+	req->rq_pill_init = 0;
+	req_capsule_init(pill, req, loc);
+	req_capsule_set(pill, fmt);
+
+	start = ktime_get();
+	for (n = 0; n < iters; n++)
+		for (i = 0; i < count; i++)
+			if (req_capsule_get_size(pill, fmt->rf_fields[loc].d[i],
+						 loc) != lens[i])
+				rc = -EPROTO;
+	*size_ns = div_u64(ktime_to_ns(ktime_sub(ktime_get(), start)), iters);
+
+	start = ktime_get();
+	for (n = 0; n < iters && rc == 0; n++) {
+		for (i = 0; i < count && rc == 0; i++) {
+			field = fmt->rf_fields[loc].d[i];
+			if (loc == RCL_CLIENT ?
+			    req_capsule_client_get(pill, field) == NULL :
+			    req_capsule_server_get(pill, field) == NULL)
+				rc = -EPROTO;
+		}
+	}
+	*get_ns = div_u64(ktime_to_ns(ktime_sub(ktime_get(), start)), iters);
+
+	req->rq_reqmsg = NULL;
+	req->rq_repmsg = NULL;
+	OBD_FREE_LARGE(msg, len);
+
+	return rc;
+}
+
+static int req_layout_bench_seq_show(struct seq_file *m, void *v)
+{
+	size_t i;
+
+	mutex_lock(&req_layout_bench_mutex);
+	seq_printf(m, "iterations: %u\n", req_layout_bench_iters);
+	seq_printf(m, "%-36s %10s %10s %10s %10s\n", "format (nsec)",
+		   "req_size", "req_get", "rep_size", "rep_get");
+	for (i = 0; req_layout_bench_iters != 0 &&
+		    i < ARRAY_SIZE(req_formats); i++)
+		seq_printf(m, "%-36s %10llu %10llu %10llu %10llu\n",
+			   req_formats[i]->rf_name,
+			   req_layout_bench_ns[i][RLB_REQ_SIZE],
+			   req_layout_bench_ns[i][RLB_REQ_GET],
+			   req_layout_bench_ns[i][RLB_REP_SIZE],
+			   req_layout_bench_ns[i][RLB_REP_GET]);
+	mutex_unlock(&req_layout_bench_mutex);
+
+	return 0;
+}
+
+static ssize_t req_layout_bench_seq_write(struct file *file,
+					  const char __user *buffer,
+					  size_t count, loff_t *off)
+{
+	struct ptlrpc_request *req;
+	unsigned int iters;
+	size_t i;
+	int rc;
+
+	rc = kstrtouint_from_user(buffer, count, 0, &iters);
+	if (rc)
+		return rc;
+
+	if (iters == 0 || iters > REQ_LAYOUT_BENCH_ITERS_MAX)
+		return -ERANGE;
+
+	/* never sent, only carries the messages the capsule looks at */
+	OBD_ALLOC_PTR(req);
+	if (req == NULL)
+		return -ENOMEM;
+
+	mutex_lock(&req_layout_bench_mutex);
+	for (i = 0; i < ARRAY_SIZE(req_formats); i++) {
+		__u64 *ns = req_layout_bench_ns[i];
+
+		rc = req_layout_bench_one(req, req_formats[i], RCL_CLIENT,
+					  iters, &ns[RLB_REQ_SIZE],
+					  &ns[RLB_REQ_GET]);
+		if (rc == 0)
+			rc = req_layout_bench_one(req, req_formats[i],
+						  RCL_SERVER, iters,
+						  &ns[RLB_REP_SIZE],
+						  &ns[RLB_REP_GET]);
+		if (rc < 0) {
+			CERROR("%s: benchmark failed: rc = %d\n",
+			       req_formats[i]->rf_name, rc);
+			break;
+		}
+		cond_resched();
+	}
+	req_layout_bench_iters = rc < 0 ? 0 : iters;
+	mutex_unlock(&req_layout_bench_mutex);
+
+	OBD_FREE_PTR(req);
+
+	return rc < 0 ? rc : count;
+}
+LDEBUGFS_SEQ_FOPS(req_layout_bench);
+
+static int req_layout_bench_init(void)
+{
+	req_layout_bench_entry = debugfs_create_file("req_layout_bench", 0644,
+						     debugfs_lustre_root, NULL,
+						     &req_layout_bench_fops);
+	if (IS_ERR_OR_NULL(req_layout_bench_entry)) {
+		int rc = req_layout_bench_entry ?
+			 PTR_ERR(req_layout_bench_entry) : -ENOMEM;
+
+		req_layout_bench_entry = NULL;
+		return rc;
+	}
+
+	return 0;
+}
+
+static void req_layout_bench_fini(void)
+{
+	debugfs_remove(req_layout_bench_entry);
+	req_layout_bench_entry = NULL;
+}
@@ -233,6 +233,8 @@ ptlrpc_ldebugfs_register(struct dentry *root, char *dir, char *name,
                              svc_counter_config, "req_timeout", "sec");
         lprocfs_counter_init(svc_stats, PTLRPC_REQBUF_AVAIL_CNTR,
                              svc_counter_config, "reqbuf_avail", "bufs");
+	lprocfs_counter_init(svc_stats, PTLRPC_REPLY_BUNDLE_CNTR,
+			     svc_counter_config, "reply_bundled", "reqs");
         for (i = 0; i < EXTRA_LAST_OPC; i++) {
                 char *units;
 
@@ -1153,11 +1155,47 @@ static ssize_t high_priority_ratio_store(struct kobject *kobj,
 }
 LUSTRE_RW_ATTR(high_priority_ratio);
 
+static ssize_t reply_bundle_usec_show(struct kobject *kobj,
+				      struct attribute *attr,
+				      char *buf)
+{
+	struct ptlrpc_service *svc = container_of(kobj, struct ptlrpc_service,
+						  srv_kobj);
+
+	return sprintf(buf, "%u\n", svc->srv_rep_bundle_usec);
+}
+
+static ssize_t reply_bundle_usec_store(struct kobject *kobj,
+				       struct attribute *attr,
+				       const char *buffer,
+				       size_t count)
+{
+	struct ptlrpc_service *svc = container_of(kobj, struct ptlrpc_service,
+						  srv_kobj);
+	unsigned int val;
+	int rc;
+
+	rc = kstrtouint(buffer, 10, &val);
+	if (rc < 0)
+		return rc;
+
+	if (val > PTLRPC_BUNDLE_USEC_MAX)
+		return -ERANGE;
+
+	spin_lock(&svc->srv_lock);
+	svc->srv_rep_bundle_usec = val;
+	spin_unlock(&svc->srv_lock);
+
+	return count;
+}
+LUSTRE_RW_ATTR(reply_bundle_usec);
+
 static struct attribute *ptlrpc_svc_attrs[] = {
 	&lustre_attr_threads_min.attr,
 	&lustre_attr_threads_started.attr,
 	&lustre_attr_threads_max.attr,
 	&lustre_attr_high_priority_ratio.attr,
+	&lustre_attr_reply_bundle_usec.attr,
 	NULL,
 };
 
@@ -633,6 +633,12 @@ int ptlrpc_send_reply(struct ptlrpc_request *req, int flags)
 
 	req->rq_sent = ktime_get_real_seconds();
 
+	if (ptlrpc_reply_bundle_add(req, flags)) {
+		/* the reply was copied into a bundle, drop the net's ref */
+		ptlrpc_rs_decref(rs);
+		goto out;
+	}
+
 	rc = ptl_send_buf(&rs->rs_md_h, rs->rs_repbuf, rs->rs_repdata_len,
 			  (rs->rs_difficult && !rs->rs_no_ack) ?
 			  LNET_ACK_REQ : LNET_NOACK_REQ,
@@ -646,6 +652,36 @@ out:
         return rc;
 }
 
+/**
+ * Send the replies coalesced in \a rb to the client in one LNet message.
+ * \a rb is freed when the message is done with.
+ */
+void ptlrpc_send_reply_bundle(struct ptlrpc_reply_bundle *rb)
+{
+	struct ptlrpc_bundle_hdr *pbh = (struct ptlrpc_bundle_hdr *)rb->rb_buf;
+	int rc;
+
+	pbh->pbh_magic = PTLRPC_BUNDLE_MAGIC;
+	pbh->pbh_count = rb->rb_count;
+	pbh->pbh_padding = 0;
+
+	rb->rb_cbid.cbid_fn = reply_bundle_out_callback;
+	rb->rb_cbid.cbid_arg = rb;
+
+	CDEBUG(D_RPCTRACE, "sending bundle of %u replies (%u bytes) to %s\n",
+	       rb->rb_count, rb->rb_nob, libcfs_id2str(rb->rb_peer));
+
+	rc = ptl_send_buf(&rb->rb_md_h, rb->rb_buf, rb->rb_nob,
+			  LNET_NOACK_REQ, &rb->rb_cbid, rb->rb_self,
+			  rb->rb_peer, REPLY_BUNDLE_PORTAL, 0, 0, NULL);
+	if (unlikely(rc != 0)) {
+		/* clients will resend, as if the replies were lost */
+		CERROR("cannot send bundle of %u replies to %s: rc = %d\n",
+		       rb->rb_count, libcfs_id2str(rb->rb_peer), rc);
+		ptlrpc_reply_bundle_free(rb);
+	}
+}
+
 int ptlrpc_reply (struct ptlrpc_request *req)
 {
         if (req->rq_no_reply)
@@ -758,6 +794,14 @@ int ptl_send_rpc(struct ptlrpc_request *request, int noreply)
 			  "resend on EINPROGRESS");
 	}
 
+	/* let the server coalesce the reply with others if we can unpack it,
+	 * the xid is final by now */
+	ptlrpc_bundle_req_del(request);
+	if (!noreply && ptlrpc_bundle_req_add(request))
+		lustre_msghdr_set_flags(request->rq_reqmsg,
+					imp->imp_msghdr_flags |
+					MSGHDR_REPLY_BUNDLE);
+
 	if (request->rq_bulk != NULL) {
 		ptlrpc_set_bulk_mbits(request);
 		lustre_msg_set_mbits(request->rq_reqmsg, request->rq_mbits);
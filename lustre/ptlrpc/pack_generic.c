@@ -1655,6 +1655,20 @@ void lustre_swab_ptlrpc_body(struct ptlrpc_body *body)
 	CLASSERT(offsetof(typeof(*body), pb_jobid) != 0);
 }
 
+void lustre_swab_ptlrpc_bundle_hdr(struct ptlrpc_bundle_hdr *pbh)
+{
+	__swab32s(&pbh->pbh_magic);
+	__swab32s(&pbh->pbh_count);
+	CLASSERT(offsetof(typeof(*pbh), pbh_padding) != 0);
+}
+
+void lustre_swab_ptlrpc_bundle_ent(struct ptlrpc_bundle_ent *pbe)
+{
+	__swab64s(&pbe->pbe_xid);
+	__swab32s(&pbe->pbe_offset);
+	__swab32s(&pbe->pbe_len);
+}
+
 void lustre_swab_connect(struct obd_connect_data *ocd)
 {
         __swab64s(&ocd->ocd_connect_flags);
@@ -66,6 +66,8 @@ extern struct mutex pinger_mutex;
 int ptlrpc_start_thread(struct ptlrpc_service_part *svcpt, int wait);
 /* ptlrpcd.c */
 int ptlrpcd_start(struct ptlrpcd_ctl *pc);
+int ptlrpcd_debugfs_init(void);
+void ptlrpcd_debugfs_fini(void);
 
 /* client.c */
 void ptlrpc_at_adj_net_latency(struct ptlrpc_request *req,
@@ -93,6 +95,45 @@ void ptlrpc_add_unreplied(struct ptlrpc_request *req);
 /* events.c */
 int ptlrpc_init_portals(void);
 void ptlrpc_exit_portals(void);
+bool ptlrpc_bundle_req_add(struct ptlrpc_request *req);
+void ptlrpc_bundle_req_del(struct ptlrpc_request *req);
+
+/* service.c */
+/** biggest LNet message used to carry a reply bundle */
+#define PTLRPC_BUNDLE_SIZE	(16 * 1024)
+/** biggest reply worth being put into a bundle */
+#define PTLRPC_BUNDLE_REPLY_MAX	(2 * 1024)
+/** upper limit of ptlrpc_service::srv_rep_bundle_usec */
+#define PTLRPC_BUNDLE_USEC_MAX	(100 * USEC_PER_MSEC)
+
+/**
+ * Small replies to one client peer which are waiting to be sent together
+ * in a single LNet message to REPLY_BUNDLE_PORTAL.
+ */
+struct ptlrpc_reply_bundle {
+	/** link to ptlrpc_hr_partition::hrp_bundles */
+	struct list_head	rb_list;
+	/** callback parameter of the bundle MD */
+	struct ptlrpc_cb_id	rb_cbid;
+	struct lnet_handle_md	rb_md_h;
+	/** client the replies are sent to, and the NID they are sent from */
+	struct lnet_process_id	rb_peer;
+	lnet_nid_t		rb_self;
+	/** time when the bundle has to be sent even if it is not full */
+	ktime_t			rb_deadline;
+	/** # of replies in the bundle */
+	unsigned int		rb_count;
+	/** # of bytes used in rb_buf, including ptlrpc_bundle_hdr */
+	unsigned int		rb_nob;
+	/** PTLRPC_BUNDLE_SIZE bytes of wire data */
+	char			*rb_buf;
+};
+
+bool ptlrpc_reply_bundle_add(struct ptlrpc_request *req, int flags);
+void ptlrpc_reply_bundle_free(struct ptlrpc_reply_bundle *rb);
+
+/* niobuf.c */
+void ptlrpc_send_reply_bundle(struct ptlrpc_reply_bundle *rb);
 
 void ptlrpc_request_handle_notconn(struct ptlrpc_request *);
 void lustre_assert_wire_constants(void);
@@ -378,6 +419,7 @@ static inline void ptlrpc_cli_req_init(struct ptlrpc_request *req)
 	INIT_LIST_HEAD(&cr->cr_set_chain);
 	INIT_LIST_HEAD(&cr->cr_ctx_chain);
 	INIT_LIST_HEAD(&cr->cr_unreplied_list);
+	INIT_HLIST_NODE(&cr->cr_bundle_hnode);
 	init_waitqueue_head(&cr->cr_reply_waitq);
 	init_waitqueue_head(&cr->cr_set_waitq);
 }
@@ -102,6 +102,9 @@ static __init int ptlrpc_init(void)
 	if (rc)
 		GOTO(err_nrs, rc);
 
+	/* the stats file is best effort, debugfs may be missing */
+	ptlrpcd_debugfs_init();
+
 	RETURN(0);
 err_nrs:
 	ptlrpc_nrs_fini();
@@ -128,6 +131,7 @@ err_layout:
 
 static void __exit ptlrpc_exit(void)
 {
+	ptlrpcd_debugfs_fini();
 	nodemap_mod_exit();
 	ptlrpc_nrs_fini();
 	sptlrpc_fini();
@@ -51,6 +51,8 @@
 
 #define DEBUG_SUBSYSTEM S_RPC
 
+#include <linux/debugfs.h>
+#include <linux/hash.h>
 #include <linux/kthread.h>
 #include <libcfs/libcfs.h>
 #include <lustre_net.h>
@@ -137,6 +139,17 @@ module_param(ptlrpcd_cpts, charp, 0644);
 MODULE_PARM_DESC(ptlrpcd_cpts,
 		 "CPU partitions ptlrpcd threads should run in");
 
+/*
+ * ptlrpcd_import_affinity: Queue the requests of an import on a fixed
+ * ptlrpcd thread of the CPT LNet uses to talk to its peer, instead of
+ * round-robin among the threads of the sender's CPT. Idle partners still
+ * steal queued requests from a busy thread.
+ */
+static int ptlrpcd_import_affinity = 1;
+module_param(ptlrpcd_import_affinity, int, 0644);
+MODULE_PARM_DESC(ptlrpcd_import_affinity,
+		 "Keep requests of one import on the same ptlrpcd thread");
+
 /* ptlrpcds_cpt_idx maps cpt numbers to an index in the ptlrpcds array. */
 static int		*ptlrpcds_cpt_idx;
 
@@ -168,6 +181,8 @@ EXPORT_SYMBOL(ptlrpcd_wake);
 static struct ptlrpcd_ctl *
 ptlrpcd_select_pc(struct ptlrpc_request *req)
 {
+	struct obd_import *imp = req != NULL ? req->rq_import : NULL;
+	struct ptlrpc_connection *conn;
 	struct ptlrpcd	*pd;
 	int		cpt;
 	int		idx;
@@ -175,13 +190,21 @@ ptlrpcd_select_pc(struct ptlrpc_request *req)
 	if (req != NULL && req->rq_send_state != LUSTRE_IMP_FULL)
 		return &ptlrpcd_rcv;
 
-	cpt = cfs_cpt_current(cfs_cpt_table, 1);
+	/* Connections are only freed when the module unloads. */
+	conn = imp != NULL ? READ_ONCE(imp->imp_connection) : NULL;
+	if (ptlrpcd_import_affinity && conn != NULL)
+		cpt = conn->c_cpt;
+	else
+		cpt = cfs_cpt_current(cfs_cpt_table, 1);
 	if (ptlrpcds_cpt_idx == NULL)
 		idx = cpt;
 	else
 		idx = ptlrpcds_cpt_idx[cpt];
 	pd = ptlrpcds[idx];
 
+	if (ptlrpcd_import_affinity && conn != NULL)
+		return &pd->pd_threads[hash_ptr(imp, 16) % pd->pd_nthreads];
+
 	/* We do not care whether it is strict load balance. */
 	idx = pd->pd_cursor;
 	if (++idx == pd->pd_nthreads)
@@ -213,6 +236,7 @@ void ptlrpcd_add_rqset(struct ptlrpc_request_set *set)
 		LASSERT(req->rq_phase == RQ_PHASE_NEW);
 		req->rq_set = new;
 		req->rq_queued_time = ktime_get_seconds();
+		req->rq_cli.cr_pc_queued_ns = ktime_get();
 	}
 
 	spin_lock(&new->set_new_req_lock);
@@ -235,29 +259,59 @@ void ptlrpcd_add_rqset(struct ptlrpc_request_set *set)
 }
 
 /**
+ * Account the time \a list of new requests waited to be picked up by \a pc.
+ */
+static void ptlrpcd_tally_queued(struct ptlrpcd_ctl *pc,
+				 struct list_head *list)
+{
+	struct ptlrpc_request *req;
+	ktime_t now = ktime_get();
+
+	list_for_each_entry(req, list, rq_set_chain) {
+		if (req->rq_cli.cr_pc_queued_ns == 0)
+			continue;
+		lprocfs_oh_tally_log2(&pc->pc_queue_hist,
+				ktime_us_delta(now, req->rq_cli.cr_pc_queued_ns));
+	}
+}
+
+/**
+ * Take half of the new requests queued on the set of a partner, so that
+ * neither thread ends up with a long queue. Requests are taken from the
+ * tail, the partner keeps the oldest ones.
+ *
  * Return transferred RPCs count.
  */
-static int ptlrpcd_steal_rqset(struct ptlrpc_request_set *des,
+static int ptlrpcd_steal_rqset(struct ptlrpcd_ctl *pc,
 			       struct ptlrpc_request_set *src)
 {
-	struct list_head *tmp, *pos;
+	struct ptlrpc_request_set *des = pc->pc_set;
 	struct ptlrpc_request *req;
+	struct ptlrpc_request *next;
+	LIST_HEAD(stolen);
+	int count;
 	int rc = 0;
 
 	spin_lock(&src->set_new_req_lock);
-	if (likely(!list_empty(&src->set_new_requests))) {
-		list_for_each_safe(pos, tmp, &src->set_new_requests) {
-			req = list_entry(pos, struct ptlrpc_request,
-					 rq_set_chain);
-			req->rq_set = des;
-		}
-		list_splice_init(&src->set_new_requests,
-				 &des->set_requests);
-		rc = atomic_read(&src->set_new_count);
-		atomic_add(rc, &des->set_remaining);
-		atomic_set(&src->set_new_count, 0);
+	count = (atomic_read(&src->set_new_count) + 1) / 2;
+	list_for_each_entry_safe_reverse(req, next, &src->set_new_requests,
+					 rq_set_chain) {
+		if (rc >= count)
+			break;
+		req->rq_set = des;
+		list_move(&req->rq_set_chain, &stolen);
+		rc++;
 	}
+	atomic_sub(rc, &src->set_new_count);
 	spin_unlock(&src->set_new_req_lock);
+
+	if (rc > 0) {
+		ptlrpcd_tally_queued(pc, &stolen);
+		list_splice(&stolen, &des->set_requests);
+		atomic_add(rc, &des->set_remaining);
+		atomic64_add(rc, &pc->pc_stolen);
+	}
+
 	return rc;
 }
 
@@ -326,10 +380,11 @@ static int ptlrpcd_check(struct lu_env *env, struct ptlrpcd_ctl *pc)
 	ENTRY;
 
 	if (atomic_read(&set->set_new_count)) {
+		LIST_HEAD(new);
+
 		spin_lock(&set->set_new_req_lock);
 		if (likely(!list_empty(&set->set_new_requests))) {
-			list_splice_init(&set->set_new_requests,
-					     &set->set_requests);
+			list_splice_init(&set->set_new_requests, &new);
 			atomic_add(atomic_read(&set->set_new_count),
 				   &set->set_remaining);
 			atomic_set(&set->set_new_count, 0);
@@ -339,6 +394,9 @@ static int ptlrpcd_check(struct lu_env *env, struct ptlrpcd_ctl *pc)
 			rc = 1;
 		}
 		spin_unlock(&set->set_new_req_lock);
+
+		ptlrpcd_tally_queued(pc, &new);
+		list_splice(&new, &set->set_requests);
 	}
 
 	/*
@@ -411,7 +469,7 @@ static int ptlrpcd_check(struct lu_env *env, struct ptlrpcd_ctl *pc)
 				spin_unlock(&partner->pc_lock);
 
 				if (atomic_read(&ps->set_new_count)) {
-					rc = ptlrpcd_steal_rqset(set, ps);
+					rc = ptlrpcd_steal_rqset(pc, ps);
 					if (rc > 0)
 						CDEBUG(D_RPCTRACE,
 						       "transfer %d async RPCs [%d->%d]\n",
@@ -540,6 +598,9 @@ static void ptlrpcd_ctl_init(struct ptlrpcd_ctl *pc, int index, int cpt)
 	init_completion(&pc->pc_starting);
 	init_completion(&pc->pc_finishing);
 	spin_lock_init(&pc->pc_lock);
+	spin_lock_init(&pc->pc_queue_hist.oh_lock);
+	lprocfs_oh_clear(&pc->pc_queue_hist);
+	atomic64_set(&pc->pc_stolen, 0);
 
 	if (index < 0) {
 		/* Recovery thread. */
@@ -979,4 +1040,103 @@ void ptlrpcd_decref(void)
 	mutex_unlock(&ptlrpcd_mutex);
 }
 EXPORT_SYMBOL(ptlrpcd_decref);
+
+static void ptlrpcd_stats_show_pc(struct seq_file *m, struct ptlrpcd_ctl *pc)
+{
+	struct ptlrpc_request_set *set = pc->pc_set;
+	unsigned long tot;
+	unsigned long cum = 0;
+	int i;
+
+	if (set == NULL)
+		return;
+
+	seq_printf(m, "%s:\n", pc->pc_name);
+	seq_printf(m, "  queued:  %d\n", atomic_read(&set->set_new_count));
+	seq_printf(m, "  active:  %d\n", atomic_read(&set->set_remaining));
+	seq_printf(m, "  stolen:  %lld\n",
+		   (long long)atomic64_read(&pc->pc_stolen));
+	seq_printf(m, "  queue usec     reqs   %% cum %%\n");
+
+	tot = lprocfs_oh_sum(&pc->pc_queue_hist);
+	for (i = 0; i < OBD_HIST_MAX && cum < tot; i++) {
+		unsigned long n = pc->pc_queue_hist.oh_buckets[i];
+
+		cum += n;
+		seq_printf(m, "  %10lu: %10lu %3u %3u\n",
+			   1UL << i, n, pct(n, tot), pct(cum, tot));
+	}
+}
+
+static int ptlrpcd_stats_seq_show(struct seq_file *m, void *v)
+{
+	int i;
+	int j;
+
+	mutex_lock(&ptlrpcd_mutex);
+	ptlrpcd_stats_show_pc(m, &ptlrpcd_rcv);
+	for (i = 0; ptlrpcds != NULL && i < ptlrpcds_num; i++) {
+		if (ptlrpcds[i] == NULL)
+			break;
+		for (j = 0; j < ptlrpcds[i]->pd_nthreads; j++)
+			ptlrpcd_stats_show_pc(m, &ptlrpcds[i]->pd_threads[j]);
+	}
+	mutex_unlock(&ptlrpcd_mutex);
+
+	return 0;
+}
+
+static void ptlrpcd_stats_clear_pc(struct ptlrpcd_ctl *pc)
+{
+	if (pc->pc_set == NULL)
+		return;
+
+	lprocfs_oh_clear(&pc->pc_queue_hist);
+	atomic64_set(&pc->pc_stolen, 0);
+}
+
+static ssize_t ptlrpcd_stats_seq_write(struct file *file,
+				       const char __user *buffer,
+				       size_t count, loff_t *off)
+{
+	int i;
+	int j;
+
+	mutex_lock(&ptlrpcd_mutex);
+	ptlrpcd_stats_clear_pc(&ptlrpcd_rcv);
+	for (i = 0; ptlrpcds != NULL && i < ptlrpcds_num; i++) {
+		if (ptlrpcds[i] == NULL)
+			break;
+		for (j = 0; j < ptlrpcds[i]->pd_nthreads; j++)
+			ptlrpcd_stats_clear_pc(&ptlrpcds[i]->pd_threads[j]);
+	}
+	mutex_unlock(&ptlrpcd_mutex);
+
+	return count;
+}
+LDEBUGFS_SEQ_FOPS(ptlrpcd_stats);
+
+static struct dentry *ptlrpcd_debugfs_entry;
+
+int ptlrpcd_debugfs_init(void)
+{
+	ptlrpcd_debugfs_entry = debugfs_create_file("ptlrpcd_stats", 0644,
+						    debugfs_lustre_root, NULL,
+						    &ptlrpcd_stats_fops);
+	if (IS_ERR_OR_NULL(ptlrpcd_debugfs_entry)) {
+		int rc = ptlrpcd_debugfs_entry ?
+			 PTR_ERR(ptlrpcd_debugfs_entry) : -ENOMEM;
+
+		ptlrpcd_debugfs_entry = NULL;
+		return rc;
+	}
+
+	return 0;
+}
+
+void ptlrpcd_debugfs_fini(void)
+{
+	debugfs_remove(ptlrpcd_debugfs_entry);
+	ptlrpcd_debugfs_entry = NULL;
+}
 /** @} ptlrpcd */
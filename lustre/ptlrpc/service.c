@@ -222,6 +222,14 @@ struct ptlrpc_hr_partition {
 	int				hrp_nthrs;
 	/* threads table */
 	struct ptlrpc_hr_thread		*hrp_thrs;
+	/* protects hrp_bundles */
+	spinlock_t			hrp_bundle_lock;
+	/* reply bundles being filled, see ptlrpc_reply_bundle_add() */
+	struct list_head		hrp_bundles;
+	/* fires when the oldest bundle has to be sent */
+	struct timer_list		hrp_bundle_timer;
+	/* set by hrp_bundle_timer, handled by the first thread */
+	int				hrp_bundle_flush;
 };
 
 #define HRT_RUNNING 0
@@ -358,6 +366,179 @@ static void rs_batch_fini(struct rs_batch *b)
 
 #define DECLARE_RS_BATCH(b)     struct rs_batch b
 
+void ptlrpc_reply_bundle_free(struct ptlrpc_reply_bundle *rb)
+{
+	OBD_FREE_LARGE(rb->rb_buf, PTLRPC_BUNDLE_SIZE);
+	OBD_FREE_PTR(rb);
+}
+
+static struct ptlrpc_reply_bundle *
+ptlrpc_reply_bundle_alloc(struct ptlrpc_hr_partition *hrp,
+			  struct ptlrpc_request *req, unsigned int usec)
+{
+	struct ptlrpc_reply_bundle *rb;
+
+	OBD_CPT_ALLOC_PTR(rb, ptlrpc_hr.hr_cpt_table, hrp->hrp_cpt);
+	if (rb == NULL)
+		return NULL;
+
+	OBD_CPT_ALLOC_LARGE(rb->rb_buf, ptlrpc_hr.hr_cpt_table, hrp->hrp_cpt,
+			    PTLRPC_BUNDLE_SIZE);
+	if (rb->rb_buf == NULL) {
+		OBD_FREE_PTR(rb);
+		return NULL;
+	}
+
+	INIT_LIST_HEAD(&rb->rb_list);
+	rb->rb_peer = req->rq_peer;
+	rb->rb_self = req->rq_self;
+	rb->rb_deadline = ktime_add_us(ktime_get(), usec);
+	rb->rb_nob = sizeof(struct ptlrpc_bundle_hdr);
+
+	return rb;
+}
+
+/**
+ * Send the bundles of \a hrp which reached their deadline.
+ */
+static void ptlrpc_hr_flush_bundles(struct ptlrpc_hr_partition *hrp)
+{
+	struct ptlrpc_reply_bundle *rb;
+	struct ptlrpc_reply_bundle *tmp;
+	ktime_t now = ktime_get();
+	ktime_t next = KTIME_MAX;
+	LIST_HEAD(due);
+
+	hrp->hrp_bundle_flush = 0;
+
+	spin_lock(&hrp->hrp_bundle_lock);
+	list_for_each_entry_safe(rb, tmp, &hrp->hrp_bundles, rb_list) {
+		if (ktime_before(now, rb->rb_deadline)) {
+			if (ktime_before(rb->rb_deadline, next))
+				next = rb->rb_deadline;
+			continue;
+		}
+		list_move_tail(&rb->rb_list, &due);
+	}
+	if (next != KTIME_MAX)
+		mod_timer(&hrp->hrp_bundle_timer, jiffies +
+			  usecs_to_jiffies(ktime_us_delta(next, now)) + 1);
+	spin_unlock(&hrp->hrp_bundle_lock);
+
+	while (!list_empty(&due)) {
+		rb = list_entry(due.next, struct ptlrpc_reply_bundle, rb_list);
+		list_del_init(&rb->rb_list);
+		ptlrpc_send_reply_bundle(rb);
+	}
+}
+
+static void ptlrpc_hr_bundle_timer(cfs_timer_cb_arg_t data)
+{
+	struct ptlrpc_hr_partition *hrp;
+
+	hrp = cfs_from_timer(hrp, data, hrp_bundle_timer);
+
+	hrp->hrp_bundle_flush = 1;
+	wake_up(&hrp->hrp_thrs[0].hrt_waitq);
+}
+
+/**
+ * Try to coalesce the reply of \a req with other small replies to the same
+ * client.  The reply has already been wrapped by sptlrpc, so its wire data
+ * is copied into the bundle as-is and the reply state is no longer needed
+ * by the network.
+ *
+ * \retval true if the reply was added to a bundle and must not be sent
+ * \retval false if the reply must be sent by the caller
+ */
+bool ptlrpc_reply_bundle_add(struct ptlrpc_request *req, int flags)
+{
+	struct ptlrpc_reply_state *rs = req->rq_reply_state;
+	struct ptlrpc_service_part *svcpt = rs->rs_svcpt;
+	struct ptlrpc_hr_partition *hrp;
+	struct ptlrpc_reply_bundle *rb;
+	struct ptlrpc_reply_bundle *new = NULL;
+	struct ptlrpc_bundle_ent *pbe;
+	unsigned int usec = svcpt->scp_service->srv_rep_bundle_usec;
+	unsigned int count;
+	unsigned int nob;
+	bool full;
+	int cpt;
+
+	if (usec == 0 || (flags & PTLRPC_REPLY_EARLY) || rs->rs_difficult)
+		return false;
+
+	if (req->rq_reqmsg == NULL ||
+	    !(lustre_msghdr_get_flags(req->rq_reqmsg) & MSGHDR_REPLY_BUNDLE))
+		return false;
+
+	if (rs->rs_repdata_len > PTLRPC_BUNDLE_REPLY_MAX)
+		return false;
+
+	/* replies to one client must meet in the same partition, so don't
+	 * rotate over partitions like ptlrpc_hr_select() does */
+	if (svcpt->scp_cpt >= 0 &&
+	    svcpt->scp_service->srv_cptable == ptlrpc_hr.hr_cpt_table)
+		cpt = svcpt->scp_cpt;
+	else
+		cpt = cfs_cpt_current(ptlrpc_hr.hr_cpt_table, 1);
+	hrp = ptlrpc_hr.hr_partitions[cpt];
+
+	nob = sizeof(*pbe) + cfs_size_round(rs->rs_repdata_len);
+again:
+	spin_lock(&hrp->hrp_bundle_lock);
+	list_for_each_entry(rb, &hrp->hrp_bundles, rb_list) {
+		if (rb->rb_peer.nid == req->rq_peer.nid &&
+		    rb->rb_peer.pid == req->rq_peer.pid &&
+		    rb->rb_self == req->rq_self)
+			goto found;
+	}
+
+	if (new == NULL) {
+		spin_unlock(&hrp->hrp_bundle_lock);
+		new = ptlrpc_reply_bundle_alloc(hrp, req, usec);
+		if (new == NULL)
+			return false;
+		goto again;
+	}
+
+	rb = new;
+	new = NULL;
+	list_add_tail(&rb->rb_list, &hrp->hrp_bundles);
+	if (!timer_pending(&hrp->hrp_bundle_timer))
+		mod_timer(&hrp->hrp_bundle_timer,
+			  jiffies + usecs_to_jiffies(usec) + 1);
+found:
+	LASSERT(rb->rb_nob + nob <= PTLRPC_BUNDLE_SIZE);
+	pbe = (struct ptlrpc_bundle_ent *)(rb->rb_buf + rb->rb_nob);
+	pbe->pbe_xid = req->rq_xid;
+	pbe->pbe_offset = req->rq_reply_off;
+	pbe->pbe_len = rs->rs_repdata_len;
+	memcpy(pbe + 1, rs->rs_repbuf, rs->rs_repdata_len);
+	rb->rb_nob += nob;
+	count = ++rb->rb_count;
+
+	/* no room for one more reply, don't wait for the deadline */
+	full = rb->rb_nob + sizeof(*pbe) + PTLRPC_BUNDLE_REPLY_MAX >
+	       PTLRPC_BUNDLE_SIZE;
+	if (full)
+		list_del_init(&rb->rb_list);
+	spin_unlock(&hrp->hrp_bundle_lock);
+
+	if (new != NULL)
+		ptlrpc_reply_bundle_free(new);
+
+	DEBUG_REQ(D_RPCTRACE, req, "reply bundled with %u others", count - 1);
+	if (likely(svcpt->scp_service->srv_stats != NULL))
+		lprocfs_counter_add(svcpt->scp_service->srv_stats,
+				    PTLRPC_REPLY_BUNDLE_CNTR, 1);
+
+	if (full)
+		ptlrpc_send_reply_bundle(rb);
+
+	return true;
+}
+
 
 /**
  * Put reply state into a queue for processing because we received
@@ -2858,7 +3039,8 @@ static int hrt_dont_sleep(struct ptlrpc_hr_thread *hrt,
 	spin_lock(&hrt->hrt_lock);
 
 	list_splice_init(&hrt->hrt_queue, replies);
-	result = ptlrpc_hr.hr_stopping || !list_empty(replies);
+	result = ptlrpc_hr.hr_stopping || !list_empty(replies) ||
+		 (hrt->hrt_id == 0 && hrt->hrt_partition->hrp_bundle_flush);
 
 	spin_unlock(&hrt->hrt_lock);
 	return result;
@@ -2908,6 +3090,9 @@ static int ptlrpc_hr_main(void *arg)
 	while (!ptlrpc_hr.hr_stopping) {
 		l_wait_condition(hrt->hrt_waitq, hrt_dont_sleep(hrt, &replies));
 
+		if (hrt->hrt_id == 0 && hrp->hrp_bundle_flush)
+			ptlrpc_hr_flush_bundles(hrp);
+
 		while (!list_empty(&replies)) {
 			struct ptlrpc_reply_state *rs;
 
@@ -3238,6 +3423,11 @@ int ptlrpc_hr_init(void)
 		atomic_set(&hrp->hrp_nstarted, 0);
 		atomic_set(&hrp->hrp_nstopped, 0);
 
+		spin_lock_init(&hrp->hrp_bundle_lock);
+		INIT_LIST_HEAD(&hrp->hrp_bundles);
+		cfs_timer_setup(&hrp->hrp_bundle_timer, ptlrpc_hr_bundle_timer,
+				(unsigned long)hrp, 0);
+
 		hrp->hrp_nthrs = cfs_cpt_weight(ptlrpc_hr.hr_cpt_table, cpt);
 		hrp->hrp_nthrs /= weight;
 		if (hrp->hrp_nthrs == 0)
@@ -3277,10 +3467,22 @@ void ptlrpc_hr_fini(void)
 	ptlrpc_stop_hr_threads();
 
 	cfs_percpt_for_each(hrp, cpt, ptlrpc_hr.hr_partitions) {
-		if (hrp->hrp_thrs != NULL) {
-			OBD_FREE(hrp->hrp_thrs,
-				 hrp->hrp_nthrs * sizeof(hrp->hrp_thrs[0]));
+		struct ptlrpc_reply_bundle *rb;
+
+		if (hrp->hrp_thrs == NULL)
+			continue; /* uninitialized */
+
+		/* all services are gone, and so is the network */
+		del_timer_sync(&hrp->hrp_bundle_timer);
+		while (!list_empty(&hrp->hrp_bundles)) {
+			rb = list_entry(hrp->hrp_bundles.next,
+					struct ptlrpc_reply_bundle, rb_list);
+			list_del(&rb->rb_list);
+			ptlrpc_reply_bundle_free(rb);
 		}
+
+		OBD_FREE(hrp->hrp_thrs,
+			 hrp->hrp_nthrs * sizeof(hrp->hrp_thrs[0]));
 	}
 
 	cfs_percpt_free(ptlrpc_hr.hr_partitions);
@@ -1959,6 +1959,47 @@ static int tgt_pages2shortio(struct niobuf_local *local, int npages,
 	return copied - size;
 }
 
+/*
+ * Generate the guards of a large bulk in parallel straight into lnb_guards,
+ * skipping the read pages whose guards came from disk already. Return 1 if
+ * the guards were generated, 0 if the caller has to generate them itself.
+ */
+static int tgt_dif_generate_niobuf(struct lu_target *tgt,
+				   struct niobuf_local *local_nb,
+				   int npages, int opc, obd_dif_csum_fn *fn,
+				   int sector_size)
+{
+	enum cksum_types t10_cksum_type = tgt->lut_dt_conf.ddp_t10_cksum_type;
+	struct obd_dif_page *odp;
+	int nr = 0;
+	int rc;
+	int i;
+
+	if (!obd_dif_parallel(npages))
+		return 0;
+
+	OBD_ALLOC_LARGE(odp, npages * sizeof(*odp));
+	if (odp == NULL)
+		return 0;
+
+	for (i = 0; i < npages; i++) {
+		if (t10_cksum_type && opc == OST_READ &&
+		    local_nb[i].lnb_guard_disk)
+			continue;
+
+		odp[nr].odp_page = local_nb[i].lnb_page;
+		odp[nr].odp_offset = local_nb[i].lnb_page_offset & ~PAGE_MASK;
+		odp[nr].odp_len = local_nb[i].lnb_len;
+		odp[nr].odp_guards = local_nb[i].lnb_guards;
+		nr++;
+	}
+
+	rc = obd_dif_generate_pages(tgt_name(tgt), odp, nr, sector_size, fn);
+	OBD_FREE_LARGE(odp, npages * sizeof(*odp));
+
+	return rc ?: 1;
+}
+
 static int tgt_checksum_niobuf_t10pi(struct lu_target *tgt,
 				     struct niobuf_local *local_nb,
 				     int npages, int opc,
@@ -1977,10 +2018,16 @@ static int tgt_checksum_niobuf_t10pi(struct lu_target *tgt,
 	int guard_number;
 	int used_number = 0;
 	__u32 cksum;
+	int precomputed;
 	int rc = 0;
 	int used;
 	int i;
 
+	precomputed = tgt_dif_generate_niobuf(tgt, local_nb, npages, opc, fn,
+					      sector_size);
+	if (precomputed < 0)
+		return precomputed;
+
 	__page = alloc_page(GFP_KERNEL);
 	if (__page == NULL)
 		return -ENOMEM;
@@ -2030,8 +2077,8 @@ static int tgt_checksum_niobuf_t10pi(struct lu_target *tgt,
 		 * The left guard number should be able to hold checksums of a
 		 * whole page
 		 */
-		if (t10_cksum_type && opc == OST_READ &&
-		    local_nb[i].lnb_guard_disk) {
+		if (precomputed || (t10_cksum_type && opc == OST_READ &&
+				    local_nb[i].lnb_guard_disk)) {
 			used = DIV_ROUND_UP(local_nb[i].lnb_len, sector_size);
 			if (used > (guard_number - used_number)) {
 				rc = -E2BIG;
@@ -2065,9 +2112,10 @@ static int tgt_checksum_niobuf_t10pi(struct lu_target *tgt,
 		if (t10_cksum_type && opc == OST_WRITE &&
 		    local_nb[i].lnb_len == PAGE_SIZE) {
 			local_nb[i].lnb_guard_rpc = 1;
-			memcpy(local_nb[i].lnb_guards,
-			       guard_start + used_number,
-			       used * sizeof(*local_nb[i].lnb_guards));
+			if (!precomputed)
+				memcpy(local_nb[i].lnb_guards,
+				       guard_start + used_number,
+				       used * sizeof(*local_nb[i].lnb_guards));
 		}
 
 		used_number += used;
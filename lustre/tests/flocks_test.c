@@ -40,6 +40,7 @@
 #include <sys/file.h>
 #include <sys/wait.h>
 #include <stdarg.h>
+#include <time.h>
 
 #define MAX_PATH_LENGTH 4096
 /**
@@ -587,6 +588,133 @@ int t5(int argc, char *argv[])
 
 }
 
+#define T6_USAGE							      \
+"usage: flocks_test 6 contenders held seconds file1\n"			      \
+"       contenders: number of processes locking file1\n"		      \
+"       held: write locks each process keeps on its own bytes\n"	      \
+"       seconds: how long to run\n"					      \
+"       file1: fcntl is called for this file\n"
+
+/* contenders share the bytes below, each has its own bytes above */
+#define T6_HOT_RANGE	64
+
+static int t6_contender(int fd, int idx, int held, int secs,
+			unsigned long long *ops)
+{
+	struct flock lock = {
+		.l_type = F_WRLCK,
+		.l_whence = SEEK_SET,
+		.l_len = 1,
+	};
+	time_t end;
+	int i;
+
+	/* every other byte, so that the held locks do not merge */
+	for (i = 0; i < held; i++) {
+		lock.l_start = T6_HOT_RANGE + 2 * ((off_t)idx * held + i);
+		if (t_fcntl(fd, F_SETLKW, &lock) < 0)
+			return -errno;
+	}
+
+	srandom(getpid());
+	*ops = 0;
+	end = time(NULL) + secs;
+	while (time(NULL) < end) {
+		lock.l_type = random() % 4 ? F_RDLCK : F_WRLCK;
+		lock.l_start = random() % (T6_HOT_RANGE - 8);
+		lock.l_len = 1 + random() % 8;
+		if (t_fcntl(fd, F_SETLKW, &lock) < 0)
+			return -errno;
+		lock.l_type = F_UNLCK;
+		if (t_fcntl(fd, F_SETLKW, &lock) < 0)
+			return -errno;
+		(*ops)++;
+	}
+
+	return 0;
+}
+
+/*
+ * Lock throughput with many contenders: each process holds \a held locks
+ * of its own and repeatedly locks and unlocks small ranges shared with
+ * the others. Prints the number of lock/unlock pairs per second.
+ */
+int t6(int argc, char *argv[])
+{
+	unsigned long long total = 0;
+	int contenders, held, secs;
+	int pipefd[2];
+	int rc = EXIT_SUCCESS;
+	int i;
+
+	if (argc != 6) {
+		fprintf(stderr, T6_USAGE);
+		return EXIT_FAILURE;
+	}
+
+	contenders = atoi(argv[2]);
+	held = atoi(argv[3]);
+	secs = atoi(argv[4]);
+	if (contenders <= 0 || held < 0 || secs <= 0) {
+		fprintf(stderr, T6_USAGE);
+		return EXIT_FAILURE;
+	}
+
+	if (pipe(pipefd) < 0) {
+		perror("pipe");
+		return EXIT_FAILURE;
+	}
+
+	for (i = 0; i < contenders; i++) {
+		unsigned long long ops = 0;
+		pid_t pid;
+		int fd;
+
+		pid = fork();
+		if (pid < 0) {
+			perror("fork");
+			rc = EXIT_FAILURE;
+			break;
+		}
+		if (pid > 0)
+			continue;
+
+		close(pipefd[0]);
+		fd = open(argv[5], O_RDWR);
+		if (fd < 0) {
+			fprintf(stderr, "Couldn't open file '%s': %s\n",
+				argv[5], strerror(errno));
+			exit(EXIT_FAILURE);
+		}
+		rc = t6_contender(fd, i, held, secs, &ops);
+		if (rc < 0)
+			fprintf(stderr, "%d: fcntl failed: %s\n", getpid(),
+				strerror(-rc));
+		close(fd);
+		if (write(pipefd[1], &ops, sizeof(ops)) != sizeof(ops))
+			rc = -EIO;
+		exit(rc < 0 ? EXIT_FAILURE : EXIT_SUCCESS);
+	}
+	close(pipefd[1]);
+
+	while (1) {
+		unsigned long long ops;
+		int status;
+
+		if (read(pipefd[0], &ops, sizeof(ops)) == sizeof(ops))
+			total += ops;
+		if (wait(&status) < 0)
+			break;
+		if (!WIFEXITED(status) || WEXITSTATUS(status) != 0)
+			rc = EXIT_FAILURE;
+	}
+	close(pipefd[0]);
+
+	printf("contenders %d held %d: %llu lock/unlock in %d s, %llu/s\n",
+	       contenders, held, total, secs, total / secs);
+	return rc;
+}
+
 /** ==============================================================
  * program entry
  */
@@ -621,6 +749,9 @@ int main(int argc, char *argv[])
 	case 5:
 		rc = t5(argc, argv);
 		break;
+	case 6:
+		rc = t6(argc, argv);
+		break;
 	default:
 		fprintf(stderr, "unknown test number '%s'\n", argv[1]);
 		break;
@@ -0,0 +1,478 @@
+/*
+ * GPL HEADER START
+ *
+ * DO NOT ALTER OR REMOVE COPYRIGHT NOTICES OR THIS FILE HEADER.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 only,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License version 2 for more details (a copy is included
+ * in the LICENSE file that accompanied this code).
+ *
+ * You should have received a copy of the GNU General Public License
+ * version 2 along with this program; If not, see
+ * http://www.gnu.org/licenses/gpl-2.0.html
+ *
+ * GPL HEADER END
+ */
+/*
+ * This file is part of Lustre, http://www.lustre.org/
+ *
+ * lustre/tests/interval_tree_test.c
+ *
+ * Userspace unit test and benchmark for the interval tree library used by
+ * the ldlm extent lock code. The library source is built directly into this
+ * program, so no Lustre mount is needed.
+ *
+ * Without -b, random inserts and erases are checked against the red-black
+ * and augmentation invariants, and every lookup is compared with a linear
+ * scan of the nodes in the tree. With -b, conflict lookups against a single
+ * tree tagged with lock modes are timed against the same lookups done on one
+ * tree per mode.
+ */
+
+#include <assert.h>
+#include <errno.h>
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <stddef.h>
+#include <time.h>
+#include <linux/types.h>
+
+/* shims for the kernel side of the library */
+#define _LUSTRE_DLM_H__
+#define ENTRY do {} while (0)
+#define EXIT do {} while (0)
+#define RETURN(rc) return (rc)
+#define LASSERT(e) assert(e)
+#define EXPORT_SYMBOL(sym) extern typeof(sym) sym
+#define container_of(ptr, type, member) \
+	((type *)((char *)(ptr) - offsetof(type, member)))
+
+#include "../ldlm/interval_tree.c"
+
+#define ERROR(fmt, ...)							\
+	fprintf(stderr, "%s: %s:%d: %s: " fmt "\n",			\
+		program_invocation_short_name, __FILE__, __LINE__,	\
+		__func__, ## __VA_ARGS__)
+
+#define ASSERTF(cond, fmt, ...)						\
+	do {								\
+		if (!(cond)) {						\
+			ERROR("assertion '%s' failed: " fmt,		\
+			      #cond, ## __VA_ARGS__);			\
+			exit(1);					\
+		}							\
+	} while (0)
+
+/* same layout as enum ldlm_mode */
+#define MODE_NUM	8
+#define MODE_EX		0x01
+#define MODE_PW		0x02
+#define MODE_PR		0x04
+#define MODE_GROUP	0x40
+
+struct test_node {
+	struct interval_node	tn_node;
+	int			tn_intree;
+};
+
+static struct test_node *nodes;
+static int node_count = 1000;
+static int loops = 10000;
+static __u64 extent_range = 1 << 16;
+static int insert_dup;
+
+static __u64 rand64(__u64 max)
+{
+	return (((__u64)random() << 31) | random()) % max;
+}
+
+static void random_extent(struct interval_node_extent *ext)
+{
+	__u64 a = rand64(extent_range);
+	__u64 b = rand64(extent_range);
+
+	/* a few whole-object extents, like glimpse and group locks */
+	if (random() % 16 == 0) {
+		ext->start = 0;
+		ext->end = ~0ULL;
+		return;
+	}
+	ext->start = a < b ? a : b;
+	ext->end = a < b ? b : a;
+}
+
+static __u16 random_mode(void)
+{
+	return 1 << (random() % MODE_NUM);
+}
+
+/* check the red-black properties and the max_high/max_mask augmentation,
+ * return the black height of the subtree */
+static int check_subtree(struct interval_node *node,
+			 struct interval_node *parent)
+{
+	__u64 max_high;
+	__u16 max_mask;
+	int lh, rh;
+
+	if (node == NULL)
+		return 1;
+
+	ASSERTF(node->in_parent == parent, "bad parent link");
+	ASSERTF(interval_is_intree(node), "node not marked in tree");
+	if (node_is_red(node))
+		ASSERTF(node_is_black_or_0(node->in_left) &&
+			node_is_black_or_0(node->in_right), "red-red link");
+	/* equal nodes may end up on either side after rotations */
+	if (node->in_left)
+		ASSERTF(node_compare(node->in_left, node) < insert_dup,
+			"bad order");
+	if (node->in_right)
+		ASSERTF(node_compare(node->in_right, node) > -insert_dup,
+			"bad order");
+
+	lh = check_subtree(node->in_left, node);
+	rh = check_subtree(node->in_right, node);
+	ASSERTF(lh == rh, "black height %d != %d", lh, rh);
+
+	max_high = interval_high(node);
+	max_mask = node->in_mask;
+	if (node->in_left) {
+		max_high = max_u64(max_high, node->in_left->in_max_high);
+		max_mask |= node->in_left->in_max_mask;
+	}
+	if (node->in_right) {
+		max_high = max_u64(max_high, node->in_right->in_max_high);
+		max_mask |= node->in_right->in_max_mask;
+	}
+	ASSERTF(node->in_max_high == max_high, "max_high %llu != %llu",
+		(unsigned long long)node->in_max_high,
+		(unsigned long long)max_high);
+	ASSERTF(node->in_max_mask == max_mask, "max_mask %#x != %#x",
+		node->in_max_mask, max_mask);
+
+	return lh + node_is_black(node);
+}
+
+static void check_tree(struct interval_node *root)
+{
+	if (root == NULL)
+		return;
+	ASSERTF(node_is_black(root), "red root");
+	check_subtree(root, NULL);
+}
+
+static inline struct test_node *to_test_node(struct interval_node *n)
+{
+	return container_of(n, struct test_node, tn_node);
+}
+
+struct search_data {
+	int		 sd_count;
+	__u64		 sd_last;	/* last start for the reverse walk */
+	__u16		 sd_mask;
+	int		*sd_seen;
+};
+
+static enum interval_iter search_cb(struct interval_node *n, void *args)
+{
+	struct search_data *sd = args;
+	int idx = to_test_node(n) - nodes;
+
+	ASSERTF(node_match(n, sd->sd_mask), "mode %#x not in %#x",
+		n->in_mask, sd->sd_mask);
+	ASSERTF(sd->sd_seen[idx] == 0, "node %d reported twice", idx);
+	sd->sd_seen[idx] = 1;
+	sd->sd_count++;
+	return INTERVAL_ITER_CONT;
+}
+
+static enum interval_iter reverse_cb(struct interval_node *n, void *args)
+{
+	struct search_data *sd = args;
+
+	ASSERTF(interval_low(n) <= sd->sd_last, "reverse walk out of order");
+	sd->sd_last = interval_low(n);
+	return search_cb(n, args);
+}
+
+static void check_lookups(struct interval_node *root, int *seen)
+{
+	struct interval_node_extent ext;
+	struct search_data sd;
+	__u64 expect_start;
+	__u64 expect_end;
+	int expect;
+	int i;
+
+	random_extent(&ext);
+	memset(&sd, 0, sizeof(sd));
+	sd.sd_seen = seen;
+	/* 0 is "all modes", otherwise a few modes as a conflict mask would */
+	sd.sd_mask = random() % 4 == 0 ? 0 : random() & 0xff;
+
+	memset(seen, 0, sizeof(*seen) * node_count);
+	interval_search_mask(root, &ext, sd.sd_mask, search_cb, &sd);
+	for (i = 0, expect = 0; i < node_count; i++) {
+		struct interval_node *n = &nodes[i].tn_node;
+		int hit = nodes[i].tn_intree && node_match(n, sd.sd_mask) &&
+			  extent_overlapped(&ext, &n->in_extent);
+
+		ASSERTF(hit == seen[i], "node %d [%llu, %llu] mode %#x: "
+			"search %d, scan %d", i,
+			(unsigned long long)interval_low(n),
+			(unsigned long long)interval_high(n), n->in_mask,
+			seen[i], hit);
+		expect += hit;
+	}
+	ASSERTF(sd.sd_count == expect, "%d found, %d expected",
+		sd.sd_count, expect);
+	ASSERTF(interval_is_overlapped_mask(root, &ext, sd.sd_mask) ==
+		(expect != 0), "is_overlapped mismatch");
+
+	/* reverse walk visits each tagged node once, by decreasing start */
+	memset(seen, 0, sizeof(*seen) * node_count);
+	sd.sd_count = 0;
+	sd.sd_last = ~0ULL;
+	interval_iterate_reverse_mask(root, sd.sd_mask, reverse_cb, &sd);
+	for (i = 0, expect = 0; i < node_count; i++)
+		expect += nodes[i].tn_intree &&
+			  node_match(&nodes[i].tn_node, sd.sd_mask);
+	ASSERTF(sd.sd_count == expect, "reverse walk %d, expected %d",
+		sd.sd_count, expect);
+
+	/* expansion stops right before the next tagged node */
+	if (interval_is_overlapped_mask(root, &ext, sd.sd_mask))
+		return;
+	expect_start = expect ? ext.start : 0;
+	expect_end = ~0ULL;
+	for (i = 0; i < node_count; i++) {
+		struct interval_node *n = &nodes[i].tn_node;
+
+		if (nodes[i].tn_intree && node_match(n, sd.sd_mask) &&
+		    interval_low(n) > ext.end)
+			expect_end = min_u64(expect_end, interval_low(n) - 1);
+	}
+	interval_expand_mask(root, &ext, NULL, sd.sd_mask);
+	ASSERTF(ext.start == expect_start && ext.end == expect_end,
+		"expanded to [%llu, %llu], expected [%llu, %llu]",
+		(unsigned long long)ext.start, (unsigned long long)ext.end,
+		(unsigned long long)expect_start,
+		(unsigned long long)expect_end);
+}
+
+static int run_unit_test(void)
+{
+	struct interval_node *root = NULL;
+	int *seen;
+	int in_tree = 0;
+	int i;
+
+	seen = calloc(node_count, sizeof(*seen));
+	if (seen == NULL)
+		return -ENOMEM;
+
+	for (i = 0; i < loops; i++) {
+		struct test_node *tn = &nodes[random() % node_count];
+		struct interval_node_extent ext;
+
+		if (tn->tn_intree) {
+			interval_erase(&tn->tn_node, &root);
+			tn->tn_intree = 0;
+			in_tree--;
+		} else {
+			random_extent(&ext);
+			interval_init(&tn->tn_node);
+			interval_set(&tn->tn_node, ext.start, ext.end);
+			interval_set_mask(&tn->tn_node, random_mode());
+			if (insert_dup) {
+				/* one node per object, like flock locks */
+				interval_insert_dup(&tn->tn_node, &root);
+				tn->tn_intree = 1;
+				in_tree++;
+			} else if (interval_insert(&tn->tn_node,
+						   &root) == NULL) {
+				/* otherwise equal extent and mode are
+				 * grouped by the caller */
+				tn->tn_intree = 1;
+				in_tree++;
+			}
+		}
+
+		check_tree(root);
+		check_lookups(root, seen);
+	}
+
+	printf("unit test: %d operations, %d nodes left in tree\n",
+	       loops, in_tree);
+	free(seen);
+	return 0;
+}
+
+static enum interval_iter count_cb(struct interval_node *n, void *args)
+{
+	(*(int *)args)++;
+	return INTERVAL_ITER_CONT;
+}
+
+static double elapsed_ns(struct timespec *start, struct timespec *end)
+{
+	return (end->tv_sec - start->tv_sec) * 1e9 +
+	       (end->tv_nsec - start->tv_nsec);
+}
+
+/*
+ * A shared object: mostly PR locks from readers, some PW locks from
+ * writers, and a handful of other modes. Each query looks for the locks
+ * conflicting with a PW request, i.e. everything but NL.
+ */
+static int run_benchmark(void)
+{
+	struct interval_node *split[MODE_NUM] = { NULL };
+	struct interval_node *root = NULL;
+	struct test_node *copy;
+	struct interval_node_extent *queries;
+	struct timespec start, end;
+	__u16 conflict = 0xff & ~0x20;
+	int found_split = 0;
+	int found_mask = 0;
+	int i, m;
+
+	copy = calloc(node_count, sizeof(*copy));
+	queries = calloc(loops, sizeof(*queries));
+	if (copy == NULL || queries == NULL)
+		return -ENOMEM;
+
+	for (i = 0; i < node_count; i++) {
+		struct interval_node_extent ext;
+		int r = random() % 100;
+		__u16 mode = r < 80 ? MODE_PR : r < 95 ? MODE_PW :
+			     random_mode();
+
+		/* short extents, about two locks deep on average */
+		ext.start = rand64(extent_range);
+		ext.end = ext.start + rand64(extent_range / node_count * 4);
+		interval_set(&nodes[i].tn_node, ext.start, ext.end);
+		interval_set_mask(&nodes[i].tn_node, mode);
+		interval_set(&copy[i].tn_node, ext.start, ext.end);
+		interval_set_mask(&copy[i].tn_node, mode);
+	}
+	for (i = 0; i < loops; i++) {
+		__u64 s = rand64(extent_range);
+
+		queries[i].start = s;
+		queries[i].end = s + rand64(extent_range / node_count * 4);
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (i = 0; i < node_count; i++)
+		interval_insert(&nodes[i].tn_node, &root);
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	printf("single tree: insert %8.1f ns/lock\n",
+	       elapsed_ns(&start, &end) / node_count);
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (i = 0; i < node_count; i++)
+		interval_insert(&copy[i].tn_node,
+				&split[ffs(copy[i].tn_node.in_mask) - 1]);
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	printf("per-mode trees: insert %8.1f ns/lock\n",
+	       elapsed_ns(&start, &end) / node_count);
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (i = 0; i < loops; i++)
+		interval_search_mask(root, &queries[i], conflict, count_cb,
+				     &found_mask);
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	printf("single tree: lookup %8.1f ns/query, %d conflicts\n",
+	       elapsed_ns(&start, &end) / loops, found_mask);
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (i = 0; i < loops; i++) {
+		for (m = 0; m < MODE_NUM; m++) {
+			if (split[m] == NULL || !((1 << m) & conflict))
+				continue;
+			interval_search(split[m], &queries[i], count_cb,
+					&found_split);
+		}
+	}
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	printf("per-mode trees: lookup %8.1f ns/query, %d conflicts\n",
+	       elapsed_ns(&start, &end) / loops, found_split);
+
+	free(queries);
+	free(copy);
+
+	if (found_mask != found_split) {
+		ERROR("single tree found %d conflicts, per-mode trees %d",
+		      found_mask, found_split);
+		return -EINVAL;
+	}
+	return 0;
+}
+
+static void usage(char *prog)
+{
+	fprintf(stderr,
+		"usage: %s [-b] [-d] [-n nodes] [-l loops] [-r range] [-s seed]\n"
+		"\t-b: run the benchmark instead of the unit test\n"
+		"\t-d: insert duplicate nodes instead of grouping them\n",
+		prog);
+	exit(EXIT_FAILURE);
+}
+
+int main(int argc, char *argv[])
+{
+	unsigned int seed = time(NULL);
+	int bench = 0;
+	int rc;
+	int c;
+
+	while ((c = getopt(argc, argv, "bdn:l:r:s:")) != -1) {
+		switch (c) {
+		case 'b':
+			bench = 1;
+			break;
+		case 'd':
+			insert_dup = 1;
+			break;
+		case 'n':
+			node_count = atoi(optarg);
+			break;
+		case 'l':
+			loops = atoi(optarg);
+			break;
+		case 'r':
+			extent_range = strtoull(optarg, NULL, 0);
+			break;
+		case 's':
+			seed = strtoul(optarg, NULL, 0);
+			break;
+		default:
+			usage(argv[0]);
+		}
+	}
+	if (node_count <= 0 || loops <= 0 || extent_range < 64)
+		usage(argv[0]);
+
+	printf("seed %u, %d nodes, %d loops\n", seed, node_count, loops);
+	srandom(seed);
+
+	nodes = calloc(node_count, sizeof(*nodes));
+	if (nodes == NULL)
+		return EXIT_FAILURE;
+
+	rc = bench ? run_benchmark() : run_unit_test();
+	free(nodes);
+
+	return rc == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -189,6 +189,208 @@ test_smoke () {
 }
 run_test smoke "lst regression test"
 
+# brw write throughput of one batch, as reported by "lst stat"
+lst_brw_rate () {
+	local servers=$1
+	local clients=$2
+	local size=$3
+	local duration=$4
+
+	export LST_SESSION=$$
+
+	$LST new_session --timeo 100000 batch_rate > /dev/null
+	$LST add_group c $(nids_list $clients) > /dev/null
+	$LST add_group s $(nids_list $servers) > /dev/null
+	$LST add_batch b > /dev/null
+	$LST add_test --batch b --loop -1 --concurrency 8 \
+		--from c --to s brw write size=$size > /dev/null
+	$LST run b > /dev/null
+	sleep $duration
+	$LST stat --bw --count 1 --delay $duration s | awk '/^\[W\] Avg:/ {
+		print $3; exit }'
+	$LST end_session > /dev/null
+}
+
+# value of field $1 in the summary line of "lst stat --lat" saved in $2
+lst_lat_field () {
+	awk -v field="$1:" '/p99:/ {
+		for (i = 1; i < NF; i++)
+			if ($i == field) {
+				print $(i + 1)
+				exit
+			}
+	}' $2
+}
+
+# p99 latency in usec of 4k brw writes issued at a fixed rate
+lst_brw_p99 () {
+	local servers=$1
+	local clients=$2
+	local duration=$3
+	local log=$TMP/lst_brw_p99.log
+
+	export LST_SESSION=$$
+
+	$LST new_session --timeo 100000 brw_p99 > /dev/null
+	$LST add_group c $(nids_list $clients) > /dev/null
+	$LST add_group s $(nids_list $servers) > /dev/null
+	$LST add_batch b > /dev/null
+	$LST add_test --batch b --loop -1 --concurrency 8 --rate 1000 \
+		--from c --to s brw write size=4k > /dev/null
+	$LST run b > /dev/null
+	# drop the warm-up samples
+	sleep 5
+	$LST stat --lat --count 1 c > /dev/null
+	sleep $duration
+	$LST stat --lat --count 1 c > $log
+	$LST end_session > /dev/null
+	lst_lat_field p99 $log
+}
+
+# sum of the ksocklnd batched receive counter over nodes $1
+socklnd_rx_batched () {
+	do_nodes $1 "cat /sys/module/ksocklnd/parameters/rx_batched" |
+		awk '{ sum += $NF } END { print sum + 0 }'
+}
+
+test_socklnd_batch () {
+	[[ $NETTYPE == tcp* ]] || skip "socklnd batching needs a tcp network"
+
+	local param=/sys/module/ksocklnd/parameters/rx_batch
+	local nodes=$(comma_list $(all_nodes))
+	local saved
+	local node
+
+	do_nodes $nodes "[ -w $param ] && [ -r ${param}ed ]" ||
+		skip "no ksocklnd rx_batch support"
+
+	lst_prepare
+
+	for node in $(all_nodes); do
+		saved=$(do_node $node cat $param)
+		stack_trap "do_node $node 'echo $saved > $param'" EXIT
+	done
+
+	local batch=$(do_facet mds1 cat $param)
+	local before
+	local batched1
+	local batchedN
+	local rate1
+	local rateN
+
+	(( batch > 1 )) || batch=8
+
+	do_nodes $nodes "echo 1 > $param"
+	before=$(socklnd_rx_batched $nodes)
+	rate1=$(lst_brw_rate $lst_SERVERS $lst_CLIENTS 1M 20)
+	batched1=$(( $(socklnd_rx_batched $nodes) - before ))
+
+	do_nodes $nodes "echo $batch > $param"
+	before=$(socklnd_rx_batched $nodes)
+	rateN=$(lst_brw_rate $lst_SERVERS $lst_CLIENTS 1M 20)
+	batchedN=$(( $(socklnd_rx_batched $nodes) - before ))
+
+	echo "brw write 1M: rx_batch=1 $rate1 MiB/s $batched1 batched," \
+	     "rx_batch=$batch $rateN MiB/s $batchedN batched"
+	[[ -n "$rate1" && -n "$rateN" ]] || error "no brw throughput reported"
+	(( batched1 == 0 )) ||
+		error "rx_batch=1 still batched $batched1 receives"
+	(( batchedN > 0 )) ||
+		error "rx_batch=$batch batched no receives"
+
+	lst_cleanup_all
+}
+run_test socklnd_batch "socklnd batched receive brw benchmark"
+
+test_peer_churn () {
+	$LST help add_test 2>&1 | grep -q -- --rate ||
+		skip "lst has no open-loop rate support"
+
+	local nodes=$(comma_list $(all_nodes))
+	local lnetctl=$(do_facet mds1 which lnetctl 2> /dev/null)
+	local nids=$(nids_list $lst_SERVERS)
+
+	[ -n "$lnetctl" ] || skip_env "lnetctl is not installed"
+
+	lst_prepare
+
+	local discovery=$(do_facet mds1 $lnetctl global show |
+			  awk '/discovery:/ { print $2 }')
+	local p99_idle
+	local p99_churn
+
+	p99_idle=$(lst_brw_p99 $lst_SERVERS $lst_CLIENTS 10)
+
+	stack_trap "do_nodes $nodes '$lnetctl set discovery ${discovery:-1}'" \
+		EXIT
+	# rediscover every server and re-push our ping buffer as fast as
+	# possible while brw traffic runs, so that discovery keeps taking
+	# the peer tables exclusively under the message fast path. The loop
+	# ends by itself on the remote nodes, after the brw run below.
+	do_nodes $nodes "end=\$((\$(date +%s) + 30))
+		while [ \$(date +%s) -lt \$end ]; do
+			$lnetctl discover ${nids// /,} > /dev/null 2>&1
+			$lnetctl set discovery 0 > /dev/null 2>&1
+			$lnetctl set discovery 1 > /dev/null 2>&1
+		done" &
+	local churn=$!
+
+	p99_churn=$(lst_brw_p99 $lst_SERVERS $lst_CLIENTS 10)
+	wait $churn
+
+	echo "brw write 4k p99: idle $p99_idle usec, churn $p99_churn usec"
+	[[ -n "$p99_idle" && -n "$p99_churn" ]] ||
+		error "no brw latency reported"
+	# the fast path must not stall behind discovery, the margin is wide
+	# as the latency of busy VMs is noisy
+	awk -v idle=$p99_idle -v churn=$p99_churn \
+		'BEGIN { exit !(churn <= idle * 20 + 20000) }' ||
+		error "brw p99 latency $p99_churn usec under churn, $p99_idle idle"
+
+	lst_cleanup_all
+}
+run_test peer_churn "brw traffic under concurrent peer discovery churn"
+
+test_latency () {
+	$LST help add_test 2>&1 | grep -q -- --rate ||
+		skip "lst has no open-loop rate support"
+
+	lst_prepare
+
+	local log=$TMP/$tfile.log
+	local count
+	local late
+
+	export LST_SESSION=$$
+	$LST new_session --timeo 100000 latency > /dev/null
+	$LST add_group c $(nids_list $lst_CLIENTS) > /dev/null
+	$LST add_group s $(nids_list $lst_SERVERS) > /dev/null
+	$LST add_batch b > /dev/null
+	# open loop: each client issues 1000 RPC/s whatever the latency is
+	$LST add_test --batch b --loop -1 --concurrency 8 --rate 1000 \
+		--from c --to s brw write size=4k > /dev/null
+	$LST run b > /dev/null
+	sleep 10
+	# drop the warm-up samples, then collect a fresh 10 second window
+	$LST stat --lat --count 1 c > /dev/null
+	sleep 10
+	$LST stat --lat --count 1 c | tee $log
+	$LST end_session > /dev/null
+
+	grep -q "p99:" $log || error "no latency reported"
+	count=$(lst_lat_field count $log)
+	late=$(lst_lat_field late $log)
+	echo "RPCs released late by the pacer: $late of $count"
+	[[ -n "$count" && -n "$late" ]] || error "no late count reported"
+	# the pacer must keep up with 1000 RPC/s, or the percentiles are
+	# those of a closed loop
+	(( late * 100 <= count )) ||
+		error "$late of $count RPCs released late by the pacer"
+
+	lst_cleanup_all
+}
+run_test latency "lst open-loop latency percentiles"
+
 complete $SECONDS
 _restore_mount
 check_and_cleanup_lustre
@@ -20368,6 +20368,759 @@ test_420()
 }
 run_test 420 "clear SGID bit on non-directories for non-members"
 
+test_421() {
+	[[ $MDS1_VERSION -ge $(version_code 2.12.55) ]] ||
+		skip "Need MDS version at least 2.12.55"
+
+	local bufs=$(cat /sys/module/ptlrpc/parameters/reply_bundle_buffers \
+		     2>/dev/null)
+
+	[[ ${bufs:-0} -gt 0 ]] ||
+		skip "client has no reply_bundle_buffers posted"
+
+	local param="mds.MDS.mdt.reply_bundle_usec"
+	local old=$(do_facet mds1 $LCTL get_param -n $param)
+	local nfiles=1000
+
+	stack_trap "do_facet mds1 $LCTL set_param $param=$old" EXIT
+	do_facet mds1 $LCTL set_param $param=500 ||
+		error "cannot set $param"
+
+	test_mkdir $DIR/$tdir
+	createmany -o $DIR/$tdir/$tfile- $nfiles ||
+		error "createmany failed"
+	cancel_lru_locks mdc
+	do_facet mds1 $LCTL set_param -n mds.MDS.mdt.stats=clear
+
+	# many concurrent getattrs produce small replies to this client
+	for i in $(seq 8); do
+		ls -l $DIR/$tdir > /dev/null &
+	done
+	wait
+
+	local count=$(ls $DIR/$tdir | wc -l)
+
+	[[ $count -eq $nfiles ]] ||
+		error "found $count files, expected $nfiles"
+
+	local bundled=$(do_facet mds1 $LCTL get_param -n mds.MDS.mdt.stats |
+			awk '/^reply_bundled/ { print $2 }')
+
+	echo "$bundled replies were bundled"
+	[[ ${bundled:-0} -gt 0 ]] || error "no reply was bundled"
+	unlinkmany $DIR/$tdir/$tfile- $nfiles || error "unlinkmany failed"
+}
+run_test 421 "metadata operations with reply bundling enabled"
+
+test_422() {
+	local mdc=$($LCTL list_param mdc.$FSNAME-MDT0000-mdc-* 2>/dev/null |
+		    head -n1)
+
+	[[ -n "$mdc" ]] || skip "no MDT0000 mdc device"
+	$LCTL get_param -n $mdc.intent_dedup_stats > /dev/null 2>&1 ||
+		skip "client does not support intent deduplication"
+
+	local old=$($LCTL get_param -n $mdc.intent_dedup)
+
+	stack_trap "$LCTL set_param $mdc.intent_dedup=$old" EXIT
+	$LCTL set_param $mdc.intent_dedup=1
+
+	$LFS mkdir -i 0 $DIR/$tdir || error "mkdir $tdir failed"
+	touch $DIR/$tdir/$tfile || error "touch $tfile failed"
+	cancel_lru_locks mdc
+	$LCTL set_param $mdc.intent_dedup_stats=clear
+
+	# hold the first getattr intent on the MDS so the others queue up
+	#define OBD_FAIL_MDS_INTENT_DELAY	0x160
+	do_facet mds1 $LCTL set_param fail_loc=0x80000160
+	for i in $(seq 8); do
+		stat $DIR/$tdir/$tfile > /dev/null &
+	done
+	wait
+	do_facet mds1 $LCTL set_param fail_loc=0
+
+	local stats=$($LCTL get_param -n $mdc.intent_dedup_stats)
+	local waits=$(awk '/^waits:/ { print $2 }' <<< "$stats")
+	local hits=$(awk '/^hits:/ { print $2 }' <<< "$stats")
+
+	echo "$stats"
+	(( waits > 0 )) || error "no getattr waited for the one in flight"
+	(( hits > 0 )) || error "no getattr shared the granted lock"
+}
+run_test 422 "concurrent getattr of one file share a single intent RPC"
+
+test_423() {
+	$LCTL get_param -n ptlrpcd_stats > /dev/null 2>&1 ||
+		skip "client does not have ptlrpcd_stats"
+
+	$LCTL set_param ptlrpcd_stats=clear
+	$LFS setstripe -c -1 $DIR/$tfile || error "setstripe $tfile failed"
+	dd if=/dev/zero of=$DIR/$tfile bs=1M count=64 ||
+		error "dd to $tfile failed"
+	cancel_lru_locks osc
+
+	local stats=$($LCTL get_param -n ptlrpcd_stats)
+	local reqs=$(awk '/^ *[0-9]+: / { sum += $2 } END { print sum + 0 }' \
+		     <<< "$stats")
+
+	echo "$stats" | head -n 20
+	(( reqs > 0 )) || error "no request latency recorded by ptlrpcd"
+	$LCTL get_param -n ptlrpcd_stats | grep -q "stolen:" ||
+		error "no work stealing counter"
+}
+run_test 423 "ptlrpcd records per-thread queue latency"
+
+test_424() {
+	$LCTL get_param -n req_layout_bench > /dev/null 2>&1 ||
+		skip "no req_layout_bench support"
+
+	$LCTL set_param req_layout_bench=1000 ||
+		error "req_layout_bench failed"
+
+	local out=$($LCTL get_param -n req_layout_bench)
+
+	echo "$out" | grep -E "^(iterations|format|MDS_GETATTR |OST_BRW_)"
+	echo "$out" | grep -q "^iterations: 1000$" ||
+		error "benchmark did not run"
+	echo "$out" | awk '/^MDS_GETATTR / { found = $2 + $3 > 0 }
+			   END { exit !found }' ||
+		error "no MDS_GETATTR field lookup timing"
+}
+run_test 424 "capsule field lookup microbenchmark per request format"
+
+test_425() {
+	[ $PARALLEL == "yes" ] && skip "skip parallel run"
+	$GSS && skip_env "could not run with gss"
+
+	local param=/sys/module/obdclass/parameters/obd_dif_parallel_pages
+	local algo
+
+	[ -f $param ] || skip "no parallel T10-PI guard support"
+	echo "$CKSUM_TYPES" | grep -q t10 || skip "no T10-PI checksum types"
+
+	local old=$(cat $param)
+
+	stack_trap "echo $old > $param" EXIT
+	# force guards of every 1MB RPC through the worker threads
+	echo 32 > $param
+
+	[ ! -f $F77_TMP ] && setup_f77
+	set_checksums 1
+	stack_trap "set_checksums 0; set_checksum_type $ORIG_CSUM_TYPE" EXIT
+	for algo in $CKSUM_TYPES; do
+		[[ $algo == t10* ]] || continue
+		set_checksum_type $algo
+		dd if=$F77_TMP of=$DIR/$tfile bs=1M count=$F77SZ oflag=direct ||
+			error "dd write with $algo failed"
+		cancel_lru_locks osc
+		cmp $F77_TMP $DIR/$tfile || error "compare with $algo failed"
+	done
+	rm -f $DIR/$tfile
+}
+run_test 425 "T10-PI bulk checksums generated in parallel"
+
+test_426() {
+	local lnetctl=$(which lnetctl 2> /dev/null)
+
+	[ -n "$lnetctl" ] || skip_env "lnetctl is not installed"
+	$lnetctl stats show | grep -q peer_credit_fast ||
+		skip "no LNet lock statistics"
+
+	local before=$($lnetctl stats show |
+		       awk '/peer_credit_fast/ { print $2 }')
+
+	dd if=/dev/zero of=$DIR/$tfile bs=1M count=16 oflag=direct ||
+		error "dd failed"
+	cancel_lru_locks osc
+
+	local after=$($lnetctl stats show |
+		      awk '/peer_credit_fast/ { print $2 }')
+
+	$lnetctl stats show | grep -E "contended|peer_credit"
+	# only remote peers take credits
+	if [ $(facet_active_host ost1) != $HOSTNAME ]; then
+		(( after > before )) ||
+			error "peer credits not taken on the fast path"
+	fi
+	rm -f $DIR/$tfile
+}
+run_test 426 "LNet lock contention and credit fast path statistics"
+
+test_427() {
+	$LCTL get_param -n match_bench > /dev/null 2>&1 ||
+		skip "no LNet match_bench support"
+
+	local nmes
+
+	for nmes in 256 4096 65536; do
+		$LCTL set_param match_bench=$nmes ||
+			error "match_bench with $nmes MEs failed"
+		$LCTL get_param -n match_bench
+	done
+
+	local out=$($LCTL get_param -n match_bench)
+
+	echo "$out" | grep -q "^mes: 65536$" || error "benchmark did not run"
+	# the grown table must not be slower than the fixed 256 chains
+	echo "$out" | awk '/^unique/ { ns[n++] = $3 }
+			   END { exit !(n == 2 && ns[1] <= ns[0]) }' ||
+		error "grown match table is slower"
+}
+run_test 427 "LNet ME lookup cost against the number of posted MEs"
+
+test_428() {
+	$LCTL --net tcp conn_list 2>/dev/null | grep -q "stripe" ||
+		skip "no socklnd connections with striping stats"
+
+	local cpp=$(cat /sys/module/ksocklnd/parameters/conns_per_peer)
+	local before=$($LCTL --net tcp conn_list |
+		awk '{ split($(NF - 2), tx, "/"); sum += tx[2] } END { print sum }')
+
+	dd if=/dev/zero of=$DIR/$tfile bs=1M count=64 oflag=direct ||
+		error "dd write failed"
+
+	local out=$($LCTL --net tcp conn_list)
+	local after=$(echo "$out" |
+		awk '{ split($(NF - 2), tx, "/"); sum += tx[2] } END { print sum }')
+
+	echo "$out"
+	(( after > before )) ||
+		error "tx bytes did not grow: $before -> $after"
+
+	# no peer may have more bulk conns of one type than conns_per_peer
+	echo "$out" | awk -v cpp=$cpp '$2 ~ /^[IO]\[/ {
+			split($2, a, "->"); split(a[2], r, ":")
+			n[$1 " " substr($2, 1, 1) " " r[1]]++ }
+		END { for (k in n) if (n[k] > cpp) exit 1 }' ||
+		error "more than $cpp bulk conns of one type to a peer"
+}
+run_test 428 "socklnd per-connection stats and bulk connection striping"
+
+test_429() {
+	local lnetctl=$(which lnetctl 2> /dev/null)
+	local param=/sys/module/lnet/parameters/auto_router_buffers
+
+	[ -n "$lnetctl" ] || skip_env "lnetctl is not installed"
+	[ -w $param ] || skip "no router buffer auto-sizing support"
+
+	local routing=$($lnetctl routing show | awk '/enable:/ { print $2 }')
+	local auto=$(cat $param)
+
+	if [[ "$routing" != 1 ]]; then
+		$lnetctl set routing 1 || error "cannot enable routing"
+		stack_trap "$lnetctl set routing 0" EXIT
+	fi
+	echo 1 > $param
+	stack_trap "echo $auto > $param" EXIT
+
+	$lnetctl routing show
+	$lnetctl routing show | grep -q "maxbuffers:" ||
+		error "no maxbuffers in routing show"
+	$lnetctl routing show | grep -q "blocked:" ||
+		error "no blocked count in routing show"
+	$LCTL get_param -n buffers | head -1 | grep -q blocked ||
+		error "no blocked column in buffers"
+
+	# an idle pool must never grow past its high water mark
+	sleep 5
+	$lnetctl routing show | awk '/nbuffers:/ { n = $2 }
+		/maxbuffers:/ { if (n > $2) exit 1 }' ||
+		error "pool larger than its high water mark"
+}
+run_test 429 "LNet router buffer pool auto-sizing stats"
+
+test_430() {
+	local lnetctl=$(which lnetctl 2> /dev/null)
+
+	[ -n "$lnetctl" ] || skip_env "lnetctl is not installed"
+	$lnetctl net set --help 2>&1 | grep -q selection ||
+		skip "no NI selection policy support"
+
+	local net=$($LCTL list_nids | head -1 | sed 's/.*@//')
+
+	[ -n "$net" ] || skip_env "no local LNet network"
+
+	$lnetctl net set --net $net --selection latency ||
+		error "cannot set latency selection on $net"
+	stack_trap "$lnetctl net set --net $net --selection default" EXIT
+	$lnetctl net show -v --net $net | grep -q "selection: latency" ||
+		error "$net selection policy is not latency"
+
+	$lnetctl net set --net $net --selection bogus &&
+		error "bogus selection policy accepted"
+
+	dd if=/dev/zero of=$DIR/$tfile bs=1M count=16 oflag=direct ||
+		error "write with latency selection failed"
+	cancel_lru_locks osc
+	dd if=$DIR/$tfile of=/dev/null bs=1M iflag=direct ||
+		error "read with latency selection failed"
+}
+run_test 430 "LNet latency aware NI selection policy"
+
+test_431() {
+	local lnetctl=$(which lnetctl 2> /dev/null)
+
+	[ -n "$lnetctl" ] || skip_env "lnetctl is not installed"
+	$lnetctl --list-commands | grep -qw trace ||
+		skip "no LNet message tracing support"
+
+	local sample=$($lnetctl global show |
+		       awk '/trace_sample:/ { print $2 }')
+	local dump=$TMP/$tfile.trace
+
+	[ -n "$sample" ] || error "trace_sample not in global show"
+	$lnetctl set trace_sample 1 || error "cannot trace every message"
+	stack_trap "$lnetctl set trace_sample $sample" EXIT
+	stack_trap "rm -f $dump" EXIT
+
+	dd if=/dev/zero of=$DIR/$tfile bs=1M count=4 oflag=direct ||
+		error "write failed"
+	cancel_lru_locks osc
+	dd if=$DIR/$tfile of=/dev/null bs=1M iflag=direct ||
+		error "read failed"
+
+	$lnetctl trace dump $dump || error "trace dump failed"
+	$lnetctl trace decode $dump | tee $TMP/$tfile.log
+	grep -q "from: send" $TMP/$tfile.log ||
+		error "no send traced"
+	grep -q "to: done" $TMP/$tfile.log ||
+		error "no completion traced"
+	$lnetctl trace decode --verbose $dump | grep -q "event: lnd_send" ||
+		error "no LND hand-off traced"
+
+	$lnetctl set trace_sample -1 && error "negative sample rate accepted"
+	return 0
+}
+run_test 431 "LNet message trace ring dump and decode"
+
+test_432() {
+	local lnetctl=$(which lnetctl 2> /dev/null)
+	local param=/sys/module/lnet/parameters/dynamic_peer_credits
+
+	[ -n "$lnetctl" ] || skip_env "lnetctl is not installed"
+	[ -w $param ] || skip "no dynamic peer credit support"
+
+	local dynamic=$(cat $param)
+
+	echo 1 > $param
+	stack_trap "echo $dynamic > $param" EXIT
+
+	dd if=/dev/zero of=$DIR/$tfile bs=1M count=32 oflag=direct ||
+		error "write failed"
+	sleep 2
+
+	$lnetctl peer show -v > $TMP/$tfile.log
+	stack_trap "rm -f $TMP/$tfile.log" EXIT
+	grep -q "allotted_tx_credits:" $TMP/$tfile.log ||
+		error "no allotted_tx_credits in peer show -v"
+	grep -q "tx_credit_demand:" $TMP/$tfile.log ||
+		error "no tx_credit_demand in peer show -v"
+
+	# no peer is ever left with less than the floor
+	awk '/allotted_tx_credits:/ { a = $2 }
+	     /floor_tx_credits:/ { if (a < $2) exit 1 }' $TMP/$tfile.log ||
+		error "peer allotted fewer credits than the floor"
+
+	echo 0 > $param
+	sleep 3
+	$lnetctl peer show -v | grep -q "allotted_tx_credits:" &&
+		error "allotment still shown with dynamic credits off"
+	return 0
+}
+run_test 432 "LNet dynamic peer tx credits"
+
+test_433() {
+	local param="ldlm.namespaces.mdt-*MDT0000*.ibits_bench"
+
+	do_facet mds1 $LCTL get_param -n $param > /dev/null 2>&1 ||
+		skip "no inodebits compatibility benchmark"
+
+	#define OBD_FAIL_LDLM_IBITS_BENCH	0x32d
+	do_facet mds1 $LCTL set_param fail_loc=0x32d
+	stack_trap "do_facet mds1 $LCTL set_param fail_loc=0" EXIT
+
+	local n
+	local out
+	local walk
+	local indexed
+
+	for n in 100 1000 10000; do
+		do_facet mds1 $LCTL set_param -n $param=$n ||
+			error "benchmark with $n locks failed"
+		out=$(do_facet mds1 $LCTL get_param -n $param)
+		echo "$out"
+		walk=$(echo $out | awk '{ print $4 }')
+		indexed=$(echo $out | awk '{ print $6 }')
+	done
+
+	# the indexed check must not depend on the number of locks which
+	# can't conflict, walking them does
+	(( indexed * 4 < walk )) ||
+		error "indexed check ($indexed ns) not faster than walk ($walk ns)"
+}
+run_test 433 "inodebits compatibility check on a hot resource"
+
+test_434() {
+	local ns=$($LCTL list_param ldlm.namespaces.*-MDT0000-mdc-* |
+		   head -n 1)
+
+	$LCTL get_param -n $ns.lru_cancel_policy > /dev/null 2>&1 ||
+		skip "no lru_cancel_policy support"
+
+	local old_size=$($LCTL get_param -n $ns.lru_size)
+	local old_policy=$($LCTL get_param -n $ns.lru_cancel_policy)
+	local stats
+	local reused
+	local once
+
+	stack_trap "$LCTL set_param $ns.lru_size=$old_size \
+		    $ns.lru_cancel_policy=$old_policy" EXIT
+
+	test_mkdir -c1 -i0 $DIR/$tdir.hot || error "mkdir hot failed"
+	test_mkdir -c1 -i0 $DIR/$tdir.cold || error "mkdir cold failed"
+	createmany -o $DIR/$tdir.hot/f 50 || error "create hot failed"
+	createmany -o $DIR/$tdir.cold/f 1000 || error "create cold failed"
+
+	$LCTL set_param $ns.lru_size=200 $ns.lru_cancel_policy=2q ||
+		error "cannot set 2q policy"
+	$LCTL set_param -n $ns.lru_size=clear
+	$LCTL set_param -n $ns.lru_stats=clear
+
+	# the hot set is used twice, the second time from the LRU
+	ls -l $DIR/$tdir.hot > /dev/null
+	ls -l $DIR/$tdir.hot > /dev/null
+	# a one-off scan much larger than the LRU
+	ls -l $DIR/$tdir.cold > /dev/null
+
+	stats=$($LCTL get_param -n $ns.lru_stats)
+	echo "$stats"
+	once=$(echo $stats | awk '{ print $10 }')
+	reused=$(echo $stats | awk '{ print $12 }')
+	(( once > 0 )) || error "scan did not cancel any lock"
+	(( reused == 0 )) || error "scan cancelled $reused reused locks"
+
+	# protected locks age out, even behind younger once-used locks,
+	# aged cancels are done by ELC at each create
+	local max_age=$($LCTL get_param -n $ns.lru_max_age)
+	local protected
+
+	stack_trap "$LCTL set_param -n $ns.lru_max_age=$max_age" EXIT
+	$LCTL set_param -n $ns.lru_max_age=1000
+	for i in $(seq 5); do
+		sleep 1.5
+		touch $DIR/$tdir.cold/young$i || error "touch young$i failed"
+	done
+	protected=$($LCTL get_param -n $ns.lru_stats | awk '{ print $14 }')
+	(( protected == 0 )) || error "$protected protected locks not aged out"
+	$LCTL set_param -n $ns.lru_max_age=$max_age
+
+	$LCTL set_param $ns.lru_cancel_policy=lru ||
+		error "cannot set lru policy"
+	[[ $($LCTL get_param -n $ns.lru_stats | awk '{ print $14 }') == 0 ]] ||
+		error "protected locks left with lru policy"
+	$LCTL set_param $ns.lru_cancel_policy=bogus &&
+		error "bogus policy accepted"
+
+	rm -rf $DIR/$tdir.hot $DIR/$tdir.cold
+}
+run_test 434 "2Q lock LRU keeps reused locks over a scan"
+
+test_435() {
+	local ns=$($LCTL list_param ldlm.namespaces.*-MDT0000-mdc-* |
+		   head -n 1)
+
+	$LCTL get_param -n $ns.resource_hash_stats > /dev/null 2>&1 ||
+		skip "no resource_hash_stats support"
+
+	local old_size=$($LCTL get_param -n $ns.lru_size)
+	local nr=5000
+	local before
+	local after
+
+	stack_trap "$LCTL set_param -n $ns.lru_size=$old_size" EXIT
+
+	test_mkdir -c1 -i0 $DIR/$tdir || error "mkdir failed"
+	createmany -o $DIR/$tdir/f $nr || error "create failed"
+
+	cancel_lru_locks mdc
+	$LCTL set_param -n $ns.lru_size=$((nr * 2))
+	before=$($LCTL get_param -n $ns.resource_hash_stats)
+	echo "before: $before"
+
+	ls -l $DIR/$tdir > /dev/null || error "ls failed"
+
+	after=$($LCTL get_param -n $ns.resource_hash_stats)
+	echo "after: $after"
+
+	local buckets=$(echo $after | awk '{ print $2 }')
+	local resources=$(echo $after | awk '{ print $4 }')
+	local creates=$(( $(echo $after | awk '{ print $8 }') -
+			  $(echo $before | awk '{ print $8 }') ))
+
+	(( resources >= nr )) ||
+		error "only $resources resources after stat of $nr files"
+	(( creates >= nr )) || error "only $creates resources created"
+	# the hash grows with the resources so chains stay short
+	(( resources <= buckets )) ||
+		error "$resources resources in $buckets buckets"
+
+	cancel_lru_locks mdc
+	rm -rf $DIR/$tdir
+}
+run_test 435 "ldlm resource hash resizes with the number of resources"
+
+test_436() {
+	local param="ldlm.namespaces.mdt-*MDT0000*.exports"
+
+	do_facet mds1 $LCTL get_param -n $param > /dev/null 2>&1 ||
+		skip "no ldlm exports support"
+	[[ $($LCTL get_param mdc.*.import) =~ connect_flags.*lock_budget ]] ||
+		skip "no lock budget support"
+
+	local ns=$($LCTL list_param ldlm.namespaces.*-MDT0000-mdc-* |
+		   head -n 1)
+	local old_size=$($LCTL get_param -n $ns.lru_size)
+	local nr=2000
+	local out
+	local locks
+	local budget
+
+	stack_trap "$LCTL set_param -n $ns.lru_size=$old_size" EXIT
+
+	test_mkdir -c1 -i0 $DIR/$tdir || error "mkdir failed"
+	createmany -o $DIR/$tdir/f $nr || error "create failed"
+
+	cancel_lru_locks mdc
+	# dynamic LRU, the client keeps what its budget allows
+	$LCTL set_param -n $ns.lru_size=0
+	ls -l $DIR/$tdir > /dev/null || error "ls failed"
+
+	out=$(do_facet mds1 $LCTL get_param -n $param)
+	echo "$out"
+	# the export of this mount is the one holding the most locks
+	read locks budget <<< $(echo "$out" |
+		awk '/locks:/ { l = $2 } /budget:/ { print l, $2 }' |
+		sort -n | tail -n 1)
+
+	(( locks >= nr )) || error "only $locks locks for $nr files"
+	(( budget >= locks )) ||
+		error "budget $budget below $locks locks without pressure"
+
+	$LCTL get_param $ns.pool.state | grep "B:" ||
+		error "no budget in client pool state"
+
+	# with the pool limit below what this client holds, the budget
+	# scale drops and the client has to shrink its LRU to its budget
+	local pool="ldlm.namespaces.mdt-*MDT0000*.pool"
+	local old_limit=$(do_facet mds1 $LCTL get_param -n $pool.limit |
+			  head -n 1)
+	local exports
+	local fair
+	local i
+
+	stack_trap "do_facet mds1 $LCTL set_param -n $pool.limit=$old_limit" \
+		EXIT
+	do_facet mds1 $LCTL set_param -n $pool.limit=$((nr / 2))
+
+	for ((i = 0; i < 60; i++)); do
+		# replies carry the budget to the client
+		$LFS df $MOUNT > /dev/null
+		sleep 2
+		locks=$($LCTL get_param -n $ns.lock_count)
+		budget=$($LCTL get_param -n $ns.pool.state |
+			 awk '/B:/ { print $2 }')
+		(( budget < nr && locks <= budget )) && break
+	done
+	echo "client holds $locks locks, budget $budget under pressure"
+	(( budget < nr )) || error "budget $budget not cut below $nr locks"
+	(( locks <= budget )) ||
+		error "client holds $locks locks over budget $budget"
+
+	# keep well within the fair share, reclaim must leave us alone
+	exports=$(do_facet mds1 $LCTL get_param -n $pool.state |
+		  awk '/BE:/ { print $2; exit }')
+	fair=$((nr / 2 / (exports > 0 ? exports : 1)))
+	$LCTL set_param -n $ns.lru_size=$((fair / 2))
+	sleep 5
+	locks=$($LCTL get_param -n $ns.lock_count)
+
+	#define OBD_FAIL_LDLM_WATERMARK_LOW     0x327
+	do_facet mds1 $LCTL set_param fail_loc=0x327 fail_val=1
+	stack_trap "do_facet mds1 $LCTL set_param fail_loc=0 fail_val=0" EXIT
+	touch $DIR/$tdir/m || error "touch failed"
+	sleep 5
+	do_facet mds1 $LCTL set_param fail_loc=0 fail_val=0
+
+	i=$($LCTL get_param -n $ns.lock_count)
+	(( i >= locks )) ||
+		error "reclaim revoked locks within budget: $locks -> $i"
+
+	cancel_lru_locks mdc
+	out=$(do_facet mds1 $LCTL get_param -n $param)
+	locks=$(echo "$out" | awk '/locks:/ { print $2 }' | sort -n |
+		tail -n 1)
+	(( locks < nr )) || error "$locks locks still counted after cancel"
+
+	rm -rf $DIR/$tdir
+}
+run_test 436 "ldlm per-client lock budgets"
+
+test_437() {
+	local param="llite.*.lockahead_auto_depth"
+
+	$LCTL get_param -n $param > /dev/null 2>&1 ||
+		skip "no automatic lockahead support"
+	[[ $($LCTL get_param osc.$FSNAME-OST0000*.import) =~ \
+		connect_flags.*lockahead ]] ||
+		skip "OST does not support lockahead"
+
+	local old_depth=$($LCTL get_param -n $param | head -n 1)
+	local file=$DIR/$tfile
+	local cmd="O"
+	local count
+	local i
+
+	stack_trap "$LCTL set_param -n $param=$old_depth" EXIT
+
+	# one 4k chunk every 8k, as two interleaved writers would do
+	for ((i = 0; i < 16; i++)); do
+		cmd+="w4096Z4096"
+	done
+	cmd+="c"
+
+	$LFS setstripe -c 1 -i 0 $file || error "setstripe failed"
+	$LCTL set_param -n $param=4
+	$LCTL set_param -n llite.*.stats=clear
+	$MULTIOP $file $cmd || error "strided write failed"
+	count=$($LCTL get_param -n llite.*.stats |
+		awk '/^lockahead_auto/ { sum += $2 } END { print sum + 0 }')
+	echo "locks requested ahead: $count"
+	(( count > 0 )) || error "no lock requested ahead of strided writes"
+
+	cancel_lru_locks osc
+	$LCTL set_param -n $param=0
+	$LCTL set_param -n llite.*.stats=clear
+	$MULTIOP $file $cmd || error "strided write failed"
+	count=$($LCTL get_param -n llite.*.stats |
+		awk '/^lockahead_auto/ { sum += $2 } END { print sum + 0 }')
+	(( count == 0 )) || error "$count locks requested ahead when disabled"
+
+	# sequential writes are left to the lock expansion
+	$LCTL set_param -n $param=4
+	$LCTL set_param -n llite.*.stats=clear
+	dd if=/dev/zero of=$file bs=4k count=64 conv=notrunc ||
+		error "sequential write failed"
+	count=$($LCTL get_param -n llite.*.stats |
+		awk '/^lockahead_auto/ { sum += $2 } END { print sum + 0 }')
+	(( count == 0 )) || error "$count locks requested ahead of sequential"
+
+	rm -f $file
+}
+run_test 437 "automatic lockahead for strided writers"
+
+test_438() {
+	which interval_tree_test > /dev/null 2>&1 ||
+		skip_env "no interval_tree_test program"
+
+	# randomized inserts, erases and lookups checked against a linear scan
+	interval_tree_test -n 1000 -l 20000 ||
+		error "interval tree unit test failed"
+	interval_tree_test -n 64 -l 50000 -r 512 ||
+		error "interval tree unit test with dense extents failed"
+	# one node per lock with duplicate extents, as for flock locks
+	interval_tree_test -d -n 300 -l 20000 -r 64 ||
+		error "interval tree unit test with duplicates failed"
+
+	# one tagged tree must find the same conflicts as one tree per mode
+	interval_tree_test -b -n 100000 -l 100000 -r 1000000000 ||
+		error "interval tree benchmark failed"
+}
+run_test 438 "extent lock interval tree unit test and benchmark"
+
+test_439() {
+	flock_is_enabled || skip_env "mount w/o flock enabled"
+
+	local held
+	local n
+	local out
+	local ops
+
+	touch $DIR/$tfile || error "touch $DIR/$tfile failed"
+	# throughput against the number of contenders, and against the
+	# number of granted locks the conflict check has to look through
+	for held in 10 1000; do
+		for n in 1 4 16 64; do
+			out=$(flocks_test 6 $n $held 5 $DIR/$tfile) ||
+				error "flocks_test 6 $n $held failed"
+			echo "$out"
+			ops=$(awk '{ print $5 }' <<< "$out")
+			(( ops > 0 )) ||
+				error "no lock taken by $n contenders: $out"
+		done
+	done
+}
+run_test 439 "flock throughput with many contenders"
+
+test_440() {
+	local mnt2=$MOUNT.440
+	local dir2=${DIR/$MOUNT/$mnt2}
+	local stats
+	local ncpt
+	local rows
+	local md
+	local data
+	local i
+
+	$LCTL get_param -n ldlm.bl_queue_stats &> /dev/null ||
+		skip "no ldlm.bl_queue_stats"
+
+	# a second mount to revoke the locks of this one
+	mkdir -p $mnt2
+	mount_client $mnt2 || error "mount $mnt2 failed"
+	stack_trap "umount_client $mnt2; rmdir $mnt2" EXIT
+
+	# MDC locks and OSC locks with dirty pages on this mount
+	createmany -o $DIR/$tfile- 200 || error "createmany failed"
+	stack_trap "unlinkmany $DIR/$tfile- 200" EXIT
+	for ((i = 0; i < 200; i++)); do
+		dd if=/dev/zero of=$DIR/$tfile-$i bs=1M count=1 \
+			2> /dev/null || error "dd failed"
+	done
+	ls -l $DIR > /dev/null
+
+	$LCTL set_param ldlm.bl_queue_stats=clear ||
+		error "cannot reset ldlm.bl_queue_stats"
+
+	# revoke them together, the data cancels have pages to flush
+	for ((i = 0; i < 200; i++)); do
+		cat $dir2/$tfile-$i > /dev/null &
+		chmod 0600 $dir2/$tfile-$i &
+	done
+	wait
+
+	stats=$($LCTL get_param -n ldlm.bl_queue_stats)
+	echo "$stats"
+
+	# one row per CPT and class, the wait average is never above the max
+	ncpt=$(awk '$1 ~ /^[0-9]+$/ { print $1 }' <<< "$stats" | sort -u |
+	       wc -l)
+	rows=$(awk '$1 ~ /^[0-9]+$/' <<< "$stats" | wc -l)
+	(( rows == ncpt * 3 )) || error "expect $((ncpt * 3)) rows, got $rows"
+	awk '$1 ~ /^[0-9]+$/ && $5 > $6 { exit 1 }' <<< "$stats" ||
+		error "average wait above the maximum"
+
+	# average waits over all CPTs, only reported as BL threads are
+	# started on demand and a backlog rarely forms
+	md=($(awk '$2 == "metadata" { n += $4; t += $4 * $5 }
+		   END { print n, (n ? int(t / n) : 0) }' <<< "$stats"))
+	data=($(awk '$2 == "data" { n += $4; t += $4 * $5 }
+		     END { print n, (n ? int(t / n) : 0) }' <<< "$stats"))
+	echo "metadata: ${md[0]} waited ${md[1]}us, data: ${data[0]} waited ${data[1]}us"
+	(( md[0] > 0 && data[0] > 0 )) ||
+		error "no metadata or data blocking callbacks"
+}
+run_test 440 "blocking callback queue statistics"
+
 prep_801() {
 	[[ $(lustre_version_code mds1) -lt $(version_code 2.9.55) ]] ||
 	[[ $OST1_VERSION -lt $(version_code 2.9.55) ]] &&
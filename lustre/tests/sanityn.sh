@@ -4707,6 +4707,111 @@ test_102() {
 }
 run_test 102 "Test open by handle of unlinked file"
 
+test_103() {
+	local client=$($LFS getname $MOUNT1 | awk '{ print $1 }')
+	local osc_ns=ldlm.namespaces.$FSNAME-OST0000-osc-${client##*-}
+	local ost_ns=ldlm.namespaces.filter-$FSNAME-OST0000_UUID
+	local rpcs
+	local locks
+	local count
+	local i
+
+	$LCTL get_param -n osc.$FSNAME-OST0000-osc-${client##*-}.import |
+		grep -q batch_bl_ast ||
+		skip "OST does not support batched blocking ASTs"
+
+	$LFS setstripe -c 1 -i 0 $DIR1/$tfile || error "setstripe failed"
+	dd if=/dev/zero of=$DIR1/$tfile bs=1M count=16 ||
+		error "dd failed"
+	cancel_lru_locks osc
+
+	rpcs=$(do_facet ost1 $LCTL get_param -n $ost_ns.bl_ast_batch_stats |
+	       awk '{ print $2 }')
+	locks=$(do_facet ost1 $LCTL get_param -n $ost_ns.bl_ast_batch_stats |
+		awk '{ print $4 }')
+
+	# one non-expanding PR lock for each MiB of the file on mount1
+	for ((i = 0; i < 16; i++)); do
+		$LFS ladvise -a lockahead -m READ -s ${i}M -l 4k \
+			$DIR1/$tfile || error "lockahead $i failed"
+	done
+	wait_update $HOSTNAME "$LCTL get_param -n $osc_ns.lock_count" 16 ||
+		error "lockahead locks not granted"
+
+	# the truncate lock conflicts with all of them
+	$TRUNCATE $DIR2/$tfile 0 || error "truncate failed"
+	wait_update $HOSTNAME "$LCTL get_param -n $osc_ns.lock_count" 0 ||
+		error "locks not cancelled"
+
+	count=$(do_facet ost1 $LCTL get_param -n $ost_ns.bl_ast_batch_stats |
+		awk '{ print $2 }')
+	(( count > rpcs )) || error "no batched blocking AST sent"
+	count=$(do_facet ost1 $LCTL get_param -n $ost_ns.bl_ast_batch_stats |
+		awk '{ print $4 }')
+	(( count - locks >= 16 )) ||
+		error "only $((count - locks)) locks in batched ASTs"
+
+	local old_batch=$(do_facet ost1 $LCTL get_param -n \
+			  $ost_ns.max_bl_ast_batch)
+
+	stack_trap "do_facet ost1 $LCTL set_param \
+		    $ost_ns.max_bl_ast_batch=$old_batch" EXIT
+	do_facet ost1 $LCTL set_param $ost_ns.max_bl_ast_batch=1 ||
+		error "cannot disable batching"
+	do_facet ost1 $LCTL set_param $ost_ns.max_bl_ast_batch=$((512 + 1)) &&
+		error "batch size over the limit accepted"
+	rm -f $DIR1/$tfile
+}
+run_test 103 "blocking ASTs to one client are batched"
+
+test_104() {
+	local client=$($LFS getname $MOUNT1 | awk '{ print $1 }')
+	local osc_ns=ldlm.namespaces.$FSNAME-OST0000-osc-${client##*-}
+	local tmp=$TMP/$tfile
+	local count
+
+	$LCTL get_param -n osc.$FSNAME-OST0000-osc-${client##*-}.import |
+		grep -q extent_convert ||
+		skip "OST does not support extent lock convert"
+
+	$LFS setstripe -c 1 -i 0 $DIR1/$tfile || error "setstripe failed"
+	stack_trap "rm -f $tmp $DIR1/$tfile" EXIT
+
+	# a reader on mount2 downgrades the PW lock of mount1 to PR
+	cancel_lru_locks osc
+	dd if=/dev/urandom of=$tmp bs=1M count=1 || error "dd to $tmp failed"
+	dd if=$tmp of=$DIR1/$tfile bs=1M count=1 conv=notrunc ||
+		error "write on mount1 failed"
+	count=$($LCTL get_param -n $osc_ns.lock_count)
+	cmp $tmp $DIR2/$tfile || error "data differs on mount2"
+	(( $($LCTL get_param -n $osc_ns.lock_count) == count )) ||
+		error "lock of mount1 cancelled, not downgraded"
+	cmp $tmp $DIR1/$tfile || error "data differs on mount1"
+	(( $($LCTL get_param -n $osc_ns.lock_count) == count )) ||
+		error "downgraded lock not matched for read"
+
+	# a writer at 8MiB on mount2 trims the lock of mount1 below 8MiB
+	cancel_lru_locks osc
+	dd if=$tmp of=$DIR1/$tfile bs=1M count=1 conv=notrunc ||
+		error "write on mount1 failed"
+	count=$($LCTL get_param -n $osc_ns.lock_count)
+	dd if=$tmp of=$DIR2/$tfile bs=1M count=1 seek=8 conv=notrunc ||
+		error "write on mount2 failed"
+	(( $($LCTL get_param -n $osc_ns.lock_count) == count )) ||
+		error "lock of mount1 cancelled, not shrunk"
+	dd if=$tmp of=$DIR1/$tfile bs=1M count=1 seek=1 conv=notrunc ||
+		error "write below 8MiB on mount1 failed"
+	(( $($LCTL get_param -n $osc_ns.lock_count) == count )) ||
+		error "shrunk lock not matched for write"
+
+	cancel_lru_locks osc
+	cmp -n 1048576 $tmp $DIR1/$tfile || error "first MiB differs"
+	cmp -n 1048576 $tmp $DIR1/$tfile 0 1048576 ||
+		error "second MiB differs"
+	cmp -n 1048576 $tmp $DIR2/$tfile 0 8388608 || error "9th MiB differs"
+}
+run_test 104 "extent locks are shrunk or downgraded instead of cancelled"
+
 log "cleanup: ======================================================"
 
 # kill and wait in each test only guarentee script finish, but command in script
@@ -768,6 +768,7 @@ int
 jt_ptl_print_connections (int argc, char **argv)
 {
         struct libcfs_ioctl_data data;
+	struct ksock_conn_stats	 stats;
 	struct lnet_process_id        id;
 	char                     buffer[2][HOST_NAME_MAX + 1];
         int                      index;
@@ -780,6 +781,11 @@ jt_ptl_print_connections (int argc, char **argv)
                 LIBCFS_IOC_INIT(data);
                 data.ioc_net     = g_net;
                 data.ioc_count   = index;
+		if (g_net_is_compatible(NULL, SOCKLND, 0)) {
+			memset(&stats, 0, sizeof(stats));
+			data.ioc_plen1 = sizeof(stats);
+			data.ioc_pbuf1 = &stats;
+		}
 
                 rc = l_ioctl(LNET_DEV_ID, IOC_LIBCFS_GET_CONN, &data);
                 if (rc != 0)
@@ -788,7 +794,8 @@ jt_ptl_print_connections (int argc, char **argv)
 		if (g_net_is_compatible(NULL, SOCKLND, 0)) {
 			id.nid = data.ioc_nid;
 			id.pid = data.ioc_u32[6];
-			printf("%-20s %s[%d]%s->%s:%d %d/%d %s\n",
+			printf("%-20s %s[%d]%s->%s:%d %d/%d %s "
+			       "stripe %u tx %llu/%llu rx %llu/%llu\n",
 			       libcfs_id2str(id),
 			       (data.ioc_u32[3] == SOCKLND_CONN_ANY) ? "A" :
 			       (data.ioc_u32[3] == SOCKLND_CONN_CONTROL) ? "C" :
@@ -804,7 +811,12 @@ jt_ptl_print_connections (int argc, char **argv)
 			       data.ioc_u32[1],         /* remote port */
 			       data.ioc_count, /* tx buffer size */
 			       data.ioc_u32[5], /* rx buffer size */
-			       data.ioc_flags ? "nagle" : "nonagle");
+			       data.ioc_flags ? "nagle" : "nonagle",
+			       stats.kcs_stripe,
+			       (unsigned long long)stats.kcs_tx_msgs,
+			       (unsigned long long)stats.kcs_tx_bytes,
+			       (unsigned long long)stats.kcs_rx_msgs,
+			       (unsigned long long)stats.kcs_rx_bytes);
 		} else if (g_net_is_compatible(NULL, O2IBLND, 0)) {
 			printf("%s mtu %d\n",
 			       libcfs_nid2str(data.ioc_nid),
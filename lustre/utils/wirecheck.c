@@ -474,6 +474,7 @@ check_ptlrpc_body(void)
 
 	CHECK_VALUE(MSGHDR_AT_SUPPORT);
 	CHECK_VALUE(MSGHDR_CKSUM_INCOMPAT18);
+	CHECK_VALUE(MSGHDR_REPLY_BUNDLE);
 
 	CHECK_VALUE_X(MSG_RESENT);
 	CHECK_VALUE_X(MSG_REPLAY);
@@ -489,6 +490,27 @@ check_ptlrpc_body(void)
 	CHECK_VALUE_X(MSG_CONNECT_TRANSNO);
 }
 
+static void
+check_ptlrpc_bundle_hdr(void)
+{
+	BLANK_LINE();
+	CHECK_STRUCT(ptlrpc_bundle_hdr);
+	CHECK_MEMBER(ptlrpc_bundle_hdr, pbh_magic);
+	CHECK_MEMBER(ptlrpc_bundle_hdr, pbh_count);
+	CHECK_MEMBER(ptlrpc_bundle_hdr, pbh_padding);
+	CHECK_VALUE_X(PTLRPC_BUNDLE_MAGIC);
+}
+
+static void
+check_ptlrpc_bundle_ent(void)
+{
+	BLANK_LINE();
+	CHECK_STRUCT(ptlrpc_bundle_ent);
+	CHECK_MEMBER(ptlrpc_bundle_ent, pbe_xid);
+	CHECK_MEMBER(ptlrpc_bundle_ent, pbe_offset);
+	CHECK_MEMBER(ptlrpc_bundle_ent, pbe_len);
+}
+
 /* XXX README XXX:
  * Please DO NOT add flag values here before first ensuring that this same
  * flag value is not in use on some other branch.  Please clear any such
@@ -612,6 +634,9 @@ check_obd_connect_data(void)
 	CHECK_DEFINE_64X(OBD_CONNECT2_PCC);
 	CHECK_DEFINE_64X(OBD_CONNECT2_PLAIN_LAYOUT);
 	CHECK_DEFINE_64X(OBD_CONNECT2_ASYNC_DISCARD);
+	CHECK_DEFINE_64X(OBD_CONNECT2_BATCH_BL_AST);
+	CHECK_DEFINE_64X(OBD_CONNECT2_LOCK_BUDGET);
+	CHECK_DEFINE_64X(OBD_CONNECT2_EXTENT_CONVERT);
 
 	CHECK_VALUE_X(OBD_CKSUM_CRC32);
 	CHECK_VALUE_X(OBD_CKSUM_ADLER);
@@ -2849,6 +2874,8 @@ main(int argc, char **argv)
 	check_lustre_handle();
 	check_lustre_msg_v2();
 	check_ptlrpc_body();
+	check_ptlrpc_bundle_hdr();
+	check_ptlrpc_bundle_ent();
 	check_obd_connect_data();
 	check_ost_layout();
 	check_obdo();
@@ -1062,6 +1062,8 @@ void lustre_assert_wire_constants(void)
 		 (long long)MSGHDR_AT_SUPPORT);
 	LASSERTF(MSGHDR_CKSUM_INCOMPAT18 == 2, "found %lld\n",
 		 (long long)MSGHDR_CKSUM_INCOMPAT18);
+	LASSERTF(MSGHDR_REPLY_BUNDLE == 4, "found %lld\n",
+		 (long long)MSGHDR_REPLY_BUNDLE);
 	LASSERTF(MSG_RESENT == 0x00000002UL, "found 0x%.8xUL\n",
 		(unsigned)MSG_RESENT);
 	LASSERTF(MSG_REPLAY == 0x00000004UL, "found 0x%.8xUL\n",
@@ -1085,6 +1087,40 @@ void lustre_assert_wire_constants(void)
 	LASSERTF(MSG_CONNECT_TRANSNO == 0x00000100UL, "found 0x%.8xUL\n",
 		(unsigned)MSG_CONNECT_TRANSNO);
 
+	/* Checks for struct ptlrpc_bundle_hdr */
+	LASSERTF((int)sizeof(struct ptlrpc_bundle_hdr) == 16, "found %lld\n",
+		 (long long)(int)sizeof(struct ptlrpc_bundle_hdr));
+	LASSERTF((int)offsetof(struct ptlrpc_bundle_hdr, pbh_magic) == 0, "found %lld\n",
+		 (long long)(int)offsetof(struct ptlrpc_bundle_hdr, pbh_magic));
+	LASSERTF((int)sizeof(((struct ptlrpc_bundle_hdr *)0)->pbh_magic) == 4, "found %lld\n",
+		 (long long)(int)sizeof(((struct ptlrpc_bundle_hdr *)0)->pbh_magic));
+	LASSERTF((int)offsetof(struct ptlrpc_bundle_hdr, pbh_count) == 4, "found %lld\n",
+		 (long long)(int)offsetof(struct ptlrpc_bundle_hdr, pbh_count));
+	LASSERTF((int)sizeof(((struct ptlrpc_bundle_hdr *)0)->pbh_count) == 4, "found %lld\n",
+		 (long long)(int)sizeof(((struct ptlrpc_bundle_hdr *)0)->pbh_count));
+	LASSERTF((int)offsetof(struct ptlrpc_bundle_hdr, pbh_padding) == 8, "found %lld\n",
+		 (long long)(int)offsetof(struct ptlrpc_bundle_hdr, pbh_padding));
+	LASSERTF((int)sizeof(((struct ptlrpc_bundle_hdr *)0)->pbh_padding) == 8, "found %lld\n",
+		 (long long)(int)sizeof(((struct ptlrpc_bundle_hdr *)0)->pbh_padding));
+	LASSERTF(PTLRPC_BUNDLE_MAGIC == 0x0bd0b0deUL, "found 0x%.8xUL\n",
+		(unsigned)PTLRPC_BUNDLE_MAGIC);
+
+	/* Checks for struct ptlrpc_bundle_ent */
+	LASSERTF((int)sizeof(struct ptlrpc_bundle_ent) == 16, "found %lld\n",
+		 (long long)(int)sizeof(struct ptlrpc_bundle_ent));
+	LASSERTF((int)offsetof(struct ptlrpc_bundle_ent, pbe_xid) == 0, "found %lld\n",
+		 (long long)(int)offsetof(struct ptlrpc_bundle_ent, pbe_xid));
+	LASSERTF((int)sizeof(((struct ptlrpc_bundle_ent *)0)->pbe_xid) == 8, "found %lld\n",
+		 (long long)(int)sizeof(((struct ptlrpc_bundle_ent *)0)->pbe_xid));
+	LASSERTF((int)offsetof(struct ptlrpc_bundle_ent, pbe_offset) == 8, "found %lld\n",
+		 (long long)(int)offsetof(struct ptlrpc_bundle_ent, pbe_offset));
+	LASSERTF((int)sizeof(((struct ptlrpc_bundle_ent *)0)->pbe_offset) == 4, "found %lld\n",
+		 (long long)(int)sizeof(((struct ptlrpc_bundle_ent *)0)->pbe_offset));
+	LASSERTF((int)offsetof(struct ptlrpc_bundle_ent, pbe_len) == 12, "found %lld\n",
+		 (long long)(int)offsetof(struct ptlrpc_bundle_ent, pbe_len));
+	LASSERTF((int)sizeof(((struct ptlrpc_bundle_ent *)0)->pbe_len) == 4, "found %lld\n",
+		 (long long)(int)sizeof(((struct ptlrpc_bundle_ent *)0)->pbe_len));
+
 	/* Checks for struct obd_connect_data */
 	LASSERTF((int)sizeof(struct obd_connect_data) == 192, "found %lld\n",
 		 (long long)(int)sizeof(struct obd_connect_data));
@@ -1374,6 +1410,12 @@ void lustre_assert_wire_constants(void)
 		 OBD_CONNECT2_PLAIN_LAYOUT);
 	LASSERTF(OBD_CONNECT2_ASYNC_DISCARD == 0x4000ULL, "found 0x%.16llxULL\n",
 		 OBD_CONNECT2_ASYNC_DISCARD);
+	LASSERTF(OBD_CONNECT2_BATCH_BL_AST == 0x8000ULL, "found 0x%.16llxULL\n",
+		 OBD_CONNECT2_BATCH_BL_AST);
+	LASSERTF(OBD_CONNECT2_LOCK_BUDGET == 0x10000ULL, "found 0x%.16llxULL\n",
+		 OBD_CONNECT2_LOCK_BUDGET);
+	LASSERTF(OBD_CONNECT2_EXTENT_CONVERT == 0x20000ULL, "found 0x%.16llxULL\n",
+		 OBD_CONNECT2_EXTENT_CONVERT);
 	LASSERTF(OBD_CKSUM_CRC32 == 0x00000001UL, "found 0x%.8xUL\n",
 		(unsigned)OBD_CKSUM_CRC32);
 	LASSERTF(OBD_CKSUM_ADLER == 0x00000002UL, "found 0x%.8xUL\n",